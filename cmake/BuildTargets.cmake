@@ -28,7 +28,7 @@ add_library(
 	${TSNE_HEADERS} ${TSNE_SOURCES} 		# t-SNE
 	${PIE_RC}
 	)
-target_link_libraries(${PIE_DLL_CORE_NAME} ${VERSION_LIB} ${OpenCV_LIBS}) 
+target_link_libraries(${PIE_DLL_CORE_NAME} ${VERSION_LIB} ${OpenCV_LIBS} ${PIE_COMPRESSION_LIBS}) 
 
 add_dependencies(${PIE_BINARY_NAME} ${PIE_DLL_CORE_NAME}) 
 
@@ -115,6 +115,8 @@ configure_file(${PIE_SOURCE_DIR}/PIE.cmake.in ${CMAKE_BINARY_DIR}/PIE.cmake)
 
 # tests
 # add_test(NAME tSNE COMMAND ${PIE_BINARY_NAME} "--tSNE")
+add_test(NAME UnitTests COMMAND ${PIE_BINARY_NAME} "--test")
+set_tests_properties(UnitTests PROPERTIES ENVIRONMENT "QT_QPA_PLATFORM=offscreen")
 
 #package 
 if (UNIX)
@@ -64,6 +64,31 @@ macro(PIE_FIND_OPENCV)
 	set_property(DIRECTORY . PROPERTY INCLUDE_DIRECTORIES ${the_include_dirs})
 endmacro(PIE_FIND_OPENCV)
 
+# optional compression libraries for compressed databases
+macro(PIE_FIND_COMPRESSION)
+
+	set(PIE_COMPRESSION_LIBS "")
+
+	find_package(ZLIB)
+	if (ZLIB_FOUND)
+		include_directories(${ZLIB_INCLUDE_DIRS})
+		list(APPEND PIE_COMPRESSION_LIBS ${ZLIB_LIBRARIES})
+		add_definitions(-DWITH_ZLIB)
+	else()
+		message(STATUS "zlib not found - gzip databases cannot be loaded")
+	endif()
+
+	find_path(ZSTD_INCLUDE_DIR zstd.h)
+	find_library(ZSTD_LIBRARY NAMES zstd zstd_static)
+	if (ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+		include_directories(${ZSTD_INCLUDE_DIR})
+		list(APPEND PIE_COMPRESSION_LIBS ${ZSTD_LIBRARY})
+		add_definitions(-DWITH_ZSTD)
+	else()
+		message(STATUS "zstd not found - zstd databases cannot be loaded")
+	endif()
+endmacro(PIE_FIND_COMPRESSION)
+
 # check if the c++ compiler supports c++11 (our code uses parts of this standard)
 macro(PIE_CHECK_COMPILER)
 	
@@ -0,0 +1,195 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#include "sptree.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tsne {
+
+	QuadTree::QuadTree(const double* Y, int n) : mY(Y) {
+
+		mNodes.reserve(2 * (size_t)n);
+
+		Node root;
+
+		if (n > 0) {
+
+			double minX = Y[0], maxX = Y[0];
+			double minY = Y[1], maxY = Y[1];
+
+			for (int idx = 1; idx < n; idx++) {
+				minX = std::min(minX, Y[2 * idx]);
+				maxX = std::max(maxX, Y[2 * idx]);
+				minY = std::min(minY, Y[2 * idx + 1]);
+				maxY = std::max(maxY, Y[2 * idx + 1]);
+			}
+
+			root.cx = (minX + maxX) * 0.5;
+			root.cy = (minY + maxY) * 0.5;
+			root.hw = std::max(maxX - minX, maxY - minY) * 0.5 + 1e-5;
+		}
+
+		mNodes.push_back(root);
+
+		for (int idx = 0; idx < n; idx++)
+			insert(idx);
+	}
+
+	/// <summary>
+	/// Computes the repulsive forces acting on a point.
+	/// </summary>
+	/// <param name="idx">The point's index.</param>
+	/// <param name="theta">The Barnes-Hut accuracy (0 = exact).</param>
+	/// <param name="negF">The (unnormalized) repulsive force is added here.</param>
+	/// <param name="sumQ">The point's contribution to the normalization Z is added here.</param>
+	void QuadTree::computeNonEdgeForces(int idx, double theta, double negF[2], double & sumQ) const {
+
+		const double x = mY[2 * idx];
+		const double y = mY[2 * idx + 1];
+		const double theta2 = theta * theta;
+
+		int stack[256];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top > 0) {
+
+			const Node& n = mNodes[stack[--top]];
+
+			if (n.size == 0)
+				continue;
+
+			double dx = x - n.comX;
+			double dy = y - n.comY;
+			double D = dx * dx + dy * dy;
+			double w = 2.0 * n.hw;
+
+			// summarize the cell if it is a leaf or small compared to its distance
+			if (n.firstChild == -1 || w * w < theta2 * D) {
+
+				// the point itself does not push
+				int mult = (D == 0.0) ? n.size - 1 : n.size;
+
+				double q = 1.0 / (1.0 + D);
+				double mq = mult * q;
+				sumQ += mq;
+				mq *= q;
+				negF[0] += mq * dx;
+				negF[1] += mq * dy;
+			}
+			else {
+				for (int cIdx = 0; cIdx < 4 && top < 256; cIdx++)
+					stack[top++] = n.firstChild + cIdx;
+			}
+		}
+	}
+
+	int QuadTree::numNodes() const {
+		return (int)mNodes.size();
+	}
+
+	void QuadTree::insert(int idx) {
+
+		const double x = mY[2 * idx];
+		const double y = mY[2 * idx + 1];
+
+		int node = 0;
+
+		for (;;) {
+
+			if (mNodes[node].firstChild == -1) {
+
+				Node& n = mNodes[node];
+
+				if (n.size == 0) {
+					n.point = idx;
+					n.comX = x;
+					n.comY = y;
+					n.size = 1;
+					return;
+				}
+
+				// duplicates (or cells which cannot be split anymore) are merged
+				const double* p = mY + 2 * n.point;
+				if ((p[0] == x && p[1] == y) || n.hw < 1e-10) {
+					n.comX = (n.comX * n.size + x) / (n.size + 1);
+					n.comY = (n.comY * n.size + y) / (n.size + 1);
+					n.size++;
+					return;
+				}
+
+				subdivide(node);
+			}
+
+			Node& n = mNodes[node];
+			n.comX = (n.comX * n.size + x) / (n.size + 1);
+			n.comY = (n.comY * n.size + y) / (n.size + 1);
+			n.size++;
+
+			node = n.firstChild + quadrant(n, x, y);
+		}
+	}
+
+	void QuadTree::subdivide(int node) {
+
+		// copy - push_back might reallocate
+		Node parent = mNodes[node];
+		int first = (int)mNodes.size();
+		double hw = parent.hw * 0.5;
+
+		for (int cIdx = 0; cIdx < 4; cIdx++) {
+
+			Node c;
+			c.cx = parent.cx + ((cIdx & 1) ? hw : -hw);
+			c.cy = parent.cy + ((cIdx & 2) ? hw : -hw);
+			c.hw = hw;
+			mNodes.push_back(c);
+		}
+
+		// move the leaf's point (and its duplicates) to a child
+		const double* p = mY + 2 * parent.point;
+		Node& c = mNodes[first + quadrant(parent, p[0], p[1])];
+		c.point = parent.point;
+		c.comX = parent.comX;
+		c.comY = parent.comY;
+		c.size = parent.size;
+
+		mNodes[node].firstChild = first;
+		mNodes[node].point = -1;
+	}
+
+	int QuadTree::quadrant(const Node & n, double x, double y) {
+		return (x >= n.cx ? 1 : 0) | (y >= n.cy ? 2 : 0);
+	}
+
+}
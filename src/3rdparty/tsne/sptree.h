@@ -0,0 +1,73 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#include <vector>
+
+namespace tsne {
+
+/// <summary>
+/// A 2D Barnes-Hut tree (quadtree) of the embedding.
+/// Distant cells are summarized by their center of mass
+/// which reduces the repulsive forces to O(N log N).
+/// Coincident points are merged into one leaf.
+/// </summary>
+class QuadTree {
+
+public:
+	QuadTree(const double* Y, int n);
+
+	void computeNonEdgeForces(int idx, double theta, double negF[2], double& sumQ) const;
+
+	int numNodes() const;
+
+private:
+	struct Node {
+		double cx = 0.0;		// cell center
+		double cy = 0.0;
+		double hw = 0.0;		// half width (cells are square)
+		double comX = 0.0;		// center of mass
+		double comY = 0.0;
+		int size = 0;			// number of points in the cell
+		int firstChild = -1;	// the 4 children are stored consecutively
+		int point = -1;			// a leaf's point
+	};
+
+	void insert(int idx);
+	void subdivide(int node);
+	static int quadrant(const Node& n, double x, double y);
+
+	const double* mY;
+	std::vector<Node> mNodes;
+};
+
+}
@@ -0,0 +1,412 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#include "tsne.h"
+#include "sptree.h"
+#include "vptree.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+#include <opencv2/core.hpp>
+
+namespace tsne {
+
+	/// <summary>
+	/// Embeds the rows of X into 2D.
+	/// </summary>
+	/// <param name="X">The input data (N x D, row-major).</param>
+	/// <param name="N">The number of points.</param>
+	/// <param name="D">The input dimension.</param>
+	/// <param name="Y">The embedding (N x 2, row-major) which is allocated by the caller.</param>
+	/// <param name="params">The t-SNE parameters.</param>
+	/// <param name="cb">An optional callback for progress updates and cancellation.</param>
+	/// <returns>false if the input is too small or the callback cancelled.</returns>
+	bool TSNE::run(const float* X, int N, int D, double* Y, const Params& params, Callback cb) {
+
+		if (N < 4 || D < 1)
+			return false;
+
+		Params p = params;
+
+		// we need at least 3 * perplexity neighbors
+		if (N - 1 < 3 * p.perplexity)
+			p.perplexity = (N - 1) / 3.0;
+
+		// zero-mean and scale the input to [-1 1]
+		std::vector<float> Xn(X, X + (size_t)N * D);
+		std::vector<double> mean(D, 0.0);
+
+		for (int idx = 0; idx < N; idx++)
+			for (int dIdx = 0; dIdx < D; dIdx++)
+				mean[dIdx] += Xn[(size_t)idx * D + dIdx];
+
+		float maxAbs = 0.0f;
+		for (int idx = 0; idx < N; idx++) {
+			for (int dIdx = 0; dIdx < D; dIdx++) {
+				float& v = Xn[(size_t)idx * D + dIdx];
+				v -= (float)(mean[dIdx] / N);
+				maxAbs = std::max(maxAbs, std::abs(v));
+			}
+		}
+
+		if (maxAbs > 0.0f) {
+			for (float& v : Xn)
+				v /= maxAbs;
+		}
+
+		SparseMatrix P = computeSimilarities(Xn.data(), N, D, p);
+		Xn.clear();
+
+		// early exaggeration
+		for (double& v : P.vals)
+			v *= p.exaggeration;
+
+		// small random initialization
+		std::mt19937 rng(p.seed);
+		std::normal_distribution<double> nd(0.0, 1e-4);
+		for (int idx = 0; idx < N * 2; idx++)
+			Y[idx] = nd(rng);
+
+		std::vector<double> dY(N * 2), uY(N * 2, 0.0), gains(N * 2, 1.0);
+
+		// a larger learning rate for large N (Belkina et al. 2019)
+		const double eta = std::max(200.0, N / p.exaggeration);
+		double momentum = 0.5;
+
+		const int nt = numThreads(p);
+
+		for (int iter = 0; iter < p.maxIter; iter++) {
+
+			computeGradient(P, Y, N, dY.data(), p);
+
+			parallelFor(N * 2, nt, [&](int start, int end, int) {
+
+				for (int idx = start; idx < end; idx++) {
+
+					// adaptive gains
+					gains[idx] = ((dY[idx] > 0.0) != (uY[idx] > 0.0)) ? gains[idx] + 0.2 : gains[idx] * 0.8;
+					gains[idx] = std::max(gains[idx], 0.01);
+
+					uY[idx] = momentum * uY[idx] - eta * gains[idx] * dY[idx];
+					Y[idx] += uY[idx];
+				}
+			});
+
+			// zero-mean the embedding
+			double mx = 0.0, my = 0.0;
+			for (int idx = 0; idx < N; idx++) {
+				mx += Y[2 * idx];
+				my += Y[2 * idx + 1];
+			}
+			mx /= N;
+			my /= N;
+			for (int idx = 0; idx < N; idx++) {
+				Y[2 * idx] -= mx;
+				Y[2 * idx + 1] -= my;
+			}
+
+			if (iter == p.stopLyingIter) {
+				for (double& v : P.vals)
+					v /= p.exaggeration;
+			}
+
+			if (iter == p.momentumSwitchIter)
+				momentum = 0.8;
+
+			bool last = iter == p.maxIter - 1;
+			if (cb && (last || (p.callbackInterval > 0 && iter % p.callbackInterval == 0))) {
+				if (!cb(iter + 1, Y))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Runs f on n items which are split into one chunk per thread.
+	/// The chunks run on OpenCV's thread pool (no threads are created per call).
+	/// </summary>
+	void TSNE::parallelFor(int n, int numThreads, const std::function<void(int start, int end, int thread)>& f) {
+
+		int nt = std::max(1, std::min(numThreads, n / 256));
+
+		if (nt == 1) {
+			f(0, n, 0);
+			return;
+		}
+
+		// one stripe per chunk - so the chunk index addresses per-thread buffers
+		cv::parallel_for_(cv::Range(0, nt), [&](const cv::Range& r) {
+
+			for (int tIdx = r.start; tIdx < r.end; tIdx++) {
+				int start = (int)((long long)n * tIdx / nt);
+				int end = (int)((long long)n * (tIdx + 1) / nt);
+				f(start, end, tIdx);
+			}
+		}, nt);
+	}
+
+	int TSNE::numThreads(const Params & params) {
+
+		if (params.numThreads > 0)
+			return params.numThreads;
+
+		return std::max(1, cv::getNumThreads());
+	}
+
+	/// <summary>
+	/// Computes the symmetric input similarities P of the k nearest neighbors.
+	/// Each point's gaussian bandwidth is found by a binary search
+	/// so that its conditional distribution has the given perplexity.
+	/// </summary>
+	TSNE::SparseMatrix TSNE::computeSimilarities(const float* X, int N, int D, const Params& p) {
+
+		const int K = std::min(N - 1, (int)(3 * p.perplexity));
+		const int nt = numThreads(p);
+
+		VpTree tree(X, N, D, p.seed);
+
+		// conditional similarities p(j|i) - K per row
+		std::vector<int> nbrs((size_t)N * K);
+		std::vector<double> cond((size_t)N * K);
+
+		parallelFor(N, nt, [&](int start, int end, int) {
+
+			std::vector<int> indices;
+			std::vector<float> distances;
+			std::vector<double> cp(K);
+			std::vector<std::pair<int, double> > row(K);
+
+			for (int idx = start; idx < end; idx++) {
+
+				tree.search(idx, K, indices, distances);
+
+				// squared distances relative to the nearest neighbor (avoids underflows)
+				std::vector<double> d2(indices.size());
+				for (size_t nIdx = 0; nIdx < d2.size(); nIdx++)
+					d2[nIdx] = (double)distances[nIdx] * distances[nIdx];
+				double d0 = d2.empty() ? 0.0 : d2[0];
+				for (double& v : d2)
+					v -= d0;
+
+				double beta = 1.0;
+				double minBeta = -DBL_MAX;
+				double maxBeta = DBL_MAX;
+				const double target = std::log(p.perplexity);
+				double sumP = 0.0;
+
+				for (int it = 0; it < 200; it++) {
+
+					sumP = DBL_MIN;
+					double H = 0.0;
+
+					for (size_t nIdx = 0; nIdx < d2.size(); nIdx++) {
+						cp[nIdx] = std::exp(-beta * d2[nIdx]);
+						sumP += cp[nIdx];
+						H += beta * d2[nIdx] * cp[nIdx];
+					}
+
+					H = H / sumP + std::log(sumP);
+					double diff = H - target;
+
+					if (std::abs(diff) < 1e-5)
+						break;
+
+					if (diff > 0) {
+						minBeta = beta;
+						beta = (maxBeta == DBL_MAX) ? beta * 2.0 : (beta + maxBeta) * 0.5;
+					}
+					else {
+						maxBeta = beta;
+						beta = (minBeta == -DBL_MAX) ? beta * 0.5 : (beta + minBeta) * 0.5;
+					}
+				}
+
+				// rows are sorted by column so that they can be merged later
+				for (size_t nIdx = 0; nIdx < indices.size(); nIdx++)
+					row[nIdx] = std::make_pair(indices[nIdx], cp[nIdx] / sumP);
+				std::sort(row.begin(), row.begin() + indices.size());
+
+				for (int nIdx = 0; nIdx < K; nIdx++) {
+					bool valid = nIdx < (int)indices.size();
+					nbrs[(size_t)idx * K + nIdx] = valid ? row[nIdx].first : -1;
+					cond[(size_t)idx * K + nIdx] = valid ? row[nIdx].second : 0.0;
+				}
+			}
+		});
+
+		// transpose: who has i as neighbor (sorted by row since rows are visited in order)
+		std::vector<int> revPtr(N + 1, 0);
+		for (int j : nbrs)
+			if (j >= 0)
+				revPtr[j + 1]++;
+		for (int idx = 0; idx < N; idx++)
+			revPtr[idx + 1] += revPtr[idx];
+
+		std::vector<int> revCols(revPtr[N]);
+		std::vector<double> revVals(revPtr[N]);
+		std::vector<int> fill(revPtr.begin(), revPtr.end() - 1);
+
+		for (int idx = 0; idx < N; idx++) {
+			for (int nIdx = 0; nIdx < K; nIdx++) {
+				int j = nbrs[(size_t)idx * K + nIdx];
+				if (j < 0)
+					continue;
+				revCols[fill[j]] = idx;
+				revVals[fill[j]] = cond[(size_t)idx * K + nIdx];
+				fill[j]++;
+			}
+		}
+
+		// P = (P + P^T) / 2N - merge each row with its transposed row
+		auto merge = [&](int idx, int* cols, double* vals) {
+
+			const int* a = &nbrs[(size_t)idx * K];
+			const double* av = &cond[(size_t)idx * K];
+			int na = K;
+			while (na > 0 && a[na - 1] < 0)
+				na--;
+
+			int ia = 0, ib = revPtr[idx], cnt = 0;
+			const int nb = revPtr[idx + 1];
+
+			while (ia < na || ib < nb) {
+
+				int col;
+				double val = 0.0;
+
+				if (ib == nb || (ia < na && a[ia] < revCols[ib])) {
+					col = a[ia];
+					val = av[ia++];
+				}
+				else if (ia == na || revCols[ib] < a[ia]) {
+					col = revCols[ib];
+					val = revVals[ib++];
+				}
+				else {
+					col = a[ia];
+					val = av[ia++] + revVals[ib++];
+				}
+
+				if (cols) {
+					cols[cnt] = col;
+					vals[cnt] = val / (2.0 * N);
+				}
+				cnt++;
+			}
+
+			return cnt;
+		};
+
+		SparseMatrix P;
+		P.rowPtr.resize(N + 1, 0);
+
+		parallelFor(N, nt, [&](int start, int end, int) {
+			for (int idx = start; idx < end; idx++)
+				P.rowPtr[idx + 1] = merge(idx, 0, 0);
+		});
+
+		for (int idx = 0; idx < N; idx++)
+			P.rowPtr[idx + 1] += P.rowPtr[idx];
+
+		P.cols.resize(P.rowPtr[N]);
+		P.vals.resize(P.rowPtr[N]);
+
+		parallelFor(N, nt, [&](int start, int end, int) {
+			for (int idx = start; idx < end; idx++)
+				merge(idx, &P.cols[P.rowPtr[idx]], &P.vals[P.rowPtr[idx]]);
+		});
+
+		return P;
+	}
+
+	/// <summary>
+	/// Computes the gradient of the KL divergence.
+	/// Attractive forces are summed over the sparse P and repulsive
+	/// forces are approximated with a quadtree (Barnes-Hut).
+	/// </summary>
+	void TSNE::computeGradient(const SparseMatrix& P, const double* Y, int N, double* dY, const Params& p) {
+
+		QuadTree tree(Y, N);
+
+		const int nt = numThreads(p);
+		std::vector<double> negF(N * 2, 0.0);
+		std::vector<double> sumQ(nt, 0.0);
+
+		parallelFor(N, nt, [&](int start, int end, int thread) {
+
+			double sq = 0.0;
+
+			for (int idx = start; idx < end; idx++) {
+
+				const double yx = Y[2 * idx];
+				const double yy = Y[2 * idx + 1];
+
+				// attractive forces
+				double pf[2] = { 0.0, 0.0 };
+				for (int rIdx = P.rowPtr[idx]; rIdx < P.rowPtr[idx + 1]; rIdx++) {
+
+					int j = P.cols[rIdx];
+					double dx = yx - Y[2 * j];
+					double dy = yy - Y[2 * j + 1];
+					double q = P.vals[rIdx] / (1.0 + dx * dx + dy * dy);
+					pf[0] += q * dx;
+					pf[1] += q * dy;
+				}
+
+				dY[2 * idx] = pf[0];
+				dY[2 * idx + 1] = pf[1];
+
+				// repulsive forces
+				tree.computeNonEdgeForces(idx, p.theta, &negF[2 * idx], sq);
+			}
+
+			sumQ[thread] += sq;
+		});
+
+		double Z = 0.0;
+		for (double s : sumQ)
+			Z += s;
+
+		if (Z <= 0.0)
+			Z = 1.0;
+
+		parallelFor(N * 2, nt, [&](int start, int end, int) {
+			for (int idx = start; idx < end; idx++)
+				dY[idx] -= negF[idx] / Z;
+		});
+	}
+
+}
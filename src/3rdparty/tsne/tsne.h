@@ -0,0 +1,86 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+namespace tsne {
+
+/// <summary>
+/// The t-SNE parameters.
+/// </summary>
+struct Params {
+	double perplexity = 30.0;
+	double theta = 0.5;				// 0 = exact repulsion (slow)
+	int maxIter = 1000;
+	int stopLyingIter = 250;		// early exaggeration ends here
+	int momentumSwitchIter = 250;
+	double exaggeration = 12.0;
+	unsigned int seed = 42;
+	int numThreads = 0;				// 0 = OpenCV's number of threads
+	int callbackInterval = 10;		// iterations between callbacks
+};
+
+/// <summary>
+/// Barnes-Hut t-SNE (van der Maaten 2014) with a 2D output.
+/// Input similarities are computed from the exact k nearest
+/// neighbors (vantage point tree) and the repulsive forces are
+/// approximated by a quadtree. All per-point stages run on
+/// multiple threads.
+/// </summary>
+class TSNE {
+
+public:
+	/// <summary>
+	/// Is called every Params::callbackInterval iterations with the current embedding (N x 2).
+	/// Return false to cancel.
+	/// </summary>
+	typedef std::function<bool(int iter, const double* Y)> Callback;
+
+	static bool run(const float* X, int N, int D, double* Y, const Params& params = Params(), Callback cb = Callback());
+
+	static void parallelFor(int n, int numThreads, const std::function<void(int start, int end, int thread)>& f);
+	static int numThreads(const Params& params);
+
+private:
+	struct SparseMatrix {
+		std::vector<int> rowPtr;
+		std::vector<int> cols;
+		std::vector<double> vals;
+	};
+
+	static SparseMatrix computeSimilarities(const float* X, int N, int D, const Params& params);
+	static void computeGradient(const SparseMatrix& P, const double* Y, int N, double* dY, const Params& params);
+};
+
+}
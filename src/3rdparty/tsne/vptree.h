@@ -0,0 +1,195 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace tsne {
+
+/// <summary>
+/// A vantage point tree for exact k-nearest neighbor queries.
+/// The tree only stores indices into the (row-major) data
+/// which must outlive the tree. Queries are read-only and
+/// can be run from multiple threads.
+/// </summary>
+class VpTree {
+
+public:
+	VpTree(const float* data, int n, int d, unsigned int seed = 42) : mData(data), mN(n), mD(d) {
+
+		mItems.resize(n);
+		for (int idx = 0; idx < n; idx++)
+			mItems[idx] = idx;
+
+		mNodes.reserve(n);
+
+		std::mt19937 rng(seed);
+		mRoot = build(0, n, rng);
+	}
+
+	/// <summary>
+	/// Finds the k nearest neighbors of point idx (the point itself is excluded).
+	/// </summary>
+	/// <param name="idx">The query point.</param>
+	/// <param name="k">The number of neighbors.</param>
+	/// <param name="indices">The neighbors sorted by their distance.</param>
+	/// <param name="distances">The euclidean distances.</param>
+	void search(int idx, int k, std::vector<int>& indices, std::vector<float>& distances) const {
+
+		Heap heap;
+		float tau = std::numeric_limits<float>::max();
+
+		search(mRoot, idx, k, heap, tau);
+
+		indices.resize(heap.size());
+		distances.resize(heap.size());
+
+		for (int rIdx = (int)heap.size() - 1; rIdx >= 0; rIdx--) {
+			indices[rIdx] = heap.top().second;
+			distances[rIdx] = heap.top().first;
+			heap.pop();
+		}
+	}
+
+private:
+	struct Node {
+		int index = -1;
+		float threshold = 0.0f;
+		int left = -1;
+		int right = -1;
+	};
+
+	typedef std::pair<float, int> Item;
+	typedef std::priority_queue<Item> Heap;
+
+	float distance(int a, int b) const {
+
+		const float* pa = mData + (size_t)a * mD;
+		const float* pb = mData + (size_t)b * mD;
+
+		float d = 0.0f;
+		for (int idx = 0; idx < mD; idx++) {
+			float diff = pa[idx] - pb[idx];
+			d += diff * diff;
+		}
+
+		return std::sqrt(d);
+	}
+
+	int build(int lower, int upper, std::mt19937& rng) {
+
+		if (upper == lower)
+			return -1;
+
+		int nIdx = (int)mNodes.size();
+		mNodes.push_back(Node());
+		mNodes[nIdx].index = mItems[lower];
+
+		if (upper - lower > 1) {
+
+			// random vantage point
+			int vp = std::uniform_int_distribution<int>(lower, upper - 1)(rng);
+			std::swap(mItems[lower], mItems[vp]);
+			mNodes[nIdx].index = mItems[lower];
+
+			int median = (upper + lower) / 2;
+			int vi = mItems[lower];
+
+			std::nth_element(
+				mItems.begin() + lower + 1,
+				mItems.begin() + median,
+				mItems.begin() + upper,
+				[this, vi](int a, int b) { return distance(vi, a) < distance(vi, b); });
+
+			mNodes[nIdx].threshold = distance(vi, mItems[median]);
+
+			// NOTE: mNodes might be reallocated - do not keep references
+			int left = build(lower + 1, median, rng);
+			int right = build(median, upper, rng);
+			mNodes[nIdx].left = left;
+			mNodes[nIdx].right = right;
+		}
+
+		return nIdx;
+	}
+
+	void search(int node, int target, int k, Heap& heap, float& tau) const {
+
+		if (node == -1)
+			return;
+
+		const Node& n = mNodes[node];
+		float d = distance(n.index, target);
+
+		if (n.index != target && d < tau) {
+
+			if ((int)heap.size() == k)
+				heap.pop();
+
+			heap.push(Item(d, n.index));
+
+			if ((int)heap.size() == k)
+				tau = heap.top().first;
+		}
+
+		if (n.left == -1 && n.right == -1)
+			return;
+
+		if (d < n.threshold) {
+			if (d - tau <= n.threshold)
+				search(n.left, target, k, heap, tau);
+			if (d + tau >= n.threshold)
+				search(n.right, target, k, heap, tau);
+		}
+		else {
+			if (d + tau >= n.threshold)
+				search(n.right, target, k, heap, tau);
+			if (d - tau <= n.threshold)
+				search(n.left, target, k, heap, tau);
+		}
+	}
+
+	const float* mData;
+	int mN;
+	int mD;
+
+	std::vector<int> mItems;
+	std::vector<Node> mNodes;
+	int mRoot = -1;
+};
+
+}
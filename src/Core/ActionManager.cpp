@@ -61,6 +61,9 @@ QMenu* ActionManager::fileMenu(QWidget* parent /* = 0 */) const {
 	QMenu* m = new QMenu(QObject::tr("&File"), parent);
 
 	m->addAction(mFileAction[file_open_database]);
+	m->addAction(mFileAction[file_import_page_xml]);
+	m->addSeparator();
+	m->addAction(mFileAction[file_export_selection]);
 
 	return m;
 }
@@ -88,6 +91,8 @@ QMenu * ActionManager::editMenu(QWidget * parent) const {
 	QMenu* m = new QMenu(QObject::tr("&Edit"), parent);
 
 	m->addAction(mEditAction[edit_add_dot_plot]);
+	m->addAction(mEditAction[edit_add_hist_plot]);
+	m->addAction(mEditAction[edit_add_splom]);
 	m->addAction(mEditAction[edit_remove_plot]);
 
 	m->addAction(mEditAction[edit_select_all]);
@@ -99,6 +104,9 @@ QMenu* ActionManager::toolsMenu(QWidget* parent /* = 0 */) const {
 
 	QMenu* m = new QMenu(QObject::tr("&Tools"), parent);
 
+	m->addAction(mToolsAction[tools_compute_embedding]);
+	m->addAction(mToolsAction[tools_cluster_pages]);
+	m->addSeparator();
 	m->addAction(mToolsAction[tools_about]);
 	m->addSeparator();
 
@@ -152,6 +160,12 @@ void ActionManager::createActions() {
 	mFileAction[file_open_database]->setToolTip(QObject::tr("Load database to visualize it's collection."));
 	mFileAction[file_open_database]->setShortcut(QKeySequence::Open);
 
+	mFileAction[file_import_page_xml] = new QAction(QObject::tr("&Import PAGE XML..."), 0);
+	mFileAction[file_import_page_xml]->setToolTip(QObject::tr("Create a collection from a folder of PAGE XML files (e.g. a Transkribus export)."));
+
+	mFileAction[file_export_selection] = new QAction(QObject::tr("&Export Selection..."), 0);
+	mFileAction[file_export_selection]->setToolTip(QObject::tr("Save the pages of the selected documents as new database."));
+
 	// view actions
 	mViewAction.resize(view_end);
 
@@ -192,6 +206,13 @@ void ActionManager::createActions() {
 	mEditAction[edit_add_dot_plot]->setShortcut(QKeySequence(sc_add_dot_plot));
 	mEditAction[edit_add_dot_plot]->setToolTip(QObject::tr("Add a new dot plot."));
 
+	mEditAction[edit_add_hist_plot] = new QAction(QPixmap(":/pie/img/hist-plot.png"), QObject::tr("Add &Histogram"), 0);
+	mEditAction[edit_add_hist_plot]->setShortcut(QKeySequence(sc_add_hist_plot));
+	mEditAction[edit_add_hist_plot]->setToolTip(QObject::tr("Add a new histogram."));
+
+	mEditAction[edit_add_splom] = new QAction(QObject::tr("Add Scatter Plot &Matrix..."), 0);
+	mEditAction[edit_add_splom]->setToolTip(QObject::tr("Add scatter plots of all pairs of the selected features."));
+
 	mEditAction[edit_remove_plot] = new QAction(QObject::tr("&Remove Plot"), 0);
 	mEditAction[edit_remove_plot]->setShortcut(QKeySequence::Delete);
 	mEditAction[edit_remove_plot]->setToolTip(QObject::tr("Remove all selected plots."));
@@ -209,6 +230,12 @@ void ActionManager::createActions() {
 	mToolsAction[tools_reverse_solar_system]->setToolTip(QObject::tr("Reverses solar system."));
 	mToolsAction[tools_reverse_solar_system]->setShortcut(sc_tools_solar);
 
+	mToolsAction[tools_compute_embedding] = new QAction(QObject::tr("Compute t-SNE &Embedding"), 0);
+	mToolsAction[tools_compute_embedding]->setToolTip(QObject::tr("Embeds all pages of the current collection into 2D."));
+
+	mToolsAction[tools_cluster_pages] = new QAction(QObject::tr("&Cluster Pages..."), 0);
+	mToolsAction[tools_cluster_pages]->setToolTip(QObject::tr("Clusters all pages of the current collection and colors them by cluster."));
+
 	mToolsAction[tools_about] = new QAction(QObject::tr("&About PIE"), 0);
 	mToolsAction[tools_about]->setToolTip(QObject::tr("Information about this software."));
 	mToolsAction[tools_about]->setShortcut(QKeySequence::HelpContents);
@@ -61,6 +61,8 @@ public:
 
 	enum FileMenuActions {
 		file_open_database,
+		file_import_page_xml,
+		file_export_selection,
 		
 		file_end,
 	};
@@ -83,6 +85,8 @@ public:
 
 	enum EditMenuActions {
 		edit_add_dot_plot,
+		edit_add_hist_plot,
+		edit_add_splom,
 		edit_remove_plot,
 
 		edit_select_all,
@@ -92,6 +96,8 @@ public:
 
 	enum ToolsMenuActions {
 		tools_about,
+		tools_compute_embedding,
+		tools_cluster_pages,
 
 		// hidden
 		tools_reverse_solar_system,
@@ -114,6 +120,7 @@ public:
 		sc_view_close_tab = Qt::CTRL + Qt::Key_W,
 
 		sc_add_dot_plot = Qt::CTRL + Qt::Key_D,
+		sc_add_hist_plot = Qt::CTRL + Qt::Key_H,
 
 		sc_tools_solar = Qt::Key_R,
 
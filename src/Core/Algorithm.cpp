@@ -33,9 +33,292 @@
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
 #pragma warning(pop)
 
 namespace pie {
-}
 
- 
\ No newline at end of file
+	// -------------------------------------------------------------------- Math 
+	/// <summary>
+	/// Counts values in equally sized bins.
+	/// Values are counted in parallel stripes with private
+	/// bins which are summed up afterwards.
+	/// Values outside [lo hi] are not counted.
+	/// </summary>
+	/// <param name="values">The values (1 x n, CV_32F).</param>
+	/// <param name="lo">The lower edge of the first bin.</param>
+	/// <param name="hi">The upper edge of the last bin.</param>
+	/// <param name="numBins">The number of bins.</param>
+	/// <param name="series">If set, the series of each value (1 x n, CV_32S) - negative series are skipped.</param>
+	/// <param name="numSeries">The number of series.</param>
+	/// <returns>The bin counts (series x bins, CV_32S).</returns>
+	cv::Mat Math::histogram(const cv::Mat & values, double lo, double hi, int numBins, const cv::Mat & series, int numSeries) {
+
+		CV_Assert(values.empty() || (values.type() == CV_32FC1 && values.isContinuous()));
+		CV_Assert(series.empty() || (series.type() == CV_32SC1 && series.total() == values.total()));
+
+		cv::Mat counts(qMax(numSeries, 1), qMax(numBins, 1), CV_32SC1, cv::Scalar(0));
+
+		if (values.empty() || hi <= lo || numBins < 1)
+			return counts;
+
+		const int n = (int)values.total();
+		const float* v = values.ptr<float>();
+		const int* s = series.empty() ? 0 : series.ptr<int>();
+		const double scale = numBins / (hi - lo);
+
+		QMutex mutex;
+
+		// a stripe per thread - otherwise merging the bins dominates
+		cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& r) {
+
+			cv::Mat c(counts.size(), CV_32SC1, cv::Scalar(0));
+
+			for (int idx = r.start; idx < r.end; idx++) {
+
+				double val = v[idx];
+
+				if (!(val >= lo && val <= hi))	// also skips NaN
+					continue;
+
+				int sIdx = s ? s[idx] : 0;
+
+				if (sIdx < 0 || sIdx >= c.rows)
+					continue;
+
+				int bIdx = qMin((int)((val - lo) * scale), numBins - 1);
+				c.ptr<int>(sIdx)[bIdx]++;
+			}
+
+			QMutexLocker lock(&mutex);
+			counts += c;
+
+		}, cv::getNumThreads());
+
+		return counts;
+	}
+
+	/// <summary>
+	/// Replaces a range of columns.
+	/// Use this to update per page data if pages were replaced or appended.
+	/// </summary>
+	/// <param name="src">The data (a column per element).</param>
+	/// <param name="first">The first column that is replaced.</param>
+	/// <param name="numRemoved">The number of columns that are removed.</param>
+	/// <param name="inserted">The columns inserted at first (same rows and type as src).</param>
+	/// <returns>The new data - src is not changed.</returns>
+	cv::Mat Math::spliceCols(const cv::Mat & src, int first, int numRemoved, const cv::Mat & inserted) {
+
+		CV_Assert(first >= 0 && numRemoved >= 0 && first + numRemoved <= src.cols);
+
+		std::vector<cv::Mat> parts;
+
+		if (first > 0)
+			parts.push_back(src.colRange(0, first));
+		if (!inserted.empty())
+			parts.push_back(inserted);
+		if (first + numRemoved < src.cols)
+			parts.push_back(src.colRange(first + numRemoved, src.cols));
+
+		if (parts.empty())
+			return cv::Mat();
+
+		cv::Mat dst;
+		cv::hconcat(parts, dst);
+
+		return dst;
+	}
+
+	// -------------------------------------------------------------------- QuantileSketch 
+	/// <summary>
+	/// Creates an empty sketch.
+	/// </summary>
+	/// <param name="k">The size of the top compactor, larger values are more accurate.</param>
+	/// <param name="seed">The seed for the compaction offsets - fix it to get reproducible results.</param>
+	QuantileSketch::QuantileSketch(int k, quint64 seed) : mRng(seed) {
+		mK = qMax(k, 8);
+		mLevels.resize(1);
+		updateSize();
+	}
+
+	void QuantileSketch::add(float value) {
+
+		if (mCount == 0) {
+			mMin = value;
+			mMax = value;
+		}
+		else {
+			mMin = qMin(mMin, value);
+			mMax = qMax(mMax, value);
+		}
+
+		mLevels[0].push_back(value);
+		mCount++;
+		mSize++;
+
+		if (mSize >= mMaxSize)
+			compress();
+	}
+
+	/// <summary>
+	/// Adds all values of another sketch.
+	/// The result has the same error guarantees as
+	/// if all values were added to this sketch.
+	/// </summary>
+	/// <param name="other">The sketch to merge.</param>
+	void QuantileSketch::merge(const QuantileSketch & other) {
+
+		if (other.isEmpty())
+			return;
+
+		if (isEmpty()) {
+			mMin = other.mMin;
+			mMax = other.mMax;
+		}
+		else {
+			mMin = qMin(mMin, other.mMin);
+			mMax = qMax(mMax, other.mMax);
+		}
+
+		if (mLevels.size() < other.mLevels.size())
+			mLevels.resize(other.mLevels.size());
+
+		for (size_t h = 0; h < other.mLevels.size(); h++)
+			mLevels[h].insert(mLevels[h].end(), other.mLevels[h].begin(), other.mLevels[h].end());
+
+		mCount += other.mCount;
+		updateSize();
+
+		if (mSize >= mMaxSize)
+			compress();
+	}
+
+	/// <summary>
+	/// Returns the approximate quantile.
+	/// </summary>
+	/// <param name="q">The quantile (0.5 = median, 0.95 = p95).</param>
+	/// <returns>The value or 0 if the sketch is empty.</returns>
+	double QuantileSketch::quantile(double q) const {
+
+		if (isEmpty())
+			return 0.0;
+
+		if (q <= 0.0)
+			return mMin;
+		if (q >= 1.0)
+			return mMax;
+
+		// (value, weight) pairs
+		std::vector<std::pair<float, qint64> > items;
+		items.reserve(mSize);
+
+		for (size_t h = 0; h < mLevels.size(); h++) {
+			for (float v : mLevels[h])
+				items.push_back(std::make_pair(v, (qint64)1 << h));
+		}
+
+		std::sort(items.begin(), items.end());
+
+		qint64 total = 0;
+		for (const auto& i : items)
+			total += i.second;
+
+		double target = q * total;
+		qint64 cum = 0;
+
+		for (const auto& i : items) {
+			cum += i.second;
+
+			if (cum >= target)
+				return i.first;
+		}
+
+		return mMax;
+	}
+
+	bool QuantileSketch::isEmpty() const {
+		return mCount == 0;
+	}
+
+	qint64 QuantileSketch::count() const {
+		return mCount;
+	}
+
+	float QuantileSketch::min() const {
+		return mMin;
+	}
+
+	float QuantileSketch::max() const {
+		return mMax;
+	}
+
+	int QuantileSketch::numRetained() const {
+		return mSize;
+	}
+
+	QString QuantileSketch::toString() const {
+
+		if (isEmpty())
+			return "empty";
+
+		QString msg;
+		msg += "median: " + QString::number(quantile(0.5));
+		msg += " p05: " + QString::number(quantile(0.05));
+		msg += " p95: " + QString::number(quantile(0.95));
+		msg += " [" + QString::number(mMin) + " " + QString::number(mMax) + "]";
+		msg += " n: " + QString::number(mCount);
+
+		return msg;
+	}
+
+	int QuantileSketch::capacity(int level) const {
+
+		// the top level has capacity k, lower levels shrink by 2/3
+		int depth = (int)mLevels.size() - 1 - level;
+		return qMax(2, (int)std::ceil(mK * std::pow(2.0 / 3.0, depth)));
+	}
+
+	void QuantileSketch::compress() {
+
+		for (size_t h = 0; h < mLevels.size(); h++) {
+
+			if ((int)mLevels[h].size() < capacity((int)h))
+				continue;
+
+			if (h + 1 == mLevels.size())
+				mLevels.resize(mLevels.size() + 1);
+
+			std::vector<float>& level = mLevels[h];
+			std::vector<float>& next = mLevels[h + 1];
+			std::sort(level.begin(), level.end());
+
+			// keep one value if the size is odd
+			bool odd = level.size() % 2 == 1;
+			float last = level.back();
+			if (odd)
+				level.pop_back();
+
+			// promote every other value (with a random offset)
+			for (size_t idx = mRng.uniform(0, 2); idx < level.size(); idx += 2)
+				next.push_back(level[idx]);
+
+			level.clear();
+			if (odd)
+				level.push_back(last);
+		}
+
+		updateSize();
+	}
+
+	void QuantileSketch::updateSize() {
+
+		mSize = 0;
+		mMaxSize = 0;
+
+		for (size_t h = 0; h < mLevels.size(); h++) {
+			mSize += (int)mLevels[h].size();
+			mMaxSize += capacity((int)h);
+		}
+	}
+}
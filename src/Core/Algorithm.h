@@ -33,6 +33,12 @@
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QString>
+#include <QList>
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <vector>
 
 #include <opencv2/core.hpp>
 #pragma warning(pop)
@@ -55,54 +61,156 @@ namespace pie {
 
 namespace Math {
 
+	/// <summary>
+	/// Returns the index of a quantile in a sorted set.
+	/// </summary>
+	/// <param name="size">The number of samples (> 0).</param>
+	/// <param name="q">The quantile (0.5 = median, 0.25 and 0.75 = quartiles).</param>
+	/// <returns>The zero based index.</returns>
+	inline size_t quantileIndex(size_t size, double q) {
+
+		double idx = std::ceil(size * q);
+		return idx < 1.0 ? 0 : qMin((size_t)idx, size) - 1;
+	}
+
+	/// <summary>
+	/// Computes multiple quantiles of a contiguous span in one go.
+	/// Instead of sorting, the quantiles are selected (nth_element)
+	/// in ascending order and each selection only partitions the
+	/// part of the span which is right of the previous quantile.
+	/// NOTE: the span is reordered.
+	/// </summary>
+	/// <param name="data">The samples.</param>
+	/// <param name="size">The number of samples.</param>
+	/// <param name="q">The quantiles (0.5 = median, 0.25 and 0.75 = quartiles).</param>
+	/// <param name="numQ">The number of quantiles.</param>
+	/// <param name="out">The quantile values (same order as q).</param>
+	/// <param name="interpolated">If true, the mean of the quantile and its successor is returned if size is even.</param>
+	template <typename T>
+	void quantiles(T* data, size_t size, const double* q, size_t numQ, double* out, bool interpolated = true) {
+
+		static_assert(std::is_arithmetic<T>::value, "quantiles need arithmetic types");
+
+		if (size == 0) {
+			std::fill(out, out + numQ, 0.0);
+			return;
+		}
+
+		// process the quantiles in ascending order
+		std::vector<size_t> order(numQ);
+		for (size_t idx = 0; idx < numQ; idx++)
+			order[idx] = idx;
+		std::sort(order.begin(), order.end(), [q](size_t a, size_t b) { return q[a] < q[b]; });
+
+		T* first = data;
+		T* end = data + size;
+
+		for (size_t oIdx : order) {
+
+			T* nth = data + quantileIndex(size, q[oIdx]);
+
+			// everything left of first is already <= *first
+			if (nth >= first) {
+				std::nth_element(first, nth, end);
+				first = nth;
+			}
+
+			double val = (double)*nth;
+
+			// the successor is the minimum of the right partition (q = 0 is the minimum)
+			if (interpolated && size % 2 == 0 && q[oIdx] > 0.0 && nth + 1 < end)
+				val = (val + (double)*std::min_element(nth + 1, end)) * 0.5;
+
+			out[oIdx] = val;
+		}
+	}
+
+	/// <summary>
+	/// Computes a quantile of a contiguous span.
+	/// NOTE: the span is reordered.
+	/// </summary>
+	/// <param name="data">The samples.</param>
+	/// <param name="size">The number of samples.</param>
+	/// <param name="q">The quantile (0.5 = median, 0.25 and 0.75 = quartiles).</param>
+	/// <param name="interpolated">If true, the mean of the quantile and its successor is returned if size is even.</param>
+	/// <returns>The quantile or 0 if the span is empty.</returns>
+	template <typename T>
+	double quantile(T* data, size_t size, double q, bool interpolated = true) {
+
+		double val = 0.0;
+		quantiles(data, size, &q, 1, &val, interpolated);
+
+		return val;
+	}
+
+	/// <summary>
+	/// Counts values (1 x n, CV_32F) in equally sized bins (see Algorithm.cpp).
+	/// </summary>
+	DllExport cv::Mat histogram(const cv::Mat& values, double lo, double hi, int numBins, const cv::Mat& series = cv::Mat(), int numSeries = 1);
+
+	/// <summary>
+	/// Replaces a range of columns, e.g. of per page data (see Algorithm.cpp).
+	/// </summary>
+	DllExport cv::Mat spliceCols(const cv::Mat& src, int first, int numRemoved, const cv::Mat& inserted);
+
 	/// <summary>
 	/// Computes robust statistical moments (quantiles).
+	/// Convenience function for Qt containers - use quantile() for spans.
 	/// </summary>
 	/// <param name="valuesIn">The statistical set (samples).</param>
 	/// <param name="momentValue">The statistical moment value (0.5 = median, 0.25 and 0.75 = quartiles).</param>
 	/// <param name="interpolated">A flag if the value should be interpolated if the length of the list is even.</param>
 	/// <returns>The statistical moment.</returns>
 	template <typename numFmt>
-	static double statMoment(const QList<numFmt>& valuesIn, double momentValue, bool interpolated = true) {
+	double statMoment(const QList<numFmt>& valuesIn, double momentValue, bool interpolated = true) {
 
-		// no stat moment if we have 1 value
-		if (valuesIn.size() == 1)
-			return valuesIn[0];
+		std::vector<numFmt> values(valuesIn.begin(), valuesIn.end());
+		return quantile(values.data(), values.size(), momentValue, interpolated);
+	}
+}
 
-		// return mean if we have two & interpolation is turned on
-		if (valuesIn.size() == 2 && interpolated) {
-			return (valuesIn[0] + valuesIn[1]) / 2.0;
-		}
-		else if (valuesIn.size() == 2)
-			return valuesIn[0];
+/// <summary>
+/// A mergeable quantile sketch (KLL).
+/// Values are kept in a hierarchy of compactors where level h
+/// holds values with weight 2^h. If a level is full, it is sorted
+/// and every other value is promoted to the next level.
+/// The memory is O(k log(n/k)) and the rank error is about 1.7/k
+/// (k = 200 => < 1 %). Sketches of documents can be built in
+/// parallel and merged afterwards.
+/// </summary>
+class DllExport QuantileSketch {
 
-		QList<numFmt> values = valuesIn;
-		qSort(values);
+public:
+	QuantileSketch(int k = 200, quint64 seed = 42);
 
-		size_t lSize = values.size();
-		double moment = -1;
-		unsigned int momIdx = cvCeil(lSize*momentValue);
-		unsigned int idx = 1;
+	void add(float value);
+	void merge(const QuantileSketch& other);
 
-		// find the statistical moment
-		for (auto val : values) {
+	double quantile(double q) const;
 
-			// skip
-			if (idx < momIdx) {
-				idx++;
-				continue;
-			}
+	bool isEmpty() const;
+	qint64 count() const;
+	float min() const;
+	float max() const;
+	int numRetained() const;
 
-			// compute mean between this and the next element
-			if (lSize % 2 == 0 && momIdx < lSize && interpolated)
-				moment = ((double)val + values[idx + 1])*0.5;
-			else
-				moment = (double)val;
-			break;
-		}
+	QString toString() const;
 
-		return moment;
-	}
-}
+private:
+	int capacity(int level) const;
+	void compress();
+	void updateSize();
+
+	int mK = 200;
+	qint64 mCount = 0;
+	float mMin = 0.0f;
+	float mMax = 0.0f;
+
+	std::vector<std::vector<float> > mLevels;
+	int mSize = 0;		// number of retained values
+	int mMaxSize = 0;	// compress if mSize reaches this
 
-}
\ No newline at end of file
+	cv::RNG mRng;
+};
+
+}
@@ -70,6 +70,7 @@ namespace pie {
 
 		if (o) {
 			o->setAxisIndex(mAxisIndex);
+			o->setAxisTransform(mAxisTransform);
 			o->setXAxisName(mXAxisName);
 			o->setYAxisName(mYAxisName);
 			o->setMinimumSize(mMinimumSize);
@@ -84,6 +85,7 @@ namespace pie {
 		//settings.setValue("axisIndex", mAxisIndex);
 		settings.setValue("xAxisName", mXAxisName);
 		settings.setValue("yAxisName", mYAxisName);
+		settings.setValue("axisTransform", mAxisTransform);
 		settings.setValue("minimumSize", mMinimumSize);
 		settings.setValue("numColumns", mNumColumns);
 		settings.setValue("mode", mMode);
@@ -98,6 +100,7 @@ namespace pie {
 		mAxisIndex = settings.value("axisIndex", mAxisIndex).toPoint();
 		mXAxisName = settings.value("xAxisName", mXAxisName).toString();
 		mYAxisName = settings.value("yAxisName", mYAxisName).toString();
+		mAxisTransform = settings.value("axisTransform", mAxisTransform).toPoint();
 		mMinimumSize = settings.value("minimumSize", mMinimumSize).toSize();
 		mNumColumns = settings.value("numColumns", mNumColumns).toInt();
 		mMode = (Mode)settings.value("mode", mMode).toInt();
@@ -142,6 +145,30 @@ namespace pie {
 		emit axisIndexChanged(mAxisIndex);
 	}
 
+	QPoint PlotParams::axisTransform() const {
+		return mAxisTransform;
+	}
+
+	/// <summary>
+	/// Sets the transforms (AxisTransform::Mode) of both axes.
+	/// Use -1 to keep the current transform of an axis.
+	/// </summary>
+	void PlotParams::setAxisTransform(const QPoint & axisTransform) {
+
+		QPoint at = mAxisTransform;
+
+		if (axisTransform.x() != -1)
+			at.setX(axisTransform.x());
+		if (axisTransform.y() != -1)
+			at.setY(axisTransform.y());
+
+		if (at == mAxisTransform)
+			return;
+
+		mAxisTransform = at;
+		emit axisTransformChanged(mAxisTransform);
+	}
+
 	void PlotParams::setMinimumSize(const QSize& size) {
 		mMinimumSize = size;
 		emit minimumSizeChanged(size);
@@ -229,6 +256,13 @@ namespace pie {
 		}
 	}
 
+	/// <summary>
+	/// Returns the (sorted) indices of the pages which were picked in the plot.
+	/// </summary>
+	QVector<int> BasePlot::pickedPages() const {
+		return QVector<int>();
+	}
+
 	bool BasePlot::isFullScreen() const {
 		return mFullScreen;
 	}
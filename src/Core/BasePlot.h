@@ -70,6 +70,7 @@ namespace pie {
 		virtual void copyTo(PlotParams* o) const;
 
 		QPoint axisIndex() const;
+		QPoint axisTransform() const;
 		QString xAxisName() const;
 		QString yAxisName() const;
 
@@ -96,6 +97,7 @@ namespace pie {
 
 	public slots:
 		void setAxisIndex(const QPoint& axisIndex);
+		void setAxisTransform(const QPoint& axisTransform);
 		void setXAxisName(const QString& axisName);
 		void setYAxisName(const QString& axisName);
 		void setMinimumSize(const QSize& size);
@@ -105,6 +107,7 @@ namespace pie {
 
 	signals:
 		void axisIndexChanged(const QPoint& axisIndex = QPoint()) const;
+		void axisTransformChanged(const QPoint& axisTransform = QPoint()) const;
 		void worldMatrixChanged(const QTransform& worldMatrix = QTransform()) const;
 		void viewMatrixChanged(const QTransform& viewMatrix = QTransform()) const;
 		void showAxisLineChanged(bool show = true);
@@ -118,6 +121,7 @@ namespace pie {
 	protected:
 
 		QPoint mAxisIndex = QPoint(-1, -1);
+		QPoint mAxisTransform = QPoint(0, 0);	// AxisTransform::Mode of x and y
 		QString mXAxisName;
 		QString mYAxisName;
 
@@ -143,11 +147,14 @@ namespace pie {
 		bool isSelected() const;
 		virtual void setSelected(bool selected);
 
-		//virtual QPoint axisIndex() const = 0;
+		virtual QPoint axisIndex() const = 0;
+		virtual QVector<int> pickedPages() const;
 		//virtual DkPlotParams* params() const = 0;
 
 	public slots:
 		virtual void setAxisIndex(const QPoint& index) = 0;
+		virtual void updateData() = 0;
+		virtual void releaseData() = 0;
 		virtual void closeRequested() const;
 
 	signals:
@@ -0,0 +1,327 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#include "Clustering.h"
+
+#include "PageData.h"
+#include "Processor.h"
+#include "Utils.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QDebug>
+
+#include <opencv2/core/hal/hal.hpp>
+
+#include <algorithm>
+#include <limits>
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- KMeans 
+	KMeans::KMeans() {
+	}
+
+	/// <summary>
+	/// Clusters the rows of data.
+	/// </summary>
+	/// <param name="data">A row per page (CV_32F).</param>
+	/// <param name="k">The number of clusters.</param>
+	/// <param name="numIterations">The maximal number of mini-batches.</param>
+	/// <param name="batchSize">The number of pages per mini-batch.</param>
+	/// <param name="seed">The random seed.</param>
+	/// <returns>The clustering.</returns>
+	KMeans KMeans::compute(const cv::Mat & data, int k, int numIterations, int batchSize, quint64 seed) {
+
+		CV_Assert(data.empty() || data.type() == CV_32FC1);
+
+		KMeans km;
+		const int n = data.rows;
+		k = qMin(k, n);
+
+		if (k < 1)
+			return km;
+
+		cv::RNG rng(seed);
+		cv::Mat centers = initCenters(data, k, rng);
+
+		std::vector<int> rows(qMin(batchSize, n));
+		std::vector<int> labels(rows.size());
+		std::vector<int> counts(k, 0);
+
+		for (int it = 0; it < numIterations; it++) {
+
+			for (int& r : rows)
+				r = rng.uniform(0, n);
+
+			assign(data, centers, rows, labels.data());
+
+			// move the centers towards their pages with a decreasing learning rate
+			cv::Mat old = centers.clone();
+
+			for (size_t idx = 0; idx < rows.size(); idx++) {
+
+				int c = labels[idx];
+				counts[c]++;
+
+				float eta = 1.0f / counts[c];
+				float* cp = centers.ptr<float>(c);
+				const float* x = data.ptr<float>(rows[idx]);
+
+				for (int fIdx = 0; fIdx < data.cols; fIdx++)
+					cp[fIdx] += eta * (x[fIdx] - cp[fIdx]);
+			}
+
+			// converged?
+			if (cv::norm(centers, old, cv::NORM_L2SQR) < 1e-6 * k)
+				break;
+		}
+
+		// assign all pages
+		km.mCenters = centers;
+		km.mLabels = cv::Mat(1, n, CV_32SC1);
+		cv::Mat dists(1, n, CV_32FC1);
+		assign(data, centers, std::vector<int>(), km.mLabels.ptr<int>(), dists.ptr<float>());
+
+		km.mInertia = cv::sum(dists)[0];
+		km.sortClusters();
+
+		return km;
+	}
+
+	/// <summary>
+	/// Clusters all pages of a collection.
+	/// Pages are described by their (robust z-scored) features.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <param name="k">The number of clusters.</param>
+	/// <param name="ids">The feature ids (if empty all base features are used).</param>
+	/// <returns>The clustering.</returns>
+	KMeans KMeans::compute(const Collection & c, int k, const QVector<int>& ids) {
+
+		Timer dt;
+		QVector<int> fIds = ids.isEmpty() ? FeatureRegistry::instance().baseFeatures(c) : ids;
+
+		QVector<AxisTransform> ts(fIds.size(), AxisTransform(AxisTransform::t_robust_z));
+		cv::Mat fm = AbstractMapper::processAll(&c, fIds, &ts);
+
+		// k-means wants a row per page
+		KMeans km = compute(cv::Mat(fm.t()), k);
+		km.setFeatures(fIds);
+
+		qInfo().noquote() << km.toString() << "computed in" << dt;
+
+		return km;
+	}
+
+	/// <summary>
+	/// Returns the cluster of each page (1 x pages, CV_32S).
+	/// </summary>
+	cv::Mat KMeans::labels() const {
+		return mLabels;
+	}
+
+	cv::Mat KMeans::centers() const {
+		return mCenters;
+	}
+
+	QVector<int> KMeans::counts() const {
+		return mCounts;
+	}
+
+	/// <summary>
+	/// Returns the sum of squared distances of all pages to their center.
+	/// </summary>
+	double KMeans::inertia() const {
+		return mInertia;
+	}
+
+	int KMeans::numClusters() const {
+		return mCenters.rows;
+	}
+
+	int KMeans::numPages() const {
+		return mLabels.cols;
+	}
+
+	/// <summary>
+	/// Sets the feature ids which describe the clustered pages.
+	/// </summary>
+	void KMeans::setFeatures(const QVector<int>& ids) {
+		mFeatures = ids;
+	}
+
+	QVector<int> KMeans::features() const {
+		return mFeatures;
+	}
+
+	QString KMeans::toString() const {
+
+		QString msg = QString("%1 clusters of %2 pages (inertia: %3) [")
+			.arg(numClusters()).arg(numPages()).arg(mInertia, 0, 'g', 4);
+
+		for (int idx = 0; idx < mCounts.size(); idx++)
+			msg += (idx > 0 ? " " : "") + QString::number(mCounts[idx]);
+
+		return msg + "]";
+	}
+
+	/// <summary>
+	/// Chooses the initial centers by k-means++ on a sample of pages.
+	/// </summary>
+	cv::Mat KMeans::initCenters(const cv::Mat & data, int k, cv::RNG & rng) {
+
+		const int numSamples = qMin(data.rows, qMax(100 * k, 10000));
+
+		cv::Mat sample(numSamples, data.cols, CV_32FC1);
+		for (int idx = 0; idx < numSamples; idx++)
+			data.row(numSamples < data.rows ? rng.uniform(0, data.rows) : idx).copyTo(sample.row(idx));
+
+		cv::Mat centers(k, data.cols, CV_32FC1);
+		sample.row(rng.uniform(0, numSamples)).copyTo(centers.row(0));
+
+		// squared distance of each sample to its nearest center
+		std::vector<float> dists(numSamples, std::numeric_limits<float>::max());
+
+		for (int cIdx = 1; cIdx < k; cIdx++) {
+
+			const float* pc = centers.ptr<float>(cIdx - 1);
+			double sum = 0.0;
+
+			for (int idx = 0; idx < numSamples; idx++) {
+				dists[idx] = qMin(dists[idx], cv::hal::normL2Sqr_(sample.ptr<float>(idx), pc, data.cols));
+				sum += dists[idx];
+			}
+
+			// pick the next center proportional to its squared distance
+			double r = rng.uniform(0.0, sum);
+			int next = numSamples - 1;
+
+			for (int idx = 0; idx < numSamples; idx++) {
+
+				r -= dists[idx];
+				if (r <= 0.0) {
+					next = idx;
+					break;
+				}
+			}
+
+			sample.row(next).copyTo(centers.row(cIdx));
+		}
+
+		return centers;
+	}
+
+	/// <summary>
+	/// Assigns pages to their nearest center in parallel.
+	/// </summary>
+	/// <param name="data">A row per page.</param>
+	/// <param name="centers">The cluster centers.</param>
+	/// <param name="rows">The pages to assign (if empty, all pages are assigned).</param>
+	/// <param name="labels">The output labels (a label per row).</param>
+	/// <param name="dists">If set, the squared distances to the nearest center.</param>
+	void KMeans::assign(const cv::Mat & data, const cv::Mat & centers, const std::vector<int>& rows, int * labels, float * dists) {
+
+		const int n = rows.empty() ? data.rows : (int)rows.size();
+
+		cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& r) {
+
+			for (int idx = r.start; idx < r.end; idx++) {
+
+				float d = 0.0f;
+				labels[idx] = nearest(data.ptr<float>(rows.empty() ? idx : rows[idx]), centers, d);
+
+				if (dists)
+					dists[idx] = d;
+			}
+		});
+	}
+
+	int KMeans::nearest(const float * x, const cv::Mat & centers, float & dist) {
+
+		int best = 0;
+		dist = std::numeric_limits<float>::max();
+
+		for (int cIdx = 0; cIdx < centers.rows; cIdx++) {
+
+			// vectorized by OpenCV
+			float d = cv::hal::normL2Sqr_(x, centers.ptr<float>(cIdx), centers.cols);
+
+			if (d < dist) {
+				dist = d;
+				best = cIdx;
+			}
+		}
+
+		return best;
+	}
+
+	/// <summary>
+	/// Relabels the clusters so that cluster 0 is the largest.
+	/// </summary>
+	void KMeans::sortClusters() {
+
+		const int k = numClusters();
+
+		QVector<int> counts(k, 0);
+		const int* lp = mLabels.ptr<int>();
+
+		for (int idx = 0; idx < mLabels.cols; idx++)
+			counts[lp[idx]]++;
+
+		QVector<int> order(k);
+		for (int idx = 0; idx < k; idx++)
+			order[idx] = idx;
+
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return counts[a] > counts[b];
+		});
+
+		std::vector<int> newLabel(k);
+		cv::Mat centers(mCenters.size(), mCenters.type());
+		mCounts.resize(k);
+
+		for (int idx = 0; idx < k; idx++) {
+			newLabel[order[idx]] = idx;
+			mCenters.row(order[idx]).copyTo(centers.row(idx));
+			mCounts[idx] = counts[order[idx]];
+		}
+
+		mCenters = centers;
+
+		int* lpw = mLabels.ptr<int>();
+		cv::parallel_for_(cv::Range(0, mLabels.cols), [&](const cv::Range& r) {
+			for (int idx = r.start; idx < r.end; idx++)
+				lpw[idx] = newLabel[lpw[idx]];
+		});
+	}
+
+}
@@ -0,0 +1,97 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QString>
+#include <QVector>
+
+#include <opencv2/core.hpp>
+#pragma warning(pop)
+
+#pragma warning (disable: 4251)	// inlined Qt functions in dll interface
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+
+namespace pie {
+
+class Collection;
+
+/// <summary>
+/// Clusters pages by mini-batch k-means.
+/// Centers are updated with small random batches of pages
+/// so that the number of iterations does not depend on the
+/// number of pages. Only the final assignment touches all pages.
+/// Clusters are sorted by their size (0 is the largest).
+/// </summary>
+class DllExport KMeans {
+
+public:
+	KMeans();
+
+	static KMeans compute(const cv::Mat& data, int k, int numIterations = 100, int batchSize = 4096, quint64 seed = 42);
+	static KMeans compute(const Collection& c, int k, const QVector<int>& ids = QVector<int>());
+
+	cv::Mat labels() const;
+	cv::Mat centers() const;
+	QVector<int> counts() const;
+	double inertia() const;
+
+	int numClusters() const;
+	int numPages() const;
+	void setFeatures(const QVector<int>& ids);
+	QVector<int> features() const;
+
+	QString toString() const;
+
+private:
+	static cv::Mat initCenters(const cv::Mat& data, int k, cv::RNG& rng);
+	static void assign(const cv::Mat& data, const cv::Mat& centers, const std::vector<int>& rows, int* labels, float* dists = 0);
+	static int nearest(const float* x, const cv::Mat& centers, float& dist);
+	void sortClusters();
+
+	QVector<int> mFeatures;
+	cv::Mat mLabels;		// 1 x pages (CV_32S)
+	cv::Mat mCenters;		// clusters x features (CV_32F)
+	QVector<int> mCounts;
+	double mInertia = 0.0;
+};
+
+}
@@ -0,0 +1,505 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+
+#include "Compression.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QFile>
+#include <QMutexLocker>
+#include <QDebug>
+#include <QtConcurrent/QtConcurrentRun>
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- DecompressionDevice 
+	DecompressionDevice::DecompressionDevice(const QString & filePath, QObject * parent) : QIODevice(parent) {
+		mFilePath = filePath;
+		mPool.setMaxThreadCount(1);
+	}
+
+	DecompressionDevice::~DecompressionDevice() {
+
+		if (isOpen())
+			close();
+	}
+
+	/// <summary>
+	/// Starts decompressing the file.
+	/// Only read-only mode is supported.
+	/// </summary>
+	bool DecompressionDevice::open(OpenMode mode) {
+
+		if (isOpen() || (mode & WriteOnly)) {
+			setErrorString("DecompressionDevice can only be opened once for reading");
+			return false;
+		}
+
+		mFormat = format(mFilePath);
+
+		if (!isSupported(mFormat)) {
+			setErrorString(mFilePath + " is not compressed or the format is not supported");
+			return false;
+		}
+
+		mChunks.clear();
+		mCurrent.clear();
+		mPos = 0;
+		mFinished = false;
+		mError.clear();
+		mCancel.store(0);
+
+		// decompressed chunks are buffered by us
+		if (!QIODevice::open(mode | Unbuffered))
+			return false;
+
+		mFuture = QtConcurrent::run(&mPool, this, &DecompressionDevice::decompress);
+
+		return true;
+	}
+
+	void DecompressionDevice::close() {
+
+		{
+			QMutexLocker lock(&mMutex);
+			mCancel.store(1);
+			mWritable.wakeAll();
+		}
+
+		mFuture.waitForFinished();
+
+		mChunks.clear();
+		mCurrent.clear();
+		mPos = 0;
+
+		QIODevice::close();
+	}
+
+	bool DecompressionDevice::isSequential() const {
+		return true;
+	}
+
+	bool DecompressionDevice::atEnd() const {
+
+		if (mPos < mCurrent.size())
+			return false;
+
+		QMutexLocker lock(&mMutex);
+		return mFinished && mChunks.isEmpty();
+	}
+
+	qint64 DecompressionDevice::bytesAvailable() const {
+
+		qint64 n = mCurrent.size() - mPos;
+
+		QMutexLocker lock(&mMutex);
+		for (const QByteArray& c : mChunks)
+			n += c.size();
+
+		return n + QIODevice::bytesAvailable();
+	}
+
+	/// <summary>
+	/// Waits until the worker decompressed the next chunk.
+	/// </summary>
+	/// <param name="msecs">The timeout in ms, -1 waits forever.</param>
+	/// <returns>false if the timeout expired or the file ended.</returns>
+	bool DecompressionDevice::waitForReadyRead(int msecs) {
+
+		if (mPos < mCurrent.size())
+			return true;
+
+		QMutexLocker lock(&mMutex);
+
+		while (mChunks.isEmpty() && !mFinished) {
+
+			if (!mReadable.wait(&mMutex, msecs < 0 ? ULONG_MAX : (unsigned long)msecs))
+				return false;
+		}
+
+		return !mChunks.isEmpty();
+	}
+
+	/// <summary>
+	/// Returns the compression format of a file.
+	/// The format is detected by the file's magic bytes and not by its suffix.
+	/// </summary>
+	DecompressionDevice::Format DecompressionDevice::format(const QString & filePath) {
+
+		QFile f(filePath);
+
+		if (!f.open(QIODevice::ReadOnly))
+			return format_none;
+
+		QByteArray magic = f.read(4);
+
+		if (magic.size() >= 2) {
+
+			const uchar b0 = (uchar)magic[0];
+			const uchar b1 = (uchar)magic[1];
+
+			// gzip or a raw zlib stream (zlib handles both)
+			if ((b0 == 0x1f && b1 == 0x8b) || (b0 == 0x78 && (b1 == 0x01 || b1 == 0x5e || b1 == 0x9c || b1 == 0xda)))
+				return format_gzip;
+		}
+
+		if (magic == QByteArray("\x28\xb5\x2f\xfd", 4))
+			return format_zstd;
+
+		return format_none;
+	}
+
+	/// <summary>
+	/// Returns true if PIE was built with the format's library.
+	/// </summary>
+	bool DecompressionDevice::isSupported(const Format & format) {
+
+		switch (format) {
+#ifdef WITH_ZLIB
+		case format_gzip:	return true;
+#endif
+#ifdef WITH_ZSTD
+		case format_zstd:	return true;
+#endif
+		default: break;
+		}
+
+		return false;
+	}
+
+	/// <summary>
+	/// Opens a file for reading.
+	/// Compressed files are decompressed on the fly, all other
+	/// files are opened as QFile (which can seek).
+	/// </summary>
+	/// <param name="filePath">The file path.</param>
+	/// <returns>The opened device or NULL if the file cannot be read.</returns>
+	QSharedPointer<QIODevice> DecompressionDevice::openFile(const QString & filePath) {
+
+		Format f = format(filePath);
+
+		if (f == format_none) {
+
+			QSharedPointer<QFile> file(new QFile(filePath));
+
+			if (!file->open(QIODevice::ReadOnly)) {
+				qCritical() << "Sorry, I could not open" << filePath << "for reading...";
+				return QSharedPointer<QIODevice>();
+			}
+
+			return file;
+		}
+
+		if (!isSupported(f)) {
+			qCritical() << filePath << "is compressed but PIE was built without" << (f == format_gzip ? "zlib" : "zstd");
+			return QSharedPointer<QIODevice>();
+		}
+
+		QSharedPointer<DecompressionDevice> d(new DecompressionDevice(filePath));
+
+		if (!d->open(QIODevice::ReadOnly)) {
+			qCritical() << "Sorry, I could not open" << filePath << "for reading:" << d->errorString();
+			return QSharedPointer<QIODevice>();
+		}
+
+		return d;
+	}
+
+	/// <summary>
+	/// Copies decompressed bytes to data.
+	/// It blocks until the worker decompressed the next chunk
+	/// if nothing is buffered.
+	/// </summary>
+	qint64 DecompressionDevice::readData(char * data, qint64 maxSize) {
+
+		qint64 n = 0;
+
+		while (n < maxSize) {
+
+			if (mPos >= mCurrent.size()) {
+
+				QMutexLocker lock(&mMutex);
+
+				// return what we have instead of waiting
+				if (mChunks.isEmpty() && n > 0)
+					break;
+
+				while (mChunks.isEmpty() && !mFinished)
+					mReadable.wait(&mMutex);
+
+				if (mChunks.isEmpty()) {
+
+					if (n == 0 && !mError.isEmpty()) {
+						setErrorString(mError);
+						return -1;
+					}
+					break;
+				}
+
+				mCurrent = mChunks.dequeue();
+				mPos = 0;
+				mWritable.wakeAll();
+			}
+
+			qint64 c = qMin(maxSize - n, (qint64)(mCurrent.size() - mPos));
+			memcpy(data + n, mCurrent.constData() + mPos, c);
+			n += c;
+			mPos += (int)c;
+		}
+
+		return n;
+	}
+
+	qint64 DecompressionDevice::writeData(const char *, qint64) {
+		return -1;
+	}
+
+	void DecompressionDevice::decompress() {
+
+		// NOTE: this runs in the worker thread
+		QFile src(mFilePath);
+
+		if (!src.open(QIODevice::ReadOnly)) {
+			finish("cannot open " + mFilePath);
+			return;
+		}
+
+		bool ok = false;
+
+		switch (mFormat) {
+		case format_gzip:	ok = decompressGzip(src);	break;
+		case format_zstd:	ok = decompressZstd(src);	break;
+		default: break;
+		}
+
+		finish(ok || mCancel.load() ? QString() : "cannot decompress " + mFilePath);
+	}
+
+	bool DecompressionDevice::decompressGzip(QIODevice & src) {
+
+#ifdef WITH_ZLIB
+		z_stream zs;
+		memset(&zs, 0, sizeof(zs));
+
+		// 15 + 32: the maximal window and automatic gzip/zlib header detection
+		if (inflateInit2(&zs, 15 + 32) != Z_OK)
+			return false;
+
+		QByteArray in;
+		QByteArray out(chunk_size, Qt::Uninitialized);
+		zs.next_out = (Bytef*)out.data();
+		zs.avail_out = chunk_size;
+
+		bool ok = true;
+		bool srcDone = false;
+		bool pending = false;	// the output was full - zlib might have more
+		bool ended = false;
+
+		while (!mCancel.load()) {
+
+			if (zs.avail_in == 0 && !srcDone) {
+				in = src.read(1 << 18);
+				srcDone = in.isEmpty();
+				zs.next_in = (Bytef*)in.data();
+				zs.avail_in = in.size();
+			}
+
+			if (srcDone && zs.avail_in == 0 && !pending)
+				break;
+
+			int ret = ::inflate(&zs, Z_NO_FLUSH);
+
+			if (ret == Z_STREAM_END) {
+
+				ended = true;
+
+				// concatenated gzip members (e.g. written by pigz)
+				if (zs.avail_in > 0 || !src.atEnd()) {
+					inflateReset(&zs);
+					ended = false;
+				}
+			}
+			else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+				qWarning() << "[DecompressionDevice] zlib error in" << mFilePath << ":" << (zs.msg ? zs.msg : "");
+				ok = false;
+				break;
+			}
+
+			pending = zs.avail_out == 0;
+
+			if (zs.avail_out == 0) {
+
+				if (!push(out))
+					break;
+
+				out = QByteArray(chunk_size, Qt::Uninitialized);
+				zs.next_out = (Bytef*)out.data();
+				zs.avail_out = chunk_size;
+			}
+		}
+
+		if (ok && !mCancel.load()) {
+
+			out.resize(chunk_size - zs.avail_out);
+			if (!out.isEmpty())
+				push(out);
+
+			if (!ended) {
+				qWarning() << "[DecompressionDevice]" << mFilePath << "is truncated";
+				ok = false;
+			}
+		}
+
+		inflateEnd(&zs);
+
+		return ok;
+#else
+		Q_UNUSED(src);
+		return false;
+#endif
+	}
+
+	bool DecompressionDevice::decompressZstd(QIODevice & src) {
+
+#ifdef WITH_ZSTD
+		ZSTD_DStream* ds = ZSTD_createDStream();
+		ZSTD_initDStream(ds);
+
+		QByteArray in;
+		QByteArray out(chunk_size, Qt::Uninitialized);
+		ZSTD_inBuffer ib = { 0, 0, 0 };
+		ZSTD_outBuffer ob = { out.data(), (size_t)chunk_size, 0 };
+
+		bool ok = true;
+		bool srcDone = false;
+		bool pending = false;	// the output was full - zstd might have more
+		size_t ret = 0;
+
+		while (!mCancel.load()) {
+
+			if (ib.pos >= ib.size && !srcDone) {
+				in = src.read(ZSTD_DStreamInSize());
+				srcDone = in.isEmpty();
+				ib.src = in.constData();
+				ib.size = in.size();
+				ib.pos = 0;
+			}
+
+			if (srcDone && ib.pos >= ib.size && !pending)
+				break;
+
+			ret = ZSTD_decompressStream(ds, &ob, &ib);
+
+			if (ZSTD_isError(ret)) {
+				qWarning() << "[DecompressionDevice] zstd error in" << mFilePath << ":" << ZSTD_getErrorName(ret);
+				ok = false;
+				break;
+			}
+
+			pending = ob.pos == ob.size;
+
+			if (ob.pos == ob.size) {
+
+				if (!push(out))
+					break;
+
+				out = QByteArray(chunk_size, Qt::Uninitialized);
+				ob.dst = out.data();
+				ob.pos = 0;
+			}
+		}
+
+		if (ok && !mCancel.load()) {
+
+			out.resize((int)ob.pos);
+			if (!out.isEmpty())
+				push(out);
+
+			// 0 means that the last frame is complete
+			if (ret != 0) {
+				qWarning() << "[DecompressionDevice]" << mFilePath << "is truncated";
+				ok = false;
+			}
+		}
+
+		ZSTD_freeDStream(ds);
+
+		return ok;
+#else
+		Q_UNUSED(src);
+		return false;
+#endif
+	}
+
+	/// <summary>
+	/// Hands a decompressed chunk to the reader.
+	/// Blocks if the reader is max_chunks behind.
+	/// </summary>
+	/// <returns>false if the device was closed.</returns>
+	bool DecompressionDevice::push(QByteArray & chunk) {
+
+		QMutexLocker lock(&mMutex);
+
+		while (mChunks.size() >= max_chunks && !mCancel.load())
+			mWritable.wait(&mMutex);
+
+		if (mCancel.load())
+			return false;
+
+		mChunks.enqueue(chunk);
+		chunk = QByteArray();
+		mReadable.wakeAll();
+
+		return true;
+	}
+
+	void DecompressionDevice::finish(const QString & error) {
+
+		QMutexLocker lock(&mMutex);
+
+		mFinished = true;
+		mError = error;
+		mReadable.wakeAll();
+
+		if (!error.isEmpty())
+			qWarning() << "[DecompressionDevice]" << error;
+	}
+
+}
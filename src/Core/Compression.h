@@ -0,0 +1,135 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QIODevice>
+#include <QString>
+#include <QByteArray>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QFuture>
+#include <QThreadPool>
+#include <QSharedPointer>
+#pragma warning(pop)
+
+#pragma warning (disable: 4251)	// inlined Qt functions in dll interface
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+
+namespace pie {
+
+/// <summary>
+/// A sequential device which decompresses a file on the fly.
+/// The file is read and decompressed by a worker thread which
+/// runs ahead of the reader, so parsing and decompression are
+/// pipelined. At most max_chunks decompressed chunks are kept,
+/// hence the decompressed file is never completely in memory.
+/// Supports gzip/zlib (WITH_ZLIB) and zstd (WITH_ZSTD).
+/// Useage:
+///		QSharedPointer<QIODevice> d = DecompressionDevice::openFile(path);
+///		JsonStreamReader reader(d.data());
+/// </summary>
+class DllExport DecompressionDevice : public QIODevice {
+	Q_OBJECT
+
+public:
+	enum Format {
+		format_none = 0,
+		format_gzip,
+		format_zstd,
+
+		format_end
+	};
+
+	DecompressionDevice(const QString& filePath, QObject* parent = 0);
+	virtual ~DecompressionDevice();
+
+	bool open(OpenMode mode) override;
+	void close() override;
+
+	bool isSequential() const override;
+	bool atEnd() const override;
+	qint64 bytesAvailable() const override;
+	bool waitForReadyRead(int msecs) override;
+
+	static Format format(const QString& filePath);
+	static bool isSupported(const Format& format);
+	static QSharedPointer<QIODevice> openFile(const QString& filePath);
+
+	enum {
+		chunk_size = 1 << 20,	// decompressed bytes per chunk
+		max_chunks = 8,
+	};
+
+protected:
+	qint64 readData(char* data, qint64 maxSize) override;
+	qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+	void decompress();
+	bool decompressGzip(QIODevice& src);
+	bool decompressZstd(QIODevice& src);
+	bool push(QByteArray& chunk);
+	void finish(const QString& error = QString());
+
+	QString mFilePath;
+	Format mFormat = format_none;
+
+	QThreadPool mPool;		// one thread per device - it must never wait for other tasks
+	QFuture<void> mFuture;
+	QAtomicInt mCancel;
+
+	mutable QMutex mMutex;
+	QWaitCondition mReadable;	// a chunk was added or the worker finished
+	QWaitCondition mWritable;	// a chunk was consumed
+	QQueue<QByteArray> mChunks;
+	bool mFinished = false;
+	QString mError;
+
+	// the chunk which is currently read (only touched by the reader)
+	QByteArray mCurrent;
+	int mPos = 0;
+};
+
+}
@@ -1,4 +1,3 @@
-#include "DatabaseLoader.h"
 /*******************************************************************************************************
  PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
 
@@ -33,15 +32,299 @@
 #include "DatabaseLoader.h"
 
 #include "Utils.h"
+#include "JsonStream.h"
+#include "TextStore.h"
+#include "PolygonStore.h"
+#include "PageXml.h"
+#include "Compression.h"
+#include "Network.h"
+
 #pragma warning(push, 0)	// no warnings from includes
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QDebug>
 #include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QBuffer>
+#include <QThread>
+#include <QDataStream>
+#include <QDateTime>
+#include <QTimer>
+#include <QMutexLocker>
+#include <QTemporaryDir>
+#include <QEventLoop>
+#include <QCoreApplication>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QMap>
+
+#include <algorithm>
+#include <opencv2/core.hpp>
 #pragma warning(pop)
 
 namespace pie {
 
+	// -------------------------------------------------------------------- DatabaseIndex 
+	DatabaseIndex::DatabaseIndex() {
+	}
+
+	/// <summary>
+	/// Returns the page index of a database.
+	/// The cached index is used if it is newer than the database.
+	/// Otherwise the database is scanned and the index is cached.
+	/// </summary>
+	/// <param name="filePath">The database's file path.</param>
+	/// <returns>The index which is empty if the database could not be scanned.</returns>
+	DatabaseIndex DatabaseIndex::create(const QString & filePath) {
+
+		Timer dt;
+		DatabaseIndex idx;
+
+		if (idx.load(filePath)) {
+			qDebug() << "[DatabaseIndex]" << idx.numPages() << "page offsets loaded in" << dt;
+			return idx;
+		}
+
+		if (!idx.scan(filePath))
+			return DatabaseIndex();
+
+		idx.save(filePath);
+		qDebug() << "[DatabaseIndex]" << idx.numPages() << "pages indexed in" << dt;
+
+		return idx;
+	}
+
+	/// <summary>
+	/// Downloads the page index of a remote database.
+	/// The index must be next to the database (e.g. db.json.pidx).
+	/// Cached indexes are revalidated by the DownloadService.
+	/// </summary>
+	/// <param name="url">The database's url.</param>
+	/// <returns>The index which is empty if the server has none.</returns>
+	DatabaseIndex DatabaseIndex::fromUrl(const QString & url) {
+
+		QSharedPointer<Download> d = DownloadService::instance().get(QUrl(indexPath(url)));
+		QByteArray ba = d->readAll();
+		d->waitForFinished();
+
+		if (d->hasError())
+			return DatabaseIndex();
+
+		QBuffer b(&ba);
+		b.open(QIODevice::ReadOnly);
+
+		DatabaseIndex idx;
+		if (!idx.read(b))
+			return DatabaseIndex();
+
+		// the database must not be modified after its index
+		idx.mIndexed = d->lastModified();
+
+		return idx;
+	}
+
+	bool DatabaseIndex::isEmpty() const {
+		return mPageOffsets.isEmpty();
+	}
+
+	/// <summary>
+	/// Returns the size of the database when it was indexed.
+	/// </summary>
+	qint64 DatabaseIndex::fileSize() const {
+		return mFileSize;
+	}
+
+	/// <summary>
+	/// Returns when a remote index was modified.
+	/// Pages are requested on condition that the database
+	/// was not modified after it (If-Unmodified-Since).
+	/// It is invalid for local indexes or if the server did not send it.
+	/// </summary>
+	QDateTime DatabaseIndex::indexed() const {
+		return mIndexed;
+	}
+
+	int DatabaseIndex::numPages() const {
+
+		int np = 0;
+		for (const QVector<qint64>& po : mPageOffsets)
+			np += po.size();
+
+		return np;
+	}
+
+	int DatabaseIndex::numPages(int docIdx) const {
+		return mPageOffsets[docIdx].size();
+	}
+
+	int DatabaseIndex::numDocuments() const {
+		return mPageOffsets.size();
+	}
+
+	QString DatabaseIndex::documentName(int docIdx) const {
+		return mDocumentNames[docIdx];
+	}
+
+	QVector<qint64> DatabaseIndex::pageOffsets(int docIdx) const {
+		return mPageOffsets[docIdx];
+	}
+
+	/// <summary>
+	/// Draws a stratified sample of the pages.
+	/// Each document contributes proportionally to its size
+	/// (but at least one page) and pages are evenly spaced
+	/// within the document. Hence, the sample is deterministic.
+	/// </summary>
+	/// <param name="numPages">The approximate sample size.</param>
+	/// <returns>The sorted page indices of each document.</returns>
+	QVector<QVector<int> > DatabaseIndex::sample(int numPages) const {
+
+		QVector<QVector<int> > s(numDocuments());
+		int np = this->numPages();
+
+		if (np == 0)
+			return s;
+
+		for (int dIdx = 0; dIdx < numDocuments(); dIdx++) {
+
+			int n = this->numPages(dIdx);
+
+			if (n == 0)
+				continue;
+
+			int k = qBound(1, qRound((double)numPages * n / np), n);
+
+			for (int idx = 0; idx < k; idx++)
+				s[dIdx] << (int)((idx + 0.5) * n / k);
+		}
+
+		return s;
+	}
+
+	QString DatabaseIndex::indexPath(const QString & filePath) {
+		return filePath + ".pidx";
+	}
+
+	bool DatabaseIndex::load(const QString & filePath) {
+
+		QFile f(indexPath(filePath));
+
+		if (!f.open(QIODevice::ReadOnly))
+			return false;
+
+		QFileInfo dbInfo(filePath);
+
+		// the index is outdated
+		if (!read(f) || 
+			mFileSize != dbInfo.size() || 
+			mModified != dbInfo.lastModified().toMSecsSinceEpoch()) {
+			*this = DatabaseIndex();
+			return false;
+		}
+
+		return true;
+	}
+
+	bool DatabaseIndex::read(QIODevice & device) {
+
+		QDataStream ds(&device);
+		quint32 magic = 0;
+		qint32 version = 0;
+
+		ds >> magic >> version >> mFileSize >> mModified;
+
+		if (magic != 0x50494458 || version != 1)
+			return false;
+
+		ds >> mDocumentNames >> mPageOffsets;
+
+		return ds.status() == QDataStream::Ok && mDocumentNames.size() == mPageOffsets.size();
+	}
+
+	bool DatabaseIndex::save(const QString & filePath) const {
+
+		QFile f(indexPath(filePath));
+
+		// this is fine - the database might be on a read-only drive
+		if (!f.open(QIODevice::WriteOnly)) {
+			qDebug() << "[DatabaseIndex] cannot cache the index to" << f.fileName();
+			return false;
+		}
+
+		QFileInfo dbInfo(filePath);
+
+		QDataStream ds(&f);
+		ds << (quint32)0x50494458 << (qint32)1;
+		ds << (qint64)dbInfo.size() << (qint64)dbInfo.lastModified().toMSecsSinceEpoch();
+		ds << mDocumentNames << mPageOffsets;
+
+		return ds.status() == QDataStream::Ok;
+	}
+
+	/// <summary>
+	/// Records the offset of each page.
+	/// Pages are skipped by a raw scan, so this is
+	/// bound by the disk and not by parsing.
+	/// </summary>
+	bool DatabaseIndex::scan(const QString & filePath) {
+
+		QFile f(filePath);
+
+		if (!f.open(QIODevice::ReadOnly)) {
+			qCritical() << "Sorry, I could not open" << filePath << "for reading...";
+			return false;
+		}
+
+		JsonStreamReader reader(&f);
+
+		if (!reader.enterObject())
+			return false;
+
+		QString key;
+		while (reader.nextKey(key)) {
+
+			if (key != "documents" || !reader.enterArray()) {
+				reader.skipValue();
+				continue;
+			}
+
+			while (reader.nextElement() && reader.enterObject()) {
+
+				QString name;
+				QVector<qint64> offsets;
+
+				QString dKey;
+				while (reader.nextKey(dKey)) {
+
+					if (dKey == "name")
+						name = reader.readString();
+					else if (dKey == "pages" && reader.enterArray()) {
+
+						while (reader.nextElement()) {
+							offsets << reader.pos();
+							reader.skipValue();
+						}
+					}
+					else
+						reader.skipValue();
+				}
+
+				mDocumentNames << name;
+				mPageOffsets << offsets;
+			}
+		}
+
+		if (reader.hasError()) {
+			qWarning() << "[DatabaseIndex] cannot index" << filePath << ":" << reader.errorString();
+			return false;
+		}
+
+		mFileSize = QFileInfo(filePath).size();
+		mModified = QFileInfo(filePath).lastModified().toMSecsSinceEpoch();
+
+		return true;
+	}
+
 	// -------------------------------------------------------------------- DatabaseLoader 
 	DatabaseLoader::DatabaseLoader(const QString & filePath) {
 		mFilePath = filePath;
@@ -50,16 +333,939 @@ namespace pie {
 	bool DatabaseLoader::parse() {
 
 		Timer dt;
-		QJsonObject jd = Utils::readJson(mFilePath);
-		mCollection = QSharedPointer<Collection>::create(Collection::fromJson(jd, QFileInfo(mFilePath).baseName()));
+
+		LoadOptions options;
+		options.fields = mFields;
+
+		if (mLazyText)
+			options.textStore = QSharedPointer<TextStore>::create();
+
+		// polygons are only kept if the database has them
+		if (mFields.contains(FieldProjection::f_regions))
+			options.polygons = QSharedPointer<PolygonStore>::create();
+
+		QString name = QFileInfo(mFilePath).baseName();
+		QStringList shards = shardFiles(mFilePath);
+
+		if (!shards.isEmpty()) {
+
+			if (!parseShards(shards, options))
+				return false;
+		}
+		else if (QFileInfo(mFilePath).isDir()) {
+
+			// build the collection from PAGE XML files
+			PageXmlIngester pi(mFilePath);
+			pi.setOptions(options);
+
+			if (!pi.ingest())
+				return false;
+
+			mCollection = pi.collection();
+		}
+		else if (QFileInfo(mFilePath).exists() && mSampleSize > 0 && parseSample(options)) {
+			// the rest is loaded by the progressive loader
+		}
+		else if (QFileInfo(mFilePath).exists()) {
+
+			// compressed databases are decompressed while parsing
+			QSharedPointer<QIODevice> d = DecompressionDevice::openFile(mFilePath);
+
+			if (!d)
+				return false;
+
+			// stream the database - unneeded fields are never materialized
+			JsonStreamReader reader(d.data());
+			mCollection = QSharedPointer<Collection>::create(Collection::fromJson(reader, name, options));
+		}
+		else {
+			// remote resources are parsed while they are downloaded
+			if (!parseRemote(options))
+				return false;
+		}
+
+		// caches are stored next to local databases
+		if (QFileInfo(mFilePath).isFile())
+			mCollection->setFilePath(mFilePath);
 
 		qDebug() << *mCollection;
 		qDebug() << "parsing takes" << dt;
 
-		return !mCollection->isEmpty();
+		// remote pages arrive once the progressive loader is started
+		return !mCollection->isEmpty() || !mLoader.isNull();
+	}
+
+	/// <summary>
+	/// Parses a stratified sample of the database.
+	/// Pages are read by their offsets so the time needed
+	/// only depends on the sample size (once the index is cached).
+	/// </summary>
+	/// <param name="options">The load options.</param>
+	/// <returns>false if the database is smaller than the sample.</returns>
+	bool DatabaseLoader::parseSample(const LoadOptions & options) {
+
+		// pages are read by their offsets which needs a seekable file
+		if (DecompressionDevice::format(mFilePath) != DecompressionDevice::format_none)
+			return false;
+
+		DatabaseIndex index = DatabaseIndex::create(mFilePath);
+
+		// nothing to gain here
+		if (index.isEmpty() || index.numPages() <= mSampleSize)
+			return false;
+
+		QFile f(mFilePath);
+
+		if (!f.open(QIODevice::ReadOnly)) {
+			qCritical() << "Sorry, I could not open" << mFilePath << "for reading...";
+			return false;
+		}
+
+		QVector<QVector<int> > sample = index.sample(mSampleSize);
+		JsonStreamReader reader(&f);
+
+		mCollection = QSharedPointer<Collection>::create(QFileInfo(mFilePath).baseName(), options);
+
+		for (int dIdx = 0; dIdx < index.numDocuments(); dIdx++) {
+
+			QVector<qint64> offsets = index.pageOffsets(dIdx);
+			QVector<QSharedPointer<PageData> > pages;
+
+			for (int pIdx : sample[dIdx]) {
+				reader.seek(offsets[pIdx]);
+				pages << QSharedPointer<PageData>::create(PageData::fromJson(reader, options));
+			}
+
+			auto doc = QSharedPointer<Document>::create(index.documentName(dIdx));
+			doc->addPages(pages);
+
+			// use the final size - otherwise the color changes while loading
+			doc->setColor(ColorManager::color(index.numPages(dIdx)));
+			mCollection->addDocument(doc);
+		}
+
+		mLoader = QSharedPointer<ProgressiveLoader>::create(mCollection, mFilePath, index, sample, options);
+
+		qDebug() << "sampled" << mCollection->numPages() << "of" << index.numPages() << "pages";
+
+		return true;
+	}
+
+	/// <summary>
+	/// Prepares loading a remote database in the background.
+	/// Only the page index is downloaded here, pages are loaded
+	/// by the progressiveLoader() which must be started by the caller.
+	/// Its collectionChanged() signal is emitted once the first pages arrived.
+	/// </summary>
+	/// <param name="options">The load options.</param>
+	/// <returns>true - download errors are reported by the loader.</returns>
+	bool DatabaseLoader::parseRemote(const LoadOptions & options) {
+
+		DatabaseIndex index = DatabaseIndex::fromUrl(mFilePath);
+
+		mCollection = QSharedPointer<Collection>::create(QFileInfo(mFilePath).baseName(), options);
+
+		// documents are known in advance if the server has the index
+		for (int dIdx = 0; dIdx < index.numDocuments(); dIdx++) {
+
+			auto doc = QSharedPointer<Document>::create(index.documentName(dIdx));
+			doc->setColor(ColorManager::color(index.numPages(dIdx)));
+			mCollection->addDocument(doc);
+		}
+
+		mLoader = QSharedPointer<ProgressiveLoader>::create(mCollection, mFilePath, index, QVector<QVector<int> >(index.numDocuments()), options);
+
+		if (index.isEmpty())
+			qDebug() << "streaming" << mFilePath;
+		else
+			qDebug() << "loading" << index.numPages() << "pages from" << mFilePath << "with parallel range requests";
+
+		return true;
+	}
+
+	/// <summary>
+	/// Parses all shards of a database concurrently (one shard per thread).
+	/// The shards share the text and polygon stores and their documents
+	/// are merged in the shard order. Each document remembers its shard
+	/// (see Document::source()). Shards are always loaded completely.
+	/// </summary>
+	/// <param name="shards">The shard files.</param>
+	/// <param name="options">The load options.</param>
+	/// <returns>false if no shard could be loaded.</returns>
+	bool DatabaseLoader::parseShards(const QStringList & shards, const LoadOptions & options) {
+
+		QVector<QSharedPointer<Collection> > collections(shards.size());
+		QSharedPointer<Collection>* cp = collections.data();
+
+		QMutex mutex;
+		int numLoaded = 0;
+
+		auto parseRange = [&](const cv::Range& r) {
+
+			for (int idx = r.start; idx < r.end; idx++) {
+
+				// skip the remaining shards
+				if (mCancel.load())
+					break;
+
+				Timer dt;
+				cp[idx] = parseShard(shards[idx], options);
+
+				QMutexLocker lock(&mutex);
+				numLoaded++;
+
+				if (cp[idx])
+					qDebug() << "[DatabaseLoader] shard" << numLoaded << "/" << shards.size() << QFileInfo(shards[idx]).fileName() 
+						<< "with" << cp[idx]->numPages() << "pages loaded in" << dt;
+
+				if (mProgress)
+					mProgress(numLoaded, shards.size());
+			}
+		};
+
+		// NOTE: this blocks - the GUI parses databases in the background (see TabWidget::loadFile)
+		cv::parallel_for_(cv::Range(0, shards.size()), parseRange, shards.size());
+
+		if (mCancel.load()) {
+			qInfo() << "[DatabaseLoader] loading" << mFilePath << "cancelled";
+			return false;
+		}
+
+		mCollection = QSharedPointer<Collection>::create(QFileInfo(mFilePath).baseName(), options);
+		int numFailed = 0;
+
+		for (const QSharedPointer<Collection>& c : collections) {
+
+			if (!c) {
+				numFailed++;
+				continue;
+			}
+
+			for (auto d : c->documents())
+				mCollection->addDocument(d);
+		}
+
+		if (numFailed > 0)
+			qWarning() << "[DatabaseLoader]" << numFailed << "of" << shards.size() << "shards could not be loaded";
+
+		return numFailed < shards.size();
+	}
+
+	/// <summary>
+	/// Parses a single shard of a sharded database.
+	/// </summary>
+	/// <param name="shard">The shard's file path or url.</param>
+	/// <param name="options">The load options.</param>
+	/// <returns>The shard's documents or a NULL pointer if it cannot be opened.</returns>
+	QSharedPointer<Collection> DatabaseLoader::parseShard(const QString & shard, const LoadOptions & options) {
+
+		QSharedPointer<QIODevice> d;
+
+		// remote shards are downloaded in parallel by the DownloadService
+		if (QFileInfo(shard).exists())
+			d = DecompressionDevice::openFile(shard);
+		else
+			d = DownloadService::instance().get(QUrl(shard));
+
+		if (!d)
+			return QSharedPointer<Collection>();
+
+		JsonStreamReader reader(d.data());
+		QSharedPointer<Collection> c = QSharedPointer<Collection>::create(Collection::fromJson(reader, QFileInfo(shard).baseName(), options));
+
+		for (auto doc : c->documents())
+			doc->setSource(shard);
+
+		return c;
+	}
+
+	/// <summary>
+	/// Returns the shards of a sharded database.
+	/// A sharded database is either a manifest (*.shards) which lists
+	/// one database per line (relative to the manifest, # starts a comment)
+	/// or a folder which contains a manifest or shards named *.shard.json
+	/// (other json files in a folder are no shards).
+	/// </summary>
+	/// <param name="filePath">The manifest or folder.</param>
+	/// <returns>The shard files or an empty list if the database is not sharded.</returns>
+	QStringList DatabaseLoader::shardFiles(const QString & filePath) {
+
+		QFileInfo fi(filePath);
+		QStringList files;
+
+		if (fi.isDir()) {
+
+			QDir dir(filePath);
+			QStringList manifests = dir.entryList(QStringList() << "*.shards", QDir::Files, QDir::Name);
+
+			if (!manifests.isEmpty())
+				return shardFiles(dir.absoluteFilePath(manifests.first()));
+
+			QStringList filters;
+			filters << "*.shard.json" << "*.shard.json.gz" << "*.shard.json.zst";
+
+			for (const QString& fn : dir.entryList(filters, QDir::Files, QDir::Name))
+				files << dir.absoluteFilePath(fn);
+		}
+		else if (fi.suffix().compare("shards", Qt::CaseInsensitive) == 0 && !fi.exists()) {
+
+			// remote manifests - shards are relative to the manifest's url
+			bool ok = false;
+			QByteArray ba = DownloadService::instance().download(QUrl(filePath), &ok);
+
+			if (!ok)
+				return files;
+
+			for (const QByteArray& l : ba.split('\n')) {
+
+				QString line = QString::fromUtf8(l).trimmed();
+
+				if (line.isEmpty() || line.startsWith("#"))
+					continue;
+
+				files << QUrl(filePath).resolved(QUrl(line)).toString();
+			}
+		}
+		else if (fi.suffix().compare("shards", Qt::CaseInsensitive) == 0) {
+
+			QFile f(filePath);
+
+			if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+				qCritical() << "Sorry, I could not open" << filePath << "for reading...";
+				return files;
+			}
+
+			QDir dir = fi.absoluteDir();
+
+			while (!f.atEnd()) {
+
+				QString line = QString::fromUtf8(f.readLine()).trimmed();
+
+				if (line.isEmpty() || line.startsWith("#"))
+					continue;
+
+				files << QDir::cleanPath(dir.absoluteFilePath(line));
+			}
+		}
+
+		return files;
+	}
+
+	/// <summary>
+	/// If lazy is true, page texts are not kept in RAM.
+	/// Use this for text-heavy collections if you are
+	/// only interested in geometric features.
+	/// </summary>
+	/// <param name="lazy">If true, texts are paged in on demand.</param>
+	void DatabaseLoader::setLazyText(bool lazy) {
+		mLazyText = lazy;
+	}
+
+	/// <summary>
+	/// Sets the fields that are loaded.
+	/// If you only need image sizes, regions and texts
+	/// are skipped which reduces load time and memory.
+	/// </summary>
+	/// <param name="fields">The fields to load.</param>
+	void DatabaseLoader::setFields(const FieldProjection & fields) {
+		mFields = fields;
+	}
+
+	/// <summary>
+	/// If numPages > 0, only a sample of the database is parsed.
+	/// The remaining pages are loaded by the progressiveLoader()
+	/// which must be started by the caller.
+	/// </summary>
+	/// <param name="numPages">The sample size, 0 loads all pages.</param>
+	void DatabaseLoader::setSampleSize(int numPages) {
+		mSampleSize = numPages;
+	}
+
+	/// <summary>
+	/// Sets a function which is called whenever a shard is loaded.
+	/// NOTE: it is called from worker threads.
+	/// </summary>
+	void DatabaseLoader::setProgressCallback(ProgressCallback progress) {
+		mProgress = progress;
+	}
+
+	/// <summary>
+	/// Stops loading shards - parse() returns false then.
+	/// Shards which are being parsed are finished first.
+	/// </summary>
+	void DatabaseLoader::cancel() {
+		mCancel.store(1);
+	}
+
+	QString DatabaseLoader::filePath() const {
+		return mFilePath;
 	}
 
 	QSharedPointer<Collection> DatabaseLoader::collection() const {
 		return mCollection;
 	}
- }
\ No newline at end of file
+
+	/// <summary>
+	/// Returns the loader for the remaining pages.
+	/// It is NULL if the whole database was parsed.
+	/// </summary>
+	QSharedPointer<ProgressiveLoader> DatabaseLoader::progressiveLoader() const {
+		return mLoader;
+	}
+
+	// -------------------------------------------------------------------- ProgressiveLoader 
+	ProgressiveLoader::ProgressiveLoader(
+		QSharedPointer<Collection> collection, 
+		const QString & filePath, 
+		const DatabaseIndex & index, 
+		const QVector<QVector<int> >& sample, 
+		const LoadOptions & options) {
+
+		mCollection = collection;
+		mFilePath = filePath;
+		mIndex = index;
+		mSample = sample;
+		mOptions = options;
+		mRemote = !QFileInfo(filePath).exists();
+
+		mNumLoaded = mCollection->numPages();
+
+		// batches are applied at a fixed rate - otherwise plots are updated too often
+		mTimer = new QTimer(this);
+		mTimer->setInterval(500);
+		connect(mTimer, SIGNAL(timeout()), this, SLOT(applyBatches()));
+
+		// databases might be parsed by a worker (see TabWidget::loadFile) - batches are applied in the GUI thread
+		if (QCoreApplication::instance())
+			moveToThread(QCoreApplication::instance()->thread());
+	}
+
+	ProgressiveLoader::~ProgressiveLoader() {
+
+		cancel();
+		mFuture.waitForFinished();
+	}
+
+	void ProgressiveLoader::start() {
+
+		if (mFinished || mFuture.isRunning())
+			return;
+
+		mTimer->start();
+		mFuture = QtConcurrent::run(this, &ProgressiveLoader::load);
+	}
+
+	void ProgressiveLoader::cancel() {
+		mCancel.store(1);
+	}
+
+	bool ProgressiveLoader::isFinished() const {
+		return mFinished;
+	}
+
+	int ProgressiveLoader::numLoaded() const {
+		return mNumLoaded;
+	}
+
+	int ProgressiveLoader::numPages() const {
+
+		// unknown until the whole database is streamed
+		if (mIndex.isEmpty())
+			return mNumLoaded;
+
+		return mIndex.numPages();
+	}
+
+	void ProgressiveLoader::load() {
+
+		// NOTE: this runs in a worker thread - do not touch the collection here
+		if (mRemote && mIndex.isEmpty()) {
+			streamRemote();
+			mDone.store(1);
+			return;
+		}
+		else if (mRemote) {
+
+			// split the documents into segments with roughly the same number of pages
+			const int numSegments = qMax(qMin(mIndex.numDocuments(), DownloadService::instance().maxConcurrent()), 1);
+			const double pagesPerSegment = (double)mIndex.numPages() / numSegments;
+
+			QVector<int> firstDoc;
+			firstDoc << 0;
+			int np = 0;
+
+			for (int dIdx = 0; dIdx < mIndex.numDocuments(); dIdx++) {
+
+				if (np >= firstDoc.size() * pagesPerSegment && firstDoc.size() < numSegments)
+					firstDoc << dIdx;
+
+				np += mIndex.numPages(dIdx);
+			}
+			firstDoc << mIndex.numDocuments();
+
+			// one range request per segment
+			cv::parallel_for_(cv::Range(0, firstDoc.size() - 1), [&](const cv::Range& r) {
+
+				for (int sIdx = r.start; sIdx < r.end; sIdx++)
+					loadSegment(firstDoc[sIdx], firstDoc[sIdx + 1]);
+
+			}, firstDoc.size() - 1);
+
+			mDone.store(1);
+			return;
+		}
+
+		QFile f(mFilePath);
+
+		if (!f.open(QIODevice::ReadOnly)) {
+			qCritical() << "Sorry, I could not open" << mFilePath << "for reading...";
+			mDone.store(1);
+			return;
+		}
+
+		JsonStreamReader reader(&f);
+		const int batchSize = 1000;
+
+		for (int dIdx = 0; dIdx < mIndex.numDocuments(); dIdx++) {
+
+			QVector<qint64> offsets = mIndex.pageOffsets(dIdx);
+			const QVector<int>& sample = mSample[dIdx];
+			int sIdx = 0;
+
+			Batch b;
+			b.docIdx = dIdx;
+
+			for (int pIdx = 0; pIdx < offsets.size(); pIdx++) {
+
+				if (mCancel.load()) {
+					mDone.store(1);
+					return;
+				}
+
+				// already loaded
+				if (sIdx < sample.size() && sample[sIdx] == pIdx) {
+					sIdx++;
+					continue;
+				}
+
+				reader.seek(offsets[pIdx]);
+				b.pageIdx << pIdx;
+				b.pages << QSharedPointer<PageData>::create(PageData::fromJson(reader, mOptions));
+
+				if (b.pages.size() >= batchSize)
+					push(b);
+			}
+
+			// the document's last page might be sampled
+			if (!b.pages.isEmpty())
+				push(b);
+		}
+
+		mDone.store(1);
+	}
+
+	/// <summary>
+	/// Downloads the documents [firstDoc lastDoc) by a single range request.
+	/// </summary>
+	void ProgressiveLoader::loadSegment(int firstDoc, int lastDoc) {
+
+		// NOTE: this runs in a worker thread
+		qint64 begin = -1, end = -1;
+
+		for (int dIdx = firstDoc; dIdx < lastDoc && begin == -1; dIdx++) {
+			if (mIndex.numPages(dIdx) > 0)
+				begin = mIndex.pageOffsets(dIdx).first();
+		}
+
+		// the segment ends where the next one starts
+		for (int dIdx = lastDoc; dIdx < mIndex.numDocuments() && end == -1; dIdx++) {
+			if (mIndex.numPages(dIdx) > 0)
+				end = mIndex.pageOffsets(dIdx).first() - 1;
+		}
+
+		if (begin == -1)
+			return;
+
+		// the request fails if the database was modified after it was indexed
+		QSharedPointer<Download> d = DownloadService::instance().get(QUrl(mFilePath), begin, end, mIndex.indexed());
+		JsonStreamReader reader(d.data(), begin);
+		const int batchSize = 1000;
+
+		for (int dIdx = firstDoc; dIdx < lastDoc; dIdx++) {
+
+			QVector<qint64> offsets = mIndex.pageOffsets(dIdx);
+
+			Batch b;
+			b.docIdx = dIdx;
+
+			for (int pIdx = 0; pIdx < offsets.size(); pIdx++) {
+
+				if (mCancel.load())
+					return;
+
+				if (!reader.seek(offsets[pIdx])) {
+
+					if (d->isModified())
+						qCritical() << "[ProgressiveLoader] the index of" << mFilePath << "is outdated - please re-index the database";
+					else
+						qWarning() << "[ProgressiveLoader] cannot load" << mFilePath << ":" << d->error();
+					return;
+				}
+
+				// the server did not send Last-Modified - so the size is all we can compare
+				if (!mIndex.indexed().isValid() && d->totalSize() > 0 && mIndex.fileSize() > 0 && d->totalSize() != mIndex.fileSize()) {
+					qCritical() << "[ProgressiveLoader] the index of" << mFilePath << "is outdated - please re-index the database";
+					return;
+				}
+
+				b.pageIdx << pIdx;
+				b.pages << QSharedPointer<PageData>::create(PageData::fromJson(reader, mOptions));
+
+				if (b.pages.size() >= batchSize || pIdx == offsets.size() - 1)
+					push(b);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Parses a remote database while it is downloaded.
+	/// Documents are created once their first batch is applied.
+	/// </summary>
+	void ProgressiveLoader::streamRemote() {
+
+		// NOTE: this runs in a worker thread
+		QSharedPointer<Download> d = DownloadService::instance().get(QUrl(mFilePath));
+		JsonStreamReader reader(d.data());
+		const int batchSize = 1000;
+
+		if (!reader.enterObject()) {
+			qWarning() << "[ProgressiveLoader] cannot load" << mFilePath << ":" << d->error();
+			return;
+		}
+
+		QString key;
+		while (reader.nextKey(key)) {
+
+			if (key != "documents" || !reader.enterArray()) {
+				reader.skipValue();
+				continue;
+			}
+
+			for (int dIdx = 0; reader.nextElement() && reader.enterObject(); dIdx++) {
+
+				Batch b;
+				b.docIdx = dIdx;
+
+				QString dKey;
+				while (reader.nextKey(dKey)) {
+
+					// NOTE: written databases have the name before the pages
+					if (dKey == "name")
+						b.docName = reader.readString();
+					else if (dKey == "pages" && reader.enterArray()) {
+
+						for (int pIdx = 0; reader.nextElement(); pIdx++) {
+
+							if (mCancel.load())
+								return;
+
+							b.pageIdx << pIdx;
+							b.pages << QSharedPointer<PageData>::create(PageData::fromJson(reader, mOptions));
+
+							if (b.pages.size() >= batchSize)
+								push(b);
+						}
+					}
+					else
+						reader.skipValue();
+				}
+
+				// empty documents are created too
+				push(b);
+			}
+		}
+
+		if (reader.hasError() || d->hasError())
+			qWarning() << "[ProgressiveLoader]" << mFilePath << "is incomplete:" << (d->hasError() ? d->error() : reader.errorString());
+	}
+
+	/// <summary>
+	/// Hands a batch to the GUI thread and clears it.
+	/// </summary>
+	void ProgressiveLoader::push(Batch & batch) {
+
+		QMutexLocker lock(&mMutex);
+		mBatches << batch;
+
+		Batch b;
+		b.docIdx = batch.docIdx;
+		b.docName = batch.docName;
+		batch = b;
+	}
+
+	void ProgressiveLoader::applyBatches() {
+
+		// check this before we take the batches - otherwise we might miss the last one
+		bool done = mDone.load() != 0;
+
+		QVector<Batch> batches;
+		{
+			QMutexLocker lock(&mMutex);
+			batches = mBatches;
+			mBatches.clear();
+		}
+
+		QVector<QSharedPointer<Document> > docs = mCollection->documents();
+		QMap<int, Batch> added;		// the new pages of each document
+
+		for (const Batch& b : batches) {
+
+			// streamed documents are not known in advance
+			while (b.docIdx >= docs.size()) {
+				docs << QSharedPointer<Document>::create(b.docName);
+				mCollection->replaceDocuments(docs.size() - 1, 0, QVector<QSharedPointer<Document> >() << docs.last());
+			}
+
+			Batch& a = added[b.docIdx];
+			a.pageIdx << b.pageIdx;
+			a.pages << b.pages;
+
+			mNumLoaded += b.pages.size();
+		}
+
+		// one splice per document - so cached features are only computed for the new pages
+		for (auto it = added.begin(); it != added.end(); ++it) {
+
+			const Batch& a = it.value();
+
+			if (a.pages.isEmpty())
+				continue;
+
+			// the sampled pages are in place and the others arrive in file order
+			QVector<int> sample = mSample.value(it.key());
+			int first = (int)(std::lower_bound(sample.begin(), sample.end(), a.pageIdx.first()) - sample.begin());
+			int last = (int)(std::lower_bound(sample.begin(), sample.end(), a.pageIdx.last()) - sample.begin());
+			int firstPage = first + docs[it.key()]->numPages() - sample.size();
+
+			// merge with the sampled pages which lie in between
+			QVector<QSharedPointer<PageData> > dp = docs[it.key()]->pages();
+			QVector<QSharedPointer<PageData> > pages;
+
+			for (int sIdx = first, idx = 0; sIdx < last || idx < a.pages.size();) {
+
+				if (idx == a.pages.size() || (sIdx < last && sample[sIdx] < a.pageIdx[idx]))
+					pages << dp[firstPage + sIdx++ - first];
+				else
+					pages << a.pages[idx++];
+			}
+
+			mCollection->replacePages(it.key(), firstPage, last - first, pages);
+		}
+
+		if (done) {
+
+			mTimer->stop();
+
+			// colors depend on the final document size
+			if (mIndex.isEmpty()) {
+				for (auto d : docs)
+					d->setColor(ColorManager::color(d->numPages()));
+			}
+
+			mFinished = true;
+
+			qDebug() << mNumLoaded << "of" << numPages() << "pages loaded in the background";
+
+			emit collectionChanged();
+			emit finished();
+		}
+		else if (!batches.isEmpty())
+			emit collectionChanged();
+	}
+
+	/// <summary>
+	/// Loads a database from a local stand-in server.
+	/// The database is served with its page index (parallel range
+	/// requests - one request fails with a 5xx response) and without
+	/// (streamed). Both must match the collection parsed from disk.
+	/// No pages must be loaded if the database is newer than its index.
+	/// </summary>
+	/// <returns>true if all remote collections match the local one.</returns>
+	bool test::RemoteDatabase() {
+
+		QTemporaryDir dir;
+		QString filePath = dir.path() + "/db.json";
+
+		// write a database which needs several segments
+		{
+			QFile f(filePath);
+
+			if (!f.open(QIODevice::WriteOnly)) {
+				qWarning() << "[test::RemoteDatabase] cannot write" << filePath;
+				return false;
+			}
+
+			cv::RNG rng(42);
+			JsonStreamWriter writer(&f);
+			writer.beginObject();
+			writer.writeKey("documents");
+			writer.beginArray();
+
+			for (int dIdx = 0; dIdx < 60; dIdx++) {
+
+				QString docName = QString("document-%1").arg(dIdx);
+
+				writer.beginObject();
+				writer.writeKey("name");
+				writer.writeString(docName);
+				writer.writeKey("pages");
+				writer.beginArray();
+
+				for (int pIdx = 0, numPages = rng.uniform(1, 40); pIdx < numPages; pIdx++) {
+
+					QString pageName = QString("%1-%2").arg(docName).arg(pIdx, 4, 10, QChar('0'));
+
+					writer.beginObject();
+					writer.writeKey("xmlName");
+					writer.writeString(pageName + ".xml");
+					writer.writeKey("content");
+					writer.writeString(QString("page %1 of %2").arg(pIdx).arg(docName));
+					writer.writeKey("collection");
+					writer.writeString(QString("test"));
+					writer.writeKey("document");
+					writer.writeString(docName);
+					writer.writeKey("imgName");
+					writer.writeString(pageName + ".jpg");
+					writer.writeKey("width");
+					writer.writeInt(2000);
+					writer.writeKey("height");
+					writer.writeInt(3000);
+					writer.writeKey("regions");
+					writer.beginArray();
+
+					for (int rIdx = 0, numRegions = rng.uniform(0, 30); rIdx < numRegions; rIdx++) {
+						writer.beginObject();
+						writer.writeKey("type");
+						writer.writeInt(rng.uniform(0, 5));
+						writer.writeKey("x");
+						writer.writeInt(rng.uniform(0, 1800));
+						writer.writeKey("y");
+						writer.writeInt(rng.uniform(0, 2800));
+						writer.writeKey("width");
+						writer.writeInt(rng.uniform(1, 200));
+						writer.writeKey("height");
+						writer.writeInt(rng.uniform(1, 200));
+						writer.endObject();
+					}
+
+					writer.endArray();
+					writer.endObject();
+				}
+
+				writer.endArray();
+				writer.endObject();
+			}
+
+			writer.endArray();
+			writer.endObject();
+
+			if (!writer.flush()) {
+				qWarning() << "[test::RemoteDatabase] cannot write" << filePath << writer.errorString();
+				return false;
+			}
+		}
+
+		DatabaseLoader localLoader(filePath);
+		if (!localLoader.parse())
+			return false;
+
+		QSharedPointer<Collection> local = localLoader.collection();
+
+		// the index is saved next to the database
+		if (DatabaseIndex::create(filePath).isEmpty())
+			return false;
+
+		QFile db(filePath);
+		QFile pidx(filePath + ".pidx");
+
+		if (!db.open(QIODevice::ReadOnly) || !pidx.open(QIODevice::ReadOnly)) {
+			qWarning() << "[test::RemoteDatabase] cannot read" << filePath;
+			return false;
+		}
+
+		QByteArray body = db.readAll();
+
+		HttpStandIn server;
+		server.add("/indexed.json", body);
+		QByteArray index = pidx.readAll();
+		server.add("/indexed.json.pidx", index);
+		server.fail("/indexed.json", HttpStandIn::fail_5xx);
+		server.add("/streamed.json", body);
+
+		// the database was modified after it was indexed
+		server.add("/outdated.json", body);
+		server.add("/outdated.json.pidx", index, true, QDateTime::currentDateTimeUtc().addSecs(-3600));
+
+		if (!server.listen()) {
+			qWarning() << "[test::RemoteDatabase] cannot start the stand-in server";
+			return false;
+		}
+
+		bool success = true;
+
+		// pages are loaded in the background
+		auto load = [](DatabaseLoader& loader) {
+
+			if (!loader.parse() || !loader.progressiveLoader())
+				return false;
+
+			QSharedPointer<ProgressiveLoader> pl = loader.progressiveLoader();
+
+			QEventLoop loop;
+			QObject::connect(pl.data(), SIGNAL(finished()), &loop, SLOT(quit()));
+			pl->start();
+			loop.exec();
+
+			return true;
+		};
+
+		for (const QString& path : { QString("/indexed.json"), QString("/streamed.json") }) {
+
+			Timer dt;
+
+			DatabaseLoader loader(server.url(path).toString());
+			bool parsed = load(loader);
+
+			QSharedPointer<Collection> remote = loader.collection();
+
+			bool ok = parsed &&
+				remote->numPages() == local->numPages() &&
+				remote->numRegions() == local->numRegions() &&
+				remote->documents().size() == local->documents().size();
+
+			for (int dIdx = 0; ok && dIdx < local->documents().size(); dIdx++) {
+
+				QVector<QSharedPointer<PageData> > lp = local->documents()[dIdx]->pages();
+				QVector<QSharedPointer<PageData> > rp = remote->documents()[dIdx]->pages();
+
+				ok = local->documents()[dIdx]->name() == remote->documents()[dIdx]->name() && lp.size() == rp.size();
+
+				for (int pIdx = 0; ok && pIdx < lp.size(); pIdx++)
+					ok = lp[pIdx]->name() == rp[pIdx]->name() && lp[pIdx]->numRegions() == rp[pIdx]->numRegions();
+			}
+
+			qInfo().noquote() << "[test::RemoteDatabase]" << path << (ok ? "ok" : "FAILED") << "in" << dt;
+			success = success && ok;
+		}
+
+		{
+			DatabaseLoader loader(server.url("/outdated.json").toString());
+			bool ok = load(loader) && loader.collection()->numPages() == 0 && server.numRequests("/outdated.json") > 0;
+
+			qInfo().noquote() << "[test::RemoteDatabase] /outdated.json" << (ok ? "ok" : "FAILED");
+			success = success && ok;
+		}
+
+		return success;
+	}
+ }
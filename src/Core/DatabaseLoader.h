@@ -36,6 +36,15 @@
 #pragma warning(push, 0)	// no warnings from includes
 #include <QString>
 #include <QSharedPointer>
+#include <QObject>
+#include <QVector>
+#include <QFuture>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QDateTime>
+
+#include <functional>
 #pragma warning(pop)
 
 #ifndef DllExport
@@ -46,21 +55,170 @@
 #endif
 #endif
 
+// Qt defines
+class QTimer;
+class QIODevice;
+
 namespace pie {	
 
+class ProgressiveLoader;
+
+/// <summary>
+/// Byte offsets of all pages in a database.
+/// The index is created by a raw scan (nothing is materialized)
+/// and cached next to the database so that it is only
+/// created once.
+/// </summary>
+class DllExport DatabaseIndex {
+
+public:
+	DatabaseIndex();
+
+	static DatabaseIndex create(const QString& filePath);
+	static DatabaseIndex fromUrl(const QString& url);
+
+	bool isEmpty() const;
+	qint64 fileSize() const;
+	QDateTime indexed() const;
+	int numPages() const;
+	int numPages(int docIdx) const;
+	int numDocuments() const;
+
+	QString documentName(int docIdx) const;
+	QVector<qint64> pageOffsets(int docIdx) const;
+
+	QVector<QVector<int> > sample(int numPages) const;
+
+private:
+	static QString indexPath(const QString& filePath);
+	bool load(const QString& filePath);
+	bool read(QIODevice& device);
+	bool save(const QString& filePath) const;
+	bool scan(const QString& filePath);
+
+	qint64 mFileSize = -1;		// the size of the indexed database
+	qint64 mModified = 0;
+	QDateTime mIndexed;			// the Last-Modified date of remote indexes
+	QVector<QString> mDocumentNames;
+	QVector<QVector<qint64> > mPageOffsets;
+};
+
+/// <summary>
+/// Loads a collection from a database.
+/// Besides a single json database, sharded databases are supported:
+/// a manifest (*.shards) listing one database per line or a folder
+/// with a manifest or *.shard.json databases. Shards are parsed concurrently
+/// and merged into one collection. Other folders are ingested as PAGE XML.
+/// parse() blocks - run it in the background if it is called by the GUI.
+/// </summary>
 class DllExport DatabaseLoader {
 
 public:
 	DatabaseLoader(const QString& filePath = QString());
 
+	typedef std::function<void(int numLoaded, int numShards)> ProgressCallback;
+
 	bool parse();
 
+	void setLazyText(bool lazy);
+	void setFields(const FieldProjection& fields);
+	void setSampleSize(int numPages);
+	void setProgressCallback(ProgressCallback progress);
+	void cancel();
+
+	QString filePath() const;
 	QSharedPointer<Collection> collection() const;
+	QSharedPointer<ProgressiveLoader> progressiveLoader() const;
+
+	static QStringList shardFiles(const QString& filePath);
+	static QSharedPointer<Collection> parseShard(const QString& shard, const LoadOptions& options);
 
 private:
+	bool parseSample(const LoadOptions& options);
+	bool parseRemote(const LoadOptions& options);
+	bool parseShards(const QStringList& shards, const LoadOptions& options);
+
 	QString mFilePath;
+	bool mLazyText = false;
+	FieldProjection mFields;
+	int mSampleSize = 0;
+	ProgressCallback mProgress;
+	QAtomicInt mCancel;
 
 	QSharedPointer<Collection> mCollection;
+	QSharedPointer<ProgressiveLoader> mLoader;
 };
 
+/// <summary>
+/// Loads the pages which are not part of the sample in the background.
+/// New pages are added to the collection in the GUI thread
+/// and collectionChanged() is emitted so that plots can refine.
+/// Pages are inserted at their file position, so cached features
+/// are spliced (see Collection::replacePages()) and not recomputed.
+/// Remote databases (urls) are parsed while they are downloaded.
+/// If the server has the database's page index (*.pidx), documents
+/// are split into segments which are fetched by parallel range requests.
+/// </summary>
+class DllExport ProgressiveLoader : public QObject {
+	Q_OBJECT
+
+public:
+	ProgressiveLoader(
+		QSharedPointer<Collection> collection, 
+		const QString& filePath, 
+		const DatabaseIndex& index, 
+		const QVector<QVector<int> >& sample, 
+		const LoadOptions& options);
+	virtual ~ProgressiveLoader();
+
+	void start();
+	void cancel();
+	
+	bool isFinished() const;
+	int numLoaded() const;
+	int numPages() const;
+
+signals:
+	void collectionChanged() const;
+	void finished() const;
+
+private slots:
+	void applyBatches();
+
+private:
+	struct Batch {
+		int docIdx = -1;
+		QString docName;	// needed if documents are not known in advance
+		QVector<int> pageIdx;
+		QVector<QSharedPointer<PageData> > pages;
+	};
+
+	void load();
+	void loadSegment(int firstDoc, int lastDoc);
+	void streamRemote();
+	void push(Batch& batch);
+
+	QSharedPointer<Collection> mCollection;
+	QString mFilePath;
+	DatabaseIndex mIndex;
+	QVector<QVector<int> > mSample;
+	LoadOptions mOptions;
+	bool mRemote = false;
+
+	int mNumLoaded = 0;
+	bool mFinished = false;
+
+	QTimer* mTimer = 0;
+	QFuture<void> mFuture;
+	QAtomicInt mCancel;
+	QAtomicInt mDone;
+
+	QMutex mMutex;
+	QVector<Batch> mBatches;	// loaded but not yet applied
+};
+
+namespace test {
+	DllExport bool RemoteDatabase();
+}
+
 }
@@ -0,0 +1,526 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#include "DatabaseWatcher.h"
+
+#include "DatabaseLoader.h"
+#include "JsonStream.h"
+#include "Compression.h"
+#include "Utils.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QFileSystemWatcher>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTimer>
+#include <QMutexLocker>
+#include <QDebug>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <opencv2/core.hpp>
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- DatabaseWatcher 
+	/// <summary>
+	/// Creates a watcher - call start() to watch the database.
+	/// </summary>
+	/// <param name="collection">The collection which was loaded from filePath.</param>
+	/// <param name="filePath">The database, a shard manifest (*.shards) or a folder of shards.</param>
+	DatabaseWatcher::DatabaseWatcher(QSharedPointer<Collection> collection, const QString & filePath, QObject* parent) : QObject(parent) {
+
+		mCollection = collection;
+		mFilePath = filePath;
+
+		// new documents share the collection's stores
+		mOptions.fields = collection->fields();
+		mOptions.textStore = collection->textStore();
+		mOptions.polygons = collection->polygons();
+
+		QFileInfo fi(filePath);
+		mSharded = fi.isDir() || fi.suffix().compare("shards", Qt::CaseInsensitive) == 0;
+
+		mWatcher = new QFileSystemWatcher(this);
+
+		// wait until writers are done
+		mDelay = new QTimer(this);
+		mDelay->setSingleShot(true);
+		mDelay->setInterval(1000);
+
+		mTimer = new QTimer(this);
+		mTimer->setInterval(200);
+
+		connect(mWatcher, SIGNAL(fileChanged(const QString&)), this, SLOT(fileChanged()));
+		connect(mWatcher, SIGNAL(directoryChanged(const QString&)), this, SLOT(fileChanged()));
+		connect(mDelay, SIGNAL(timeout()), this, SLOT(reload()));
+		connect(mTimer, SIGNAL(timeout()), this, SLOT(applyDeltas()));
+	}
+
+	DatabaseWatcher::~DatabaseWatcher() {
+		mFuture.waitForFinished();
+	}
+
+	/// <summary>
+	/// Indexes the database in the background and starts watching it.
+	/// Call this once the collection is completely loaded.
+	/// </summary>
+	void DatabaseWatcher::start() {
+
+		if (mIndexed || mFuture.isRunning())
+			return;
+
+		if (!QFileInfo(mFilePath).exists()) {
+			qInfo() << "[DatabaseWatcher] only local databases can be watched:" << mFilePath;
+			return;
+		}
+
+		mDone.store(0);
+		mTimer->start();
+		mFuture = QtConcurrent::run(this, &DatabaseWatcher::index);
+	}
+
+	bool DatabaseWatcher::isWatching() const {
+		return !mWatcher->files().isEmpty() || !mWatcher->directories().isEmpty();
+	}
+
+	/// <summary>
+	/// Parses the changes of the database in the background.
+	/// They are applied to the collection once they are parsed.
+	/// </summary>
+	void DatabaseWatcher::reload() {
+
+		if (!mIndexed)
+			return;
+
+		// the database changed while the last changes were parsed
+		if (mFuture.isRunning()) {
+			mPending = true;
+			return;
+		}
+
+		mDone.store(0);
+		mTimer->start();
+		mFuture = QtConcurrent::run(this, &DatabaseWatcher::parse);
+	}
+
+	void DatabaseWatcher::fileChanged() {
+
+		// restart - so that we parse once the writer is done
+		mDelay->start();
+	}
+
+	/// <summary>
+	/// Applies the parsed changes to the collection.
+	/// </summary>
+	void DatabaseWatcher::applyDeltas() {
+
+		if (!mDone.load())
+			return;
+
+		mTimer->stop();
+
+		if (!mIndexed) {
+
+			mIndexed = true;
+
+			QMutexLocker lock(&mMutex);
+
+			if (mSharded && mShards.isEmpty()) {
+				qInfo() << "[DatabaseWatcher] cannot watch" << mFilePath << "- it has no json shards";
+				return;
+			}
+
+			// the database changed while it was loaded - the next change reloads all documents
+			if (!mSharded && mDocOffsets.size() != mCollection->numDocuments())
+				mDocOffsets.clear();
+			else if (!mSharded && !mDocOffsets.isEmpty()) {
+				mLastName = mCollection->documents().last()->name();
+				mLastNumPages = mCollection->documents().last()->numPages();
+			}
+
+			lock.unlock();
+			updatePaths();
+			qInfo() << "[DatabaseWatcher] watching" << mFilePath;
+
+			return;
+		}
+
+		Timer dt;
+		int numPages = 0;
+
+		QVector<Delta> deltas;
+		{
+			QMutexLocker lock(&mMutex);
+			deltas.swap(mDeltas);
+		}
+
+		for (const Delta& d : deltas) {
+
+			int firstDoc = d.firstDoc;
+			int numRemoved = d.numRemoved;
+
+			// the documents of a shard are contiguous - new shards are appended
+			if (!d.source.isEmpty()) {
+
+				QVector<QSharedPointer<Document> > docs = mCollection->documents();
+				firstDoc = docs.size();
+				numRemoved = 0;
+
+				for (int dIdx = 0; dIdx < docs.size(); dIdx++) {
+
+					if (docs[dIdx]->source() == d.source) {
+						
+						if (numRemoved == 0)
+							firstDoc = dIdx;
+						numRemoved++;
+					}
+				}
+			}
+
+			if (numRemoved == -1)
+				numRemoved = mCollection->numDocuments() - firstDoc;
+
+			mCollection->replaceDocuments(firstDoc, numRemoved, d.documents);
+
+			for (auto doc : d.documents)
+				numPages += doc->numPages();
+		}
+
+		bool changed = !deltas.isEmpty();
+
+		// files might have been replaced (which ends watching them) or shards were added
+		updatePaths();
+
+		if (changed) {
+			qInfo() << "[DatabaseWatcher]" << numPages << "pages of" << mFilePath << "updated in" << dt;
+			emit collectionChanged();
+		}
+
+		if (mPending) {
+			mPending = false;
+			reload();
+		}
+	}
+
+	void DatabaseWatcher::index() {
+
+		// NOTE: this runs in a worker thread - do not touch the collection here
+		Timer dt;
+
+		if (mSharded) {
+
+			QStringList shards = DatabaseLoader::shardFiles(mFilePath);
+			QHash<QString, qint64> modified;
+
+			for (const QString& s : shards)
+				modified.insert(s, QFileInfo(s).lastModified().toMSecsSinceEpoch());
+
+			QMutexLocker lock(&mMutex);
+			mShards = shards;
+			mModified = modified;
+		}
+		else {
+
+			qint64 size = QFileInfo(mFilePath).size();
+			QSharedPointer<QIODevice> d = DecompressionDevice::openFile(mFilePath);
+
+			JsonStreamReader reader(d.data());
+			QVector<qint64> offsets;
+			QVector<QSharedPointer<Document> > docs;
+
+			if (!d || !readDatabase(reader, false, offsets, docs)) {
+				qWarning() << "[DatabaseWatcher] cannot index" << mFilePath << "- changes reload all documents";
+				offsets.clear();
+			}
+
+			QMutexLocker lock(&mMutex);
+			mFileSize = size;
+			mDocOffsets = offsets;
+		}
+
+		qDebug() << "[DatabaseWatcher]" << mFilePath << "indexed in" << dt;
+		mDone.store(1);
+	}
+
+	void DatabaseWatcher::parse() {
+
+		// NOTE: this runs in a worker thread - do not touch the collection here
+		if (mSharded)
+			parseShards();
+		else
+			parseDatabase();
+
+		mDone.store(1);
+	}
+
+	/// <summary>
+	/// Parses the documents which were appended to a json database.
+	/// The last known document is parsed again since pages might have
+	/// been appended to it. If the database was changed otherwise,
+	/// all documents are parsed.
+	/// </summary>
+	void DatabaseWatcher::parseDatabase() {
+
+		const qint64 size = QFileInfo(mFilePath).size();
+
+		// work on a copy - the state is updated once the delta is parsed
+		qint64 fileSize;
+		QVector<qint64> docOffsets;
+		QString lastName;
+		int lastNumPages;
+		{
+			QMutexLocker lock(&mMutex);
+			fileSize = mFileSize;
+			docOffsets = mDocOffsets;
+			lastName = mLastName;
+			lastNumPages = mLastNumPages;
+		}
+
+		// e.g. the file was touched
+		if (size == fileSize)
+			return;
+
+		QVector<qint64> offsets;
+		QVector<QSharedPointer<Document> > docs;
+		bool appended = false;
+
+		QSharedPointer<QIODevice> d = DecompressionDevice::openFile(mFilePath);
+
+		if (!d)
+			return;
+
+		// NOTE: compressed databases are skipped up to the last document - but nothing is materialized
+		JsonStreamReader reader(d.data());
+
+		if (size > fileSize && !docOffsets.isEmpty() && reader.seekElement(docOffsets.last())) {
+
+			if (!readDocuments(reader, true, offsets, docs)) {
+				qInfo() << "[DatabaseWatcher]" << mFilePath << "is incomplete - waiting for the next change";
+				return;
+			}
+
+			// the old documents are unchanged if the last one is still at its position
+			appended = !docs.isEmpty() && docs.first()->name() == lastName;
+		}
+
+		Delta delta;
+
+		if (appended) {
+
+			delta.firstDoc = docOffsets.size() - 1;
+			delta.numRemoved = 1;
+
+			// keep the last document if no pages were appended to it
+			if (docs.first()->numPages() == lastNumPages) {
+				docs.removeFirst();
+				offsets.removeFirst();
+				delta.firstDoc++;
+				delta.numRemoved = 0;
+			}
+
+			docOffsets.resize(delta.firstDoc);
+			docOffsets << offsets;
+		}
+		else {
+
+			offsets.clear();
+			docs.clear();
+
+			d = DecompressionDevice::openFile(mFilePath);
+			JsonStreamReader fullReader(d.data());
+
+			if (!d || !readDatabase(fullReader, true, offsets, docs)) {
+				qInfo() << "[DatabaseWatcher]" << mFilePath << "is incomplete - waiting for the next change";
+				return;
+			}
+
+			delta.firstDoc = 0;
+			delta.numRemoved = -1;
+			docOffsets = offsets;
+
+			qInfo() << "[DatabaseWatcher]" << mFilePath << "was rewritten - all documents are reloaded";
+		}
+
+		delta.documents = docs;
+
+		QMutexLocker lock(&mMutex);
+
+		if (!docs.isEmpty()) {
+			mLastName = docs.last()->name();
+			mLastNumPages = docs.last()->numPages();
+		}
+
+		mFileSize = size;
+		mDocOffsets = docOffsets;
+
+		if (delta.numRemoved != 0 || !docs.isEmpty())
+			mDeltas << delta;
+	}
+
+	/// <summary>
+	/// Parses shards which were added or changed.
+	/// Shards are parsed concurrently.
+	/// </summary>
+	void DatabaseWatcher::parseShards() {
+
+		QStringList shards = DatabaseLoader::shardFiles(mFilePath);
+
+		QStringList oldShards;
+		QHash<QString, qint64> lastModified;
+		{
+			QMutexLocker lock(&mMutex);
+			oldShards = mShards;
+			lastModified = mModified;
+		}
+
+		QVector<Delta> deltas;
+
+		// removed shards
+		for (const QString& s : oldShards) {
+
+			if (!shards.contains(s)) {
+				Delta d;
+				d.source = s;
+				deltas << d;
+				lastModified.remove(s);
+			}
+		}
+
+		QStringList changed;
+		QVector<qint64> modified;
+
+		for (const QString& s : shards) {
+
+			qint64 m = QFileInfo(s).lastModified().toMSecsSinceEpoch();
+
+			if (lastModified.value(s, -1) != m) {
+				changed << s;
+				modified << m;
+			}
+		}
+
+		QVector<QSharedPointer<Collection> > collections(changed.size());
+		QSharedPointer<Collection>* cp = collections.data();
+
+		cv::parallel_for_(cv::Range(0, changed.size()), [&](const cv::Range& r) {
+
+			for (int idx = r.start; idx < r.end; idx++)
+				cp[idx] = DatabaseLoader::parseShard(changed[idx], mOptions);
+
+		}, changed.size());
+
+		for (int idx = 0; idx < changed.size(); idx++) {
+
+			if (!collections[idx])
+				continue;
+
+			Delta d;
+			d.source = changed[idx];
+			d.documents = collections[idx]->documents();
+			deltas << d;
+
+			lastModified.insert(changed[idx], modified[idx]);
+		}
+
+		QMutexLocker lock(&mMutex);
+		mDeltas << deltas;
+		mModified = lastModified;
+		mShards = shards;
+	}
+
+	bool DatabaseWatcher::readDatabase(JsonStreamReader & reader, bool materialize, QVector<qint64>& offsets, QVector<QSharedPointer<Document> >& docs) const {
+
+		if (!reader.enterObject())
+			return false;
+
+		QString key;
+		while (reader.nextKey(key)) {
+
+			if (key == "documents" && reader.enterArray()) {
+				if (!readDocuments(reader, materialize, offsets, docs))
+					return false;
+			}
+			else
+				reader.skipValue();
+		}
+
+		return !reader.hasError();
+	}
+
+	/// <summary>
+	/// Reads the remaining documents of the documents array.
+	/// </summary>
+	/// <param name="reader">The reader which is positioned in the documents array.</param>
+	/// <param name="materialize">If false, documents are skipped and only their offsets are collected.</param>
+	/// <param name="offsets">The position of each document.</param>
+	/// <param name="docs">The documents.</param>
+	/// <returns>false if the database is corrupt (or still being written).</returns>
+	bool DatabaseWatcher::readDocuments(JsonStreamReader & reader, bool materialize, QVector<qint64>& offsets, QVector<QSharedPointer<Document> >& docs) const {
+
+		while (reader.nextElement()) {
+
+			offsets << reader.pos();
+
+			if (!materialize) {
+				reader.skipValue();
+				continue;
+			}
+
+			docs << QSharedPointer<Document>::create(Document::fromJson(reader, mOptions));
+		}
+
+		return !reader.hasError();
+	}
+
+	void DatabaseWatcher::updatePaths() {
+
+		QStringList paths;
+		paths << mFilePath;
+
+		QMutexLocker lock(&mMutex);
+		QStringList shards = mShards;
+		lock.unlock();
+
+		for (const QString& s : shards) {
+			if (QFileInfo(s).exists())
+				paths << s;
+		}
+
+		if (!mWatcher->files().isEmpty())
+			mWatcher->removePaths(mWatcher->files());
+		if (!mWatcher->directories().isEmpty())
+			mWatcher->removePaths(mWatcher->directories());
+
+		mWatcher->addPaths(paths);
+	}
+
+}
@@ -0,0 +1,138 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#include "PageData.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QString>
+#include <QSharedPointer>
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QFuture>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QStringList>
+#pragma warning(pop)
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+class QTimer;
+class QFileSystemWatcher;
+
+namespace pie {
+
+class JsonStreamReader;
+
+/// <summary>
+/// Watches a local database and applies its changes to an open collection.
+/// Only the delta is parsed: documents appended to a json database
+/// are read from the last known document on and only changed shards
+/// of a sharded database are parsed again. Changes are applied by
+/// Collection::replaceDocuments(), hence cached features are only
+/// computed for the new pages. Other changes (e.g. a database that
+/// was rewritten) reload all documents.
+/// </summary>
+class DllExport DatabaseWatcher : public QObject {
+	Q_OBJECT
+
+public:
+	DatabaseWatcher(QSharedPointer<Collection> collection, const QString& filePath, QObject* parent = 0);
+	virtual ~DatabaseWatcher();
+
+	bool isWatching() const;
+
+signals:
+	void collectionChanged() const;
+
+public slots:
+	void start();
+	void reload();
+
+private slots:
+	void fileChanged();
+	void applyDeltas();
+
+private:
+	struct Delta {
+		QString source;		// the shard (if sharded)
+		int firstDoc = -1;	// -1 replaces the documents of source
+		int numRemoved = 0;	// -1 replaces all documents
+		QVector<QSharedPointer<Document> > documents;
+	};
+
+	void index();
+	void parse();
+	void parseDatabase();
+	void parseShards();
+	bool readDatabase(JsonStreamReader& reader, bool materialize, QVector<qint64>& offsets, QVector<QSharedPointer<Document> >& docs) const;
+	bool readDocuments(JsonStreamReader& reader, bool materialize, QVector<qint64>& offsets, QVector<QSharedPointer<Document> >& docs) const;
+	void updatePaths();
+
+	QSharedPointer<Collection> mCollection;
+	QString mFilePath;
+	LoadOptions mOptions;
+
+	QFileSystemWatcher* mWatcher = 0;
+	QTimer* mDelay = 0;		// writers change files in several steps
+	QTimer* mTimer = 0;
+
+	QFuture<void> mFuture;
+	QAtomicInt mDone;
+	bool mSharded = false;
+	bool mIndexed = false;
+	bool mPending = false;
+
+	// NOTE: the following members are shared with the worker - lock mMutex
+	mutable QMutex mMutex;
+	QVector<Delta> mDeltas;
+
+	// json databases
+	qint64 mFileSize = -1;
+	QVector<qint64> mDocOffsets;	// the positions of all documents
+	QString mLastName;				// the last document's name and size
+	int mLastNumPages = 0;
+
+	// sharded databases
+	QStringList mShards;
+	QHash<QString, qint64> mModified;	// shard -> last modified
+};
+
+}
@@ -0,0 +1,443 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#include "Embedding.h"
+
+#include "Processor.h"
+#include "Utils.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QDebug>
+#include <QTimer>
+#include <QMutexLocker>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <limits>
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- PrincipalComponents 
+	PrincipalComponents::PrincipalComponents() {
+	}
+
+	/// <summary>
+	/// Computes the principal components of all pages.
+	/// The feature covariance C is never formed explicitly.
+	/// Instead, each pass over the pages computes C * Q for a
+	/// small basis Q (features x (components + 10)).
+	/// Passes are split into blocks that are multiplied in parallel.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <param name="ids">The feature ids (if empty all base features are used).</param>
+	/// <param name="numComponents">The number of components.</param>
+	/// <returns>The principal components.</returns>
+	PrincipalComponents PrincipalComponents::compute(const Collection & c, const QVector<int>& ids, int numComponents) {
+
+		Timer dt;
+		FeatureRegistry& fr = FeatureRegistry::instance();
+
+		PrincipalComponents pc;
+		pc.mFeatures = ids.isEmpty() ? fr.baseFeatures(c) : ids;
+
+		QVector<QSharedPointer<PageData> > pages = c.pages();
+		const int n = pages.size();
+		const int d = pc.mFeatures.size();
+		const int k = qMin(numComponents, d);
+
+		pc.mNumPages = n;
+
+		if (n < 2 || k < 1)
+			return pc;
+
+		// create the caches - chunks are computed in parallel afterwards
+		fr.prepare(c, pc.mFeatures);
+
+		const int chunkSize = 1 << 16;
+		const int blockSize = 4096;
+
+		// keep the feature matrix if it is small - otherwise it is recomputed in each pass
+		const bool keep = (qint64)n * d * sizeof(float) <= (qint64)256 * 1024 * 1024;
+		cv::Mat all;
+
+		auto features = [&](const cv::Range& r) {
+
+			if (!all.empty())
+				return all.colRange(r);
+
+			cv::Mat fm(d, r.size(), CV_32FC1);
+			cv::parallel_for_(cv::Range(0, (r.size() + blockSize - 1) / blockSize), [&](const cv::Range& br) {
+
+				for (int bIdx = br.start; bIdx < br.end; bIdx++) {
+					cv::Range pr(r.start + bIdx * blockSize, qMin(r.start + (bIdx + 1) * blockSize, r.end));
+					fr.compute(c, pages, pc.mFeatures, pr).copyTo(fm.colRange(pr.start - r.start, pr.end - r.start));
+				}
+			});
+
+			return fm;
+		};
+
+		if (keep)
+			all = features(cv::Range(0, n));
+
+		// pass 1: mean & standard deviation
+		cv::Mat mean(d, 1, CV_64FC1, cv::Scalar(0));
+		cv::Mat sigma(d, 1, CV_64FC1, cv::Scalar(0));
+
+		for (int start = 0; start < n; start += chunkSize) {
+
+			cv::Mat fm;
+			features(cv::Range(start, qMin(start + chunkSize, n))).convertTo(fm, CV_64F);
+
+			cv::Mat s;
+			cv::reduce(fm, s, 1, cv::REDUCE_SUM, CV_64F);
+			mean += s;
+			cv::reduce(fm.mul(fm), s, 1, cv::REDUCE_SUM, CV_64F);
+			sigma += s;
+		}
+
+		mean /= n;
+		cv::sqrt(cv::max(sigma / n - mean.mul(mean), 0.0), sigma);
+
+		int numValid = 0;
+		for (int idx = 0; idx < d; idx++) {
+
+			double& s = sigma.at<double>(idx);
+			if (s > 1e-12)
+				numValid++;
+			else
+				s = std::numeric_limits<double>::infinity();	// constant features become 0
+		}
+
+		auto zscore = [&](const cv::Range& r) {
+
+			cv::Mat z;
+			features(r).convertTo(z, CV_64F);
+
+			for (int idx = 0; idx < d; idx++) {
+				double s = 1.0 / sigma.at<double>(idx);
+				cv::Mat zr = z.row(idx);
+				zr.convertTo(zr, CV_64F, s, -mean.at<double>(idx) * s);
+			}
+
+			return z;
+		};
+
+		// returns Z * Z' * Q (the unnormalized covariance times Q)
+		auto covTimes = [&](const cv::Mat& Q) {
+
+			cv::Mat W(d, Q.cols, CV_64FC1, cv::Scalar(0));
+			QMutex mutex;
+
+			for (int start = 0; start < n; start += chunkSize) {
+
+				cv::Mat z = zscore(cv::Range(start, qMin(start + chunkSize, n)));
+
+				cv::parallel_for_(cv::Range(0, (z.cols + blockSize - 1) / blockSize), [&](const cv::Range& br) {
+
+					cv::Mat w(d, Q.cols, CV_64FC1, cv::Scalar(0));
+
+					for (int bIdx = br.start; bIdx < br.end; bIdx++) {
+
+						cv::Mat zb = z.colRange(bIdx * blockSize, qMin((bIdx + 1) * blockSize, z.cols));
+						cv::Mat t;
+						cv::gemm(zb, Q, 1.0, cv::noArray(), 0.0, t, cv::GEMM_1_T);	// pages x l
+						cv::gemm(zb, t, 1.0, w, 1.0, w);
+					}
+
+					QMutexLocker lock(&mutex);
+					W += w;
+				});
+			}
+
+			return W;
+		};
+
+		// randomized subspace iteration (Halko et al. 2011) - the exact basis is used for few features
+		const int l = qMin(d, k + 10);
+		cv::Mat Q;
+
+		if (l == d)
+			Q = cv::Mat::eye(d, d, CV_64FC1);
+		else {
+			Q.create(d, l, CV_64FC1);
+			cv::RNG(42).fill(Q, cv::RNG::NORMAL, 0.0, 1.0);
+
+			for (int it = 0; it < 3; it++)
+				Q = orthonormalize(covTimes(orthonormalize(Q)));
+		}
+
+		// Rayleigh-Ritz: eigenvectors of the small projected covariance
+		cv::Mat T = Q.t() * covTimes(Q);
+		cv::Mat evals, evecs;
+		cv::eigen((T + T.t()) * 0.5, evals, evecs);
+
+		pc.mComponents = evecs.rowRange(0, k) * Q.t();	// k x d
+
+		// make the signs deterministic: the largest loading is positive
+		for (int idx = 0; idx < k; idx++) {
+
+			cv::Mat r = pc.mComponents.row(idx);
+			cv::Point maxLoc, minLoc;
+			double minV, maxV;
+			cv::minMaxLoc(r, &minV, &maxV, &minLoc, &maxLoc);
+
+			if (std::abs(minV) > std::abs(maxV))
+				r *= -1.0;
+		}
+
+		pc.mExplained = evals.rowRange(0, k) / qMax(1.0, (double)numValid * n);
+
+		// last pass: project all pages
+		pc.mScores.create(k, n, CV_32FC1);
+
+		for (int start = 0; start < n; start += chunkSize) {
+
+			cv::Range r(start, qMin(start + chunkSize, n));
+			cv::Mat s = pc.mComponents * zscore(r);
+			cv::Mat dst = pc.mScores.colRange(r);
+			s.convertTo(dst, CV_32F);
+		}
+
+		qInfo().noquote() << pc.toString() << "computed in" << dt;
+
+		return pc;
+	}
+
+	/// <summary>
+	/// Returns the projected pages with a row per component and a column per page.
+	/// </summary>
+	cv::Mat PrincipalComponents::scores() const {
+		return mScores;
+	}
+
+	/// <summary>
+	/// Returns the loadings with a row per component and a column per feature.
+	/// </summary>
+	cv::Mat PrincipalComponents::components() const {
+		return mComponents;
+	}
+
+	/// <summary>
+	/// Returns the ratio of the total variance explained by each component.
+	/// </summary>
+	cv::Mat PrincipalComponents::explainedVariance() const {
+		return mExplained;
+	}
+
+	int PrincipalComponents::numComponents() const {
+		return mComponents.rows;
+	}
+
+	int PrincipalComponents::numPages() const {
+		return mNumPages;
+	}
+
+	QString PrincipalComponents::toString() const {
+
+		QString msg = "PCA of " + QString::number(mNumPages) + " pages with " + QString::number(mFeatures.size()) + " features";
+
+		for (int idx = 0; idx < mExplained.rows; idx++)
+			msg += QString(idx == 0 ? " - explained variance: " : ", ") + QString::number(mExplained.at<double>(idx) * 100.0, 'f', 1) + "%";
+
+		return msg;
+	}
+
+	/// <summary>
+	/// Orthonormalizes the columns of m (modified Gram-Schmidt).
+	/// </summary>
+	cv::Mat PrincipalComponents::orthonormalize(const cv::Mat & m) {
+
+		cv::Mat q = m.clone();
+
+		for (int cIdx = 0; cIdx < q.cols; cIdx++) {
+
+			cv::Mat c = q.col(cIdx);
+
+			for (int pIdx = 0; pIdx < cIdx; pIdx++) {
+				cv::Mat p = q.col(pIdx);
+				c -= p * p.dot(c);
+			}
+
+			double nrm = cv::norm(c);
+			if (nrm > 1e-12)
+				c /= nrm;
+			else
+				c.setTo(0);
+		}
+
+		return q;
+	}
+
+	// -------------------------------------------------------------------- TsneEmbedding 
+	TsneEmbedding::TsneEmbedding(QSharedPointer<Collection> collection, QObject* parent) : QObject(parent) {
+
+		mCollection = collection;
+		mFeatures = defaultFeatures(*collection);
+
+		// the embedding is applied at a fixed rate - otherwise plots are updated too often
+		mTimer = new QTimer(this);
+		mTimer->setInterval(500);
+		connect(mTimer, SIGNAL(timeout()), this, SLOT(applyEmbedding()));
+	}
+
+	TsneEmbedding::~TsneEmbedding() {
+
+		cancel();
+		mFuture.waitForFinished();
+	}
+
+	/// <summary>
+	/// Sets the features which describe a page.
+	/// </summary>
+	/// <param name="ids">The feature ids (see FeatureRegistry).</param>
+	void TsneEmbedding::setFeatures(const QVector<int>& ids) {
+		mFeatures = ids;
+	}
+
+	QVector<int> TsneEmbedding::features() const {
+		return mFeatures;
+	}
+
+	/// <summary>
+	/// Returns all features which can be computed from the collection's fields.
+	/// </summary>
+	QVector<int> TsneEmbedding::defaultFeatures(const Collection & c) {
+		return FeatureRegistry::instance().baseFeatures(c);
+	}
+
+	void TsneEmbedding::setParams(const tsne::Params & params) {
+		mParams = params;
+	}
+
+	tsne::Params TsneEmbedding::params() const {
+		return mParams;
+	}
+
+	bool TsneEmbedding::isRunning() const {
+		return mFuture.isRunning() || mTimer->isActive();
+	}
+
+	QString TsneEmbedding::toString() const {
+
+		return "t-SNE of " + QString::number(mNumPages) + " pages with " + QString::number(mFeatures.size()) +
+			" features (perplexity: " + QString::number(mParams.perplexity) + " theta: " + QString::number(mParams.theta) + ")";
+	}
+
+	/// <summary>
+	/// Starts the embedding in a worker thread.
+	/// </summary>
+	void TsneEmbedding::start() {
+
+		if (isRunning())
+			return;
+
+		Timer dt;
+
+		// features are computed in the GUI thread - the collection might change later on
+		QVector<AxisTransform> ts(mFeatures.size(), AxisTransform(AxisTransform::t_robust_z));
+		cv::Mat fm = AbstractMapper::processAll(mCollection.data(), mFeatures, &ts);
+
+		// tsne wants a row per page
+		cv::Mat features = fm.t();
+		mNumPages = features.rows;
+
+		qInfo().noquote() << toString() << "- features computed in" << dt;
+
+		mCancel.store(0);
+		mDone.store(0);
+		mIteration = 0;
+
+		mTimer->start();
+		mFuture = QtConcurrent::run(this, &TsneEmbedding::compute, features);
+	}
+
+	void TsneEmbedding::cancel() {
+		mCancel.store(1);
+	}
+
+	void TsneEmbedding::compute(const cv::Mat& features) {
+
+		// NOTE: this runs in a worker thread - do not touch the collection here
+		Timer dt;
+		cv::Mat Y(features.rows, 2, CV_64FC1, cv::Scalar(0));
+
+		auto cb = [&](int iter, const double* y) {
+
+			QMutexLocker lock(&mMutex);
+			cv::Mat(features.rows, 2, CV_64FC1, const_cast<double*>(y)).convertTo(mEmbedding, CV_32F);
+			mIteration = iter;
+			mChanged = true;
+
+			return mCancel.load() == 0;
+		};
+
+		bool ok = features.isContinuous() && 
+			tsne::TSNE::run(features.ptr<float>(), features.rows, features.cols, Y.ptr<double>(), mParams, cb);
+
+		if (ok)
+			qInfo() << "t-SNE computed in" << dt;
+		else
+			qInfo() << "t-SNE cancelled after" << dt;
+
+		mDone.store(1);
+	}
+
+	void TsneEmbedding::applyEmbedding() {
+
+		// check this before we take the embedding - otherwise we might miss the last one
+		bool done = mDone.load() != 0;
+
+		cv::Mat e;
+		int iter = 0;
+		{
+			QMutexLocker lock(&mMutex);
+			if (mChanged)
+				e = mEmbedding.clone();
+			iter = mIteration;
+			mChanged = false;
+		}
+
+		// pages were added while we were running
+		if (!e.empty() && e.rows == mCollection->numPages()) {
+			mCollection->setEmbedding(e);
+			emit embeddingChanged();
+		}
+
+		emit progress(iter, mParams.maxIter);
+
+		if (done) {
+			mTimer->stop();
+			emit finished();
+		}
+	}
+
+}
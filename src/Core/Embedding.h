@@ -0,0 +1,154 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#include "PageData.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QObject>
+#include <QSharedPointer>
+#include <QVector>
+#include <QFuture>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include <opencv2/core.hpp>
+
+#include <tsne/tsne.h>
+#pragma warning(pop)
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+class QTimer;
+
+namespace pie {
+
+/// <summary>
+/// Principal components of the (z-scored) page features.
+/// The feature matrix is streamed in chunks of pages so that
+/// millions of pages do not need to be held in memory.
+/// The components are found by a randomized subspace iteration
+/// on the feature covariance which only needs a few passes.
+/// </summary>
+class DllExport PrincipalComponents {
+
+public:
+	PrincipalComponents();
+
+	enum {
+		num_components = 4,
+	};
+
+	static PrincipalComponents compute(const Collection& c, const QVector<int>& ids = QVector<int>(), int numComponents = num_components);
+
+	cv::Mat scores() const;
+	cv::Mat components() const;
+	cv::Mat explainedVariance() const;
+
+	int numComponents() const;
+	int numPages() const;
+
+	QString toString() const;
+
+private:
+	static cv::Mat orthonormalize(const cv::Mat& m);
+
+	QVector<int> mFeatures;
+	cv::Mat mScores;		// components x pages (CV_32F)
+	cv::Mat mComponents;	// components x features (CV_64F)
+	cv::Mat mExplained;		// explained variance ratio per component
+	int mNumPages = 0;
+};
+
+/// <summary>
+/// Computes a 2D t-SNE embedding of all pages in the background.
+/// Pages are described by their (robust z-scored) features.
+/// The current embedding is pushed to the collection at a fixed
+/// rate so that plots show how it converges.
+/// Plot it with the "t-SNE 1" and "t-SNE 2" features.
+/// </summary>
+class DllExport TsneEmbedding : public QObject {
+	Q_OBJECT
+
+public:
+	TsneEmbedding(QSharedPointer<Collection> collection, QObject* parent = 0);
+	virtual ~TsneEmbedding();
+
+	void setFeatures(const QVector<int>& ids);
+	QVector<int> features() const;
+	static QVector<int> defaultFeatures(const Collection& c);
+
+	void setParams(const tsne::Params& params);
+	tsne::Params params() const;
+
+	bool isRunning() const;
+	QString toString() const;
+
+public slots:
+	void start();
+	void cancel();
+
+signals:
+	void progress(int iteration, int numIterations) const;
+	void embeddingChanged() const;
+	void finished() const;
+
+private slots:
+	void applyEmbedding();
+
+private:
+	void compute(const cv::Mat& features);
+
+	QSharedPointer<Collection> mCollection;
+	QVector<int> mFeatures;
+	tsne::Params mParams;
+	int mNumPages = 0;
+
+	QTimer* mTimer = 0;
+	QFuture<void> mFuture;
+	QAtomicInt mCancel;
+	QAtomicInt mDone;
+
+	QMutex mMutex;
+	cv::Mat mEmbedding;		// latest snapshot (pages x 2)
+	int mIteration = 0;
+	bool mChanged = false;
+};
+
+}
@@ -0,0 +1,655 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#include "JsonStream.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QDebug>
+
+#include <cmath>
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- JsonStreamReader
+	/// <summary>
+	/// Creates a reader.
+	/// </summary>
+	/// <param name="device">The device which is opened for reading.</param>
+	/// <param name="offset">The position of the device's first byte, if it only holds a part of the file (e.g. a range request).</param>
+	JsonStreamReader::JsonStreamReader(QIODevice* device, qint64 offset) {
+		mDevice = device;
+
+		if (offset >= 0)
+			mOffset = offset;
+		else if (mDevice)
+			mOffset = mDevice->pos();
+	}
+
+	/// <summary>
+	/// Consumes the opening bracket of an object.
+	/// </summary>
+	/// <returns>false if the next value is not an object.</returns>
+	bool JsonStreamReader::enterObject() {
+
+		if (hasError() || !expect('{'))
+			return false;
+
+		mFirst << true;
+		return true;
+	}
+
+	/// <summary>
+	/// Reads the next key of the current object.
+	/// The reader is positioned at the key's value afterwards,
+	/// which must be consumed by readValue() or skipValue().
+	/// </summary>
+	/// <param name="key">The key.</param>
+	/// <returns>false if the object ended.</returns>
+	bool JsonStreamReader::nextKey(QString & key) {
+
+		if (hasError() || mFirst.isEmpty() || !skipWhitespace())
+			return false;
+
+		if (mBuffer.at(mPos) == '}') {
+			mPos++;
+			mFirst.pop_back();
+			return false;
+		}
+
+		if (!mFirst.last() && !expect(','))
+			return false;
+
+		mFirst.last() = false;
+
+		key = readString();
+
+		return !hasError() && expect(':');
+	}
+
+	/// <summary>
+	/// Consumes the opening bracket of an array.
+	/// </summary>
+	/// <returns>false if the next value is not an array.</returns>
+	bool JsonStreamReader::enterArray() {
+
+		if (hasError() || !expect('['))
+			return false;
+
+		mFirst << true;
+		return true;
+	}
+
+	/// <summary>
+	/// Moves to the next element of the current array.
+	/// </summary>
+	/// <returns>false if the array ended.</returns>
+	bool JsonStreamReader::nextElement() {
+
+		if (hasError() || mFirst.isEmpty() || !skipWhitespace())
+			return false;
+
+		if (mBuffer.at(mPos) == ']') {
+			mPos++;
+			mFirst.pop_back();
+			return false;
+		}
+
+		if (!mFirst.last() && !expect(','))
+			return false;
+
+		mFirst.last() = false;
+
+		return true;
+	}
+
+	/// <summary>
+	/// Materializes the next value.
+	/// </summary>
+	/// <returns>The value or an undefined value if parsing failed.</returns>
+	QJsonValue JsonStreamReader::readValue() {
+
+		QByteArray raw;
+		if (!skipValue(&raw) || raw.isEmpty())
+			return QJsonValue(QJsonValue::Undefined);
+
+		QJsonParseError pe;
+
+		if (raw.at(0) == '{') {
+			QJsonDocument doc = QJsonDocument::fromJson(raw, &pe);
+			if (pe.error == QJsonParseError::NoError)
+				return doc.object();
+		}
+		else if (raw.at(0) == '[') {
+			QJsonDocument doc = QJsonDocument::fromJson(raw, &pe);
+			if (pe.error == QJsonParseError::NoError)
+				return doc.array();
+		}
+		else if (raw.at(0) == '"') {
+			return decodeString(raw);
+		}
+		else {
+			// Qt does not parse top-level scalars
+			QJsonDocument doc = QJsonDocument::fromJson("[" + raw + "]", &pe);
+			if (pe.error == QJsonParseError::NoError && !doc.array().isEmpty())
+				return doc.array().first();
+		}
+
+		setError("cannot parse value at " + QString::number(pos()) + ": " + pe.errorString());
+		return QJsonValue(QJsonValue::Undefined);
+	}
+
+	/// <summary>
+	/// Reads the next string value.
+	/// </summary>
+	/// <returns>The decoded string.</returns>
+	QString JsonStreamReader::readString() {
+
+		if (!skipWhitespace() || mBuffer.at(mPos) != '"') {
+			setError("string expected at " + QString::number(pos()));
+			return QString();
+		}
+
+		QByteArray raw;
+		skipValue(&raw);
+
+		return decodeString(raw);
+	}
+
+	/// <summary>
+	/// Reads the next number.
+	/// Other values (e.g. null) are skipped and read as 0.
+	/// </summary>
+	/// <returns>The number.</returns>
+	double JsonStreamReader::readNumber() {
+
+		QByteArray raw;
+		if (!skipValue(&raw))
+			return 0.0;
+
+		bool ok = false;
+		double v = raw.toDouble(&ok);
+
+		return ok ? v : 0.0;
+	}
+
+	/// <summary>
+	/// Skips the next value without materializing it.
+	/// Nested objects and arrays are skipped by a raw scan
+	/// which only tracks strings and the nesting depth.
+	/// </summary>
+	/// <param name="raw">If not NULL, the value's raw bytes are appended.</param>
+	/// <returns>false if the file ended unexpectedly.</returns>
+	bool JsonStreamReader::skipValue(QByteArray* raw) {
+
+		if (hasError())
+			return false;
+
+		if (!skipWhitespace()) {
+			setError("unexpected end of file");
+			return false;
+		}
+
+		const char first = mBuffer.at(mPos);
+		const bool scalar = first != '{' && first != '[' && first != '"';
+
+		int depth = 0;
+		bool inString = false;
+		bool escaped = false;
+
+		for (;;) {
+
+			if (mPos >= mBuffer.size() && !fill()) {
+
+				// a number at the very end of a file is fine
+				if (scalar)
+					return true;
+
+				setError("unexpected end of file");
+				return false;
+			}
+
+			const char* b = mBuffer.constData();
+			const int start = mPos;
+			const int end = mBuffer.size();
+			int idx = start;
+			bool done = false;
+
+			for (; idx < end; idx++) {
+
+				const char c = b[idx];
+
+				if (scalar) {
+					// scalars end at the next delimiter (which is not consumed)
+					if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+						done = true;
+						break;
+					}
+				}
+				else if (inString) {
+					if (escaped)
+						escaped = false;
+					else if (c == '\\')
+						escaped = true;
+					else if (c == '"') {
+						inString = false;
+
+						if (depth == 0) {
+							idx++;
+							done = true;
+							break;
+						}
+					}
+				}
+				else if (c == '"')
+					inString = true;
+				else if (c == '{' || c == '[')
+					depth++;
+				else if (c == '}' || c == ']') {
+					depth--;
+
+					if (depth == 0) {
+						idx++;
+						done = true;
+						break;
+					}
+				}
+			}
+
+			if (raw)
+				raw->append(b + start, idx - start);
+
+			mPos = idx;
+
+			if (done)
+				return true;
+		}
+	}
+
+	/// <summary>
+	/// Returns the current position in the device.
+	/// </summary>
+	qint64 JsonStreamReader::pos() const {
+		return mOffset + mPos;
+	}
+
+	/// <summary>
+	/// Moves the reader to pos.
+	/// The position must point to the beginning of a value.
+	/// Sequential devices (e.g. downloads) can only seek forward
+	/// which skips the bytes in between.
+	/// Seeking forward within the current chunk does not touch the device,
+	/// so reading nearby values by their offsets is cheap.
+	/// </summary>
+	/// <param name="pos">The absolute position in the device.</param>
+	/// <returns>true if the device could seek.</returns>
+	bool JsonStreamReader::seek(qint64 pos) {
+
+		if (!mDevice)
+			return false;
+
+		mFirst.clear();
+		mError.clear();
+
+		if (pos >= mOffset && pos < mOffset + mBuffer.size()) {
+			mPos = (int)(pos - mOffset);
+			return true;
+		}
+
+		if (mDevice->isSequential()) {
+
+			if (pos < mOffset + mBuffer.size())
+				return false;
+
+			mOffset += mBuffer.size();
+			mBuffer.clear();
+			mPos = 0;
+
+			while (mOffset < pos) {
+
+				QByteArray skipped = mDevice->read(qMin(pos - mOffset, (qint64)1 << 16));
+
+				if (skipped.isEmpty() && !mDevice->waitForReadyRead(30000))
+					return false;
+
+				mOffset += skipped.size();
+			}
+
+			return true;
+		}
+
+		if (!mDevice->seek(pos))
+			return false;
+
+		mBuffer.clear();
+		mPos = 0;
+		mOffset = pos;
+
+		return true;
+	}
+
+	/// <summary>
+	/// Moves the reader to an element of an array.
+	/// In contrast to seek(), the following elements
+	/// of the array can be read by nextElement().
+	/// </summary>
+	/// <param name="pos">The absolute position of the element.</param>
+	/// <returns>true if the device could seek.</returns>
+	bool JsonStreamReader::seekElement(qint64 pos) {
+
+		if (!seek(pos))
+			return false;
+
+		mFirst << true;
+		return true;
+	}
+
+	bool JsonStreamReader::hasError() const {
+		return !mError.isEmpty();
+	}
+
+	QString JsonStreamReader::errorString() const {
+		return mError;
+	}
+
+	bool JsonStreamReader::fill() {
+
+		if (mPos < mBuffer.size())
+			return true;
+
+		if (!mDevice)
+			return false;
+
+		const int chunkSize = 1 << 16;
+
+		mOffset += mBuffer.size();
+		mBuffer = mDevice->read(chunkSize);
+		mPos = 0;
+
+		// sequential devices (e.g. decompressors, network) might not have data yet
+		while (mBuffer.isEmpty() && mDevice->isSequential() && mDevice->waitForReadyRead(30000))
+			mBuffer = mDevice->read(chunkSize);
+
+		return !mBuffer.isEmpty();
+	}
+
+	bool JsonStreamReader::skipWhitespace() {
+
+		for (;;) {
+
+			if (mPos >= mBuffer.size() && !fill())
+				return false;
+
+			const char c = mBuffer.at(mPos);
+
+			if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+				mPos++;
+			else
+				return true;
+		}
+	}
+
+	bool JsonStreamReader::expect(char c) {
+
+		if (!skipWhitespace() || mBuffer.at(mPos) != c) {
+			setError(QString("'%1' expected at %2").arg(c).arg(pos()));
+			return false;
+		}
+
+		mPos++;
+		return true;
+	}
+
+	void JsonStreamReader::setError(const QString & msg) {
+
+		// keep the first error
+		if (mError.isEmpty()) {
+			mError = msg;
+			qWarning() << "[JsonStreamReader]" << msg;
+		}
+	}
+
+	QString JsonStreamReader::decodeString(const QByteArray & raw) {
+
+		if (raw.size() < 2)
+			return QString();
+
+		// fast path - nothing to unescape
+		if (!raw.contains('\\'))
+			return QString::fromUtf8(raw.constData() + 1, raw.size() - 2);
+
+		QJsonDocument doc = QJsonDocument::fromJson("[" + raw + "]");
+		return doc.array().isEmpty() ? QString() : doc.array().first().toString();
+	}
+
+	// -------------------------------------------------------------------- JsonStreamWriter 
+	/// <summary>
+	/// Creates a writer.
+	/// </summary>
+	/// <param name="device">The device which is opened for writing.</param>
+	JsonStreamWriter::JsonStreamWriter(QIODevice* device) {
+		mDevice = device;
+		mBuffer.reserve(chunk_size + (chunk_size >> 4));
+	}
+
+	JsonStreamWriter::~JsonStreamWriter() {
+		flush();
+	}
+
+	void JsonStreamWriter::beginObject() {
+		separate();
+		mBuffer.append('{');
+		mFirst << true;
+	}
+
+	void JsonStreamWriter::endObject() {
+		mBuffer.append('}');
+		if (!mFirst.isEmpty())
+			mFirst.pop_back();
+	}
+
+	/// <summary>
+	/// Writes the key of the next value.
+	/// </summary>
+	/// <param name="key">The UTF-8 encoded key.</param>
+	void JsonStreamWriter::writeKey(const char* key) {
+
+		separate();
+		mBuffer.append('"');
+		appendEscaped(key, qstrlen(key));
+		mBuffer.append("\":", 2);
+		mAfterKey = true;
+	}
+
+	void JsonStreamWriter::beginArray() {
+		separate();
+		mBuffer.append('[');
+		mFirst << true;
+	}
+
+	void JsonStreamWriter::endArray() {
+		mBuffer.append(']');
+		if (!mFirst.isEmpty())
+			mFirst.pop_back();
+	}
+
+	void JsonStreamWriter::writeString(const QString & str) {
+		writeString(str.toUtf8());
+	}
+
+	/// <summary>
+	/// Writes a string which is UTF-8 encoded already.
+	/// </summary>
+	void JsonStreamWriter::writeString(const QByteArray & utf8) {
+		separate();
+		mBuffer.append('"');
+		appendEscaped(utf8.constData(), utf8.size());
+		mBuffer.append('"');
+	}
+
+	void JsonStreamWriter::writeInt(qint64 value) {
+		separate();
+		mBuffer.append(QByteArray::number(value));
+	}
+
+	void JsonStreamWriter::writeDouble(double value) {
+
+		separate();
+
+		// json does not know nan & inf
+		if (std::isfinite(value))
+			mBuffer.append(QByteArray::number(value, 'g', 17));
+		else
+			mBuffer.append("null", 4);
+	}
+
+	void JsonStreamWriter::writeBool(bool value) {
+		separate();
+		mBuffer.append(value ? "true" : "false");
+	}
+
+	/// <summary>
+	/// Writes any value - use this for small (nested) values only
+	/// since objects and arrays are serialized by QJsonDocument.
+	/// </summary>
+	void JsonStreamWriter::writeValue(const QJsonValue & value) {
+
+		switch (value.type()) {
+		case QJsonValue::Bool:		writeBool(value.toBool()); break;
+		case QJsonValue::Double:	writeDouble(value.toDouble()); break;
+		case QJsonValue::String:	writeString(value.toString()); break;
+		case QJsonValue::Array:
+			separate();
+			mBuffer.append(QJsonDocument(value.toArray()).toJson(QJsonDocument::Compact));
+			break;
+		case QJsonValue::Object:
+			separate();
+			mBuffer.append(QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact));
+			break;
+		default:
+			separate();
+			mBuffer.append("null", 4);
+		}
+	}
+
+	/// <summary>
+	/// Writes the buffered chunk to the device.
+	/// </summary>
+	/// <returns>false if the device could not be written.</returns>
+	bool JsonStreamWriter::flush() {
+
+		if (mBuffer.isEmpty() || hasError())
+			return !hasError();
+
+		if (!mDevice || mDevice->write(mBuffer) != mBuffer.size()) {
+			mError = mDevice ? mDevice->errorString() : QString("no device");
+			qWarning() << "[JsonStreamWriter] cannot write:" << mError;
+			return false;
+		}
+
+		mBytesWritten += mBuffer.size();
+		mBuffer.resize(0);	// keeps the capacity
+
+		return true;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes written to the device.
+	/// </summary>
+	qint64 JsonStreamWriter::bytesWritten() const {
+		return mBytesWritten;
+	}
+
+	bool JsonStreamWriter::hasError() const {
+		return !mError.isEmpty();
+	}
+
+	QString JsonStreamWriter::errorString() const {
+		return mError;
+	}
+
+	void JsonStreamWriter::separate() {
+
+		// write full chunks - values are never split
+		if (mBuffer.size() >= chunk_size)
+			flush();
+
+		if (mAfterKey) {
+			mAfterKey = false;
+			return;
+		}
+
+		if (!mFirst.isEmpty()) {
+
+			if (!mFirst.last())
+				mBuffer.append(',');
+
+			mFirst.last() = false;
+		}
+	}
+
+	void JsonStreamWriter::appendEscaped(const char* str, int length) {
+
+		int start = 0;
+
+		for (int idx = 0; idx < length; idx++) {
+
+			const unsigned char c = (unsigned char)str[idx];
+
+			// fast path - most characters are copied in runs
+			if (c >= 0x20 && c != '"' && c != '\\')
+				continue;
+
+			mBuffer.append(str + start, idx - start);
+			start = idx + 1;
+
+			switch (c) {
+			case '"':	mBuffer.append("\\\"", 2); break;
+			case '\\':	mBuffer.append("\\\\", 2); break;
+			case '\n':	mBuffer.append("\\n", 2); break;
+			case '\r':	mBuffer.append("\\r", 2); break;
+			case '\t':	mBuffer.append("\\t", 2); break;
+			default: {
+				char esc[7];
+				qsnprintf(esc, sizeof(esc), "\\u%04x", c);
+				mBuffer.append(esc, 6);
+			}
+			}
+		}
+
+		mBuffer.append(str + start, length - start);
+	}
+
+}
@@ -0,0 +1,164 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QJsonValue>
+#pragma warning(pop)
+
+#pragma warning (disable: 4251)	// inlined Qt functions in dll interface
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+class QIODevice;
+
+namespace pie {
+
+/// <summary>
+/// A pull parser for large JSON files.
+/// In contrast to QJsonDocument, it does not need the
+/// whole file in memory and values which are not needed
+/// can be skipped without materializing them.
+/// Useage:
+///		reader.enterObject();
+///		QString key;
+///		while (reader.nextKey(key)) {
+///			if (key == "name")	name = reader.readValue().toString();
+///			else				reader.skipValue();
+///		}
+/// </summary>
+class DllExport JsonStreamReader {
+
+public:
+	JsonStreamReader(QIODevice* device, qint64 offset = -1);
+
+	bool enterObject();
+	bool nextKey(QString& key);
+
+	bool enterArray();
+	bool nextElement();
+
+	QJsonValue readValue();
+	QString readString();
+	double readNumber();
+	bool skipValue(QByteArray* raw = 0);
+
+	qint64 pos() const;
+	bool seek(qint64 pos);
+	bool seekElement(qint64 pos);
+
+	bool hasError() const;
+	QString errorString() const;
+
+private:
+	bool fill();
+	bool skipWhitespace();
+	bool expect(char c);
+	void setError(const QString& msg);
+
+	static QString decodeString(const QByteArray& raw);
+
+	QIODevice* mDevice = 0;
+	QByteArray mBuffer;
+	int mPos = 0;
+	qint64 mOffset = 0;		// device position of mBuffer[0]
+
+	QVector<bool> mFirst;	// true if the current container has no elements yet
+	QString mError;
+};
+
+/// <summary>
+/// Writes large JSON files without building a QJsonDocument.
+/// Values are serialized to a chunk buffer which is written to
+/// the device whenever it is full - so the memory is constant.
+/// Commas are inserted automatically.
+/// Useage:
+///		writer.beginObject();
+///		writer.writeKey("name");
+///		writer.writeString(name);
+///		writer.endObject();
+///		writer.flush();
+/// </summary>
+class DllExport JsonStreamWriter {
+
+public:
+	JsonStreamWriter(QIODevice* device);
+	~JsonStreamWriter();
+
+	void beginObject();
+	void endObject();
+	void writeKey(const char* key);
+
+	void beginArray();
+	void endArray();
+
+	void writeString(const QString& str);
+	void writeString(const QByteArray& utf8);
+	void writeInt(qint64 value);
+	void writeDouble(double value);
+	void writeBool(bool value);
+	void writeValue(const QJsonValue& value);
+
+	bool flush();
+	qint64 bytesWritten() const;
+
+	bool hasError() const;
+	QString errorString() const;
+
+	enum {
+		chunk_size = 1 << 20,
+	};
+
+private:
+	void separate();
+	void appendEscaped(const char* str, int length);
+
+	QIODevice* mDevice = 0;
+	QByteArray mBuffer;
+	qint64 mBytesWritten = 0;
+
+	QVector<bool> mFirst;	// true if the current container has no elements yet
+	bool mAfterKey = false;	// true if the next value belongs to a key
+	QString mError;
+};
+
+}
@@ -0,0 +1,188 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+
+#include "MemoryBudget.h"
+
+#include "PageData.h"
+#include "Settings.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QDebug>
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- MemoryBudget 
+	MemoryBudget::MemoryBudget() {
+	}
+
+	MemoryBudget & MemoryBudget::instance() {
+
+		static MemoryBudget inst;
+		return inst;
+	}
+
+	/// <summary>
+	/// Marks a collection as visible and restores it if it was evicted.
+	/// </summary>
+	void MemoryBudget::acquire(QSharedPointer<Collection> collection) {
+
+		if (!collection)
+			return;
+
+		Entry& e = entry(collection);
+		e.active = true;
+		e.lastUsed = ++mClock;
+
+		collection->restore();
+	}
+
+	/// <summary>
+	/// Marks a collection as hidden - so it can be evicted.
+	/// Collections are evicted if the budget is exceeded.
+	/// </summary>
+	void MemoryBudget::release(QSharedPointer<Collection> collection) {
+
+		if (!collection)
+			return;
+
+		Entry& e = entry(collection);
+		e.active = false;
+		e.lastUsed = ++mClock;
+
+		trim();
+	}
+
+	/// <summary>
+	/// Evicts the least recently used hidden collections until
+	/// all collections fit into the budget.
+	/// </summary>
+	void MemoryBudget::trim() {
+
+		// closed tabs do not need memory
+		for (int idx = mEntries.size() - 1; idx >= 0; idx--) {
+			if (mEntries[idx].collection.isNull())
+				mEntries.remove(idx);
+		}
+
+		qint64 b = budget();
+		if (b <= 0)
+			return;
+
+		qint64 total = memorySize();
+
+		while (total > b) {
+
+			int lru = -1;
+
+			for (int idx = 0; idx < mEntries.size(); idx++) {
+
+				const Entry& e = mEntries[idx];
+				QSharedPointer<Collection> c = e.collection.toStrongRef();
+
+				if (c && !e.active && !c->isEvicted() && (lru == -1 || e.lastUsed < mEntries[lru].lastUsed))
+					lru = idx;
+			}
+
+			// only visible collections are left
+			if (lru == -1)
+				break;
+
+			qint64 freed = mEntries[lru].collection.toStrongRef()->evict();
+
+			if (freed <= 0)
+				break;
+
+			total -= freed;
+		}
+
+		qDebug().noquote() << "[MemoryBudget]" << QString("%1 of %2 MB used").arg(total / 1024.0 / 1024.0, 0, 'f', 1).arg(b / 1024 / 1024);
+	}
+
+	/// <summary>
+	/// Returns the budget in bytes (0 if collections are never evicted).
+	/// </summary>
+	qint64 MemoryBudget::budget() const {
+		return qMax((qint64)Settings::instance().app().memoryBudget, (qint64)0) * 1024 * 1024;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes all collections keep in RAM.
+	/// </summary>
+	qint64 MemoryBudget::memorySize() const {
+
+		qint64 s = 0;
+
+		for (const Entry& e : mEntries) {
+
+			QSharedPointer<Collection> c = e.collection.toStrongRef();
+			if (c)
+				s += c->memorySize();
+		}
+
+		return s;
+	}
+
+	/// <summary>
+	/// Returns the memory report of all collections (a line per collection).
+	/// </summary>
+	QString MemoryBudget::toString() const {
+
+		QString msg;
+
+		for (const Entry& e : mEntries) {
+
+			QSharedPointer<Collection> c = e.collection.toStrongRef();
+			if (c)
+				msg += c->name() + ": " + c->memoryString() + "\n";
+		}
+
+		msg += QString("budget: %1 MB").arg(budget() / 1024 / 1024);
+
+		return msg;
+	}
+
+	MemoryBudget::Entry & MemoryBudget::entry(QSharedPointer<Collection> collection) {
+
+		for (Entry& e : mEntries) {
+			if (e.collection == collection)
+				return e;
+		}
+
+		Entry e;
+		e.collection = collection;
+		mEntries << e;
+
+		return mEntries.last();
+	}
+
+}
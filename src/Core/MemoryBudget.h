@@ -0,0 +1,95 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QVector>
+#include <QString>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#pragma warning(pop)
+
+#pragma warning (disable: 4251)	// inlined Qt functions in dll interface
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+
+namespace pie {
+
+class Collection;
+
+/// <summary>
+/// Keeps the collections of all tabs within a global memory
+/// budget (see AppSettings::memoryBudget). Tabs release their
+/// collection when they are hidden. If all collections need
+/// more RAM than the budget, the least recently used released
+/// collections are evicted to disk (see Collection::evict).
+/// Acquiring a collection restores it.
+/// </summary>
+class DllExport MemoryBudget {
+
+public:
+	static MemoryBudget& instance();
+
+	void acquire(QSharedPointer<Collection> collection);
+	void release(QSharedPointer<Collection> collection);
+	void trim();
+
+	qint64 budget() const;
+	qint64 memorySize() const;
+	QString toString() const;
+
+private:
+	MemoryBudget();
+	MemoryBudget(const MemoryBudget&);
+
+	struct Entry {
+		QWeakPointer<Collection> collection;
+		bool active = true;		// true if the collection is visible (or busy)
+		qint64 lastUsed = 0;
+	};
+
+	Entry& entry(QSharedPointer<Collection> collection);
+
+	QVector<Entry> mEntries;
+	qint64 mClock = 0;
+};
+
+}
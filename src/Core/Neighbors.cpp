@@ -0,0 +1,554 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#include "Neighbors.h"
+
+#include "PageData.h"
+#include "Processor.h"
+#include "Utils.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QDateTime>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- NeighborIndex 
+	NeighborIndex::NeighborIndex() {
+	}
+
+	/// <summary>
+	/// Builds the index of arbitrary points.
+	/// Trees are built in parallel.
+	/// </summary>
+	/// <param name="data">A row per point (CV_32F).</param>
+	/// <param name="numTrees">The number of trees - more trees increase the recall.</param>
+	/// <param name="leafSize">The maximal number of points per leaf.</param>
+	/// <param name="seed">The random seed.</param>
+	/// <returns>The index.</returns>
+	NeighborIndex NeighborIndex::build(const cv::Mat & data, int numTrees, int leafSize, quint64 seed) {
+
+		CV_Assert(data.empty() || data.type() == CV_32FC1);
+
+		NeighborIndex ni;
+		ni.mData = data.isContinuous() ? data : data.clone();
+		ni.mLeafSize = qMax(leafSize, 2);
+		ni.buildTrees(numTrees, seed);
+
+		return ni;
+	}
+
+	/// <summary>
+	/// Returns the neighbor index of all pages.
+	/// If the collection was loaded from a file, the trees are
+	/// cached next to it and only rebuilt if the database changed.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <param name="ids">The feature ids (if empty all base features are used).</param>
+	/// <returns>The index.</returns>
+	NeighborIndex NeighborIndex::compute(const Collection & c, const QVector<int>& ids) {
+
+		Timer dt;
+
+		NeighborIndex ni;
+		ni.mFeatures = ids.isEmpty() ? FeatureRegistry::instance().baseFeatures(c) : ids;
+		ni.mData = featureMatrix(c, ni.mFeatures);
+
+		if (!c.filePath().isEmpty() && ni.load(c.filePath())) {
+			qInfo().noquote() << ni.toString() << "loaded in" << dt;
+			return ni;
+		}
+
+		ni.buildTrees(10, 42);
+		qInfo().noquote() << ni.toString() << "built in" << dt;
+
+		if (!c.filePath().isEmpty())
+			ni.save(c.filePath());
+
+		return ni;
+	}
+
+	/// <summary>
+	/// Returns the robust z-scores of the page features.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <param name="ids">The feature ids.</param>
+	/// <returns>A row per page (CV_32F).</returns>
+	cv::Mat NeighborIndex::featureMatrix(const Collection & c, const QVector<int>& ids) {
+
+		if (ids.isEmpty() || c.isEmpty())
+			return cv::Mat();
+
+		cv::Mat fm = FeatureRegistry::instance().compute(c, ids);
+
+		for (int idx = 0; idx < fm.rows; idx++) {
+			cv::Mat r = fm.row(idx);
+			AxisTransform(AxisTransform::t_robust_z).apply(r);
+		}
+
+		return fm.t();
+	}
+
+	/// <summary>
+	/// Returns the approximate k nearest neighbors of q.
+	/// </summary>
+	/// <param name="q">The query (a value per feature).</param>
+	/// <param name="k">The number of neighbors.</param>
+	/// <param name="searchK">The number of candidates which are ranked (-1 for 8 * k * numTrees).</param>
+	/// <param name="exclude">A page which is not returned (e.g. the query page itself).</param>
+	/// <returns>The neighbors sorted by their distance.</returns>
+	QVector<NeighborIndex::Neighbor> NeighborIndex::query(const float * q, int k, int searchK, int exclude) const {
+
+		QVector<Neighbor> nbs;
+
+		if (isEmpty() || k <= 0)
+			return nbs;
+
+		// ~0.97 recall for 20 neighbors of 100k pages (20 features) in 0.3 ms
+		if (searchK < 0)
+			searchK = 8 * qMax(k * mTrees.size(), 2 * mLeafSize);
+
+		// visit the nodes with the largest margin first
+		typedef std::pair<float, std::pair<int, int> > Entry;	// margin, (tree, node)
+		std::priority_queue<Entry> pq;
+
+		for (int tIdx = 0; tIdx < mTrees.size(); tIdx++)
+			pq.push(Entry(std::numeric_limits<float>::max(), std::make_pair(tIdx, 0)));
+
+		std::vector<int> candidates;
+		candidates.reserve(searchK + mLeafSize);
+
+		while (!pq.empty() && (int)candidates.size() < searchK) {
+
+			Entry e = pq.top();
+			pq.pop();
+
+			const Tree& t = mTrees[e.second.first];
+			const Node& n = t.nodes[e.second.second];
+
+			if (n.plane < 0) {
+				candidates.insert(candidates.end(), t.items.constData() + n.begin, t.items.constData() + n.end);
+				continue;
+			}
+
+			float m = margin(t, n, q);
+			pq.push(Entry(qMin(e.first, m), std::make_pair(e.second.first, (int)n.right)));
+			pq.push(Entry(qMin(e.first, -m), std::make_pair(e.second.first, (int)n.left)));
+		}
+
+		// pages are found by several trees
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+		nbs.reserve((int)candidates.size());
+		for (int pIdx : candidates) {
+
+			if (pIdx == exclude)
+				continue;
+
+			Neighbor nb;
+			nb.page = pIdx;
+			nb.distance = distance(q, mData.ptr<float>(pIdx));
+			nbs << nb;
+		}
+
+		auto closer = [](const Neighbor& a, const Neighbor& b) {
+			return a.distance < b.distance;
+		};
+
+		k = qMin(k, nbs.size());
+		std::partial_sort(nbs.begin(), nbs.begin() + k, nbs.end(), closer);
+		nbs.resize(k);
+
+		for (Neighbor& nb : nbs)
+			nb.distance = std::sqrt(nb.distance);
+
+		return nbs;
+	}
+
+	/// <summary>
+	/// Returns the approximate k nearest neighbors of a page.
+	/// The page itself is not returned.
+	/// </summary>
+	/// <param name="pageIdx">The page's index in the collection.</param>
+	/// <param name="k">The number of neighbors.</param>
+	/// <param name="searchK">The number of candidates which are ranked (-1 for 8 * k * numTrees).</param>
+	/// <returns>The neighbors sorted by their distance.</returns>
+	QVector<NeighborIndex::Neighbor> NeighborIndex::neighbors(int pageIdx, int k, int searchK) const {
+
+		if (pageIdx < 0 || pageIdx >= numPages())
+			return QVector<Neighbor>();
+
+		return query(mData.ptr<float>(pageIdx), k, searchK, pageIdx);
+	}
+
+	/// <summary>
+	/// Returns the kNN graph of all pages.
+	/// Pages are queried in parallel.
+	/// Missing neighbors (if there are less than k pages) are -1.
+	/// </summary>
+	/// <param name="k">The number of neighbors.</param>
+	/// <param name="distances">If set, the neighbors' distances (pages x k, CV_32F).</param>
+	/// <returns>The neighbor indices (pages x k, CV_32S).</returns>
+	cv::Mat NeighborIndex::graph(int k, cv::Mat* distances) const {
+
+		cv::Mat g(numPages(), k, CV_32SC1, cv::Scalar(-1));
+		cv::Mat d(numPages(), k, CV_32FC1, cv::Scalar(0));
+
+		cv::parallel_for_(cv::Range(0, numPages()), [&](const cv::Range& r) {
+
+			for (int pIdx = r.start; pIdx < r.end; pIdx++) {
+
+				QVector<Neighbor> nbs = neighbors(pIdx, k);
+
+				int* gp = g.ptr<int>(pIdx);
+				float* dp = d.ptr<float>(pIdx);
+
+				for (int idx = 0; idx < nbs.size(); idx++) {
+					gp[idx] = nbs[idx].page;
+					dp[idx] = nbs[idx].distance;
+				}
+			}
+		});
+
+		if (distances)
+			*distances = d;
+
+		return g;
+	}
+
+	/// <summary>
+	/// Returns the mean distance of each page to its k nearest neighbors.
+	/// Pages with large scores are far from all others.
+	/// </summary>
+	/// <param name="k">The number of neighbors.</param>
+	/// <returns>A score per page (1 x pages, CV_32F).</returns>
+	cv::Mat NeighborIndex::outlierScores(int k) const {
+
+		cv::Mat d;
+		graph(k, &d);
+
+		cv::Mat scores;
+		if (!d.empty())
+			cv::reduce(d, scores, 1, cv::REDUCE_AVG, CV_32F);
+
+		return scores.t();
+	}
+
+	bool NeighborIndex::isEmpty() const {
+		return mTrees.isEmpty() || mData.empty();
+	}
+
+	int NeighborIndex::numPages() const {
+		return mData.rows;
+	}
+
+	int NeighborIndex::numTrees() const {
+		return mTrees.size();
+	}
+
+	QVector<int> NeighborIndex::features() const {
+		return mFeatures;
+	}
+
+	QString NeighborIndex::toString() const {
+
+		int numNodes = 0;
+		for (const Tree& t : mTrees)
+			numNodes += t.nodes.size();
+
+		return QString("neighbor index of %1 pages (%2 features, %3 trees, %4 nodes)")
+			.arg(numPages()).arg(mData.cols).arg(numTrees()).arg(numNodes);
+	}
+
+	QString NeighborIndex::indexPath(const QString & filePath) {
+		return filePath + ".knn";
+	}
+
+	/// <summary>
+	/// Loads the trees which were cached next to the database.
+	/// The features must be set before, they are not cached.
+	/// </summary>
+	/// <param name="filePath">The database's file path.</param>
+	/// <returns>false if there is no valid cache.</returns>
+	bool NeighborIndex::load(const QString & filePath) {
+
+		QFile f(indexPath(filePath));
+
+		if (!f.open(QIODevice::ReadOnly))
+			return false;
+
+		QFileInfo dbInfo(filePath);
+
+		QDataStream ds(&f);
+		quint32 magic = 0;
+		qint32 version = 0;
+		qint64 size = 0, modified = 0;
+		qint32 numPages = 0, numTrees = 0, leafSize = 0;
+		QVector<int> features;
+
+		ds >> magic >> version >> size >> modified;
+
+		// the index is outdated
+		if (magic != 0x504b4e4e || version != 1 ||
+			size != dbInfo.size() ||
+			modified != dbInfo.lastModified().toMSecsSinceEpoch())
+			return false;
+
+		ds >> numPages >> features >> leafSize >> numTrees;
+
+		// the index was built for other pages or features
+		if (numPages != this->numPages() || features != mFeatures || numTrees <= 0)
+			return false;
+
+		QVector<Tree> trees(numTrees);
+		for (Tree& t : trees) {
+			if (!readArray(ds, t.nodes) || !readArray(ds, t.planes) || !readArray(ds, t.items))
+				return false;
+		}
+
+		if (ds.status() != QDataStream::Ok)
+			return false;
+
+		mTrees = trees;
+		mLeafSize = leafSize;
+
+		return true;
+	}
+
+	/// <summary>
+	/// Caches the trees next to the database.
+	/// </summary>
+	/// <param name="filePath">The database's file path.</param>
+	/// <returns>true if the index was written.</returns>
+	bool NeighborIndex::save(const QString & filePath) const {
+
+		QFile f(indexPath(filePath));
+
+		// this is fine - the database might be on a read-only drive
+		if (!f.open(QIODevice::WriteOnly)) {
+			qDebug() << "[NeighborIndex] cannot cache the index to" << f.fileName();
+			return false;
+		}
+
+		QFileInfo dbInfo(filePath);
+
+		QDataStream ds(&f);
+		ds << (quint32)0x504b4e4e << (qint32)1;
+		ds << (qint64)dbInfo.size() << (qint64)dbInfo.lastModified().toMSecsSinceEpoch();
+		ds << (qint32)numPages() << mFeatures << (qint32)mLeafSize << (qint32)numTrees();
+
+		for (const Tree& t : mTrees) {
+			writeArray(ds, t.nodes);
+			writeArray(ds, t.planes);
+			writeArray(ds, t.items);
+		}
+
+		return ds.status() == QDataStream::Ok;
+	}
+
+	// NOTE: arrays are stored in native byte order - the cache is not meant to be shared
+	template <typename T>
+	bool NeighborIndex::readArray(QDataStream & ds, QVector<T>& v) {
+
+		qint32 s = 0;
+		ds >> s;
+
+		if (s < 0 || ds.status() != QDataStream::Ok)
+			return false;
+
+		v.resize(s);
+		int nb = s * (int)sizeof(T);
+		return ds.readRawData((char*)v.data(), nb) == nb;
+	}
+
+	template <typename T>
+	void NeighborIndex::writeArray(QDataStream & ds, const QVector<T>& v) {
+
+		ds << (qint32)v.size();
+		ds.writeRawData((const char*)v.constData(), v.size() * (int)sizeof(T));
+	}
+
+	void NeighborIndex::buildTrees(int numTrees, quint64 seed) {
+
+		mTrees.clear();
+
+		if (mData.empty() || numTrees <= 0)
+			return;
+
+		mTrees.resize(numTrees);
+		Tree* trees = mTrees.data();	// detach before threads write to it
+
+		cv::parallel_for_(cv::Range(0, numTrees), [&](const cv::Range& r) {
+
+			for (int tIdx = r.start; tIdx < r.end; tIdx++)
+				trees[tIdx] = buildTree(seed + tIdx);
+		});
+	}
+
+	/// <summary>
+	/// Builds a tree by splitting the pages recursively.
+	/// Each split is the hyperplane halfway between two random pages.
+	/// </summary>
+	NeighborIndex::Tree NeighborIndex::buildTree(quint64 seed) const {
+
+		const int n = mData.rows;
+		const int d = mData.cols;
+
+		cv::RNG rng(seed);
+		Tree t;
+
+		t.items.resize(n);
+		for (int idx = 0; idx < n; idx++)
+			t.items[idx] = idx;
+
+		Node root;
+		root.end = n;
+		t.nodes << root;
+
+		QVector<int> stack;
+		stack << 0;
+
+		std::vector<float> normal(d);
+
+		while (!stack.isEmpty()) {
+
+			const int nIdx = stack.takeLast();
+			const int b = t.nodes[nIdx].begin;
+			const int e = t.nodes[nIdx].end;
+
+			if (e - b <= mLeafSize)
+				continue;
+
+			// find two distinct pages
+			float len = 0.0f;
+			const float* pa = 0;
+			const float* pb = 0;
+
+			for (int idx = 0; idx < 5 && len == 0.0f; idx++) {
+
+				pa = mData.ptr<float>(t.items[b + rng.uniform(0, e - b)]);
+				pb = mData.ptr<float>(t.items[b + rng.uniform(0, e - b)]);
+
+				len = 0.0f;
+				for (int fIdx = 0; fIdx < d; fIdx++) {
+					normal[fIdx] = pa[fIdx] - pb[fIdx];
+					len += normal[fIdx] * normal[fIdx];
+				}
+			}
+
+			float offset = 0.0f;
+
+			if (len > 0.0f) {
+				for (int fIdx = 0; fIdx < d; fIdx++)
+					offset += normal[fIdx] * 0.5f * (pa[fIdx] + pb[fIdx]);
+			}
+			else {
+				// (most likely) identical pages - fall back to a random direction
+				for (int fIdx = 0; fIdx < d; fIdx++) {
+					normal[fIdx] = (float)rng.gaussian(1.0);
+					offset += normal[fIdx] * pa[fIdx];
+				}
+			}
+
+			auto below = [&](int pIdx) {
+				const float* p = mData.ptr<float>(pIdx);
+				float m = 0.0f;
+				for (int fIdx = 0; fIdx < d; fIdx++)
+					m += normal[fIdx] * p[fIdx];
+				return m <= offset;
+			};
+
+			int mid = (int)(std::partition(t.items.begin() + b, t.items.begin() + e, below) - t.items.begin());
+
+			// all pages are on one side - split them arbitrarily so that the tree stays balanced
+			if (mid == b || mid == e)
+				mid = b + (e - b) / 2;
+
+			Node left, right;
+			left.begin = b;
+			left.end = mid;
+			right.begin = mid;
+			right.end = e;
+
+			Node& n = t.nodes[nIdx];
+			n.plane = t.planes.size() / d;
+			n.offset = offset;
+			n.left = t.nodes.size();
+			n.right = t.nodes.size() + 1;
+
+			for (float v : normal)
+				t.planes << v;
+
+			stack << t.nodes.size() << t.nodes.size() + 1;
+			t.nodes << left << right;
+		}
+
+		t.nodes.squeeze();
+		t.planes.squeeze();
+
+		return t;
+	}
+
+	float NeighborIndex::margin(const Tree & t, const Node & n, const float * q) const {
+
+		const int d = mData.cols;
+		const float* normal = t.planes.constData() + n.plane * d;
+
+		float m = -n.offset;
+		for (int fIdx = 0; fIdx < d; fIdx++)
+			m += normal[fIdx] * q[fIdx];
+
+		return m;
+	}
+
+	float NeighborIndex::distance(const float * a, const float * b) const {
+
+		// squared L2
+		float dist = 0.0f;
+		for (int fIdx = 0; fIdx < mData.cols; fIdx++) {
+			float v = a[fIdx] - b[fIdx];
+			dist += v * v;
+		}
+
+		return dist;
+	}
+
+}
@@ -0,0 +1,126 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QString>
+#include <QVector>
+
+#include <opencv2/core.hpp>
+#pragma warning(pop)
+
+#pragma warning (disable: 4251)	// inlined Qt functions in dll interface
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+class QDataStream;
+
+namespace pie {
+
+class Collection;
+
+/// <summary>
+/// Approximate k-nearest neighbors of pages.
+/// Pages are described by their (robust z-scored) features.
+/// The index is a random projection forest: each tree splits
+/// the pages recursively by hyperplanes between two random pages.
+/// A query descends all trees at once (best margin first) and
+/// ranks the pages of the visited leaves by their exact distance.
+/// </summary>
+class DllExport NeighborIndex {
+
+public:
+	NeighborIndex();
+
+	struct Neighbor {
+		int page;
+		float distance;
+	};
+
+	static NeighborIndex build(const cv::Mat& data, int numTrees = 10, int leafSize = 32, quint64 seed = 42);
+	static NeighborIndex compute(const Collection& c, const QVector<int>& ids = QVector<int>());
+	static cv::Mat featureMatrix(const Collection& c, const QVector<int>& ids);
+
+	QVector<Neighbor> query(const float* q, int k, int searchK = -1, int exclude = -1) const;
+	QVector<Neighbor> neighbors(int pageIdx, int k, int searchK = -1) const;
+	cv::Mat graph(int k, cv::Mat* distances = 0) const;
+	cv::Mat outlierScores(int k) const;
+
+	bool isEmpty() const;
+	int numPages() const;
+	int numTrees() const;
+	QVector<int> features() const;
+
+	QString toString() const;
+
+	bool load(const QString& filePath);
+	bool save(const QString& filePath) const;
+	static QString indexPath(const QString& filePath);
+
+private:
+	struct Node {
+		qint32 plane = -1;	// leaves have no plane
+		qint32 left = -1;
+		qint32 right = -1;
+		qint32 begin = 0;	// items of the node
+		qint32 end = 0;
+		float offset = 0.0f;
+	};
+
+	struct Tree {
+		QVector<Node> nodes;
+		QVector<float> planes;	// a normal (dims) per inner node
+		QVector<qint32> items;	// page indices - leaves hold a range
+	};
+
+	void buildTrees(int numTrees, quint64 seed);
+	Tree buildTree(quint64 seed) const;
+	float margin(const Tree& t, const Node& n, const float* q) const;
+	float distance(const float* a, const float* b) const;
+
+	template <typename T> static bool readArray(QDataStream& ds, QVector<T>& v);
+	template <typename T> static void writeArray(QDataStream& ds, const QVector<T>& v);
+
+	QVector<Tree> mTrees;
+	QVector<int> mFeatures;
+	cv::Mat mData;			// pages x features (CV_32F)
+	int mLeafSize = 32;
+};
+
+}
@@ -32,10 +32,19 @@
 #include "Network.h"
 
 #pragma warning(push, 0)	// no warnings from includes
-#include <QNetworkProxyQuery>
+#include <QNetworkProxyFactory>
+#include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
 #include <QNetworkReply>
-#include <QEventLoop>
+#include <QStandardPaths>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QTcpServer>
 #include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QLocale>
+#include <QDebug>
 #pragma warning(pop)
 
 namespace pie {
@@ -49,51 +58,899 @@ namespace pie {
 /// <returns></returns>
 QByteArray net::download(const QString & url, bool* ok) {
 
-	if (ok)
-		*ok = false;
-
 	if (!QUrl(url).isValid()) {
+
+		if (ok)
+			*ok = false;
 		return QByteArray();
 	}
-	//if (!urlExists(url)) {
-	//	qWarning() << url << "is not available";
-	//	return QByteArray();
-	//}
 
-	QNetworkAccessManager manager;
+	return DownloadService::instance().download(QUrl(url), ok);
+}
+
+/// <summary>
+/// Formats a date for HTTP headers (RFC 7231), e.g. Sun, 06 Nov 1994 08:49:37 GMT.
+/// </summary>
+QByteArray net::toHttpDate(const QDateTime & dt) {
+	return QLocale::c().toString(dt.toUTC(), "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toLatin1();
+}
+
+/// <summary>
+/// Parses a date of an HTTP header.
+/// </summary>
+/// <returns>The date which is invalid if it could not be parsed.</returns>
+QDateTime net::fromHttpDate(const QByteArray & date) {
+
+	QDateTime dt = QLocale::c().toDateTime(QString::fromLatin1(date.trimmed()), "ddd, dd MMM yyyy hh:mm:ss 'GMT'");
+	dt.setTimeSpec(Qt::UTC);
+
+	return dt;
+}
 
-	// do we need to support global proxies?
-	QNetworkProxyQuery npq(QUrl("http://www.nomacs.org"));
-	QList<QNetworkProxy> listOfProxies = QNetworkProxyFactory::systemProxyForQuery(npq);
+// -------------------------------------------------------------------- Download 
+/// <summary>
+/// Creates a download.
+/// If begin > 0 or end >= 0, only the byte range [begin end] is
+/// requested and the server must support range requests.
+/// If unmodifiedSince is valid, the download fails if the
+/// resource was modified after it (see isModified()).
+/// </summary>
+Download::Download(const QUrl & url, qint64 begin, qint64 end, const QDateTime& unmodifiedSince, QObject * parent) : QIODevice(parent) {
+	mUrl = url;
+	mBegin = begin;
+	mEnd = end;
+	mUnmodifiedSince = unmodifiedSince;
+}
+
+Download::~Download() {
+
+	if (mReply)
+		mReply->abort();
+}
+
+QUrl Download::url() const {
+	return mUrl;
+}
 
-	if (!listOfProxies.empty() && listOfProxies[0].hostName() != "") {
-		manager.setProxy(listOfProxies[0]);
+/// <summary>
+/// Returns the size of the whole resource (not only the requested range).
+/// It is -1 until the first bytes arrived or if the server did not send it.
+/// </summary>
+qint64 Download::totalSize() const {
+
+	QMutexLocker lock(&mMutex);
+	return mTotalSize;
+}
+
+bool Download::isSequential() const {
+	return true;
+}
+
+bool Download::atEnd() const {
+
+	QMutexLocker lock(&mMutex);
+	return mFinished && mPos >= mBuffer.size();
+}
+
+qint64 Download::bytesAvailable() const {
+
+	QMutexLocker lock(&mMutex);
+	return mBuffer.size() - mPos + QIODevice::bytesAvailable();
+}
+
+/// <summary>
+/// Blocks until new data arrived.
+/// </summary>
+/// <param name="msecs">The timeout in ms, -1 waits forever.</param>
+/// <returns>false if the timeout expired or the download finished.</returns>
+bool Download::waitForReadyRead(int msecs) {
+
+	QMutexLocker lock(&mMutex);
+
+	while (mPos >= mBuffer.size() && !mFinished) {
+
+		if (!mReadable.wait(&mMutex, msecs < 0 ? ULONG_MAX : (unsigned long)msecs))
+			return false;
 	}
 
-	QNetworkRequest request(url);
-	QNetworkReply* nr = manager.get(request);
+	return mPos < mBuffer.size();
+}
 
-	if (!nr) {
-		qCritical() << "QNetworkReply is unexpectedly NULL";
-		return QByteArray();
+/// <summary>
+/// Blocks until the download finished.
+/// NOTE: the data must be read, otherwise large downloads
+/// never finish since the network is paused if the buffer is full.
+/// </summary>
+/// <param name="msecs">The timeout in ms, -1 waits forever.</param>
+/// <returns>false if the timeout expired.</returns>
+bool Download::waitForFinished(int msecs) {
+
+	QElapsedTimer dt;
+	dt.start();
+
+	QMutexLocker lock(&mMutex);
+
+	while (!mFinished) {
+
+		if (msecs < 0)
+			mReadable.wait(&mMutex);
+		else if (dt.elapsed() >= msecs || !mReadable.wait(&mMutex, (unsigned long)(msecs - dt.elapsed())))
+			return false;
 	}
 
-	// wait for finished - yes this is a blocking downloader
-	QEventLoop loop;
-	QObject::connect(nr, SIGNAL(finished()), &loop, SLOT(quit()));
-	loop.exec();
+	return true;
+}
 
-	QByteArray ba = nr->readAll();
-	nr->deleteLater();
-	
-	if (ok)
-		*ok = !ba.isEmpty();
+bool Download::isFinished() const {
+
+	QMutexLocker lock(&mMutex);
+	return mFinished;
+}
+
+bool Download::hasError() const {
+
+	QMutexLocker lock(&mMutex);
+	return !mError.isEmpty();
+}
+
+QString Download::error() const {
+
+	QMutexLocker lock(&mMutex);
+	return mError;
+}
+
+/// <summary>
+/// Returns true if the response was served from the HTTP cache.
+/// This is only valid once the download finished.
+/// </summary>
+bool Download::isFromCache() const {
+
+	QMutexLocker lock(&mMutex);
+	return mFromCache;
+}
+
+/// <summary>
+/// Returns true if the resource was modified after the
+/// requested date or while the download was resumed (412 response).
+/// </summary>
+bool Download::isModified() const {
+
+	QMutexLocker lock(&mMutex);
+	return mStatusCode == 412;
+}
+
+/// <summary>
+/// Returns the HTTP status code of the last response.
+/// It is 0 until the download finished.
+/// </summary>
+int Download::statusCode() const {
+
+	QMutexLocker lock(&mMutex);
+	return mStatusCode;
+}
+
+/// <summary>
+/// Returns the resource's ETag or an empty array if the server did not send it.
+/// </summary>
+QByteArray Download::etag() const {
+
+	QMutexLocker lock(&mMutex);
+	return mETag;
+}
+
+/// <summary>
+/// Returns when the resource was modified.
+/// The date is invalid if the server did not send it.
+/// </summary>
+QDateTime Download::lastModified() const {
+
+	QMutexLocker lock(&mMutex);
+	return mLastModified;
+}
+
+qint64 Download::readData(char * data, qint64 maxSize) {
+
+	QMutexLocker lock(&mMutex);
+
+	while (mPos >= mBuffer.size() && !mFinished)
+		mReadable.wait(&mMutex);
+
+	if (mPos >= mBuffer.size())
+		return mError.isEmpty() ? 0 : -1;
+
+	qint64 n = qMin(maxSize, (qint64)(mBuffer.size() - mPos));
+	memcpy(data, mBuffer.constData() + mPos, n);
+	mPos += (int)n;
+
+	// the network was paused - continue in the service thread
+	if (!mFinished && mBuffer.size() - mPos < max_buffer / 2 && mPullPending.testAndSetOrdered(0, 1))
+		QMetaObject::invokeMethod(this, "pull", Qt::QueuedConnection);
+
+	return n;
+}
+
+qint64 Download::writeData(const char *, qint64) {
+	return -1;
+}
+
+void Download::start() {
+
+	// NOTE: this runs in the service thread
+	QNetworkRequest request(mUrl);
+	request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+
+	// the cache is revalidated (ETag/Last-Modified) before it is used
+	request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferNetwork);
+
+	// request a range or continue where the failed request stopped
+	qint64 first = mBegin + mReceived;
+
+	if (first > 0 || mEnd >= 0) {
+
+		QByteArray range = "bytes=" + QByteArray::number(first) + "-";
+		if (mEnd >= 0)
+			range += QByteArray::number(mEnd);
+
+		request.setRawHeader("Range", range);
+		request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+		request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+		mPartial = true;
+	}
+
+	// the resource must not change after the given date
+	if (mUnmodifiedSince.isValid())
+		request.setRawHeader("If-Unmodified-Since", net::toHttpDate(mUnmodifiedSince));
+
+	// resumed bytes must belong to the same version of the resource
+	if (mReceived > 0 && !mETag.isEmpty())
+		request.setRawHeader("If-Match", mETag);
+
+	mHeaderChecked = false;
+
+	mReplyFinished = false;
+	mReply = mManager->get(request);
+	mReply->setParent(this);
+	mReply->setReadBufferSize(max_buffer);
+
+	connect(mReply, SIGNAL(readyRead()), this, SLOT(pull()));
+	connect(mReply, SIGNAL(finished()), this, SLOT(onReplyFinished()));
+	connect(mReply, SIGNAL(downloadProgress(qint64, qint64)), this, SIGNAL(progress(qint64, qint64)));
+}
+
+/// <summary>
+/// Moves bytes from the reply to the reader's buffer.
+/// If the buffer is full, the reply is not read and
+/// the network pauses until the reader catches up.
+/// </summary>
+void Download::pull() {
+
+	mPullPending.store(0);
+
+	if (!mReply)
+		return;
+
+	if (!mHeaderChecked && mReply->bytesAvailable() > 0) {
+
+		int status = mReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+		// error pages are not part of the resource - onReplyFinished() retries or fails
+		if (status != 0 && (status < 200 || status >= 300)) {
+			mReply->readAll();
+			return;
+		}
+
+		// a server which ignores the range would send everything
+		if (mPartial && status != 206) {
+			mReply->abort();
+			complete("cannot download a part of " + mUrl.toString() + " - the server does not support range requests");
+			return;
+		}
+
+		// Content-Range: bytes 0-99/1234
+		QByteArray cr = mReply->rawHeader("Content-Range");
+		int sep = cr.lastIndexOf('/');
+		qint64 total = -1;
+
+		if (sep != -1)
+			total = cr.mid(sep + 1).toLongLong();
+		else if (!mPartial)
+			total = mReply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+
+		QMutexLocker lock(&mMutex);
+		mTotalSize = total > 0 ? total : -1;
+		mETag = mReply->rawHeader("ETag");
+		mLastModified = mReply->header(QNetworkRequest::LastModifiedHeader).toDateTime();
+		mHeaderChecked = true;
+	}
+
+	while (mReply->bytesAvailable() > 0) {
+
+		QMutexLocker lock(&mMutex);
+
+		if (mBuffer.size() - mPos >= max_buffer)
+			return;
+
+		// drop consumed bytes
+		if (mPos > 0) {
+			mBuffer.remove(0, mPos);
+			mPos = 0;
+		}
+
+		QByteArray ba = mReply->read(max_buffer - mBuffer.size());
+		mReceived += ba.size();
+		mBuffer.append(ba);
+		mReadable.wakeAll();
+		lock.unlock();
+
+		emit readyRead();
+	}
+
+	if (mReplyFinished)
+		complete();
+}
+
+void Download::onReplyFinished() {
+
+	if (!mReply)
+		return;
+
+	{
+		QMutexLocker lock(&mMutex);
+		mStatusCode = mReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	}
+
+	if (mReply->error() == QNetworkReply::NoError) {
+
+		QMutexLocker lock(&mMutex);
+		mFromCache = mReply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
+		lock.unlock();
+
+		mReplyFinished = true;
+		pull();		// completes once the reader has all bytes
+		return;
+	}
+
+	if (isRetryable() && mNumRetries < mMaxRetries) {
+
+		mNumRetries++;
+		int waitMs = 500 << mNumRetries;
+		qInfo() << "[Download]" << mUrl.toString() << "failed:" << mReply->errorString() << "- retrying in" << waitMs << "ms";
+
+		// bytes which were not moved to the buffer are requested again
+		mReply->deleteLater();
+		mReply = 0;
+
+		QTimer::singleShot(waitMs, this, SLOT(start()));
+		return;
+	}
+
+	QString msg = mUrl.toString() + ": " + mReply->errorString();
+	mReply->deleteLater();
+	mReply = 0;
+
+	complete(msg);
+}
+
+void Download::complete(const QString & error) {
+
+	QMutexLocker lock(&mMutex);
+
+	if (mFinished)
+		return;
+
+	mFinished = true;
+	mError = error;
+	mReadable.wakeAll();
+	lock.unlock();
+
+	if (!error.isEmpty())
+		qWarning() << "[Download]" << error;
+
+	emit readChannelFinished();
+	emit finished();
+}
+
+/// <summary>
+/// Returns true if the reply failed for temporary reasons
+/// (e.g. timeouts, dropped connections or 5xx responses).
+/// </summary>
+bool Download::isRetryable() const {
+
+	int status = mReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+	if (status == 429 || status >= 500)
+		return true;
+
+	switch (mReply->error()) {
+	case QNetworkReply::ConnectionRefusedError:
+	case QNetworkReply::RemoteHostClosedError:
+	case QNetworkReply::TimeoutError:
+	case QNetworkReply::TemporaryNetworkFailureError:
+	case QNetworkReply::NetworkSessionFailedError:
+	case QNetworkReply::ProxyTimeoutError:
+	case QNetworkReply::UnknownNetworkError:
+		return true;
+	default:
+		break;
+	}
+
+	return false;
+}
+
+// -------------------------------------------------------------------- DownloadService 
+DownloadService::DownloadService() : mMaxConcurrent(6), mMaxRetries(3) {
+
+	// the network runs in its own thread so that any thread can block on a download
+	mThread.setObjectName("DownloadService");
+	moveToThread(&mThread);
+	mThread.start();
+
+	QMetaObject::invokeMethod(this, "init", Qt::BlockingQueuedConnection);
+}
+
+DownloadService::~DownloadService() {
+
+	QMetaObject::invokeMethod(this, "release", Qt::BlockingQueuedConnection);
+
+	mThread.quit();
+	mThread.wait();
+}
+
+DownloadService & DownloadService::instance() {
 
-	// TODO: check for non-existing files 
-	//if (ba.isEmpty())
-	//	qWarning() << nr->errorString();
+	static DownloadService inst;
+	return inst;
+}
+
+/// <summary>
+/// Starts downloading url.
+/// This can be called from any thread, but do not
+/// block on the download in the service's thread.
+/// </summary>
+/// <param name="url">The resource.</param>
+/// <param name="begin">The first byte.</param>
+/// <param name="end">The last byte (inclusive) or -1 to download everything after begin.</param>
+/// <param name="unmodifiedSince">If valid, the download fails if the resource was modified after it.</param>
+/// <returns>The download which can be read immediately.</returns>
+QSharedPointer<Download> DownloadService::get(const QUrl & url, qint64 begin, qint64 end, const QDateTime& unmodifiedSince) {
+
+	Download* d = new Download(url, begin, end, unmodifiedSince);
+	d->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+	d->mMaxRetries = mMaxRetries.load();
+	d->moveToThread(&mThread);
+
+	QMetaObject::invokeMethod(this, "enqueue", Qt::QueuedConnection, Q_ARG(QObject*, d));
+
+	// the download is deleted in the service thread
+	return QSharedPointer<Download>(d, &QObject::deleteLater);
+}
+
+/// <summary>
+/// Downloads url and blocks until it finished.
+/// </summary>
+/// <param name="url">The resource.</param>
+/// <param name="ok">If set, it is false if the download failed.</param>
+/// <returns>The response's body.</returns>
+QByteArray DownloadService::download(const QUrl & url, bool * ok) {
+
+	QSharedPointer<Download> d = get(url);
+
+	QByteArray ba = d->readAll();
+	d->waitForFinished();
+
+	if (ok)
+		*ok = !d->hasError();
 
 	return ba;
 }
 
+/// <summary>
+/// Sets the maximal number of parallel requests.
+/// </summary>
+void DownloadService::setMaxConcurrent(int numRequests) {
+
+	mMaxConcurrent.store(qMax(numRequests, 1));
+	QMetaObject::invokeMethod(this, "startNext", Qt::QueuedConnection);
+}
+
+int DownloadService::maxConcurrent() const {
+	return mMaxConcurrent.load();
+}
+
+void DownloadService::setMaxRetries(int numRetries) {
+	mMaxRetries.store(numRetries);
+}
+
+/// <summary>
+/// Moves the HTTP cache.
+/// </summary>
+/// <param name="dirPath">The cache directory.</param>
+/// <param name="maxSize">The maximal cache size in bytes.</param>
+void DownloadService::setCache(const QString & dirPath, qint64 maxSize) {
+	QMetaObject::invokeMethod(this, "initCache", Qt::BlockingQueuedConnection, Q_ARG(QString, dirPath), Q_ARG(qint64, maxSize));
+}
+
+void DownloadService::init() {
+
+	// proxies are resolved once per host by Qt (and not per request by us)
+	QNetworkProxyFactory::setUseSystemConfiguration(true);
+
+	mManager = new QNetworkAccessManager(this);
+	initCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/http", (qint64)1 << 30);
+}
+
+void DownloadService::release() {
+
+	for (const QPointer<Download>& d : mActive) {
+		if (d)
+			d->complete("the download service was shut down");
+	}
+
+	delete mManager;
+	mManager = 0;
+}
+
+void DownloadService::enqueue(QObject * download) {
+
+	Download* d = qobject_cast<Download*>(download);
+
+	if (!d)
+		return;
+
+	connect(d, SIGNAL(finished()), this, SLOT(startNext()));
+	connect(d, SIGNAL(destroyed()), this, SLOT(startNext()));
+
+	mPending.enqueue(d);
+	startNext();
+}
+
+void DownloadService::startNext() {
+
+	// remove finished & deleted downloads
+	for (int idx = mActive.size() - 1; idx >= 0; idx--) {
+
+		if (!mActive[idx] || mActive[idx]->isFinished())
+			mActive.remove(idx);
+	}
+
+	while (!mPending.isEmpty() && mActive.size() < mMaxConcurrent.load()) {
+
+		QPointer<Download> d = mPending.dequeue();
+
+		// the reader lost interest
+		if (!d)
+			continue;
+
+		d->mManager = mManager;
+		d->start();
+		mActive << d;
+	}
+}
+
+void DownloadService::initCache(const QString & dirPath, qint64 maxSize) {
+
+	QNetworkDiskCache* cache = new QNetworkDiskCache(mManager);
+	cache->setCacheDirectory(dirPath);
+	cache->setMaximumCacheSize(maxSize);
+
+	// the manager takes the ownership
+	mManager->setCache(cache);
+}
+
+// -------------------------------------------------------------------- HttpStandIn 
+HttpStandIn::HttpStandIn() {
+}
+
+HttpStandIn::~HttpStandIn() {
+
+	// quit() is lost if the event loop did not start yet
+	while (isRunning() && !wait(100))
+		quit();
+}
+
+/// <summary>
+/// Serves body at path.
+/// </summary>
+/// <param name="path">The url's path (e.g. /db.json).</param>
+/// <param name="body">The resource.</param>
+/// <param name="ranges">If false, range requests are ignored (the whole body is sent).</param>
+/// <param name="modified">The resource's Last-Modified date (default: now).</param>
+void HttpStandIn::add(const QString & path, const QByteArray & body, bool ranges, const QDateTime& modified) {
+
+	Resource r;
+	r.body = body;
+	r.modified = modified.isValid() ? modified : QDateTime::currentDateTimeUtc();
+	r.etag = "\"" + QByteArray::number(qChecksum(body.constData(), body.size())) + "-" + QByteArray::number(body.size()) + "\"";
+	r.ranges = ranges;
+
+	QMutexLocker lock(&mMutex);
+	mResources.insert(path, r);
+}
+
+/// <summary>
+/// Lets the next requests of a resource fail.
+/// </summary>
+void HttpStandIn::fail(const QString & path, const Failure & failure, int numFailures) {
+
+	QMutexLocker lock(&mMutex);
+
+	if (!mResources.contains(path))
+		return;
+
+	mResources[path].failure = failure;
+	mResources[path].numFailures = numFailures;
+}
+
+/// <summary>
+/// Starts the server on a free port of the local host.
+/// </summary>
+/// <returns>false if the server could not listen.</returns>
+bool HttpStandIn::listen() {
+
+	start();
+	mListening.acquire();
+
+	return mPort.load() > 0;
+}
+
+QUrl HttpStandIn::url(const QString & path) const {
+	return QUrl("http://127.0.0.1:" + QString::number(mPort.load()) + path);
+}
+
+/// <summary>
+/// Returns the number of requests of a resource (including failed ones).
+/// </summary>
+int HttpStandIn::numRequests(const QString & path) const {
+
+	QMutexLocker lock(&mMutex);
+	return mResources.value(path).numRequests;
+}
+
+/// <summary>
+/// Returns the number of 304 responses of a resource.
+/// </summary>
+int HttpStandIn::numNotModified(const QString & path) const {
+
+	QMutexLocker lock(&mMutex);
+	return mResources.value(path).numNotModified;
+}
+
+void HttpStandIn::run() {
+
+	QTcpServer server;
+
+	if (!server.listen(QHostAddress::LocalHost)) {
+		qWarning() << "[HttpStandIn] cannot listen:" << server.errorString();
+		mListening.release();
+		return;
+	}
+
+	QObject::connect(&server, &QTcpServer::newConnection, [&server, this]() {
+
+		while (QTcpSocket* s = server.nextPendingConnection()) {
+
+			QObject::connect(s, &QTcpSocket::disconnected, s, &QObject::deleteLater);
+			QObject::connect(s, &QTcpSocket::readyRead, [s, this]() {
+
+				QByteArray request = s->property("request").toByteArray() + s->readAll();
+				int end = request.indexOf("\r\n\r\n");
+
+				// the header is not complete
+				if (end == -1) {
+					s->setProperty("request", request);
+					return;
+				}
+
+				// one response per connection
+				s->write(respond(request.left(end)));
+				s->disconnectFromHost();
+			});
+		}
+	});
+
+	mPort.store(server.serverPort());
+	mListening.release();
+
+	exec();
+}
+
+QByteArray HttpStandIn::respond(const QByteArray & header) {
+
+	QList<QByteArray> lines = header.split('\n');
+	QList<QByteArray> request = lines.value(0).trimmed().split(' ');	// GET /db.json HTTP/1.1
+	QString path = QUrl(QString::fromLatin1(request.value(1))).path();
+
+	QMap<QByteArray, QByteArray> fields;
+	for (int idx = 1; idx < lines.size(); idx++) {
+
+		int sep = lines[idx].indexOf(':');
+		if (sep != -1)
+			fields.insert(lines[idx].left(sep).trimmed().toLower(), lines[idx].mid(sep + 1).trimmed());
+	}
+
+	QMutexLocker lock(&mMutex);
+
+	if (request.value(0) != "GET" || !mResources.contains(path))
+		return response(404, "Not Found", "<html>not found</html>");
+
+	Resource& r = mResources[path];
+	r.numRequests++;
+
+	if (r.failure == fail_5xx && r.numFailures > 0) {
+		r.numFailures--;
+		return response(503, "Service Unavailable", "<html>please try again later</html>");
+	}
+
+	// HTTP dates have seconds
+	QDateTime since = net::fromHttpDate(fields.value("if-unmodified-since"));
+	bool modified = since.isValid() && r.modified.toMSecsSinceEpoch() / 1000 > since.toMSecsSinceEpoch() / 1000;
+
+	if (modified || (fields.contains("if-match") && fields.value("if-match") != r.etag))
+		return response(412, "Precondition Failed", "<html>the resource was modified</html>");
+
+	if (fields.value("if-none-match") == r.etag) {
+		r.numNotModified++;
+		return response(304, "Not Modified", QByteArray(), "ETag: " + r.etag + "\r\n");
+	}
+
+	// the response is stored, but revalidated before it is used
+	QByteArray headers = "ETag: " + r.etag + "\r\nLast-Modified: " + net::toHttpDate(r.modified) + "\r\nCache-Control: max-age=0\r\n";
+	QByteArray body = r.body;
+	int status = 200;
+	QByteArray reason = "OK";
+
+	// Range: bytes=first-[last]
+	QByteArray range = fields.value("range");
+
+	if (r.ranges && range.startsWith("bytes=")) {
+
+		QList<QByteArray> fl = range.mid(6).split('-');
+		qint64 size = r.body.size();
+		qint64 first = fl.value(0).toLongLong();
+		qint64 last = fl.value(1).isEmpty() ? size - 1 : qMin(fl.value(1).toLongLong(), size - 1);
+
+		if (first > last)
+			return response(416, "Range Not Satisfiable", QByteArray(), "Content-Range: bytes */" + QByteArray::number(size) + "\r\n");
+
+		body = r.body.mid(first, last - first + 1);
+		status = 206;
+		reason = "Partial Content";
+		headers += "Accept-Ranges: bytes\r\n";
+		headers += "Content-Range: bytes " + QByteArray::number(first) + "-" + QByteArray::number(last) + "/" + QByteArray::number(size) + "\r\n";
+	}
+
+	QByteArray res = response(status, reason, body, headers);
+
+	// the header announces the whole body
+	if (r.failure == fail_drop && r.numFailures > 0) {
+		r.numFailures--;
+		res.chop(body.size() / 2);
+	}
+
+	return res;
+}
+
+QByteArray HttpStandIn::response(int status, const QByteArray & reason, const QByteArray & body, const QByteArray & headers) {
+
+	QByteArray res = "HTTP/1.1 " + QByteArray::number(status) + " " + reason + "\r\n";
+	res += headers;
+	res += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+	res += "Connection: close\r\n\r\n";
+	res += body;
+
+	return res;
+}
+
+/// <summary>
+/// Tests the DownloadService against a local stand-in server.
+/// It checks streamed reads of a body which is larger than the
+/// download buffer, range requests, ETag revalidation, retries
+/// of 5xx responses, resuming dropped connections and failures.
+/// </summary>
+/// <returns>true if all checks passed.</returns>
+bool test::Downloads() {
+
+	// larger than the download buffer - so the network pauses while reading
+	QByteArray body(20 << 20, 0);
+	for (int idx = 0; idx < body.size(); idx++)
+		body[idx] = (char)((idx * 7919) >> 3);
+
+	HttpStandIn server;
+	server.add("/db.json", body);
+	server.add("/flaky.json", body);
+	server.fail("/flaky.json", HttpStandIn::fail_5xx, 2);
+	server.add("/dropped.json", body);
+	server.fail("/dropped.json", HttpStandIn::fail_drop);
+	server.add("/norange.json", body, false);
+
+	if (!server.listen()) {
+		qWarning() << "[test::Downloads] cannot start the stand-in server";
+		return false;
+	}
+
+	// start with an empty cache
+	QTemporaryDir cacheDir;
+	DownloadService& ds = DownloadService::instance();
+	ds.setCache(cacheDir.path(), (qint64)1 << 30);
+
+	bool success = true;
+	auto check = [&success](const char* name, bool ok) {
+		qInfo().noquote() << "[test::Downloads]" << name << (ok ? "ok" : "FAILED");
+		success = success && ok;
+	};
+
+	// read small chunks while bytes arrive
+	{
+		QElapsedTimer dt;
+		dt.start();
+
+		QSharedPointer<Download> d = ds.get(server.url("/db.json"));
+		QByteArray received;
+
+		while (!d->atEnd()) {
+
+			QByteArray chunk = d->read(1 << 16);
+
+			if (chunk.isEmpty() && d->hasError())
+				break;
+
+			received += chunk;
+		}
+
+		qInfo().noquote() << "[test::Downloads]" << QString("%1 MB/s").arg(body.size() / 1024.0 / 1024.0 / qMax(dt.elapsed() / 1000.0, 0.001), 0, 'f', 1);
+		check("streamed read", received == body && d->totalSize() == body.size() && !d->hasError());
+	}
+
+	{
+		QSharedPointer<Download> d = ds.get(server.url("/db.json"), 1000, 1999);
+		QByteArray ba = d->readAll();
+		check("range request", ba == body.mid(1000, 1000) && d->totalSize() == body.size());
+	}
+
+	{
+		QSharedPointer<Download> d = ds.get(server.url("/db.json"), body.size() - 100);
+		QByteArray ba = d->readAll();
+		check("open range request", ba == body.right(100));
+	}
+
+	// the first response is cached
+	{
+		QSharedPointer<Download> d = ds.get(server.url("/db.json"));
+		QByteArray ba = d->readAll();
+		d->waitForFinished();
+		check("ETag revalidation", ba == body && d->isFromCache() && server.numNotModified("/db.json") == 1);
+	}
+
+	{
+		bool ok = false;
+		QByteArray ba = ds.download(server.url("/flaky.json"), &ok);
+		check("5xx retry", ok && ba == body && server.numRequests("/flaky.json") == 3);
+	}
+
+	// the retry continues with a range request
+	{
+		bool ok = false;
+		QByteArray ba = ds.download(server.url("/dropped.json"), &ok);
+		check("resume dropped connection", ok && ba == body && server.numRequests("/dropped.json") == 2);
+	}
+
+	{
+		QSharedPointer<Download> d = ds.get(server.url("/norange.json"), 10, 19);
+		d->readAll();
+		d->waitForFinished();
+		check("server without range support", d->hasError());
+	}
+
+	{
+		bool ok = true;
+		QByteArray ba = ds.download(server.url("/missing.json"), &ok);
+		check("missing resource", !ok && ba.isEmpty() && server.numRequests("/missing.json") == 0);
+	}
+
+	// do not keep the test's cache
+	ds.setCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/http", (qint64)1 << 30);
+
+	return success;
+}
+
 }
\ No newline at end of file
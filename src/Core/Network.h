@@ -34,6 +34,18 @@
 #pragma warning(push, 0)	// no warnings from includes
 #include <QString>
 #include <QByteArray>
+#include <QIODevice>
+#include <QUrl>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QPointer>
+#include <QQueue>
+#include <QThread>
+#include <QSharedPointer>
+#include <QSemaphore>
+#include <QMap>
+#include <QDateTime>
 #pragma warning(pop)
 
 #pragma warning (disable: 4251)	// inlined Qt functions in dll interface
@@ -47,6 +59,8 @@
 #endif
 
 // Qt defines
+class QNetworkAccessManager;
+class QNetworkReply;
 
 namespace pie {
 
@@ -55,6 +69,201 @@ namespace pie {
 namespace net {
 
 	DllExport QByteArray download(const QString& url, bool* ok = 0);
+	DllExport QByteArray toHttpDate(const QDateTime& dt);
+	DllExport QDateTime fromHttpDate(const QByteArray& date);
+}
+
+/// <summary>
+/// A single download which can be read while bytes arrive.
+/// Downloads are created by the DownloadService and can be
+/// read from any thread (reads block until data is available).
+/// At most max_buffer bytes are buffered, the network is
+/// paused if the reader falls behind.
+/// Downloads are conditional: if unmodifiedSince is valid, the
+/// request fails (412) if the resource was modified after it.
+/// Resumed requests must match the first response's ETag.
+/// </summary>
+class DllExport Download : public QIODevice {
+	Q_OBJECT
+
+public:
+	Download(const QUrl& url, qint64 begin = 0, qint64 end = -1, const QDateTime& unmodifiedSince = QDateTime(), QObject* parent = 0);
+	virtual ~Download();
+
+	QUrl url() const;
+	qint64 totalSize() const;
+
+	bool isSequential() const override;
+	bool atEnd() const override;
+	qint64 bytesAvailable() const override;
+	bool waitForReadyRead(int msecs) override;
+	bool waitForFinished(int msecs = -1);
+
+	bool isFinished() const;
+	bool hasError() const;
+	QString error() const;
+	bool isFromCache() const;
+	bool isModified() const;
+	int statusCode() const;
+
+	QByteArray etag() const;
+	QDateTime lastModified() const;
+
+	enum {
+		max_buffer = 1 << 23,	// 8 MB
+	};
+
+signals:
+	void progress(qint64 received, qint64 total) const;
+	void finished() const;
+
+protected:
+	qint64 readData(char* data, qint64 maxSize) override;
+	qint64 writeData(const char* data, qint64 maxSize) override;
+
+private slots:
+	void start();
+	void pull();
+	void onReplyFinished();
+
+private:
+	friend class DownloadService;
+
+	void complete(const QString& error = QString());
+	bool isRetryable() const;
+
+	QUrl mUrl;
+	qint64 mBegin = 0;		// the requested byte range
+	qint64 mEnd = -1;		// the last byte or -1 for the whole resource
+	QDateTime mUnmodifiedSince;
+
+	// shared with the reader
+	mutable QMutex mMutex;
+	QWaitCondition mReadable;	// data arrived or the download finished
+	QByteArray mBuffer;
+	int mPos = 0;
+	bool mFinished = false;
+	bool mFromCache = false;
+	int mStatusCode = 0;
+	qint64 mTotalSize = -1;
+	QByteArray mETag;
+	QDateTime mLastModified;
+	QString mError;
+	QAtomicInt mPullPending;
+
+	// only touched in the service thread
+	QNetworkAccessManager* mManager = 0;
+	QPointer<QNetworkReply> mReply;
+	bool mReplyFinished = false;
+	bool mPartial = false;		// a range was requested
+	bool mHeaderChecked = false;
+	qint64 mReceived = 0;
+	int mNumRetries = 0;
+	int mMaxRetries = 3;
+};
+
+/// <summary>
+/// Downloads resources asynchronously.
+/// All downloads share one QNetworkAccessManager which runs
+/// in the service's thread, so connections to a host are reused.
+/// At most maxConcurrent() requests are active, the others are queued.
+/// Failed requests are retried (and resumed if the server supports it).
+/// Responses are kept in an HTTP disk cache which is revalidated
+/// with ETag/Last-Modified, so unchanged databases are not downloaded twice.
+/// Useage:
+///		QSharedPointer<Download> d = DownloadService::instance().get(url);
+///		JsonStreamReader reader(d.data());	// parses while bytes arrive
+/// </summary>
+class DllExport DownloadService : public QObject {
+	Q_OBJECT
+
+public:
+	static DownloadService& instance();
+	virtual ~DownloadService();
+
+	QSharedPointer<Download> get(const QUrl& url, qint64 begin = 0, qint64 end = -1, const QDateTime& unmodifiedSince = QDateTime());
+	QByteArray download(const QUrl& url, bool* ok = 0);
+
+	void setMaxConcurrent(int numRequests);
+	int maxConcurrent() const;
+	void setMaxRetries(int numRetries);
+	void setCache(const QString& dirPath, qint64 maxSize);
+
+private slots:
+	void init();
+	void release();
+	void enqueue(QObject* download);
+	void startNext();
+	void initCache(const QString& dirPath, qint64 maxSize);
+
+private:
+	DownloadService();
+
+	QThread mThread;
+	QNetworkAccessManager* mManager = 0;
+
+	QQueue<QPointer<Download> > mPending;
+	QVector<QPointer<Download> > mActive;
+	QAtomicInt mMaxConcurrent;
+	QAtomicInt mMaxRetries;
+};
+
+/// <summary>
+/// A minimal HTTP server which serves resources from memory.
+/// It is a local stand-in for remote databases in tests and
+/// supports range requests, ETags (304 responses) and
+/// preconditions (If-Match/If-Unmodified-Since). Failures
+/// can be injected per resource (5xx responses or connections
+/// which are dropped in the middle of the body).
+/// The server runs in its own thread and closes the connection
+/// after each response.
+/// </summary>
+class DllExport HttpStandIn : public QThread {
+
+public:
+	enum Failure {
+		fail_none = 0,
+		fail_5xx,		// 503 with an error page
+		fail_drop,		// the connection is closed after half of the body
+	};
+
+	HttpStandIn();
+	virtual ~HttpStandIn();
+
+	void add(const QString& path, const QByteArray& body, bool ranges = true, const QDateTime& modified = QDateTime());
+	void fail(const QString& path, const Failure& failure, int numFailures = 1);
+	bool listen();
+
+	QUrl url(const QString& path) const;
+	int numRequests(const QString& path) const;
+	int numNotModified(const QString& path) const;
+
+protected:
+	void run() override;
+
+private:
+	QByteArray respond(const QByteArray& header);
+	static QByteArray response(int status, const QByteArray& reason, const QByteArray& body, const QByteArray& headers = QByteArray());
+
+	struct Resource {
+		QByteArray body;
+		QByteArray etag;
+		QDateTime modified;
+		bool ranges = true;
+		Failure failure = fail_none;
+		int numFailures = 0;
+		int numRequests = 0;
+		int numNotModified = 0;
+	};
+
+	mutable QMutex mMutex;
+	QMap<QString, Resource> mResources;
+	QSemaphore mListening;
+	QAtomicInt mPort;
+};
+
+namespace test {
+	DllExport bool Downloads();
 }
 
 }
\ No newline at end of file
@@ -32,52 +32,363 @@
 #include "PageData.h"
 #include "Algorithm.h"
 #include "Utils.h"
+#include "TextStore.h"
+#include "PolygonStore.h"
+#include "JsonStream.h"
+#include "Processor.h"
+#include "Embedding.h"
+#include "Neighbors.h"
+#include "Clustering.h"
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QXmlStreamReader>
+#include <QPolygon>
 #include <QSharedPointer>
+#include <QStringList>
 #include <QtMath>
 #include <QDebug>
+#include <QFile>
+#include <QDir>
+#include <QDataStream>
+#include <QTemporaryFile>
 #pragma warning(pop)
 
 namespace pie {
+
+	// -------------------------------------------------------------------- FieldProjection 
+	FieldProjection::FieldProjection(bool all) {
+
+		if (all)
+			mFields = (1 << f_end) - 1;
+	}
+
+	void FieldProjection::add(const Field & field) {
+		mFields |= 1 << field;
+	}
+
+	void FieldProjection::add(const FieldProjection & fields) {
+		mFields |= fields.mFields;
+	}
+
+	bool FieldProjection::contains(const Field & field) const {
+		return (mFields & (1 << field)) != 0;
+	}
+
+	bool FieldProjection::contains(const FieldProjection & fields) const {
+		return (mFields & fields.mFields) == fields.mFields;
+	}
+
+	bool FieldProjection::isAll() const {
+		return contains(FieldProjection(true));
+	}
+
+	/// <summary>
+	/// Returns true if a page's json key is needed.
+	/// Unknown keys are never needed.
+	/// </summary>
+	/// <param name="jsonKey">The json key of a page object.</param>
+	/// <returns>true if the key should be materialized.</returns>
+	bool FieldProjection::containsKey(const QString & jsonKey) const {
+
+		if (jsonKey == "xmlName")
+			return contains(f_xml_name);
+		if (jsonKey == "content")
+			return contains(f_content);
+		if (jsonKey == "collection")
+			return contains(f_collection);
+		if (jsonKey == "document")
+			return contains(f_document);
+		if (jsonKey == "imgName" || jsonKey == "width" || jsonKey == "height")
+			return contains(f_image);
+		if (jsonKey == "regions")
+			return contains(f_regions);
+
+		return false;
+	}
+
+	QString FieldProjection::toString() const {
+
+		QStringList fl;
+		for (int idx = 0; idx < f_end; idx++) {
+
+			if (contains((Field)idx))
+				fl << fieldName((Field)idx);
+		}
+
+		return fl.join(",");
+	}
+
+	/// <summary>
+	/// Creates a projection from a comma separated list.
+	/// e.g. "image,regions" only materializes image data and regions.
+	/// An empty list or "all" returns all fields.
+	/// </summary>
+	/// <param name="fieldList">The field list.</param>
+	/// <returns>The projection.</returns>
+	FieldProjection FieldProjection::fromString(const QString & fieldList) {
+
+		QString fls = fieldList.trimmed().toLower();
+
+		if (fls.isEmpty() || fls == "all")
+			return FieldProjection(true);
+
+		FieldProjection fp(false);
+
+		for (const QString& f : fls.split(",", QString::SkipEmptyParts)) {
+
+			bool found = false;
+			for (int idx = 0; idx < f_end; idx++) {
+
+				if (fieldName((Field)idx) == f.trimmed()) {
+					fp.add((Field)idx);
+					found = true;
+					break;
+				}
+			}
+
+			if (!found)
+				qWarning() << "[FieldProjection] unknown field:" << f;
+		}
+
+		return fp;
+	}
+
+	QString FieldProjection::fieldName(const Field & field) {
+
+		switch (field) {
+		case f_xml_name:	return "xml";
+		case f_content:		return "text";
+		case f_collection:	return "collection";
+		case f_document:	return "document";
+		case f_image:		return "image";
+		case f_regions:		return "regions";
+		case f_end: break;
+		}
+
+		return "";
+	}
 	
 	// -------------------------------------------------------------------- Region 
 	Region::Region(Type type, const QSize & s) {
 		mType = type;
-		mSize = s;
+		mRect = QRect(QPoint(0, 0), s);
+	}
+
+	Region::Region(Type type, const QRect & r, int polygonIdx, bool hasPosition) {
+		mType = type;
+		mRect = r;
+		mPolygonIdx = polygonIdx;
+		mHasPosition = hasPosition;
 	}
 
 	QSize Region::size() const {
-		return mSize;
+		return mRect.size();
+	}
+
+	/// <summary>
+	/// Returns the region's bounding box in page coordinates.
+	/// </summary>
+	QRect Region::rect() const {
+		return mRect;
+	}
+
+	/// <summary>
+	/// Returns false if the region's origin is unknown.
+	/// e.g. databases which only store region sizes.
+	/// </summary>
+	bool Region::hasPosition() const {
+		return mHasPosition;
+	}
+
+	Region::Type Region::type() const {
+		return mType;
+	}
+
+	/// <summary>
+	/// Returns the index of the region's polygon in the
+	/// collection's PolygonStore or -1 if it is not stored.
+	/// </summary>
+	int Region::polygonIndex() const {
+		return mPolygonIdx;
+	}
+
+	/// <summary>
+	/// Returns the PAGE XML name of a region type.
+	/// </summary>
+	QString Region::typeName(const Type & type) {
+
+		switch (type) {
+		case type_unknown:		return "Unknown";
+		case type_root:			return "Root";
+		case type_table_region:	return "TableRegion";
+		case type_table_cell:	return "TableCell";
+		case type_text_region:	return "TextRegion";
+		case type_text_line:	return "TextLine";
+		case type_word:			return "Word";
+		case type_separator:	return "SeparatorRegion";
+		case type_image:		return "ImageRegion";
+		case type_graphic:		return "GraphicRegion";
+		case type_chart:		return "ChartRegion";
+		case type_noise:		return "NoiseRegion";
+		case type_border:		return "Border";
+		case type_end: break;
+		}
+
+		return "";
 	}
 
 	double Region::area() const {
-		return mSize.width()*mSize.height();
+		return (double)mRect.width()*mRect.height();
 	}
 
 	double Region::width() const {
-		return mSize.width();
+		return mRect.width();
 	}
 
 	double Region::height() const {
-		return mSize.height();
+		return mRect.height();
+	}
+
+	/// <summary>
+	/// Returns the type of a PAGE XML element.
+	/// </summary>
+	/// <param name="name">The element name (e.g. TextRegion).</param>
+	/// <returns>type_unknown if the element is not a region.</returns>
+	Region::Type Region::typeFromName(const QStringRef & name) {
+
+		for (int idx = type_table_region; idx < type_end; idx++) {
+
+			if (name == typeName((Type)idx))
+				return (Type)idx;
+		}
+
+		return type_unknown;
 	}
 
 	Region Region::fromJson(const QJsonObject & jo) {
 
 		Region r;
 		r.mType = (Type)jo.value("type").toInt(0);
+		r.mHasPosition = jo.contains("x") && jo.contains("y");
 
+		int x = jo.value("x").toInt(0);
+		int y = jo.value("y").toInt(0);
 		int w = jo.value("width").toInt(0);
 		int h = jo.value("height").toInt(0);
 
-		r.mSize = QSize(w, h);
+		r.mRect = QRect(x, y, w, h);
 		
 		return r;
 	}
 
+	/// <summary>
+	/// Parses a region from a json stream.
+	/// </summary>
+	/// <param name="reader">The reader which is positioned at a region object.</param>
+	/// <param name="points">If set, it contains the region's polygon (empty if there is none).</param>
+	/// <returns>The region.</returns>
+	Region Region::fromJson(JsonStreamReader & reader, QString * points) {
+
+		Region r;
+
+		if (!reader.enterObject())
+			return r;
+
+		int x = 0, y = 0, w = 0, h = 0;
+		bool hasX = false, hasY = false;
+
+		QString key;
+		while (reader.nextKey(key)) {
+
+			if (key == "type")
+				r.mType = (Type)(int)reader.readNumber();
+			else if (key == "x") {
+				x = (int)reader.readNumber();
+				hasX = true;
+			}
+			else if (key == "y") {
+				y = (int)reader.readNumber();
+				hasY = true;
+			}
+			else if (key == "width")
+				w = (int)reader.readNumber();
+			else if (key == "height")
+				h = (int)reader.readNumber();
+			else if (key == "points" && points)
+				*points = reader.readValue().toString();
+			else
+				reader.skipValue();
+		}
+
+		r.mRect = QRect(x, y, w, h);
+		r.mHasPosition = hasX && hasY;
+
+		return r;
+	}
+
+	QJsonObject Region::toJson() const {
+
+		QJsonObject jo;
+		jo.insert("type", mType);
+
+		// unknown positions are not written - otherwise they are 0 when loaded again
+		if (mHasPosition) {
+			jo.insert("x", mRect.x());
+			jo.insert("y", mRect.y());
+		}
+		jo.insert("width", mRect.width());
+		jo.insert("height", mRect.height());
+
+		return jo;
+	}
+
+	/// <summary>
+	/// Writes the region.
+	/// </summary>
+	/// <param name="writer">The writer.</param>
+	/// <param name="polygon">The region's polygon which is written if it is not empty.</param>
+	void Region::toJson(JsonStreamWriter & writer, const QPolygon & polygon) const {
+
+		writer.beginObject();
+		writer.writeKey("type");
+		writer.writeInt(mType);
+
+		if (mHasPosition) {
+			writer.writeKey("x");
+			writer.writeInt(mRect.x());
+			writer.writeKey("y");
+			writer.writeInt(mRect.y());
+		}
+		writer.writeKey("width");
+		writer.writeInt(mRect.width());
+		writer.writeKey("height");
+		writer.writeInt(mRect.height());
+
+		if (!polygon.isEmpty()) {
+
+			// same format as Converter::polyToString - without temporary QStrings
+			QByteArray pts;
+			pts.reserve(polygon.size() * 10);
+
+			for (const QPoint& p : polygon) {
+
+				if (!pts.isEmpty())
+					pts.append(' ');
+
+				pts.append(QByteArray::number(p.x()));
+				pts.append(',');
+				pts.append(QByteArray::number(p.y()));
+			}
+
+			writer.writeKey("points");
+			writer.writeString(pts);
+		}
+
+		writer.endObject();
+	}
+
 	// -------------------------------------------------------------------- PageData 
 	PageData::PageData() {
 	}
@@ -90,14 +401,33 @@ namespace pie {
 		return mImg;
 	}
 
+	/// <summary>
+	/// Returns the polygon of a region.
+	/// </summary>
+	/// <param name="regionIdx">The region's index in regions().</param>
+	/// <returns>The polygon or the region's bounding box if polygons are not kept.</returns>
+	QPolygon PageData::polygon(int regionIdx) const {
+
+		if (regionIdx < 0 || regionIdx >= mRegions.size())
+			return QPolygon();
+
+		const Region& r = *mRegions[regionIdx];
+
+		if (mPolygons && r.polygonIndex() >= 0)
+			return mPolygons->polygon(r.polygonIndex());
+
+		return QPolygon(r.rect());
+	}
+
 	double PageData::averageRegion(std::function<double(const Region&)> prop) const {
 
-		QList<double> sizes;
-		for (const auto r : regions()) {
-			sizes << prop(*r);
-		}
+		std::vector<double> sizes;
+		sizes.reserve(mRegions.size());
+
+		for (const auto r : mRegions)
+			sizes.push_back(prop(*r));
 
-		return Math::statMoment(sizes, 0.5);
+		return Math::quantile(sizes.data(), sizes.size(), 0.5);
 	}
 	
 	QVector<QSharedPointer<Region>> PageData::regions() const {
@@ -109,31 +439,514 @@ namespace pie {
 	}
 
 	QString PageData::text() const {
+
+		if (mTextStore)
+			return mTextStore->text(mTextId);
+
 		return mContent;
 	}
 
+	/// <summary>
+	/// Returns the number of characters without paging in the text.
+	/// </summary>
+	int PageData::textLength() const {
+
+		if (mTextStore)
+			return mTextStore->length(mTextId);
+
+		return mContent.length();
+	}
+
+	bool PageData::hasText() const {
+
+		// do not page in the text if it is stored on disk
+		return textLength() > 0;
+	}
+
 	QString PageData::collectionName() const {
 		return mCollectionName;
 	}
 
-	PageData PageData::fromJson(const QJsonObject & jo) {
+	PageData PageData::fromJson(const QJsonObject & jo, const LoadOptions& options) {
+
+		const FieldProjection& fp = options.fields;
+
+		PageData pd;
+
+		if (fp.contains(FieldProjection::f_xml_name))
+			pd.mXmlFilePath = jo.value("xmlName").toString();
+
+		if (fp.contains(FieldProjection::f_content)) {
+
+			if (options.textStore) {
+				pd.mTextStore = options.textStore;
+				pd.mTextId = options.textStore->add(jo.value("content").toString());
+			}
+			else
+				pd.mContent = jo.value("content").toString();
+		}
+
+		if (fp.contains(FieldProjection::f_collection))
+			pd.mCollectionName = jo.value("collection").toString();
+		if (fp.contains(FieldProjection::f_document))
+			pd.mDocumentName = jo.value("document").toString();
+		if (fp.contains(FieldProjection::f_image))
+			pd.mImg = ImageData::fromJson(jo);
+
+		if (fp.contains(FieldProjection::f_regions)) {
+
+			QJsonArray regions = jo.value("regions").toArray();
+			PolygonBuffer polys;
+
+			for (auto r : regions) {
+
+				QJsonObject ro = r.toObject();
+				Region region = Region::fromJson(ro);
+
+				// polygons are optional (e.g. databases created by the ingester)
+				if (options.polygons && ro.contains("points")) {
+					QString pl = ro.value("points").toString();
+					int pIdx = polys.add(QStringRef(&pl));
+
+					if (polys.numPoints(pIdx) > 0)
+						region = Region(region.type(), region.hasPosition() ? region.rect() : polys.boundingRect(pIdx), pIdx);
+				}
+
+				pd.mRegions << QSharedPointer<Region>::create(region);
+			}
+
+			if (polys.size() > 0) {
+
+				int first = options.polygons->add(polys);
+				pd.mPolygons = options.polygons;
+
+				for (auto r : pd.mRegions) {
+					if (r->polygonIndex() >= 0)
+						*r = Region(r->type(), r->rect(), first + r->polygonIndex());
+				}
+			}
+		}
+
+		return pd;
+	}
+
+	/// <summary>
+	/// Parses a page from a json stream.
+	/// The projected keys are read directly from the stream - all
+	/// other keys are skipped without materializing them.
+	/// </summary>
+	/// <param name="reader">The reader which is positioned at a page object.</param>
+	/// <param name="options">The load options.</param>
+	/// <returns>The page.</returns>
+	PageData PageData::fromJson(JsonStreamReader & reader, const LoadOptions & options) {
+
+		const FieldProjection& fp = options.fields;
 
 		PageData pd;
-		pd.mXmlFilePath = jo.value("xmlName").toString();
-		pd.mContent = jo.value("content").toString();
-		pd.mCollectionName = jo.value("collection").toString();
-		pd.mDocumentName = jo.value("document").toString();
-		pd.mImg = ImageData::fromJson(jo);
 
-		QJsonArray regions = jo.value("regions").toArray();
-		for (auto r : regions)
-			pd.mRegions << QSharedPointer<Region>::create(Region::fromJson(r.toObject()));
+		if (!reader.enterObject())
+			return pd;
+
+		QString imgName;
+		QSize imgSize(0, 0);
+		PolygonBuffer polys;
+
+		QString key;
+		while (reader.nextKey(key)) {
+
+			if (!fp.containsKey(key))
+				reader.skipValue();
+			else if (key == "xmlName")
+				pd.mXmlFilePath = reader.readValue().toString();
+			else if (key == "content") {
+
+				if (options.textStore) {
+					pd.mTextStore = options.textStore;
+					pd.mTextId = options.textStore->add(reader.readValue().toString());
+				}
+				else
+					pd.mContent = reader.readValue().toString();
+			}
+			else if (key == "collection")
+				pd.mCollectionName = reader.readValue().toString();
+			else if (key == "document")
+				pd.mDocumentName = reader.readValue().toString();
+			else if (key == "imgName")
+				imgName = reader.readValue().toString();
+			else if (key == "width")
+				imgSize.setWidth((int)reader.readNumber());
+			else if (key == "height")
+				imgSize.setHeight((int)reader.readNumber());
+			else if (key == "regions" && reader.enterArray()) {
+
+				while (reader.nextElement()) {
+
+					// polygons are optional (e.g. databases created by the ingester)
+					QString pl;
+					Region region = Region::fromJson(reader, options.polygons ? &pl : 0);
+
+					if (!pl.isEmpty()) {
+						int pIdx = polys.add(QStringRef(&pl));
+
+						if (polys.numPoints(pIdx) > 0)
+							region = Region(region.type(), region.hasPosition() ? region.rect() : polys.boundingRect(pIdx), pIdx);
+					}
+
+					pd.mRegions << QSharedPointer<Region>::create(region);
+				}
+			}
+			else
+				reader.skipValue();
+		}
+
+		if (fp.contains(FieldProjection::f_image))
+			pd.mImg = ImageData(imgName, imgSize);
+
+		if (polys.size() > 0) {
+
+			int first = options.polygons->add(polys);
+			pd.mPolygons = options.polygons;
+
+			for (auto r : pd.mRegions) {
+				if (r->polygonIndex() >= 0)
+					*r = Region(r->type(), r->rect(), first + r->polygonIndex());
+			}
+		}
 
 		return pd;
 	}
+
+	/// <summary>
+	/// Parses a PAGE XML file.
+	/// The file is read by a streaming reader. Regions are
+	/// stored with their bounding box and the text is taken
+	/// from the text lines (one line per row).
+	/// </summary>
+	/// <param name="xml">The PAGE XML file's content.</param>
+	/// <param name="xmlName">The file name.</param>
+	/// <param name="documentName">The document's name.</param>
+	/// <param name="collectionName">The collection's name.</param>
+	/// <param name="options">Specifies which fields are loaded and where texts are stored.</param>
+	/// <param name="isPage">If set, it is false if the file is no PAGE XML (e.g. METS).</param>
+	/// <param name="error">If set, it contains the parser's error.</param>
+	/// <returns>The page.</returns>
+	PageData PageData::fromPageXml(
+		const QByteArray & xml, 
+		const QString & xmlName, 
+		const QString & documentName, 
+		const QString & collectionName, 
+		const LoadOptions & options, 
+		bool* isPage,
+		QString* error) {
+
+		const FieldProjection& fp = options.fields;
+		const bool parseRegions = fp.contains(FieldProjection::f_regions);
+		const bool parseText = fp.contains(FieldProjection::f_content);
+		const bool keepPolygons = parseRegions && options.polygons;
+
+		PageData pd;
+
+		if (fp.contains(FieldProjection::f_xml_name))
+			pd.mXmlFilePath = xmlName;
+		if (fp.contains(FieldProjection::f_collection))
+			pd.mCollectionName = collectionName;
+		if (fp.contains(FieldProjection::f_document))
+			pd.mDocumentName = documentName;
+
+		QXmlStreamReader reader(xml);
+
+		// one entry per open element
+		QVector<Region::Type> types;
+		QVector<int> regionIdx;		// the index in mRegions or -1 if the element is no region
+		bool inLineText = false;	// in a text line's TextEquiv
+		bool isPcGts = false;
+		QStringList lines;
+		PolygonBuffer polys;		// all coords of the page
+
+		while (!reader.atEnd()) {
+
+			QXmlStreamReader::TokenType token = reader.readNext();
+
+			if (token == QXmlStreamReader::EndElement) {
+
+				if (!types.isEmpty()) {
+					types.pop_back();
+					regionIdx.pop_back();
+				}
+				
+				if (reader.name() == "TextEquiv")
+					inLineText = false;
+				continue;
+			}
+			else if (token != QXmlStreamReader::StartElement)
+				continue;
+
+			const QStringRef name = reader.name();
+
+			// the root must be PcGts - everything else is no PAGE file
+			if (types.isEmpty() && !isPcGts) {
+
+				if (name != "PcGts")
+					break;
+
+				isPcGts = true;
+			}
+
+			if (name == "Page") {
+
+				if (fp.contains(FieldProjection::f_image)) {
+					QXmlStreamAttributes a = reader.attributes();
+					pd.mImg = ImageData::fromJson(QJsonObject{
+						{ "imgName", a.value("imageFilename").toString() },
+						{ "width", a.value("imageWidth").toInt() },
+						{ "height", a.value("imageHeight").toInt() } });
+				}
+			}
+			else if (name == "Coords" && parseRegions && !regionIdx.isEmpty() && regionIdx.last() != -1) {
+
+				QSharedPointer<Region> r = pd.mRegions[regionIdx.last()];
+				QXmlStreamAttributes a = reader.attributes();
+				int pIdx = polys.add(a.value("points"));
+
+				// the index is moved to the store once the page is parsed
+				if (polys.numPoints(pIdx) > 0)
+					*r = Region(r->type(), polys.boundingRect(pIdx), keepPolygons ? pIdx : -1);
+				else {
+					// PAGE 2010 stores points as children
+					QPolygon poly;
+
+					while (reader.readNextStartElement()) {
+
+						if (reader.name() == "Point") {
+							a = reader.attributes();
+							poly << QPoint(a.value("x").toInt(), a.value("y").toInt());
+						}
+						reader.skipCurrentElement();
+					}
+
+					// readNextStartElement consumed the end of Coords
+					if (!poly.isEmpty()) {
+						pIdx = polys.add(poly);
+						*r = Region(r->type(), poly.boundingRect(), keepPolygons ? pIdx : -1);
+					}
+					continue;
+				}
+			}
+			else if (name == "TextEquiv" && parseText && !types.isEmpty() && types.last() == Region::type_text_line) {
+				inLineText = true;
+			}
+			else if (name == "Unicode" && inLineText) {
+
+				lines << reader.readElementText();
+
+				// readElementText consumed the end element
+				continue;
+			}
+
+			Region::Type type = Region::typeFromName(name);
+			types << type;
+
+			if (type != Region::type_unknown && parseRegions) {
+				pd.mRegions << QSharedPointer<Region>::create(type);
+				regionIdx << pd.mRegions.size() - 1;
+			}
+			else
+				regionIdx << -1;
+		}
+
+		if (isPage)
+			*isPage = isPcGts;
+
+		if (reader.hasError() && isPcGts) {
+			if (error)
+				*error = reader.errorString() + QString(" (line %1)").arg(reader.lineNumber());
+			return PageData();
+		}
+
+		if (parseText) {
+
+			if (options.textStore) {
+				pd.mTextStore = options.textStore;
+				pd.mTextId = options.textStore->add(lines.join("\n"));
+			}
+			else
+				pd.mContent = lines.join("\n");
+		}
+
+		if (keepPolygons) {
+
+			// one lock per page
+			int first = options.polygons->add(polys);
+			pd.mPolygons = options.polygons;
+
+			for (auto r : pd.mRegions) {
+				if (r->polygonIndex() >= 0)
+					*r = Region(r->type(), r->rect(), first + r->polygonIndex());
+			}
+		}
+
+		return pd;
+	}
+
+	QJsonObject PageData::toJson() const {
+
+		QJsonObject jo;
+		jo.insert("xmlName", mXmlFilePath);
+		jo.insert("content", text());
+		jo.insert("collection", mCollectionName);
+		jo.insert("document", mDocumentName);
+		jo.insert("imgName", mImg.name());
+		jo.insert("width", mImg.width());
+		jo.insert("height", mImg.height());
+
+		QJsonArray regions;
+		for (int idx = 0; idx < mRegions.size(); idx++) {
+
+			QJsonObject ro = mRegions[idx]->toJson();
+			
+			if (mRegions[idx]->polygonIndex() >= 0)
+				ro.insert("points", Converter::polyToString(polygon(idx)));
+
+			regions << ro;
+		}
+
+		jo.insert("regions", regions);
+
+		return jo;
+	}
+
+	/// <summary>
+	/// Writes the page without building a QJsonObject.
+	/// The result is the same as toJson() if all fields are written.
+	/// </summary>
+	/// <param name="writer">The writer.</param>
+	/// <param name="fields">The fields which are written (i.e. the fields which were loaded).</param>
+	void PageData::toJson(JsonStreamWriter & writer, const FieldProjection & fields) const {
+
+		writer.beginObject();
+
+		// fields which were not loaded are not written - otherwise they would be empty
+		if (fields.contains(FieldProjection::f_xml_name)) {
+			writer.writeKey("xmlName");
+			writer.writeString(mXmlFilePath);
+		}
+		if (fields.contains(FieldProjection::f_content)) {
+			writer.writeKey("content");
+			writer.writeString(text());
+		}
+		if (fields.contains(FieldProjection::f_collection)) {
+			writer.writeKey("collection");
+			writer.writeString(mCollectionName);
+		}
+		if (fields.contains(FieldProjection::f_document)) {
+			writer.writeKey("document");
+			writer.writeString(mDocumentName);
+		}
+		if (fields.contains(FieldProjection::f_image)) {
+			writer.writeKey("imgName");
+			writer.writeString(mImg.name());
+			writer.writeKey("width");
+			writer.writeInt(mImg.width());
+			writer.writeKey("height");
+			writer.writeInt(mImg.height());
+		}
+
+		if (fields.contains(FieldProjection::f_regions)) {
+
+			writer.writeKey("regions");
+			writer.beginArray();
+
+			for (int idx = 0; idx < mRegions.size(); idx++)
+				mRegions[idx]->toJson(writer, mRegions[idx]->polygonIndex() >= 0 ? polygon(idx) : QPolygon());
+
+			writer.endArray();
+		}
+
+		writer.endObject();
+	}
+
+	/// <summary>
+	/// Serializes the regions (type, bounding box and polygon index).
+	/// </summary>
+	void PageData::writeRegions(QDataStream & ds) const {
+
+		ds << (qint32)mRegions.size();
+
+		for (const QSharedPointer<Region>& r : mRegions) {
+
+			QRect rc = r->rect();
+			ds << (qint32)r->type() << (qint32)rc.x() << (qint32)rc.y() << (qint32)rc.width() << (qint32)rc.height() << (qint32)r->polygonIndex() << r->hasPosition();
+		}
+	}
+
+	/// <summary>
+	/// Reads the regions written by writeRegions().
+	/// </summary>
+	/// <returns>false if the stream is corrupt - the regions are not changed then.</returns>
+	bool PageData::readRegions(QDataStream & ds) {
+
+		qint32 n = 0;
+		ds >> n;
+
+		QVector<QSharedPointer<Region> > regions;
+		regions.reserve(qMax(n, 0));
+
+		for (int idx = 0; idx < n && ds.status() == QDataStream::Ok; idx++) {
+
+			qint32 type = 0, x = 0, y = 0, w = 0, h = 0, pIdx = -1;
+			bool hasPosition = false;
+			ds >> type >> x >> y >> w >> h >> pIdx >> hasPosition;
+
+			regions << QSharedPointer<Region>::create((Region::Type)type, QRect(x, y, w, h), pIdx, hasPosition);
+		}
+
+		if (ds.status() != QDataStream::Ok)
+			return false;
+
+		mRegions = regions;
+
+		return true;
+	}
+
+	/// <summary>
+	/// Frees the text and the regions (see Collection::evict).
+	/// The text is moved to the text store and paged in on demand.
+	/// Call writeRegions() before - the regions are removed.
+	/// </summary>
+	/// <param name="textStore">The store which keeps the text on disk.</param>
+	void PageData::evict(QSharedPointer<TextStore> textStore) {
+
+		if (!mTextStore && textStore && !mContent.isEmpty()) {
+
+			int id = textStore->add(mContent);
+
+			if (id >= 0) {
+				mTextStore = textStore;
+				mTextId = id;
+				mContent = QString();
+			}
+		}
+
+		mRegions = QVector<QSharedPointer<Region> >();
+	}
+
+	/// <summary>
+	/// Returns the approximate number of bytes of the page's text and regions.
+	/// </summary>
+	qint64 PageData::memorySize() const {
+
+		qint64 s = sizeof(PageData);
+		s += (qint64)mContent.capacity() * sizeof(QChar);
+		s += (qint64)mRegions.capacity() * sizeof(QSharedPointer<Region>);
+		s += (qint64)mRegions.size() * (sizeof(Region) + 2 * sizeof(void*));	// the shared pointer's reference count
+
+		return s;
+	}
 	
 	// -------------------------------------------------------------------- ImageData 
-	ImageData::ImageData() {
+	ImageData::ImageData(const QString& fileName, const QSize& size) {
+		mFileName = fileName;
+		mSize = size;
 	}
 
 	QString ImageData::name() const {
@@ -266,13 +1079,42 @@ namespace pie {
 
 
 
-	Document Document::fromJson(const QJsonObject & jo) {
+	/// <summary>
+	/// Appends pages to the document.
+	/// This is used if pages are loaded progressively.
+	/// </summary>
+	/// <param name="pages">The new pages.</param>
+	void Document::addPages(const QVector<QSharedPointer<PageData>>& pages) {
+
+		mPages << pages;
+		mDictionary.clear();
+	}
+
+	void Document::setPages(const QVector<QSharedPointer<PageData>>& pages) {
+
+		mPages = pages;
+		mDictionary.clear();
+	}
+
+	/// <summary>
+	/// Returns the database file (e.g. a shard) the document was loaded from.
+	/// It is empty if the collection was loaded from a single database.
+	/// </summary>
+	QString Document::source() const {
+		return mSource;
+	}
+
+	void Document::setSource(const QString & filePath) {
+		mSource = filePath;
+	}
+
+	Document Document::fromJson(const QJsonObject & jo, const LoadOptions& options) {
 
 		Document d(jo["name"].toString());
 
 		QJsonArray entities = jo.value("pages").toArray();
 		for (auto p : entities)
-			d.mPages << QSharedPointer<PageData>::create(PageData::fromJson(p.toObject()));
+			d.mPages << QSharedPointer<PageData>::create(PageData::fromJson(p.toObject(), options));
 
 		// always get the same color - this is bad if all documents have the same size
 		d.setColor(ColorManager::color(d.numPages()));
@@ -280,22 +1122,238 @@ namespace pie {
 		return d;
 	}
 
+	Document Document::fromJson(JsonStreamReader & reader, const LoadOptions & options) {
+
+		QString name;
+		QVector<QSharedPointer<PageData> > pages;
+
+		if (!reader.enterObject())
+			return Document();
+
+		QString key;
+		while (reader.nextKey(key)) {
+
+			if (key == "name")
+				name = reader.readString();
+			else if (key == "pages" && reader.enterArray()) {
+
+				while (reader.nextElement())
+					pages << QSharedPointer<PageData>::create(PageData::fromJson(reader, options));
+			}
+			else
+				reader.skipValue();
+		}
+
+		Document d(name);
+		d.mPages = pages;
+		d.setColor(ColorManager::color(d.numPages()));
+
+		return d;
+	}
+
+	QJsonObject Document::toJson() const {
+
+		QJsonArray pages;
+		for (auto p : mPages)
+			pages << p->toJson();
+
+		QJsonObject jo;
+		jo.insert("name", name());
+		jo.insert("pages", pages);
+
+		return jo;
+	}
+
+	void Document::toJson(JsonStreamWriter & writer, const FieldProjection & fields) const {
+
+		QVector<int> pageIdx;
+		for (int idx = 0; idx < mPages.size(); idx++)
+			pageIdx << idx;
+
+		toJson(writer, pageIdx, fields);
+	}
+
+	/// <summary>
+	/// Writes a subset of the document's pages.
+	/// </summary>
+	/// <param name="writer">The writer.</param>
+	/// <param name="pageIdx">The indices of the pages which are written.</param>
+	/// <param name="fields">The page fields which are written.</param>
+	void Document::toJson(JsonStreamWriter & writer, const QVector<int>& pageIdx, const FieldProjection & fields) const {
+
+		writer.beginObject();
+		writer.writeKey("name");
+		writer.writeString(name());
+		writer.writeKey("pages");
+		writer.beginArray();
+
+		for (int idx : pageIdx) {
+			if (idx >= 0 && idx < mPages.size())
+				mPages[idx]->toJson(writer, fields);
+		}
+
+		writer.endArray();
+		writer.endObject();
+	}
+
 	// -------------------------------------------------------------------- Collection 
-	Collection::Collection(const QString& name) : BaseCollection(name) {
+	Collection::Collection(const QString& name, const LoadOptions& options) : BaseCollection(name) {
+		mTextStore = options.textStore;
+		mPolygons = options.polygons;
+		mFields = options.fields;
 	}
 
-	Collection Collection::fromJson(const QJsonObject & jo, const QString& name) {
+	/// <summary>
+	/// Parses a collection from a PIE database.
+	/// </summary>
+	/// <param name="jo">The database's root object.</param>
+	/// <param name="name">The collection name.</param>
+	/// <param name="options">Specifies which fields are loaded and where texts are stored.</param>
+	/// <returns>The collection.</returns>
+	Collection Collection::fromJson(const QJsonObject & jo, const QString& name, const LoadOptions& options) {
 
-		Collection c(name);
+		Collection c(name, options);
 
 		QJsonArray entities = jo.value("documents").toArray();
 		for (auto p : entities)
-			c.mDocuments << QSharedPointer<Document>::create(Document::fromJson(p.toObject()));
+			c.mDocuments << QSharedPointer<Document>::create(Document::fromJson(p.toObject(), options));
 
 		return c;
 
 	}
 
+	/// <summary>
+	/// Parses a collection from a json stream.
+	/// In contrast to the QJsonObject version, the database 
+	/// is never completely in memory.
+	/// </summary>
+	/// <param name="reader">The reader positioned at the database's root object.</param>
+	/// <param name="name">The collection name.</param>
+	/// <param name="options">Specifies which fields are loaded and where texts are stored.</param>
+	/// <returns>The collection.</returns>
+	Collection Collection::fromJson(JsonStreamReader & reader, const QString & name, const LoadOptions & options) {
+
+		Collection c(name, options);
+
+		if (!reader.enterObject())
+			return c;
+
+		QString key;
+		while (reader.nextKey(key)) {
+
+			if (key == "documents" && reader.enterArray()) {
+
+				while (reader.nextElement())
+					c.mDocuments << QSharedPointer<Document>::create(Document::fromJson(reader, options));
+			}
+			else
+				reader.skipValue();
+		}
+
+		if (reader.hasError())
+			qWarning() << "[Collection] database is corrupt:" << reader.errorString();
+
+		return c;
+	}
+
+	/// <summary>
+	/// Writes the collection as PIE database.
+	/// </summary>
+	/// <param name="writer">The writer.</param>
+	/// <param name="pageIdx">The sorted indices (see pages()) of the pages which are written - if empty, all pages are written.</param>
+	void Collection::toJson(JsonStreamWriter & writer, const QVector<int>& pageIdx) const {
+
+		restore();
+
+		writer.beginObject();
+		writer.writeKey("documents");
+		writer.beginArray();
+
+		int first = 0;
+		int sIdx = 0;
+
+		for (const QSharedPointer<Document>& d : mDocuments) {
+
+			const int last = first + d->numPages();
+
+			if (pageIdx.isEmpty())
+				d->toJson(writer, mFields);
+			else {
+				// documents without selected pages are skipped
+				QVector<int> dIdx;
+				for (; sIdx < pageIdx.size() && pageIdx[sIdx] < last; sIdx++)
+					dIdx << pageIdx[sIdx] - first;
+
+				if (!dIdx.isEmpty())
+					d->toJson(writer, dIdx, mFields);
+			}
+
+			first = last;
+		}
+
+		writer.endArray();
+		writer.endObject();
+	}
+
+	/// <summary>
+	/// Writes the collection (or a subset of its pages) as PIE database.
+	/// Pages are streamed to disk - the database is never completely in memory.
+	/// </summary>
+	/// <param name="filePath">The database's file path.</param>
+	/// <param name="pageIdx">The sorted indices (see pages()) of the pages which are written - if empty, all pages are written.</param>
+	/// <returns>true if the database was written.</returns>
+	bool Collection::write(const QString & filePath, const QVector<int>& pageIdx) const {
+
+		Timer dt;
+		QFile f(filePath);
+
+		if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+			qCritical() << "Sorry, I could not open" << filePath << "for writing...";
+			return false;
+		}
+
+		// the database only has the fields which were loaded
+		if (!mFields.isAll())
+			qWarning().noquote() << "[Collection] only" << mFields.toString() << "are written to" << filePath;
+
+		JsonStreamWriter writer(&f);
+		toJson(writer, pageIdx);
+
+		if (!writer.flush()) {
+			qCritical() << "[Collection] could not write to" << filePath << ":" << writer.errorString();
+			return false;
+		}
+
+		int numPages = pageIdx.isEmpty() ? this->numPages() : pageIdx.size();
+		double mbs = writer.bytesWritten() / 1024.0 / 1024.0;
+
+		qInfo().noquote() << "[Collection]" << numPages << "pages written to" << filePath << "in" << dt
+			<< QString("(%1 MB/s)").arg(mbs / qMax(dt.elapsed() / 1000.0, 0.001), 0, 'f', 1);
+
+		return true;
+	}
+
+	/// <summary>
+	/// Returns the indices (see pages()) of all pages of the selected documents.
+	/// </summary>
+	QVector<int> Collection::selectedPages() const {
+
+		QVector<int> pageIdx;
+		int first = 0;
+
+		for (const QSharedPointer<Document>& d : mDocuments) {
+
+			if (d->selected()) {
+				for (int idx = 0; idx < d->numPages(); idx++)
+					pageIdx << first + idx;
+			}
+
+			first += d->numPages();
+		}
+
+		return pageIdx;
+	}
+
 	bool Collection::isEmpty() const {
 		return mDocuments.isEmpty();
 	}
@@ -327,6 +1385,500 @@ namespace pie {
 		return mDocuments;
 	}
 
+	void Collection::addDocument(QSharedPointer<Document> document) {
+		restore();
+		mDocuments << document;
+		clearCache();
+	}
+
+	/// <summary>
+	/// Replaces documents (e.g. of a changed shard) or appends new ones.
+	/// In contrast to clearCache(), cached page features are kept
+	/// and only the new pages are processed. Models that depend on
+	/// all pages (embedding, clustering, etc.) are cleared.
+	/// </summary>
+	/// <param name="firstDoc">The index of the first document that is replaced (numDocuments() appends).</param>
+	/// <param name="numRemoved">The number of documents which are removed.</param>
+	/// <param name="documents">The documents which are inserted at firstDoc.</param>
+	void Collection::replaceDocuments(int firstDoc, int numRemoved, const QVector<QSharedPointer<Document> >& documents) {
+
+		if (firstDoc < 0 || numRemoved < 0 || firstDoc + numRemoved > mDocuments.size()) {
+			qWarning() << "[Collection] illegal document range:" << firstDoc << "+" << numRemoved;
+			return;
+		}
+
+		restore();
+
+		int firstPage = 0;
+		for (int dIdx = 0; dIdx < firstDoc; dIdx++)
+			firstPage += mDocuments[dIdx]->numPages();
+
+		int numPagesRemoved = 0;
+		for (int dIdx = firstDoc; dIdx < firstDoc + numRemoved; dIdx++)
+			numPagesRemoved += mDocuments[dIdx]->numPages();
+
+		QVector<QSharedPointer<PageData> > added;
+		for (auto d : documents)
+			added << d->pages();
+
+		mDocuments.remove(firstDoc, numRemoved);
+		for (int idx = 0; idx < documents.size(); idx++)
+			mDocuments.insert(firstDoc + idx, documents[idx]);
+
+		splice(firstPage, numPagesRemoved, added, firstDoc, numRemoved, documents.size());
+	}
+
+	/// <summary>
+	/// Replaces pages of a document (e.g. pages which were loaded in the background).
+	/// Like replaceDocuments(), cached page features are kept and only the new pages
+	/// are processed. Models that depend on all pages are cleared.
+	/// </summary>
+	/// <param name="docIdx">The document's index.</param>
+	/// <param name="firstPage">The index of the document's first page that is replaced (numPages() appends).</param>
+	/// <param name="numRemoved">The number of pages which are removed.</param>
+	/// <param name="pages">The pages which are inserted at firstPage.</param>
+	void Collection::replacePages(int docIdx, int firstPage, int numRemoved, const QVector<QSharedPointer<PageData> >& pages) {
+
+		if (docIdx < 0 || docIdx >= mDocuments.size() ||
+			firstPage < 0 || numRemoved < 0 || firstPage + numRemoved > mDocuments[docIdx]->numPages()) {
+			qWarning() << "[Collection] illegal page range:" << docIdx << ":" << firstPage << "+" << numRemoved;
+			return;
+		}
+
+		restore();
+
+		int pageOffset = 0;
+		for (int dIdx = 0; dIdx < docIdx; dIdx++)
+			pageOffset += mDocuments[dIdx]->numPages();
+
+		QVector<QSharedPointer<PageData> > dp = mDocuments[docIdx]->pages();
+		dp.remove(firstPage, numRemoved);
+		for (int idx = 0; idx < pages.size(); idx++)
+			dp.insert(firstPage + idx, pages[idx]);
+
+		mDocuments[docIdx]->setPages(dp);
+
+		splice(pageOffset + firstPage, numRemoved, pages, docIdx, 1, 1);
+	}
+
+	/// <summary>
+	/// Updates the caches after pages or documents were replaced.
+	/// NOTE: call this after the collection was changed.
+	/// </summary>
+	void Collection::splice(int firstPage, int numRemoved, const QVector<QSharedPointer<PageData> >& added, int firstDoc, int numDocsRemoved, int numDocsAdded) {
+
+		// caches are only valid if they were computed for the previous pages
+		const int oldNumPages = numPages() - added.size() + numRemoved;
+		const int oldNumDocs = mDocuments.size() - numDocsAdded + numDocsRemoved;
+
+		if (mRegionStats && mRegionStats->numPages() == oldNumPages)
+			mRegionStats->splice(firstPage, numRemoved, added);
+		else
+			mRegionStats.clear();
+
+		if (mLayoutStats && mLayoutStats->numPages() == oldNumPages)
+			mLayoutStats->splice(firstPage, numRemoved, added);
+		else
+			mLayoutStats.clear();
+
+		if (mRegionDist && mRegionDist->numPages() == oldNumPages && mRegionDist->numDocuments() == oldNumDocs)
+			mRegionDist->splice(*this, firstDoc, numDocsRemoved, numDocsAdded);
+		else
+			mRegionDist.clear();
+
+		// features need the region and layout statistics
+		if (mFeatureCache)
+			mFeatureCache->splice(firstPage, numRemoved, added.size());
+
+		mComponents.clear();
+		mNeighbors.clear();
+		mEmbedding.release();
+		mClustering.clear();
+		mRegionPositions = -1;
+	}
+
+	QSharedPointer<TextStore> Collection::textStore() const {
+		return mTextStore;
+	}
+
+	QSharedPointer<PolygonStore> Collection::polygons() const {
+		return mPolygons;
+	}
+
+	FieldProjection Collection::fields() const {
+		return mFields;
+	}
+
+	/// <summary>
+	/// Returns false if regions only have a size (e.g. databases
+	/// without x/y keys). Position dependent features (see PageLayout)
+	/// are not available then.
+	/// </summary>
+	bool Collection::hasRegionPositions() const {
+
+		if (mRegionPositions == -1) {
+
+			restore();
+			mRegionPositions = 1;
+
+			for (const QSharedPointer<Document>& d : mDocuments) {
+
+				for (const QSharedPointer<PageData>& p : d->pages()) {
+
+					for (const QSharedPointer<Region>& r : p->regions()) {
+
+						if (!r->hasPosition() && !r->rect().isEmpty()) {
+							mRegionPositions = 0;
+							return false;
+						}
+					}
+				}
+			}
+		}
+
+		return mRegionPositions == 1;
+	}
+
+	QString Collection::filePath() const {
+		return mFilePath;
+	}
+
+	/// <summary>
+	/// Sets the database file the collection was loaded from.
+	/// Caches (e.g. the neighbor index) are stored next to it.
+	/// </summary>
+	void Collection::setFilePath(const QString & filePath) {
+		mFilePath = filePath;
+	}
+
+	/// <summary>
+	/// Returns the region statistics of all pages.
+	/// They are computed once and shared by all plots.
+	/// </summary>
+	QSharedPointer<RegionStatistics> Collection::regionStatistics() const {
+
+		// pages might have been added to documents
+		if (!mRegionStats || mRegionStats->numPages() != numPages()) {
+
+			restore();
+
+			Timer dt;
+			mRegionStats = QSharedPointer<RegionStatistics>::create(RegionStatistics::compute(pages()));
+			qDebug() << "region statistics of" << numPages() << "pages computed in" << dt;
+		}
+
+		return mRegionStats;
+	}
+
+	/// <summary>
+	/// Returns the layout features of all pages.
+	/// They are computed once and shared by all plots.
+	/// </summary>
+	QSharedPointer<LayoutStatistics> Collection::layoutStatistics() const {
+
+		if (!mLayoutStats || mLayoutStats->numPages() != numPages()) {
+
+			restore();
+
+			Timer dt;
+			mLayoutStats = QSharedPointer<LayoutStatistics>::create(LayoutStatistics::compute(pages()));
+			qDebug() << "layout statistics of" << numPages() << "pages computed in" << dt;
+		}
+
+		return mLayoutStats;
+	}
+
+	/// <summary>
+	/// Returns the region size distributions of all documents.
+	/// The memory needed is constant for any number of regions.
+	/// </summary>
+	QSharedPointer<RegionDistribution> Collection::regionDistribution() const {
+
+		if (!mRegionDist || mRegionDist->numPages() != numPages()) {
+
+			restore();
+
+			Timer dt;
+			mRegionDist = QSharedPointer<RegionDistribution>::create(RegionDistribution::compute(*this));
+			qDebug() << "region distribution of" << numPages() << "pages computed in" << dt;
+		}
+
+		return mRegionDist;
+	}
+
+	/// <summary>
+	/// Returns the principal components of all pages' features.
+	/// </summary>
+	QSharedPointer<PrincipalComponents> Collection::principalComponents() const {
+
+		if (!mComponents || mComponents->numPages() != numPages()) {
+			restore();
+			mComponents = QSharedPointer<PrincipalComponents>::create(PrincipalComponents::compute(*this));
+		}
+
+		return mComponents;
+	}
+
+	/// <summary>
+	/// Returns the approximate nearest neighbor index of all pages.
+	/// </summary>
+	QSharedPointer<NeighborIndex> Collection::neighborIndex() const {
+
+		if (!mNeighbors || mNeighbors->numPages() != numPages()) {
+			restore();
+			mNeighbors = QSharedPointer<NeighborIndex>::create(NeighborIndex::compute(*this));
+		}
+
+		return mNeighbors;
+	}
+
+	/// <summary>
+	/// Returns the mapped feature columns which are shared by all plots.
+	/// </summary>
+	QSharedPointer<FeatureCache> Collection::featureCache() const {
+
+		if (!mFeatureCache)
+			mFeatureCache = QSharedPointer<FeatureCache>::create(this);
+
+		return mFeatureCache;
+	}
+
+	/// <summary>
+	/// Returns the page embedding (a row per page) or an empty matrix.
+	/// </summary>
+	cv::Mat Collection::embedding() const {
+		return mEmbedding;
+	}
+
+	void Collection::setEmbedding(const cv::Mat & embedding) {
+		mEmbedding = embedding;
+	}
+
+	/// <summary>
+	/// Returns the page clusters or a NULL pointer if pages are not clustered.
+	/// </summary>
+	QSharedPointer<KMeans> Collection::clustering() const {
+
+		// the labels are outdated if pages were added
+		if (mClustering && mClustering->numPages() != numPages())
+			return QSharedPointer<KMeans>();
+
+		return mClustering;
+	}
+
+	void Collection::setClustering(QSharedPointer<KMeans> clustering) {
+		mClustering = clustering;
+	}
+
+	/// <summary>
+	/// Returns the cluster of a page or -1 if pages are not clustered.
+	/// </summary>
+	int Collection::cluster(int pageIdx) const {
+
+		QSharedPointer<KMeans> km = clustering();
+
+		if (!km || pageIdx < 0 || pageIdx >= km->numPages())
+			return -1;
+
+		return km->labels().at<int>(pageIdx);
+	}
+
+	/// <summary>
+	/// Removes cached features.
+	/// Call this if pages were changed.
+	/// </summary>
+	void Collection::clearCache() {
+		mRegionStats.clear();
+		mLayoutStats.clear();
+		mRegionDist.clear();
+		mComponents.clear();
+		mNeighbors.clear();
+
+		if (mFeatureCache)
+			mFeatureCache->clear();
+		mEmbedding.release();	// the page order might have changed
+		mClustering.clear();
+		mRegionPositions = -1;
+	}
+
+	/// <summary>
+	/// Moves texts, regions and feature columns out of RAM.
+	/// Call this if the collection is not visible (see MemoryBudget).
+	/// Texts are moved to the text store and region polygons and
+	/// feature columns are spilled to disk - all of them are paged
+	/// in on demand. The regions are written to a spill file and
+	/// read back by restore(). Caches that are computed from the
+	/// regions (e.g. the region statistics) are removed.
+	/// </summary>
+	/// <returns>The number of bytes freed.</returns>
+	qint64 Collection::evict() {
+
+		if (isEvicted())
+			return 0;
+
+		Timer dt;
+		qint64 before = memorySize();
+
+		QSharedPointer<QTemporaryFile> spill(new QTemporaryFile(QDir::tempPath() + "/pie-regions-XXXXXX.bin"));
+
+		if (!spill->open()) {
+			qCritical() << "[Collection] cannot open spill file" << spill->fileName();
+			return 0;
+		}
+
+		QVector<QSharedPointer<PageData> > ps = pages();
+
+		// nothing is freed if the regions cannot be written
+		QDataStream ds(spill.data());
+		for (auto p : ps)
+			p->writeRegions(ds);
+
+		if (ds.status() != QDataStream::Ok || !spill->flush()) {
+			qCritical() << "[Collection] could not write to" << spill->fileName();
+			return 0;
+		}
+
+		if (!mTextStore)
+			mTextStore = QSharedPointer<TextStore>::create();
+
+		for (auto p : ps)
+			p->evict(mTextStore);
+
+		mTextStore->clearCache();
+
+		if (mPolygons)
+			mPolygons->evict();
+
+		// columns which are still referenced by plots are not freed
+		qint64 shared = 0;
+		if (mFeatureCache) {
+			shared = mFeatureCache->memorySize();
+			shared -= mFeatureCache->evict();
+		}
+
+		mRegionStats.clear();
+		mLayoutStats.clear();
+		mRegionDist.clear();
+		mComponents.clear();
+		mNeighbors.clear();
+		mRegionSpill = spill;
+
+		qint64 freed = before - memorySize() - shared;
+		qInfo().noquote() << "[Collection]" << name() << "evicted" << QString("%1 MB").arg(freed / 1024.0 / 1024.0, 0, 'f', 1) << "in" << dt;
+
+		return freed;
+	}
+
+	/// <summary>
+	/// Reads the regions of an evicted collection back.
+	/// Texts, polygons and feature columns stay on disk until
+	/// they are needed. Nothing is done if the collection is
+	/// not evicted - so call this before regions are accessed.
+	/// </summary>
+	/// <returns>false if the regions could not be read.</returns>
+	bool Collection::restore() const {
+
+		if (!mRegionSpill)
+			return true;
+
+		Timer dt;
+
+		// the spill file is kept until all pages are read - so restore() can be called again
+		if (!mRegionSpill->seek(0)) {
+			qCritical() << "[Collection] cannot read" << mRegionSpill->fileName();
+			return false;
+		}
+
+		QDataStream ds(mRegionSpill.data());
+
+		for (auto p : pages()) {
+
+			if (!p->readRegions(ds)) {
+				qCritical() << "[Collection] cannot read regions from" << mRegionSpill->fileName();
+				return false;
+			}
+		}
+
+		mRegionSpill.clear();
+
+		qInfo().noquote() << "[Collection]" << name() << "restored in" << dt;
+
+		return true;
+	}
+
+	bool Collection::isEvicted() const {
+		return !mRegionSpill.isNull();
+	}
+
+	/// <summary>
+	/// Returns the approximate number of bytes the collection keeps in RAM.
+	/// </summary>
+	qint64 Collection::memorySize() const {
+
+		qint64 s = 0;
+
+		for (auto p : pages())
+			s += p->memorySize();
+
+		if (mTextStore)
+			s += mTextStore->memorySize();
+
+		if (mPolygons)
+			s += mPolygons->memorySize();
+
+		if (mFeatureCache)
+			s += mFeatureCache->memorySize();
+
+		if (mRegionStats)
+			s += mRegionStats->data().total() * mRegionStats->data().elemSize();
+
+		if (mLayoutStats)
+			s += mLayoutStats->data().total() * mLayoutStats->data().elemSize();
+
+		if (mComponents)
+			s += mComponents->scores().total() * mComponents->scores().elemSize();
+
+		s += mEmbedding.total() * mEmbedding.elemSize();
+
+		return s;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes spilled to disk.
+	/// </summary>
+	qint64 Collection::diskSize() const {
+
+		qint64 s = 0;
+
+		if (mTextStore)
+			s += mTextStore->diskSize();
+
+		if (mFeatureCache)
+			s += mFeatureCache->diskSize();
+
+		if (mRegionSpill)
+			s += mRegionSpill->size();
+
+		return s;
+	}
+
+	/// <summary>
+	/// Returns a short memory report (e.g. for tab tooltips).
+	/// </summary>
+	QString Collection::memoryString() const {
+
+		QString msg = QString("%1 MB in RAM").arg(memorySize() / 1024.0 / 1024.0, 0, 'f', 1);
+
+		qint64 ds = diskSize();
+		if (ds > 0)
+			msg += QString(", %1 MB on disk").arg(ds / 1024.0 / 1024.0, 0, 'f', 1);
+
+		if (isEvicted())
+			msg += " (evicted)";
+
+		return msg;
+	}
+
 	QString Collection::toString() const {
 
 		int nr = numRegions();
@@ -338,6 +1890,18 @@ namespace pie {
 		msg += QString::number(nr) + " regions (" + QString::number((double)nr / numPages()) + " per page)\n";
 		msg += QString::number(nt) + " pages with text";
 
+		if (mTextStore)
+			msg += " (" + QString::number(mTextStore->diskSize() / 1024) + " KB on disk)";
+
+		if (mPolygons && mPolygons->size() > 0)
+			msg += "\n" + QString::number(mPolygons->size()) + " polygons (" + QString::number(mPolygons->memorySize() / 1024) + " KB)";
+
+		if (!mFields.isAll())
+			msg += "\nloaded fields: " + mFields.toString();
+
+		if (nr > 0)
+			msg += "\n" + regionDistribution()->toString();
+
 		return msg;
 	}
 
@@ -350,6 +1914,8 @@ namespace pie {
 
 	int Collection::numRegions() const {
 
+		restore();
+
 		int nr = 0;
 		for (auto p : pages())
 			nr += p->numRegions();
@@ -361,7 +1927,7 @@ namespace pie {
 
 		int ntp = 0;
 		for (auto p : pages()) {
-			if (!p->text().isEmpty())
+			if (p->hasText())
 				ntp++;
 		}
 
@@ -36,10 +36,14 @@
 #pragma warning(push, 0)	// no warnings from includes
 #include <QVector>
 #include <QSize>
+#include <QRect>
+#include <QPolygon>
 #include <QColor>
 #include <QMap>
 
 #include <functional>
+
+#include <opencv2/core.hpp>
 #pragma warning(pop)
 
 #ifndef DllExport
@@ -54,9 +58,71 @@
 
 // Qt defines
 class QSettings;
+class QJsonObject;
+class QDataStream;
+class QTemporaryFile;
 
 namespace pie {	
 
+class TextStore;
+class PolygonStore;
+class JsonStreamReader;
+class JsonStreamWriter;
+class RegionStatistics;
+class LayoutStatistics;
+class RegionDistribution;
+class PrincipalComponents;
+class NeighborIndex;
+class KMeans;
+class FeatureCache;
+
+/// <summary>
+/// Specifies which page fields are materialized when loading a database.
+/// </summary>
+class DllExport FieldProjection {
+
+public:
+	enum Field {
+		f_xml_name = 0,
+		f_content,
+		f_collection,
+		f_document,
+		f_image,
+		f_regions,
+
+		f_end
+	};
+
+	FieldProjection(bool all = true);
+
+	void add(const Field& field);
+	void add(const FieldProjection& fields);
+	bool contains(const Field& field) const;
+	bool contains(const FieldProjection& fields) const;
+	bool isAll() const;
+
+	bool containsKey(const QString& jsonKey) const;
+
+	QString toString() const;
+	static FieldProjection fromString(const QString& fieldList);
+
+private:
+	static QString fieldName(const Field& field);
+
+	int mFields = 0;
+};
+
+/// <summary>
+/// Options which are passed on when parsing a database.
+/// </summary>
+class DllExport LoadOptions {
+
+public:
+	FieldProjection fields;
+	QSharedPointer<TextStore> textStore;	// if set, texts are kept on disk
+	QSharedPointer<PolygonStore> polygons;	// if set, region polygons are kept
+};
+
 class DllExport Region : public BaseElement {
 
 public:
@@ -86,25 +152,38 @@ public:
 	};
 
 	Region(Type type = type_unknown, const QSize& s = QSize());
+	Region(Type type, const QRect& r, int polygonIdx = -1, bool hasPosition = true);
 
 	QSize size() const;
+	QRect rect() const;
+	bool hasPosition() const;
+	Type type() const;
+	int polygonIndex() const;
+	static QString typeName(const Type& type);
 	
 	// properties
 	double area() const;
 	double width() const;
 	double height() const;
 
+	static Type typeFromName(const QStringRef& name);
+
 	static Region fromJson(const QJsonObject& jo);
+	static Region fromJson(JsonStreamReader& reader, QString* points = 0);
+	QJsonObject toJson() const;
+	void toJson(JsonStreamWriter& writer, const QPolygon& polygon = QPolygon()) const;
 
 private:
-	QSize mSize;
+	QRect mRect;			// the bounding box (the origin is 0 if unknown)
 	Type mType;
+	int mPolygonIdx = -1;	// index in the collection's PolygonStore
+	bool mHasPosition = false;	// false if only the size is known
 };
 
 class DllExport ImageData : public BaseElement {
 
 public:
-	ImageData();
+	ImageData(const QString& fileName = QString(), const QSize& size = QSize());
 
 	QString name() const;
 	int width() const;
@@ -126,16 +205,38 @@ public:
 	QVector<QSharedPointer<Region> > regions() const;
 	QString name() const;
 	QString text() const;
+	int textLength() const;
+	bool hasText() const;
 	QString collectionName() const;
 
 	ImageData image() const;
+	QPolygon polygon(int regionIdx) const;
 	double averageRegion(std::function<double(const Region&)> prop) const;
 
-	static PageData fromJson(const QJsonObject& jo);
+	static PageData fromJson(const QJsonObject& jo, const LoadOptions& options = LoadOptions());
+	static PageData fromJson(JsonStreamReader& reader, const LoadOptions& options = LoadOptions());
+	static PageData fromPageXml(
+		const QByteArray& xml, 
+		const QString& xmlName, 
+		const QString& documentName, 
+		const QString& collectionName, 
+		const LoadOptions& options = LoadOptions(),
+		bool* isPage = 0,
+		QString* error = 0);
+	QJsonObject toJson() const;
+	void toJson(JsonStreamWriter& writer, const FieldProjection& fields = FieldProjection()) const;
+
+	void writeRegions(QDataStream& ds) const;
+	bool readRegions(QDataStream& ds);
+	void evict(QSharedPointer<TextStore> textStore);
+	qint64 memorySize() const;
 
 private:
 	QString mXmlFilePath;
 	QString mContent;
+	QSharedPointer<TextStore> mTextStore;	// if set, the text is kept on disk
+	int mTextId = -1;
+	QSharedPointer<PolygonStore> mPolygons;	// if set, region polygons are kept
 	ImageData mImg;
 	QString mDocumentName;
 	QString mCollectionName;
@@ -177,21 +278,33 @@ public:
 	QMap<QString, int> dictionary();
 	float dictionaryDistance(Document& doc);
 
-	static Document fromJson(const QJsonObject& jo);
+	void addPages(const QVector<QSharedPointer<PageData> >& pages);
+	void setPages(const QVector<QSharedPointer<PageData> >& pages);
+
+	QString source() const;
+	void setSource(const QString& filePath);
+
+	static Document fromJson(const QJsonObject& jo, const LoadOptions& options = LoadOptions());
+	static Document fromJson(JsonStreamReader& reader, const LoadOptions& options = LoadOptions());
+	QJsonObject toJson() const;
+	void toJson(JsonStreamWriter& writer, const FieldProjection& fields = FieldProjection()) const;
+	void toJson(JsonStreamWriter& writer, const QVector<int>& pageIdx, const FieldProjection& fields = FieldProjection()) const;
 
 private:
 	void createDictionary();
 
 	QVector<QSharedPointer<PageData> > mPages;
 	QMap<QString, int> mDictionary;
+	QString mSource;	// the shard the document was loaded from
 };
 
 class DllExport Collection : public BaseCollection {
 
 public:
-	Collection(const QString& name = "");
+	Collection(const QString& name = "", const LoadOptions& options = LoadOptions());
 
-	static Collection fromJson(const QJsonObject& jo, const QString& name = "");
+	static Collection fromJson(const QJsonObject& jo, const QString& name = "", const LoadOptions& options = LoadOptions());
+	static Collection fromJson(JsonStreamReader& reader, const QString& name = "", const LoadOptions& options = LoadOptions());
 
 	bool isEmpty() const override;
 
@@ -199,6 +312,43 @@ public:
 	int numDocuments() const;
 	QVector<QSharedPointer<PageData> > pages() const override;
 	QVector<QSharedPointer<Document> > documents() const;
+	void addDocument(QSharedPointer<Document> document);
+	void replaceDocuments(int firstDoc, int numRemoved, const QVector<QSharedPointer<Document> >& documents);
+	void replacePages(int docIdx, int firstPage, int numRemoved, const QVector<QSharedPointer<PageData> >& pages);
+
+	void toJson(JsonStreamWriter& writer, const QVector<int>& pageIdx = QVector<int>()) const;
+	bool write(const QString& filePath, const QVector<int>& pageIdx = QVector<int>()) const;
+	QVector<int> selectedPages() const;
+	QSharedPointer<TextStore> textStore() const;
+	QSharedPointer<PolygonStore> polygons() const;
+	FieldProjection fields() const;
+	bool hasRegionPositions() const;
+
+	QString filePath() const;
+	void setFilePath(const QString& filePath);
+
+	QSharedPointer<RegionStatistics> regionStatistics() const;
+	QSharedPointer<LayoutStatistics> layoutStatistics() const;
+	QSharedPointer<RegionDistribution> regionDistribution() const;
+	QSharedPointer<PrincipalComponents> principalComponents() const;
+	QSharedPointer<NeighborIndex> neighborIndex() const;
+	QSharedPointer<FeatureCache> featureCache() const;
+
+	cv::Mat embedding() const;
+	void setEmbedding(const cv::Mat& embedding);
+
+	QSharedPointer<KMeans> clustering() const;
+	void setClustering(QSharedPointer<KMeans> clustering);
+	int cluster(int pageIdx) const;
+
+	void clearCache();
+
+	qint64 evict();
+	bool restore() const;
+	bool isEvicted() const;
+	qint64 memorySize() const;
+	qint64 diskSize() const;
+	QString memoryString() const;
 
 	QString toString() const override;
 	
@@ -207,8 +357,24 @@ public:
 private:
 	int numRegions() const;
 	int numTextPages() const;
+	void splice(int firstPage, int numRemoved, const QVector<QSharedPointer<PageData> >& added, int firstDoc, int numDocsRemoved, int numDocsAdded);
 
 	QVector<QSharedPointer<Document> > mDocuments;
+	QSharedPointer<TextStore> mTextStore;
+	QSharedPointer<PolygonStore> mPolygons;
+	FieldProjection mFields;
+	QString mFilePath;		// the database (if loaded from a local file)
+
+	mutable QSharedPointer<RegionStatistics> mRegionStats;	// cached
+	mutable QSharedPointer<LayoutStatistics> mLayoutStats;	// cached
+	mutable QSharedPointer<RegionDistribution> mRegionDist;	// cached
+	mutable QSharedPointer<PrincipalComponents> mComponents;	// cached
+	mutable QSharedPointer<NeighborIndex> mNeighbors;	// cached
+	mutable QSharedPointer<FeatureCache> mFeatureCache;
+	mutable int mRegionPositions = -1;	// 1 if all region positions are known (-1 if not checked yet)
+	cv::Mat mEmbedding;		// pages x 2 (see TsneEmbedding)
+	QSharedPointer<KMeans> mClustering;
+	mutable QSharedPointer<QTemporaryFile> mRegionSpill;	// the regions if the collection is evicted
 };
 
 }
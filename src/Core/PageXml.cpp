@@ -0,0 +1,219 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+
+#include "PageXml.h"
+#include "Utils.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <opencv2/core.hpp>
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- PageXmlIngester 
+	PageXmlIngester::PageXmlIngester(const QString & dirPath) {
+		mDirPath = dirPath;
+	}
+
+	/// <summary>
+	/// Crawls the directory and parses all PAGE XML files.
+	/// XML files which are not PAGE (e.g. METS or Transkribus' doc.xml)
+	/// are silently ignored, corrupt PAGE files are reported.
+	/// </summary>
+	/// <returns>true if at least one page was found.</returns>
+	bool PageXmlIngester::ingest() {
+
+		Timer dt;
+
+		QStringList files = crawl(mDirPath);
+
+		if (files.isEmpty()) {
+			qWarning() << "[PageXmlIngester] no xml files found in" << mDirPath;
+			return false;
+		}
+
+		QString cName = QFileInfo(mDirPath).fileName();
+		QVector<QSharedPointer<PageData> > pages(files.size());
+		QVector<QString> docNames(files.size());
+
+		// NOTE: get raw pointers to prevent detaching in the threads
+		QSharedPointer<PageData>* pp = pages.data();
+		QString* dp = docNames.data();
+		QMutex mutex;
+
+		// small stripes balance varying file sizes
+		double numStripes = qMax(files.size() / 64.0, 1.0);
+
+		cv::parallel_for_(cv::Range(0, files.size()), [&](const cv::Range& r) {
+
+			for (int idx = r.start; idx < r.end; idx++) {
+
+				const QString& fp = files[idx];
+				QFile f(fp);
+
+				if (!f.open(QIODevice::ReadOnly)) {
+					QMutexLocker l(&mutex);
+					mFailedFiles << fp;
+					continue;
+				}
+
+				bool isPage = false;
+				QString error;
+				dp[idx] = documentName(fp);
+
+				PageData pd = PageData::fromPageXml(f.readAll(), QFileInfo(fp).fileName(), dp[idx], cName, mOptions, &isPage, &error);
+
+				if (!error.isEmpty()) {
+					qWarning() << "[PageXmlIngester]" << fp << error;
+					QMutexLocker l(&mutex);
+					mFailedFiles << fp;
+				}
+				else if (isPage)
+					pp[idx] = QSharedPointer<PageData>::create(pd);
+			}
+		}, numStripes);
+
+		// files are sorted - so pages of a document are contiguous
+		mCollection = QSharedPointer<Collection>::create(cName, mOptions);
+
+		QSharedPointer<Document> doc;
+		QVector<QSharedPointer<PageData> > docPages;
+
+		for (int idx = 0; idx <= pages.size(); idx++) {
+
+			if (idx < pages.size() && !pages[idx])
+				continue;
+
+			if (doc && (idx == pages.size() || docNames[idx] != doc->name())) {
+				doc->setPages(docPages);
+				doc->setColor(ColorManager::color(doc->numPages()));
+				mCollection->addDocument(doc);
+				doc.clear();
+				docPages.clear();
+			}
+
+			if (idx == pages.size())
+				break;
+
+			if (!doc)
+				doc = QSharedPointer<Document>::create(docNames[idx]);
+
+			docPages << pages[idx];
+		}
+
+		if (!mFailedFiles.isEmpty())
+			qWarning() << "[PageXmlIngester]" << mFailedFiles.size() << "files could not be parsed";
+
+		qInfo() << "[PageXmlIngester]" << mCollection->numPages() << "pages of" << files.size() << "xml files ingested in" << dt;
+
+		return !mCollection->isEmpty();
+	}
+
+	/// <summary>
+	/// Sets the fields which are parsed and the text store.
+	/// </summary>
+	void PageXmlIngester::setOptions(const LoadOptions & options) {
+		mOptions = options;
+	}
+
+	QSharedPointer<Collection> PageXmlIngester::collection() const {
+		return mCollection;
+	}
+
+	/// <summary>
+	/// Returns the PAGE files which could not be read or parsed.
+	/// </summary>
+	QStringList PageXmlIngester::failedFiles() const {
+		return mFailedFiles;
+	}
+
+	/// <summary>
+	/// Returns all xml files in the directory tree (sorted).
+	/// </summary>
+	/// <param name="dirPath">The root directory.</param>
+	QStringList PageXmlIngester::crawl(const QString & dirPath) {
+
+		QStringList files;
+		QDirIterator it(dirPath, QStringList() << "*.xml", QDir::Files, QDirIterator::Subdirectories);
+
+		while (it.hasNext())
+			files << it.next();
+
+		// keep the order of documents and pages reproducible
+		files.sort();
+
+		return files;
+	}
+
+	/// <summary>
+	/// Writes the collection as PIE database.
+	/// Pages are streamed by Collection::write().
+	/// </summary>
+	/// <param name="collection">The collection.</param>
+	/// <param name="filePath">The database's file path.</param>
+	/// <returns>true on success.</returns>
+	bool PageXmlIngester::write(const Collection & collection, const QString & filePath) {
+
+		return collection.write(filePath);
+	}
+
+	/// <summary>
+	/// Returns the document of a page.
+	/// The document is the page's directory relative to the root.
+	/// Transkribus' page folders are omitted.
+	/// </summary>
+	QString PageXmlIngester::documentName(const QString & filePath) const {
+
+		QString dn = QDir(mDirPath).relativeFilePath(QFileInfo(filePath).path());
+
+		if (dn == "page")
+			dn = ".";
+		else if (dn.endsWith("/page"))
+			dn.chop(5);
+
+		// pages in the root folder
+		if (dn == ".")
+			dn = QFileInfo(mDirPath).fileName();
+
+		return dn;
+	}
+
+}
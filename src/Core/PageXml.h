@@ -0,0 +1,92 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+
+#pragma once
+
+#include "PageData.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QString>
+#include <QStringList>
+#include <QSharedPointer>
+#pragma warning(pop)
+
+#pragma warning (disable: 4251)	// inlined Qt functions in dll interface
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+
+namespace pie {
+
+/// <summary>
+/// Builds a collection from a directory tree of PAGE XML files
+/// (e.g. a Transkribus export). Files are parsed in parallel
+/// by a streaming XML reader, so no DOM is ever created.
+/// Pages are grouped into documents by their directory:
+///		export/doc_a/page/0001.xml -> document "doc_a"
+/// Useage:
+///		PageXmlIngester pi("C:/exports/my-collection");
+///		if (pi.ingest())
+///			PageXmlIngester::write(*pi.collection(), "C:/temp/db.json");
+/// </summary>
+class DllExport PageXmlIngester {
+
+public:
+	PageXmlIngester(const QString& dirPath = QString());
+
+	bool ingest();
+
+	void setOptions(const LoadOptions& options);
+	QSharedPointer<Collection> collection() const;
+	QStringList failedFiles() const;
+
+	static QStringList crawl(const QString& dirPath);
+	static bool write(const Collection& collection, const QString& filePath);
+
+private:
+	QString documentName(const QString& filePath) const;
+
+	QString mDirPath;
+	LoadOptions mOptions;
+
+	QSharedPointer<Collection> mCollection;
+	QStringList mFailedFiles;
+};
+
+}
@@ -39,6 +39,8 @@
 #include "ActionManager.h"
 #include "Utils.h"
 #include "WidgetManager.h"
+#include "DatabaseWatcher.h"
+#include "PlotWidgets.h"
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QTabBar>
@@ -50,6 +52,8 @@
 #include <QDir>
 #include <QAction>
 #include <QMenuBar>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
 
 #pragma warning(pop)
 
@@ -80,6 +84,7 @@ namespace pie {
 
 		// connects
 		connect(this, SIGNAL(tabCloseRequested(int)), this, SLOT(removeTab(int)));
+		connect(this, SIGNAL(currentChanged(int)), this, SLOT(updateMemoryInfo()));
 		connect(&dm, SIGNAL(loadFileSignal(const QString&)), this, SLOT(loadFile(const QString&)));
 		
 		connect(am.action(ActionManager::view_new_tab), SIGNAL(triggered()), this, SLOT(newTab()));
@@ -126,23 +131,103 @@ namespace pie {
 
 	}
 
+	/// <summary>
+	/// Starts loading a database.
+	/// Databases are parsed in the background and the tab
+	/// is added once the database is parsed (or the first
+	/// pages of a remote database arrived).
+	/// </summary>
+	/// <param name="filePath">The database, manifest, folder or url.</param>
+	/// <returns>false if another database is being loaded.</returns>
 	bool TabWidget::loadFile(const QString & filePath) {
 
-		DatabaseLoader db(filePath);
-		
-		if (db.parse()) {
+		// e.g. a file was dropped while another database is loaded
+		if (mLoading)
+			return false;
+
+		QSharedPointer<DatabaseLoader> db = QSharedPointer<DatabaseLoader>::create(filePath);
+		db->setLazyText(Settings::instance().app().lazyText);
+		db->setFields(FieldProjection::fromString(Settings::instance().app().loadFields));
+		db->setSampleSize(Settings::instance().app().sampleSize);
+
+		// sharded databases report each loaded shard
+		ProgressWidget* progress = new ProgressWidget(this);
+		progress->setMessage(tr("Loading %1").arg(QFileInfo(filePath).fileName()));
+		progress->hide();
+		setCornerWidget(progress, Qt::TopRightCorner);
+		connect(progress, &ProgressWidget::cancelSignal, progress, [db]() { db->cancel(); });
+
+		// NOTE: the callback is called from worker threads
+		db->setProgressCallback([progress](int numLoaded, int numShards) {
+			QMetaObject::invokeMethod(progress, "setProgress", Qt::QueuedConnection, Q_ARG(int, numLoaded), Q_ARG(int, numShards));
+			QMetaObject::invokeMethod(progress, "show", Qt::QueuedConnection);
+		});
+
+		QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+
+		connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, progress, db]() {
+
+			// pending updates are discarded
+			setCornerWidget(0, Qt::TopRightCorner);
+			delete progress;
+
+			mLoading = false;
+			addDatabase(db, watcher->result());
+			watcher->deleteLater();
+		});
+
+		mLoading = true;
+		watcher->setFuture(QtConcurrent::run([db]() { return db->parse(); }));
+
+		return true;
+	}
+
+	/// <summary>
+	/// Adds a tab which shows a parsed database.
+	/// </summary>
+	/// <param name="db">The loader which parsed the database.</param>
+	/// <param name="parsed">The result of DatabaseLoader::parse().</param>
+	void TabWidget::addDatabase(QSharedPointer<DatabaseLoader> db, bool parsed) {
+
+		QString filePath = db->filePath();
+		QSharedPointer<ProgressiveLoader> pl = db->progressiveLoader();
+
+		// remote databases are empty until their first pages arrived
+		if (parsed && pl && db->collection()->numPages() == 0 && !pl->isFinished()) {
+
+			QSharedPointer<QMetaObject::Connection> c(new QMetaObject::Connection());
+			*c = connect(pl.data(), &ProgressiveLoader::collectionChanged, this, [this, db, c]() {
+				disconnect(*c);
+				addDatabase(db, true);
+			});
+
+			pl->start();
+			return;
+		}
+
+		// e.g. the server was not reachable
+		if (parsed && pl && db->collection()->numPages() == 0)
+			parsed = false;
+
+		if (parsed) {
 			Settings::instance().app().addRecentFile(filePath);
 		}
 		else {
 			// TODO: add error
 			qDebug() << "could not parse" << filePath;
-			return false;
+			return;
 		}
 
-		PlotWidget* pw = new PlotWidget(db.collection(), this);
+		PlotWidget* pw = new PlotWidget(db->collection(), this);
 		addTab(pw, pw->title(), true);
 
-		return true;
+		// show the sample first & load the rest in the background
+		if (db->progressiveLoader())
+			pw->setLoader(db->progressiveLoader());
+
+		// apply changes (e.g. appended documents) of local databases
+		if (Settings::instance().app().watchFiles && QFileInfo(filePath).exists())
+			pw->setWatcher(QSharedPointer<DatabaseWatcher>::create(db->collection(), filePath));
 	}
 
 	int TabWidget::addTab(QWidget* w, const QString& info, bool selected) {
@@ -176,6 +261,21 @@ namespace pie {
 			newTab();
 	}
 
+	/// <summary>
+	/// Shows the memory used by each tab in its tooltip.
+	/// Hidden tabs were evicted (if needed) when the current tab changed.
+	/// </summary>
+	void TabWidget::updateMemoryInfo() {
+
+		for (int idx = 0; idx < count(); idx++) {
+
+			PlotWidget* pw = qobject_cast<PlotWidget*>(widget(idx));
+
+			if (pw)
+				setTabToolTip(idx, pw->title() + "\n" + pw->memoryString());
+		}
+	}
+
 	bool TabWidget::loadFromMime(const QMimeData * mimeData) {
 
 		if (mimeData->hasUrls()) {
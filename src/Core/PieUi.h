@@ -34,6 +34,7 @@
 #pragma warning(push, 0)	// no warnings from includes
 #include <QTabWidget>
 #include <QMainWindow>
+#include <QSharedPointer>
 #pragma warning(pop)
 
 #pragma warning (disable: 4251)	// inlined Qt functions in dll interface
@@ -54,6 +55,7 @@ namespace pie {
 // read defines
 
 	class PlotWidget;
+	class DatabaseLoader;
 
 	class DllExport TabWidget : public QTabWidget {
 		Q_OBJECT
@@ -67,12 +69,16 @@ namespace pie {
 		int addTab(QWidget* w, const QString& info = tr("New Tab"), bool selected = false);
 		void newTab();
 		bool loadFile(const QString& filePath);
+		void updateMemoryInfo();
 
 	private:
 		void dragEnterEvent(QDragEnterEvent* ev);
 		void dropEvent(QDropEvent* ev);
 
 		bool loadFromMime(const QMimeData* mimeData);
+		void addDatabase(QSharedPointer<DatabaseLoader> db, bool parsed);
+
+		bool mLoading = false;	// true while a database is parsed in the background
 	};
 
 	class DllExport MainWindow : public QMainWindow {
@@ -36,6 +36,13 @@
 #include "ViewPort.h"
 #include "PlotWidgets.h"
 #include "Settings.h"
+#include "PageData.h"
+#include "DatabaseLoader.h"
+#include "DatabaseWatcher.h"
+#include "Embedding.h"
+#include "Clustering.h"
+#include "Processor.h"
+#include "MemoryBudget.h"
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QGridLayout>
@@ -45,6 +52,13 @@
 #include <QDrag>
 #include <QMimeData>
 #include <QObject>
+#include <QInputDialog>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
 #pragma warning(pop)
 
 namespace pie {
@@ -78,11 +92,14 @@ namespace pie {
 	void DotPlotParams::copyTo(DotPlotParams* o) const {
 
 		if (o) {
-			DotPlotParams::copyTo(o);
+			PlotParams::copyTo(o);
 
 			o->setPointSize(mPointSize);
 			o->setAlpha(mPointAlpha);
 			o->setDisplayPercent(mDisplayPercent);
+			o->setColorIndex(mColorIndex);
+			o->setColorMap(mColorMap);
+			o->setColorRange(mColorRange);
 		}
 	}
 
@@ -93,6 +110,9 @@ namespace pie {
 		settings.setValue("displayPercent", mDisplayPercent);
 		settings.setValue("pointAlpha", mPointAlpha);
 		settings.setValue("pointSize", mPointSize);
+		settings.setValue("colorIndex", mColorIndex);
+		settings.setValue("colorMap", mColorMap);
+		settings.setValue("colorRange", mColorRange);
 	}
 
 	void DotPlotParams::load(QSettings& settings) {
@@ -102,6 +122,9 @@ namespace pie {
 		mDisplayPercent = settings.value("displayPercent", mDisplayPercent).toInt();
 		mPointAlpha = settings.value("pointAlpha", mPointAlpha).toInt();
 		mPointSize = settings.value("pointSize", mPointSize).toInt();
+		mColorIndex = settings.value("colorIndex", mColorIndex).toInt();
+		mColorMap = settings.value("colorMap", mColorMap).toInt();
+		mColorRange = settings.value("colorRange", mColorRange).toPointF();
 	}
 
 	int DotPlotParams::pointSize() const {
@@ -148,6 +171,103 @@ namespace pie {
 		if (ts)		emit displayPercentChanged(displayPercent);
 	}
 
+	int DotPlotParams::colorIndex() const {
+		return mColorIndex;
+	}
+
+	void DotPlotParams::setColorIndex(int colorIndex) {
+
+		bool tS = mColorIndex != colorIndex;
+		mColorIndex = colorIndex;
+
+		if (tS)		emit colorIndexChanged(colorIndex);
+	}
+
+	int DotPlotParams::colorMap() const {
+		return mColorMap;
+	}
+
+	void DotPlotParams::setColorMap(int colorMap) {
+
+		bool tS = mColorMap != colorMap;
+		mColorMap = colorMap;
+
+		if (tS)		emit colorMapChanged(colorMap);
+	}
+
+	QPointF DotPlotParams::colorRange() const {
+		return mColorRange;
+	}
+
+	/// <summary>
+	/// Sets the range of the colormap.
+	/// The range is given in normalized feature values where
+	/// 0 is the feature's minimum and 1 its maximum.
+	/// </summary>
+	void DotPlotParams::setColorRange(const QPointF & colorRange) {
+
+		bool tS = mColorRange != colorRange;
+		mColorRange = colorRange;
+
+		if (tS)		emit colorRangeChanged(colorRange);
+	}
+
+	// HistPlotParams --------------------------------------------------------------------
+	HistPlotParams::HistPlotParams(QObject* parent) : PlotParams(parent) {
+
+		mMode = m_hist;
+	}
+
+	void HistPlotParams::copyTo(HistPlotParams* o) const {
+
+		if (o) {
+			PlotParams::copyTo(o);
+
+			o->setNumBins(mNumBins);
+			o->setStacked(mStacked);
+		}
+	}
+
+	void HistPlotParams::save(QSettings& settings) const {
+
+		PlotParams::save(settings);
+
+		settings.setValue("numBins", mNumBins);
+		settings.setValue("stacked", mStacked);
+	}
+
+	void HistPlotParams::load(QSettings& settings) {
+
+		PlotParams::load(settings);
+
+		mNumBins = settings.value("numBins", mNumBins).toInt();
+		mStacked = settings.value("stacked", mStacked).toBool();
+	}
+
+	int HistPlotParams::numBins() const {
+		return mNumBins;
+	}
+
+	void HistPlotParams::setNumBins(int numBins) {
+
+		bool tS = mNumBins != numBins;
+		mNumBins = qMax(numBins, 1);
+
+		if (tS)		emit numBinsChanged(mNumBins);
+	}
+
+	bool HistPlotParams::stacked() const {
+		return mStacked;
+	}
+
+	void HistPlotParams::setStacked(bool stacked) {
+
+		bool tS = mStacked != stacked;
+		mStacked = stacked;
+
+		if (tS)		emit stackedChanged(stacked);
+	}
+
 	// DotPlot --------------------------------------------------------------------
 	DotPlot::DotPlot(QSharedPointer<Collection> collection, QWidget* parent /* = 0 */) : BasePlot(parent) {
 
@@ -159,9 +279,16 @@ namespace pie {
 
 		createLayout();
 
+		mXAxisLabel->setCollection(collection);
+		mYAxisLabel->setCollection(collection);
+		mXAxisLabel->setTransform(mP->axisTransform().x());
+		mYAxisLabel->setTransform(mP->axisTransform().y());
+
 		// viewport connects
 		connect(mXAxisLabel, SIGNAL(changeAxisIndex(const QPoint&)), mViewPort, SLOT(setAxisIndex(const QPoint&)));
 		connect(mYAxisLabel, SIGNAL(changeAxisIndex(const QPoint&)), mViewPort, SLOT(setAxisIndex(const QPoint&)));
+		connect(mXAxisLabel, SIGNAL(changeAxisTransform(const QPoint&)), mViewPort, SLOT(setAxisTransform(const QPoint&)));
+		connect(mYAxisLabel, SIGNAL(changeAxisTransform(const QPoint&)), mViewPort, SLOT(setAxisTransform(const QPoint&)));
 	}
 
 	void DotPlot::createLayout() {
@@ -219,9 +346,33 @@ namespace pie {
 	}
 
 	void DotPlot::setAxisIndex(const QPoint& index) {
+
+		FeatureRegistry& fr = FeatureRegistry::instance();
+
+		if (index.x() >= 0)
+			mXAxisLabel->setText(fr.feature(index.x()).name());
+		if (index.y() >= 0)
+			mYAxisLabel->setText(fr.feature(index.y()).name());
+
 		mViewPort->setAxisIndex(index);
 	}
 
+	void DotPlot::setCorrelation(double r) {
+		mViewPort->setCorrelation(r);
+	}
+
+	void DotPlot::updateData() {
+		mViewPort->updateData();
+	}
+
+	void DotPlot::releaseData() {
+		mViewPort->releaseData();
+	}
+
+	QVector<int> DotPlot::pickedPages() const {
+		return mViewPort->pickedPages();
+	}
+
 	QPoint DotPlot::axisIndex() const {
 		return (mP) ? mP->axisIndex() : QPoint();
 	}
@@ -282,6 +433,88 @@ namespace pie {
 		return mMenuButton;
 	}
 
+	// HistPlot --------------------------------------------------------------------
+	HistPlot::HistPlot(QSharedPointer<Collection> collection, QWidget* parent /* = 0 */) : BasePlot(parent) {
+
+		mP = new HistPlotParams(this);
+		setObjectName("HistPlot");
+
+		mViewPort = new HistViewPort(collection, mP, this);
+		mViewPort->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::MinimumExpanding);
+
+		createLayout();
+
+		mXAxisLabel->setCollection(collection);
+		mXAxisLabel->setTransform(mP->axisTransform().x());
+
+		// viewport connects
+		connect(mXAxisLabel, SIGNAL(changeAxisIndex(const QPoint&)), mViewPort, SLOT(setAxisIndex(const QPoint&)));
+		connect(mXAxisLabel, SIGNAL(changeAxisTransform(const QPoint&)), mViewPort, SLOT(setAxisTransform(const QPoint&)));
+	}
+
+	void HistPlot::createLayout() {
+
+		mXAxisLabel = new AxisButton(tr("Select"), Qt::Horizontal, this);
+		mXAxisLabel->setObjectName("axisLabel");
+
+		mMenuButton = new MenuButton(this);
+		mMenuButton->setPlotParams(mP);
+
+		// dummy widget which gives us space for focus effect
+		QWidget* selectionBorder = new QWidget(this);
+		selectionBorder->setFixedHeight(2);
+
+		QWidget* labelWidget = new QWidget(this);
+		QHBoxLayout* labelLayout = new QHBoxLayout(labelWidget);
+		labelLayout->setContentsMargins(0, 0, 0, 0);
+		labelLayout->addWidget(mMenuButton);
+		labelLayout->addWidget(mXAxisLabel);
+
+		QVBoxLayout* vL = new QVBoxLayout(this);
+		vL->setSpacing(0);
+		vL->setContentsMargins(0, 0, 0, 0);
+		vL->addWidget(selectionBorder);
+		vL->addWidget(mViewPort);
+		vL->addWidget(labelWidget);
+	}
+
+	void HistPlot::update() {
+
+		mViewPort->update();
+		BasePlot::update();
+	}
+
+	void HistPlot::setAxisIndex(const QPoint& index) {
+
+		if (index.x() >= 0)
+			mXAxisLabel->setText(FeatureRegistry::instance().feature(index.x()).name());
+
+		// histograms have a single axis
+		mViewPort->setAxisIndex(QPoint(index.x(), -1));
+	}
+
+	void HistPlot::updateData() {
+		mViewPort->updateData();
+	}
+
+	void HistPlot::releaseData() {
+		mViewPort->releaseData();
+	}
+
+	QPoint HistPlot::axisIndex() const {
+		return (mP) ? mP->axisIndex() : QPoint();
+	}
+
+	void HistPlot::setSelected(bool selected) {
+
+		mViewPort->setSelected(selected);
+		BasePlot::setSelected(selected);
+	}
+
+	MenuButton * HistPlot::menuButton() const {
+		return mMenuButton;
+	}
+
 	// DkGlobalPlotParams --------------------------------------------------------------------
 	GlobalPlotParams::GlobalPlotParams() {
 
@@ -441,6 +674,225 @@ namespace pie {
 		return mCollection->name();
 	}
 
+	/// <summary>
+	/// Starts loading the remaining pages.
+	/// Plots are refined whenever new pages arrive.
+	/// </summary>
+	/// <param name="loader">The loader which holds the pages that are not sampled.</param>
+	void PlotWidget::setLoader(QSharedPointer<ProgressiveLoader> loader) {
+
+		mLoader = loader;
+
+		if (mLoader) {
+			connect(mLoader.data(), SIGNAL(collectionChanged()), this, SLOT(updateData()));
+			connect(mLoader.data(), SIGNAL(finished()), this, SLOT(releaseMemory()));
+			mLoader->start();
+		}
+	}
+
+	/// <summary>
+	/// Watches the collection's database.
+	/// Plots are updated whenever pages are appended or changed.
+	/// Watching starts once all pages are loaded.
+	/// </summary>
+	/// <param name="watcher">The watcher of the collection's database.</param>
+	void PlotWidget::setWatcher(QSharedPointer<DatabaseWatcher> watcher) {
+
+		mWatcher = watcher;
+
+		if (!mWatcher)
+			return;
+
+		connect(mWatcher.data(), SIGNAL(collectionChanged()), this, SLOT(updateData()));
+
+		if (mLoader && !mLoader->isFinished())
+			connect(mLoader.data(), SIGNAL(finished()), mWatcher.data(), SLOT(start()));
+		else
+			mWatcher->start();
+	}
+
+	void PlotWidget::updateData() {
+
+		// released plots are updated when they are shown
+		if (mReleased)
+			return;
+
+		for (BasePlot* p : mPlots)
+			p->updateData();
+
+		mLegendWidget->updateList();
+	}
+
+	/// <summary>
+	/// Starts the t-SNE embedding of the collection.
+	/// A new plot shows the embedding while it converges.
+	/// </summary>
+	void PlotWidget::computeEmbedding() {
+
+		// the action is shared by all tabs
+		if (!isVisible())
+			return;
+
+		if (mEmbedding && mEmbedding->isRunning())
+			return;
+
+		if (mLoader && !mLoader->isFinished()) {
+			qInfo() << "please wait until all pages are loaded before computing the embedding";
+			return;
+		}
+
+		if (!mEmbedding) {
+			mEmbedding = QSharedPointer<TsneEmbedding>::create(mCollection);
+			connect(mEmbedding.data(), SIGNAL(embeddingChanged()), this, SLOT(updateEmbedding()));
+			connect(mEmbedding.data(), SIGNAL(progress(int, int)), mProgressWidget, SLOT(setProgress(int, int)));
+			connect(mEmbedding.data(), SIGNAL(finished()), mProgressWidget, SLOT(hide()));
+			connect(mEmbedding.data(), SIGNAL(finished()), this, SLOT(releaseMemory()));
+			connect(mProgressWidget, SIGNAL(cancelSignal()), mEmbedding.data(), SLOT(cancel()));
+		}
+
+		FeatureRegistry& fr = FeatureRegistry::instance();
+		addPlot();
+		mPlots.last()->setAxisIndex(QPoint(fr.id("tsne_1"), fr.id("tsne_2")));
+
+		mProgressWidget->setMessage(tr("t-SNE"));
+		mProgressWidget->setProgress(0, mEmbedding->params().maxIter);
+		mProgressWidget->show();
+
+		mEmbedding->start();
+	}
+
+	/// <summary>
+	/// Updates all plots which show the embedding.
+	/// </summary>
+	void PlotWidget::updateEmbedding() {
+
+		FeatureRegistry& fr = FeatureRegistry::instance();
+		const int embedding = fr.providerId("embedding");
+
+		// the cached embedding columns are outdated
+		for (const Feature& f : fr.features()) {
+			if (f.provider() == embedding)
+				mCollection->featureCache()->invalidate(f.id());
+		}
+
+		for (BasePlot* p : mPlots) {
+
+			QPoint idx = p->axisIndex();
+
+			if (fr.feature(idx.x()).provider() == embedding || fr.feature(idx.y()).provider() == embedding)
+				p->updateData();
+		}
+	}
+
+	/// <summary>
+	/// Clusters all pages by k-means in the background.
+	/// Plots and the legend show the clusters once it finished (see applyClustering()).
+	/// </summary>
+	void PlotWidget::clusterPages() {
+
+		// the action is shared by all tabs
+		if (!isVisible())
+			return;
+
+		if (mLoader && !mLoader->isFinished()) {
+			qInfo() << "please wait until all pages are loaded before clustering";
+			return;
+		}
+
+		if (mClustering->isRunning()) {
+			qInfo() << "please wait until the pages are clustered";
+			return;
+		}
+
+		bool ok = false;
+		int k = QInputDialog::getInt(this, tr("Cluster Pages"), tr("Number of clusters:"), 8, 2, 20, 1, &ok);
+
+		if (!ok)
+			return;
+
+		// features are computed in the GUI thread - the collection might change later on
+		QVector<int> ids = FeatureRegistry::instance().baseFeatures(*mCollection);
+		QVector<AxisTransform> ts(ids.size(), AxisTransform(AxisTransform::t_robust_z));
+		cv::Mat fm = AbstractMapper::processAll(mCollection.data(), ids, &ts);
+
+		mClustering->setFuture(QtConcurrent::run([fm, k, ids]() {
+
+			Timer dt;
+
+			// k-means wants a row per page
+			KMeans km = KMeans::compute(cv::Mat(fm.t()), k);
+			km.setFeatures(ids);
+
+			qInfo().noquote() << km.toString() << "computed in" << dt;
+
+			return km;
+		}));
+	}
+
+	/// <summary>
+	/// Shows the clusters computed by clusterPages().
+	/// </summary>
+	void PlotWidget::applyClustering() {
+
+		KMeans km = mClustering->result();
+
+		// pages were added while we were running
+		if (km.numPages() != mCollection->numPages())
+			return;
+
+		mCollection->setClustering(QSharedPointer<KMeans>::create(km));
+		mLegendWidget->updateList();
+
+		// update() is shadowed by the plots
+		for (BasePlot* p : mPlots)
+			QMetaObject::invokeMethod(p, "update");
+	}
+
+	/// <summary>
+	/// Writes the pages of the selected documents to a new database.
+	/// </summary>
+	void PlotWidget::exportSelection() {
+
+		// the action is shared by all tabs
+		if (!isVisible())
+			return;
+
+		if (mLoader && !mLoader->isFinished()) {
+			qInfo() << "please wait until all pages are loaded before exporting";
+			return;
+		}
+
+		// selected documents and the pages picked in plots (with their similar pages)
+		QVector<int> pageIdx = mCollection->selectedPages();
+
+		for (BasePlot* p : mPlots)
+			pageIdx << p->pickedPages();
+
+		std::sort(pageIdx.begin(), pageIdx.end());
+		pageIdx.erase(std::unique(pageIdx.begin(), pageIdx.end()), pageIdx.end());
+
+		if (pageIdx.isEmpty()) {
+			qInfo() << "please select documents or pick pages you want to export first";
+			return;
+		}
+
+		QString filePath = QFileDialog::getSaveFileName(
+			this, 
+			tr("Export Selection"), 
+			QFileInfo(mCollection->filePath()).absolutePath(),
+			tr("Collection (*.json)"));
+
+		if (filePath.isEmpty())
+			return;
+
+		QApplication::setOverrideCursor(Qt::WaitCursor);
+		bool ok = mCollection->write(filePath, pageIdx);
+		QApplication::restoreOverrideCursor();
+
+		if (ok)
+			Settings::instance().app().addRecentFile(filePath);
+	}
+
 	void PlotWidget::createLayout() {
 
 		// holds everything & is put into the scroll area (for correct scrolling)
@@ -456,6 +908,12 @@ namespace pie {
 		mLegendWidget = new LegendWidget(mCollection, this);
 		mLegendWidget->hide();
 
+		mProgressWidget = new ProgressWidget(this);
+		mProgressWidget->hide();
+
+		mClustering = new QFutureWatcher<KMeans>(this);
+		connect(mClustering, SIGNAL(finished()), this, SLOT(applyClustering()));
+
 		ResizableScrollArea* scrollArea = new ResizableScrollArea(this);
 		scrollArea->setObjectName("ScrollAreaPlots");
 		scrollArea->setWidgetResizable(true);
@@ -464,13 +922,20 @@ namespace pie {
 
 		QVBoxLayout* layout = new QVBoxLayout(this);
 		layout->setContentsMargins(0, 0, 0, 0);
+		layout->addWidget(mProgressWidget);
 		layout->addWidget(scrollArea);
 
 		ActionManager& m = ActionManager::instance();
+		connect(m.action(m.tools_compute_embedding), SIGNAL(triggered()), this, SLOT(computeEmbedding()));
+		connect(m.action(m.tools_cluster_pages), SIGNAL(triggered()), this, SLOT(clusterPages()));
+		connect(m.action(m.file_export_selection), SIGNAL(triggered()), this, SLOT(exportSelection()));
 		connect(m.action(m.edit_add_dot_plot), SIGNAL(triggered()), this, SLOT(addPlot()));
+		connect(m.action(m.edit_add_hist_plot), SIGNAL(triggered()), this, SLOT(addHistPlot()));
+		connect(m.action(m.edit_add_splom), SIGNAL(triggered()), this, SLOT(addSplom()));
 		connect(m.action(m.edit_select_all), SIGNAL(triggered(bool)), this, SLOT(selectAll(bool)));
 
 		connect(mNewPlotWidget, SIGNAL(newDotPlotSignal()), this, SLOT(addPlot()));
+		connect(mNewPlotWidget, SIGNAL(newHistPlotSignal()), this, SLOT(addHistPlot()));
 
 		connect(GlobalPlotParams::instance().params(), SIGNAL(numColumnsChanged(int)), this, SLOT(setNumColumns(int)));
 		//connect(DkGlobalPlotParams::instance().params(), SIGNAL(loadPlotsSignal(const QString&)), this, SLOT(loadPlots(const QString&)));
@@ -511,6 +976,72 @@ namespace pie {
 			updateLayout();
 	}
 
+	void PlotWidget::addHistPlot(bool update) {
+
+		HistPlot* plot = new HistPlot(mCollection, this);
+		plot->hide();
+
+		connectPlot(plot);
+		mPlots.append(plot);
+
+		if (update)
+			updateLayout();
+	}
+
+	/// <summary>
+	/// Adds a scatter plot matrix of the features selected by the user.
+	/// Histograms are shown on the diagonal and the scatter plots show
+	/// Pearson's r. All plots share the collection's feature columns,
+	/// which are computed once together with the correlation matrix.
+	/// </summary>
+	void PlotWidget::addSplom() {
+
+		// the action is shared by all tabs
+		if (!isVisible())
+			return;
+
+		FeatureDialog d(*mCollection, this);
+
+		if (d.exec() != QDialog::Accepted)
+			return;
+
+		QVector<int> ids = d.features();
+
+		if (ids.size() < 2) {
+			qInfo() << "please select at least two features for a scatter plot matrix";
+			return;
+		}
+
+		// the mappers' transforms (default: same as new plots)
+		QVector<AxisTransform> ts(ids.size());
+
+		QApplication::setOverrideCursor(Qt::WaitCursor);
+		cv::Mat r = mCollection->featureCache()->correlation(ids, ts);
+
+		for (int row = 0; row < ids.size(); row++) {
+			for (int col = 0; col < ids.size(); col++) {
+
+				if (row == col) {
+					addHistPlot(false);
+					mPlots.last()->setAxisIndex(QPoint(ids[col], -1));
+				}
+				else {
+					addPlot(false);
+					DotPlot* p = static_cast<DotPlot*>(mPlots.last());
+					p->setAxisIndex(QPoint(ids[col], ids[row]));
+
+					if (!r.empty())
+						p->setCorrelation(r.at<double>(row, col));
+				}
+			}
+		}
+		QApplication::restoreOverrideCursor();
+
+		// one matrix row per grid row
+		mNumColumns = ids.size();
+		updateLayout();
+	}
+
 	void PlotWidget::connectPlot(BasePlot* plot) {
 
 		connect(plot, SIGNAL(closeSignal()), this, SLOT(removePlot()));
@@ -527,7 +1058,7 @@ namespace pie {
 
 	void PlotWidget::shiftSelection(bool selected) {
 
-		DotPlot* pw = dynamic_cast<DotPlot*>(QObject::sender());
+		BasePlot* pw = dynamic_cast<BasePlot*>(QObject::sender());
 
 		if (!pw)
 			return;
@@ -583,7 +1114,7 @@ namespace pie {
 
 	void PlotWidget::removePlot() {
 
-		DotPlot* w = dynamic_cast<DotPlot*>(QObject::sender());
+		BasePlot* w = dynamic_cast<BasePlot*>(QObject::sender());
 
 		if (!w) {
 			qWarning() << "Could not cast to BasePlot on close request...";
@@ -601,7 +1132,7 @@ namespace pie {
 
 	void PlotWidget::singlePlot() {
 
-		DotPlot* plot = dynamic_cast<DotPlot*>(QObject::sender());
+		BasePlot* plot = dynamic_cast<BasePlot*>(QObject::sender());
 
 		if (!plot) {
 			qWarning() << "illegal object called singlePlot()";
@@ -641,7 +1172,14 @@ namespace pie {
 
 
 		if (show) {
-			// TODO: we can save RAM here...
+			// evicted regions are paged in again
+			MemoryBudget::instance().acquire(mCollection);
+
+			if (mReleased) {
+				mReleased = false;
+				updateData();
+			}
+
 			//DkBasicGLWidget* vp = DkGlobalPlotParams::instance().baseViewPort();
 			//vp->setFcs(mFcs);
 
@@ -654,6 +1192,40 @@ namespace pie {
 		}
 
 		QWidget::setVisible(show);
+
+		if (!show)
+			releaseMemory();
+	}
+
+	/// <summary>
+	/// Allows the MemoryBudget to evict the collection while the tab is hidden.
+	/// Collections are not released while pages are loaded or embedded.
+	/// </summary>
+	void PlotWidget::releaseMemory() {
+
+		if (isVisible())
+			return;
+
+		if ((mLoader && !mLoader->isFinished()) || (mEmbedding && mEmbedding->isRunning()))
+			return;
+
+		// the columns are only freed if no plot references them
+		if (!mReleased) {
+
+			for (BasePlot* p : mPlots)
+				p->releaseData();
+
+			mReleased = true;
+		}
+
+		MemoryBudget::instance().release(mCollection);
+	}
+
+	/// <summary>
+	/// Returns the memory report of the tab's collection.
+	/// </summary>
+	QString PlotWidget::memoryString() const {
+		return mCollection->memoryString();
 	}
 
 	//void PlotWidget::savePlots(const QString & name) {
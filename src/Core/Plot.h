@@ -51,15 +51,22 @@
 // Qt defines
 class QGridLayout;
 class QMimeData;
+template <typename T> class QFutureWatcher;
 
 namespace pie {
 
 	// pie defines
 	class DotViewPort;
+	class HistViewPort;
 	class MenuButton;
 	class AxisButton;
 	class NewPlotWidget;
 	class LegendWidget;
+	class ProgressiveLoader;
+	class DatabaseWatcher;
+	class TsneEmbedding;
+	class KMeans;
+	class ProgressWidget;
 
 	class DllExport DotPlotParams : public PlotParams {
 		Q_OBJECT
@@ -80,22 +87,66 @@ namespace pie {
 		int displayPercent() const;
 		int alpha() const;
 
+		int colorIndex() const;
+		int colorMap() const;
+		QPointF colorRange() const;
+
 	public slots:
 		void setPointSize(int pointSize);
 		void setDisplayPercent(int displayPercent);
 		void setAlpha(int alpha);
 		void setAlphaPercent(int alpha);
+		void setColorIndex(int colorIndex);
+		void setColorMap(int colorMap);
+		void setColorRange(const QPointF& colorRange);
 
 	signals:
 		void pointSizeChanged(int pointSize = 1) const;
 		void displayPercentChanged(int displayPercent = 100) const;
 		void pointAlphaChanged(int alpha = 255) const;
+		void colorIndexChanged(int colorIndex = -1) const;
+		void colorMapChanged(int colorMap = 0) const;
+		void colorRangeChanged(const QPointF& colorRange = QPointF(0, 1)) const;
 
 	protected:
 
 		int mDisplayPercent = 100;
 		int mPointSize = 1;
 		int mPointAlpha = 255;
+
+		int mColorIndex = -1;					// the feature which colors the points (-1 = documents)
+		int mColorMap = 0;						// ColorManager::ColorMap
+		QPointF mColorRange = QPointF(0, 1);	// the colormap's range in normalized feature values [0 1]
+	};
+
+	class DllExport HistPlotParams : public PlotParams {
+		Q_OBJECT
+
+	public:
+		HistPlotParams(QObject* parent);
+		virtual ~HistPlotParams() {}
+
+		using PlotParams::copyTo;
+		virtual void copyTo(HistPlotParams* o) const;
+
+		virtual void save(QSettings& settings) const;
+		virtual void load(QSettings& settings);
+
+		int numBins() const;
+		bool stacked() const;
+
+	public slots:
+		void setNumBins(int numBins);
+		void setStacked(bool stacked);
+
+	signals:
+		void numBinsChanged(int numBins = 64) const;
+		void stackedChanged(bool stacked = true) const;
+
+	protected:
+
+		int mNumBins = 64;
+		bool mStacked = true;	// stacked or overlaid series
 	};
 
 	class DllExport GlobalPlotParams {
@@ -139,11 +190,15 @@ namespace pie {
 		MenuButton* menuButton() const;
 
 		 QPoint axisIndex() const;
+		QVector<int> pickedPages() const override;
 		void setFullScreen(bool fullScreen) override;
 		void setSelected(bool selected) override;
+		void setCorrelation(double r);
 
 	public slots:
 		void setAxisIndex(const QPoint& index) override;
+		void updateData() override;
+		void releaseData() override;
 		void setMinimumSize(const QSize& size);
 		void update();
 
@@ -160,6 +215,34 @@ namespace pie {
 		MenuButton* mMenuButton;
 	};
 
+	class DllExport HistPlot : public BasePlot {
+		Q_OBJECT
+
+	public:
+		HistPlot(QSharedPointer<Collection> collection, QWidget* parent = 0);
+		virtual ~HistPlot() {}
+
+		MenuButton* menuButton() const;
+
+		QPoint axisIndex() const override;
+		void setSelected(bool selected) override;
+
+	public slots:
+		void setAxisIndex(const QPoint& index) override;
+		void updateData() override;
+		void releaseData() override;
+		void update();
+
+	protected:
+		void createLayout();
+
+		AxisButton* mXAxisLabel;
+		HistViewPort* mViewPort;
+
+		HistPlotParams* mP;
+		MenuButton* mMenuButton;
+	};
+
 	class PlotWidget : public Widget {
 		Q_OBJECT
 
@@ -168,15 +251,28 @@ namespace pie {
 		virtual ~PlotWidget();
 
 		QString title() const;
+		void setLoader(QSharedPointer<ProgressiveLoader> loader);
+		void setWatcher(QSharedPointer<DatabaseWatcher> watcher);
+		QString memoryString() const;
 		//void clear();
 
 	public slots:
 		virtual void setVisible(bool show) override;
 		void setNumColumns(int numColumns = -1);
 		void addPlot(bool update = true);
+		void addHistPlot(bool update = true);
+		void addSplom();
 		void removePlot();
 		void singlePlot();
 
+		void updateData();
+		void computeEmbedding();
+		void updateEmbedding();
+		void clusterPages();
+		void applyClustering();
+		void exportSelection();
+		void releaseMemory();
+
 		void selectAll(bool selected = true);
 		void selectPlots(bool selected = true, int from = 0, int to = -1);
 		void clearSelection();
@@ -206,12 +302,18 @@ namespace pie {
 
 		NewPlotWidget* mNewPlotWidget = 0;
 		LegendWidget* mLegendWidget = 0;	// *ary
+		ProgressWidget* mProgressWidget = 0;
 
 		int mLastShiftIdx = -1;
 		int mNumColumns = 3;
 		QGridLayout* oLayout;
 
 		QSharedPointer<Collection> mCollection;
+		QSharedPointer<ProgressiveLoader> mLoader;
+		QSharedPointer<DatabaseWatcher> mWatcher;
+		QSharedPointer<TsneEmbedding> mEmbedding;
+		QFutureWatcher<KMeans>* mClustering = 0;
+		bool mReleased = false;		// true if the plots released their columns (see releaseMemory())
 	};
 
 }
\ No newline at end of file
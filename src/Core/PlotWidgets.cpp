@@ -33,6 +33,7 @@
 #include "Utils.h"
 #include "Processor.h"
 #include "PageData.h"
+#include "Clustering.h"
 #include "GeneralWidgets.h"
 
 #pragma warning(disable: 4714)	// disable force inline warnings from Qt
@@ -52,6 +53,11 @@
 #include <QCheckBox>
 #include <QApplication>
 #include <QDataStream>
+#include <QActionGroup>
+#include <QProgressBar>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QDialogButtonBox>
 #pragma warning(pop)
 
 
@@ -61,6 +67,23 @@ namespace pie {
 	AxisButton::AxisButton(const QString& text, Qt::Orientation orientation, QWidget* parent) : OrButton(text, orientation, parent) {
 	}
 
+	/// <summary>
+	/// Sets the collection which is plotted.
+	/// Features it cannot compute (see Feature::isAvailable) are disabled.
+	/// </summary>
+	/// <param name="collection">The collection.</param>
+	void AxisButton::setCollection(QSharedPointer<Collection> collection) {
+		mCollection = collection;
+	}
+
+	/// <summary>
+	/// Sets the transform which is checked in the menu.
+	/// </summary>
+	/// <param name="mode">The AxisTransform::Mode.</param>
+	void AxisButton::setTransform(int mode) {
+		mTransform = mode;
+	}
+
 	void AxisButton::mousePressEvent(QMouseEvent *ev) {
 	
 		OrButton::mousePressEvent(ev);
@@ -83,15 +106,37 @@ namespace pie {
 	void AxisButton::openMenu(const QPoint& pos) {
 
 		QMenu* m = new QMenu(tr("Axis"), this);
+		QMap<QString, QMenu*> groups;
 
-		for (int idx = 0; idx < AbstractMapper::m_end; idx++) {
+		for (const Feature& f : FeatureRegistry::instance().features()) {
 
-			auto map = AbstractMapper::create((AbstractMapper::Type)idx);
+			// features are grouped by their data source
+			QMenu* gm = groups.value(f.group());
 
-			QAction* a = new QAction(map->name(), this);
-			a->setData(idx);
+			if (!gm) {
+				gm = m->addMenu(f.group());
+				groups.insert(f.group(), gm);
+			}
+
+			QAction* a = new QAction(f.name(), this);
+			a->setData(f.id());
+			a->setEnabled(!mCollection || f.isAvailable(*mCollection));
 			connect(a, SIGNAL(triggered()), this, SLOT(actionClicked()));
-			m->addAction(a);
+			gm->addAction(a);
+		}
+
+		m->addSeparator();
+		QMenu* tm = m->addMenu(tr("Transform"));
+		QActionGroup* tg = new QActionGroup(tm);
+
+		for (int t = 0; t < AxisTransform::t_end; t++) {
+
+			QAction* a = new QAction(AxisTransform::name((AxisTransform::Mode)t), tg);
+			a->setData(t);
+			a->setCheckable(true);
+			a->setChecked(t == mTransform);
+			connect(a, SIGNAL(triggered()), this, SLOT(transformClicked()));
+			tm->addAction(a);
 		}
 
 		m->exec(pos);
@@ -119,6 +164,24 @@ namespace pie {
 		emit changeAxisIndex(p);
 	}
 
+	void AxisButton::transformClicked() {
+
+		QAction* action = static_cast<QAction*>(this->sender());
+
+		if (!action)
+			return;
+
+		QPoint p(-1, -1);
+		mTransform = action->data().toInt();
+
+		if (mOrientation == Qt::Horizontal)
+			p.setX(mTransform);
+		else
+			p.setY(mTransform);
+
+		emit changeAxisTransform(p);
+	}
+
 	// MenuButton --------------------------------------------------------------------
 	MenuButton::MenuButton(QWidget* parent /* = 0 */) : QPushButton(parent) {
 
@@ -199,15 +262,24 @@ namespace pie {
 		dotPlotButton->setFlat(true);
 		dotPlotButton->setObjectName("newPlotButton");
 
+		QPixmap pmh(":/pie/img/hist-plot.png");
+		pmh = ColorManager::colorizePixmap(pmh, ColorManager::blue());
+		QPushButton* histPlotButton = new QPushButton(pmh, tr(""), this);
+		histPlotButton->setIconSize(QSize(64, 64));
+		histPlotButton->setFlat(true);
+		histPlotButton->setObjectName("newPlotButton");
+
 		QGridLayout* layout = new QGridLayout(this);
 		layout->setRowStretch(0, 10);
 		layout->setColumnStretch(0, 10);
 		layout->addWidget(newPlotLabel, 1, 1, 1, 2, Qt::AlignHCenter);
-		layout->addWidget(dotPlotButton, 2, 2, 1, 2, Qt::AlignHCenter);
+		layout->addWidget(dotPlotButton, 2, 1, Qt::AlignHCenter);
+		layout->addWidget(histPlotButton, 2, 2, Qt::AlignHCenter);
 		layout->setRowStretch(10, 10);
 		layout->setColumnStretch(10, 10);
 
 		connect(dotPlotButton, SIGNAL(clicked()), this, SIGNAL(newDotPlotSignal()));
+		connect(histPlotButton, SIGNAL(clicked()), this, SIGNAL(newHistPlotSignal()));
 	}
 
 	// -------------------------------------------------------------------- DocumentItem 
@@ -231,12 +303,31 @@ namespace pie {
 		return mDoc;
 	}
 
+	// -------------------------------------------------------------------- ClusterItem 
+	ClusterItem::ClusterItem(int cluster, int numPages, QListWidget* parent) : QListWidgetItem(parent) {
+
+		mCluster = cluster;
+
+		QPixmap colIcon(32, 32);
+		QPainter p(&colIcon);
+		p.setPen(Qt::NoPen);
+		p.setBrush(ColorManager::color(cluster));
+		p.drawRect(colIcon.rect());
+
+		setText(QObject::tr("Cluster %1").arg(cluster + 1) + " [" + QString::number(numPages) + "]");
+		setIcon(colIcon);
+	}
+
+	int ClusterItem::cluster() const {
+		return mCluster;
+	}
+
 	// -------------------------------------------------------------------- LegendWidget 
 	LegendWidget::LegendWidget(QSharedPointer<Collection> collection, QWidget* parent) : Widget(parent) {
 		
 		mCollection = collection;
 		createLayout();
-		updateList(collection);
+		updateList();
 	}
 
 	void LegendWidget::contextMenuEvent(QContextMenuEvent * ev) {
@@ -300,11 +391,111 @@ namespace pie {
 		connect(mLegendList, &QListWidget::itemDoubleClicked, this, doubleClickEvent);
 	}
 
-	void LegendWidget::updateList(QSharedPointer<Collection> col) {
+	void LegendWidget::updateList() {
 
-		for (auto d : col->documents()) {
+		// page counts change if pages are loaded progressively
+		mLegendList->clear();
+
+		// plots are colored by cluster
+		QSharedPointer<KMeans> km = mCollection->clustering();
+		if (km) {
+
+			QVector<int> counts = km->counts();
+			for (int idx = 0; idx < counts.size(); idx++)
+				mLegendList->addItem(new ClusterItem(idx, counts[idx], mLegendList));
+
+			return;
+		}
+
+		for (auto d : mCollection->documents()) {
 
 			mLegendList->addItem(new DocumentItem(d, mLegendList));
 		}
 	}
+
+	// ProgressWidget --------------------------------------------------------------------
+	ProgressWidget::ProgressWidget(QWidget* parent) : Widget(parent) {
+		createLayout();
+	}
+
+	void ProgressWidget::setProgress(int value, int maximum) {
+
+		mProgress->setMaximum(maximum);
+		mProgress->setValue(value);
+	}
+
+	void ProgressWidget::setMessage(const QString & msg) {
+		mProgress->setFormat(msg + " %p%");
+	}
+
+	void ProgressWidget::createLayout() {
+
+		mProgress = new QProgressBar(this);
+		mProgress->setTextVisible(true);
+
+		QPushButton* cancelButton = new QPushButton(tr("Cancel"), this);
+		connect(cancelButton, SIGNAL(clicked()), this, SIGNAL(cancelSignal()));
+
+		QHBoxLayout* layout = new QHBoxLayout(this);
+		layout->setContentsMargins(0, 0, 0, 0);
+		layout->addWidget(mProgress);
+		layout->addWidget(cancelButton);
+	}
+
+	// -------------------------------------------------------------------- FeatureDialog 
+	FeatureDialog::FeatureDialog(const Collection& collection, QWidget* parent) : QDialog(parent) {
+
+		setWindowTitle(tr("Select Features"));
+		createLayout(collection);
+	}
+
+	void FeatureDialog::setChecked(const QVector<int>& ids) {
+
+		for (int idx = 0; idx < mList->count(); idx++) {
+			QListWidgetItem* item = mList->item(idx);
+			item->setCheckState(ids.contains(item->data(Qt::UserRole).toInt()) ? Qt::Checked : Qt::Unchecked);
+		}
+	}
+
+	/// <summary>
+	/// Returns the ids of all checked features.
+	/// </summary>
+	QVector<int> FeatureDialog::features() const {
+
+		QVector<int> ids;
+
+		for (int idx = 0; idx < mList->count(); idx++) {
+
+			QListWidgetItem* item = mList->item(idx);
+
+			if (item->checkState() == Qt::Checked)
+				ids << item->data(Qt::UserRole).toInt();
+		}
+
+		return ids;
+	}
+
+	void FeatureDialog::createLayout(const Collection& collection) {
+
+		mList = new QListWidget(this);
+
+		for (const Feature& f : FeatureRegistry::instance().features()) {
+
+			if (!f.isAvailable(collection))
+				continue;
+
+			QListWidgetItem* item = new QListWidgetItem(f.group() + ": " + f.name(), mList);
+			item->setData(Qt::UserRole, f.id());
+			item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+			item->setCheckState(Qt::Unchecked);
+		}
+
+		QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+		connect(buttons, SIGNAL(accepted()), this, SLOT(accept()));
+		connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+
+		QVBoxLayout* layout = new QVBoxLayout(this);
+		layout->addWidget(mList);
+		layout->addWidget(buttons);
+	}
 }
@@ -36,6 +36,7 @@
 #pragma warning(push, 0)	// no warnings from includes
 #include <QPixmap>
 #include <QListWidgetItem>
+#include <QDialog>
 #pragma warning(pop)
 
 #pragma warning(disable: 4251)	// disable dll interface warning
@@ -53,6 +54,7 @@ class QCheckBox;
 class QGridLayout;
 class QSettings;
 class QMimeData;
+class QProgressBar;
 class QListWidget;
 
 namespace pie {
@@ -67,17 +69,25 @@ namespace pie {
 	public:
 		AxisButton(const QString& text = QString(), Qt::Orientation orientation = Qt::Horizontal, QWidget* parent = 0);
 
+		void setCollection(QSharedPointer<Collection> collection);
+		void setTransform(int mode);
+
 	public slots:
 		void actionClicked();
+		void transformClicked();
 
 	signals:
 		void changeAxisIndex(const QPoint& idx) const;
+		void changeAxisTransform(const QPoint& mode) const;
 
 	protected:
 		void mousePressEvent(QMouseEvent *ev);
 		void mouseReleaseEvent(QMouseEvent *ev);
 		void contextMenuEvent(QContextMenuEvent *ev);
 		void openMenu(const QPoint& pos);
+
+		QSharedPointer<Collection> mCollection;	// features it cannot compute are disabled
+		int mTransform = 0;							// AxisTransform::Mode
 	};
 
 	class DllExport MenuButton : public QPushButton {
@@ -111,6 +121,7 @@ namespace pie {
 
 	signals:
 		void newDotPlotSignal();
+		void newHistPlotSignal();
 
 	protected:
 		void createLayout();
@@ -127,21 +138,73 @@ namespace pie {
 		QSharedPointer<Document> mDoc;
 	};
 
+	class DllExport ClusterItem : public QListWidgetItem {
+
+	public:
+		ClusterItem(int cluster, int numPages, QListWidget* parent = 0);
+
+		int cluster() const;
+
+	private:
+		int mCluster = -1;
+	};
+
 	class DllExport LegendWidget : public Widget {
 		Q_OBJECT
 
 	public:
 		LegendWidget(QSharedPointer<Collection> collection, QWidget* parent = 0);
 
+	public slots:
+		void updateList();
+
 	signals:
 		void updateSignal();
 
 	private:
 		void contextMenuEvent(QContextMenuEvent* ev) override;
 		void createLayout();
-		void updateList(QSharedPointer<Collection> col);
 
 		QListWidget* mLegendList = 0;
 		QSharedPointer<Collection> mCollection;
 	};
+
+	class DllExport ProgressWidget : public Widget {
+		Q_OBJECT
+
+	public:
+		ProgressWidget(QWidget* parent = 0);
+
+	public slots:
+		void setProgress(int value, int maximum);
+		void setMessage(const QString& msg);
+
+	signals:
+		void cancelSignal() const;
+
+	private:
+		void createLayout();
+
+		QProgressBar* mProgress = 0;
+	};
+
+	/// <summary>
+	/// Lets the user check several features (e.g. for a scatter plot matrix).
+	/// Features which are not available in the collection (e.g. their
+	/// fields were not loaded) are not listed.
+	/// </summary>
+	class DllExport FeatureDialog : public QDialog {
+		Q_OBJECT
+
+	public:
+		FeatureDialog(const Collection& collection, QWidget* parent = 0);
+
+		void setChecked(const QVector<int>& ids);
+		QVector<int> features() const;
+
+	private:
+		void createLayout(const Collection& collection);
+
+		QListWidget* mList = 0;
+	};
 }
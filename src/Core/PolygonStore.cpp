@@ -0,0 +1,312 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+
+#include "PolygonStore.h"
+#include "Utils.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QDebug>
+#include <QDir>
+#include <QMutexLocker>
+#include <QtEndian>
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- PolygonStore 
+	PolygonStore::PolygonStore() : mSpill(QDir::tempPath() + "/pie-polygons-XXXXXX.bin") {
+	}
+
+	/// <summary>
+	/// Appends all polygons of a buffer (e.g. the coords of a page).
+	/// The store is locked once for the whole buffer.
+	/// </summary>
+	/// <param name="polys">The polygons.</param>
+	/// <returns>The index of the first polygon.</returns>
+	int PolygonStore::add(const PolygonBuffer & polys) {
+
+		QMutexLocker lock(&mMutex);
+
+		int first = mOffsets.size();
+
+		for (int idx = 0; idx < polys.size(); idx++)
+			append(polys.points(idx), polys.numPoints(idx));
+
+		return first;
+	}
+
+	/// <summary>
+	/// Appends a single polygon.
+	/// </summary>
+	/// <returns>The polygon's index.</returns>
+	int PolygonStore::add(const QPolygon & poly) {
+
+		QMutexLocker lock(&mMutex);
+
+		append(poly.constData(), poly.size());
+
+		return mOffsets.size() - 1;
+	}
+
+	/// <summary>
+	/// Decodes a polygon.
+	/// </summary>
+	/// <param name="idx">The index returned by add().</param>
+	/// <returns>The polygon or an empty polygon if idx is illegal.</returns>
+	QPolygon PolygonStore::polygon(int idx) const {
+
+		QMutexLocker lock(&mMutex);
+
+		if (idx < 0 || idx >= mOffsets.size())
+			return QPolygon();
+
+		QPair<int, int> r = range(idx);
+		const int numBytes = r.second - r.first;
+
+		if (numBytes == 0 || !pageIn(idx / block_size))
+			return QPolygon();
+
+		const bool wide = isWide(idx);
+		const char* b = mBlocks[idx / block_size].constData() + r.first;
+		const int n = 1 + (numBytes - 8) / (wide ? 8 : 4);
+
+		QPolygon poly(n);
+		QPoint* p = poly.data();
+
+		int x = qFromLittleEndian<qint32>((const uchar*)b);
+		int y = qFromLittleEndian<qint32>((const uchar*)b + 4);
+		p[0] = QPoint(x, y);
+		b += 8;
+
+		if (wide) {
+			for (int pIdx = 1; pIdx < n; pIdx++, b += 8) {
+				x += qFromLittleEndian<qint32>((const uchar*)b);
+				y += qFromLittleEndian<qint32>((const uchar*)b + 4);
+				p[pIdx] = QPoint(x, y);
+			}
+		}
+		else {
+			for (int pIdx = 1; pIdx < n; pIdx++, b += 4) {
+				x += qFromLittleEndian<qint16>((const uchar*)b);
+				y += qFromLittleEndian<qint16>((const uchar*)b + 2);
+				p[pIdx] = QPoint(x, y);
+			}
+		}
+
+		return poly;
+	}
+
+	/// <summary>
+	/// Returns the number of points without decoding the polygon.
+	/// </summary>
+	int PolygonStore::numPoints(int idx) const {
+
+		QMutexLocker lock(&mMutex);
+
+		if (idx < 0 || idx >= mOffsets.size())
+			return 0;
+
+		QPair<int, int> r = range(idx);
+		const int numBytes = r.second - r.first;
+
+		return numBytes == 0 ? 0 : 1 + (numBytes - 8) / (isWide(idx) ? 8 : 4);
+	}
+
+	int PolygonStore::size() const {
+
+		QMutexLocker lock(&mMutex);
+		return mOffsets.size();
+	}
+
+	/// <summary>
+	/// Returns the number of bytes allocated by the store.
+	/// </summary>
+	qint64 PolygonStore::memorySize() const {
+
+		QMutexLocker lock(&mMutex);
+
+		qint64 s = (qint64)mOffsets.capacity() * sizeof(quint32);
+
+		for (const QByteArray& b : mBlocks)
+			s += b.capacity();
+
+		return s;
+	}
+
+	/// <summary>
+	/// Writes all blocks to the spill file and frees them.
+	/// Blocks which were paged in and did not change are not written again.
+	/// </summary>
+	/// <returns>The number of bytes freed.</returns>
+	qint64 PolygonStore::evict() {
+
+		QMutexLocker lock(&mMutex);
+
+		if (mBlocks.isEmpty())
+			return 0;
+
+		if (!mSpill.isOpen() && !mSpill.open()) {
+			qCritical() << "[PolygonStore] cannot open spill file" << mSpill.fileName();
+			return 0;
+		}
+
+		while (mSpillOffsets.size() < mBlocks.size())
+			mSpillOffsets << -1;
+
+		qint64 freed = 0;
+
+		for (int bIdx = 0; bIdx < mBlocks.size(); bIdx++) {
+
+			QByteArray& b = mBlocks[bIdx];
+
+			if (b.isEmpty())
+				continue;
+
+			if (mSpillOffsets[bIdx] < 0) {
+
+				qint64 offset = mSpill.size();
+
+				if (!mSpill.seek(offset) || mSpill.write(b) != b.size()) {
+					qCritical() << "[PolygonStore] could not write to" << mSpill.fileName();
+					break;
+				}
+
+				mSpillOffsets[bIdx] = offset;
+			}
+
+			freed += b.capacity();
+			b = QByteArray();
+		}
+
+		return freed;
+	}
+
+	void PolygonStore::append(const QPoint * pts, int numPoints) {
+
+		// NOTE: the mutex is locked by the caller
+		if (mOffsets.size() % block_size == 0) {
+
+			// the previous block is complete
+			if (!mBlocks.isEmpty())
+				mBlocks.last().squeeze();
+
+			mBlocks << QByteArray();
+		}
+		else if (mBlocks.size() <= mSpillOffsets.size()) {
+
+			// the block grows - so its spilled copy is outdated
+			pageIn(mBlocks.size() - 1);
+			mSpillOffsets[mBlocks.size() - 1] = -1;
+		}
+
+		QByteArray& block = mBlocks.last();
+		bool wide = false;
+
+		for (int idx = 1; idx < numPoints; idx++) {
+
+			QPoint d = pts[idx] - pts[idx - 1];
+
+			if (d.x() != (qint16)d.x() || d.y() != (qint16)d.y()) {
+				wide = true;
+				break;
+			}
+		}
+
+		if (numPoints > 0) {
+
+			const int stride = wide ? 8 : 4;
+			int pos = block.size();
+
+			block.resize(pos + 8 + (numPoints - 1) * stride);
+			uchar* b = (uchar*)block.data() + pos;
+
+			qToLittleEndian<qint32>(pts[0].x(), b);
+			qToLittleEndian<qint32>(pts[0].y(), b + 4);
+			b += 8;
+
+			for (int idx = 1; idx < numPoints; idx++, b += stride) {
+
+				QPoint d = pts[idx] - pts[idx - 1];
+
+				if (wide) {
+					qToLittleEndian<qint32>(d.x(), b);
+					qToLittleEndian<qint32>(d.y(), b + 4);
+				}
+				else {
+					qToLittleEndian<qint16>((qint16)d.x(), b);
+					qToLittleEndian<qint16>((qint16)d.y(), b + 2);
+				}
+			}
+		}
+
+		mOffsets << ((quint32)block.size() | (wide ? 0x80000000u : 0u));
+	}
+
+	bool PolygonStore::isWide(int idx) const {
+		return (mOffsets[idx] & 0x80000000u) != 0;
+	}
+
+	/// <summary>
+	/// Returns the byte range of a polygon in its block.
+	/// </summary>
+	QPair<int, int> PolygonStore::range(int idx) const {
+
+		int end = (int)(mOffsets[idx] & 0x7fffffffu);
+		int start = idx % block_size == 0 ? 0 : (int)(mOffsets[idx - 1] & 0x7fffffffu);
+
+		return QPair<int, int>(start, end);
+	}
+
+	/// <summary>
+	/// Reads an evicted block from the spill file.
+	/// </summary>
+	/// <returns>false if the block could not be read.</returns>
+	bool PolygonStore::pageIn(int blockIdx) const {
+
+		// NOTE: the mutex is locked by the caller
+		if (blockIdx >= mSpillOffsets.size() || mSpillOffsets[blockIdx] < 0 || !mBlocks[blockIdx].isEmpty())
+			return true;
+
+		int last = qMin((blockIdx + 1) * block_size, mOffsets.size()) - 1;
+		int numBytes = (int)(mOffsets[last] & 0x7fffffffu);
+
+		if (!mSpill.seek(mSpillOffsets[blockIdx])) {
+			qWarning() << "[PolygonStore] cannot seek to" << mSpillOffsets[blockIdx];
+			return false;
+		}
+
+		mBlocks[blockIdx] = mSpill.read(numBytes);
+
+		return mBlocks[blockIdx].size() == numBytes;
+	}
+
+}
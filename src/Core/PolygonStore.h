@@ -0,0 +1,105 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QVector>
+#include <QByteArray>
+#include <QMutex>
+#include <QPolygon>
+#include <QPair>
+#include <QTemporaryFile>
+#pragma warning(pop)
+
+#pragma warning (disable: 4251)	// inlined Qt functions in dll interface
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+
+namespace pie {
+
+class PolygonBuffer;
+
+/// <summary>
+/// Keeps the region polygons of a collection in one arena.
+/// A polygon is stored as its first point (2 x int32) followed
+/// by the deltas to the previous point. Deltas are stored as
+/// int16 pairs unless one of them overflows, then the whole
+/// polygon is stored with int32 deltas.
+/// Polygons are grouped into blocks which are allocated once
+/// and only a 32 bit offset per polygon stays in RAM. Hence,
+/// a typical polygon needs ~4 bytes per point.
+/// Blocks can be evicted to a spill file, they are paged
+/// in again when one of their polygons is decoded.
+/// </summary>
+class DllExport PolygonStore {
+
+public:
+	PolygonStore();
+
+	int add(const PolygonBuffer& polys);
+	int add(const QPolygon& poly);
+
+	QPolygon polygon(int idx) const;
+	int numPoints(int idx) const;
+
+	int size() const;
+	qint64 memorySize() const;
+	qint64 evict();
+
+	enum {
+		block_size = 4096,	// polygons per block
+	};
+
+private:
+	void append(const QPoint* pts, int numPoints);
+	bool isWide(int idx) const;
+	QPair<int, int> range(int idx) const;
+	bool pageIn(int blockIdx) const;
+
+	mutable QMutex mMutex;
+	mutable QTemporaryFile mSpill;
+
+	mutable QVector<QByteArray> mBlocks;
+	QVector<quint32> mOffsets;	// the polygon's end in its block, the top bit is set for int32 deltas
+	QVector<qint64> mSpillOffsets;	// the block's offset in the spill file or -1 if it changed
+};
+
+}
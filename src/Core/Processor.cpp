@@ -30,12 +30,23 @@
  *******************************************************************************************************/
 
 #include "Processor.h"
+#include "Algorithm.h"
+#include "Embedding.h"
+#include "Utils.h"
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QDataStream>
+#include <QDir>
+#include <QTemporaryFile>
+#include <QMutex>
+#include <QMutexLocker>
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/imgproc/imgproc_c.h>
+
+#include <limits>
 #pragma warning(pop)
 
 namespace pie {
@@ -46,6 +57,22 @@ namespace pie {
 		return pd->numRegions();
 	}
 
+	double cmp::textLength(const PageData * pd) {
+
+		assert(pd);
+		return pd->textLength();
+	}
+
+	double cmp::aspectRatio(const PageData * pd) {
+
+		assert(pd);
+		
+		if (pd->image().height() == 0)
+			return 0.0;
+
+		return (double)pd->image().width() / pd->image().height();
+	}
+
 	bool test::Processor(const Collection& c) {
 
 		auto widths		= [&](const Region& r) { return r.width(); };
@@ -62,6 +89,150 @@ namespace pie {
 
 		return true;
 	}
+
+	namespace test {
+
+		/// <summary>
+		/// The statMoment implementation we had before Math::quantiles.
+		/// It is only kept as a reference for the benchmark.
+		/// NOTE: it reads values[idx + 1] which is out of bounds for even sizes
+		/// so the benchmark only uses odd sizes.
+		/// </summary>
+		template <typename numFmt>
+		double legacyStatMoment(const QList<numFmt>& valuesIn, double momentValue, bool interpolated = true) {
+
+			if (valuesIn.size() == 1)
+				return valuesIn[0];
+
+			if (valuesIn.size() == 2 && interpolated)
+				return (valuesIn[0] + valuesIn[1]) / 2.0;
+			else if (valuesIn.size() == 2)
+				return valuesIn[0];
+
+			QList<numFmt> values = valuesIn;
+			qSort(values);
+
+			size_t lSize = values.size();
+			double moment = -1;
+			unsigned int momIdx = cvCeil(lSize*momentValue);
+			unsigned int idx = 1;
+
+			for (auto val : values) {
+
+				if (idx < momIdx) {
+					idx++;
+					continue;
+				}
+
+				if (lSize % 2 == 0 && momIdx < lSize && interpolated)
+					moment = ((double)val + values[idx + 1])*0.5;
+				else
+					moment = (double)val;
+				break;
+			}
+
+			return moment;
+		}
+	}
+
+	/// <summary>
+	/// Checks Math::quantile against hand-computed values (even and
+	/// odd sizes, q = 0 and q = 1) and compares Math::quantiles to the
+	/// legacy statMoment. It reports the time needed to compute the
+	/// quartiles (q25, median, q75) of random sets.
+	/// </summary>
+	/// <returns>true if all values are as expected.</returns>
+	bool test::Quantiles() {
+
+		bool success = true;
+
+		// hand-computed values - even sizes interpolate with the successor
+		struct Case {
+			std::vector<float> values;
+			double q;
+			bool interpolated;
+			double expected;
+		};
+
+		const std::vector<Case> cases = {
+			{ { 4, 1, 3, 2 }, 0.5, true, 2.5 },
+			{ { 4, 1, 3, 2 }, 0.25, true, 1.5 },
+			{ { 4, 1, 3, 2 }, 0.75, true, 3.5 },
+			{ { 4, 1, 3, 2 }, 0.5, false, 2.0 },
+			{ { 4, 1, 3, 2 }, 0.0, true, 1.0 },
+			{ { 4, 1, 3, 2 }, 1.0, true, 4.0 },
+			{ { 8, 2 }, 0.5, true, 5.0 },
+			{ { 3, 1, 2 }, 0.5, true, 2.0 },
+			{ { 3, 1, 2 }, 0.0, true, 1.0 },
+			{ { 3, 1, 2 }, 1.0, true, 3.0 },
+			{ { 7 }, 0.5, true, 7.0 },
+			{ {}, 0.5, true, 0.0 },
+		};
+
+		for (const Case& c : cases) {
+
+			std::vector<float> v = c.values;
+			double val = Math::quantile(v.data(), v.size(), c.q, c.interpolated);
+
+			if (val != c.expected) {
+				qWarning() << "[Quantiles] n =" << c.values.size() << "q =" << c.q << "interpolated:" << c.interpolated
+					<< "expected:" << c.expected << "got:" << val;
+				success = false;
+			}
+		}
+
+		cv::RNG rng(42);
+		const double qs[3] = { 0.25, 0.5, 0.75 };
+		const int sizes[5] = { 15, 127, 1023, 16383, 262143 };	// odd - see legacyStatMoment
+
+		for (int size : sizes) {
+
+			// keep the total work about constant
+			int reps = qMax(1, 2000000 / size);
+
+			QList<float> list;
+			std::vector<float> values(size);
+			for (int idx = 0; idx < size; idx++) {
+				values[idx] = rng.uniform(0.0f, 1000.0f);
+				list << values[idx];
+			}
+
+			double legacy[3], current[3];
+			double checksum = 0;
+			QElapsedTimer t;
+
+			t.start();
+			for (int r = 0; r < reps; r++) {
+				for (int idx = 0; idx < 3; idx++)
+					legacy[idx] = legacyStatMoment(list, qs[idx]);
+				checksum += legacy[0];
+			}
+			qint64 tl = t.nsecsElapsed();
+
+			t.restart();
+			for (int r = 0; r < reps; r++) {
+				std::vector<float> v = values;	// the kernel reorders the span
+				Math::quantiles(v.data(), v.size(), qs, 3, current);
+				checksum += current[0];
+			}
+			qint64 tc = t.nsecsElapsed();
+
+			for (int idx = 0; idx < 3; idx++) {
+				if (legacy[idx] != current[idx]) {
+					qWarning() << "[Quantiles] size" << size << "q" << qs[idx] << "legacy:" << legacy[idx] << "current:" << current[idx];
+					success = false;
+				}
+			}
+
+			qInfo().nospace() << "[Quantiles] n=" << size
+				<< " legacy: " << tl / reps / 1000.0 << " us"
+				<< " quantiles: " << tc / reps / 1000.0 << " us"
+				<< " speed-up: " << (double)tl / qMax(tc, (qint64)1) << "x"
+				<< " (" << checksum << ")";
+		}
+
+		return success;
+	}
 	
 	// -------------------------------------------------------------------- DisplayConverter 
 	DisplayConverter::DisplayConverter(QSharedPointer<Collection> Collection) {
@@ -72,139 +243,2006 @@ namespace pie {
 		return mapper->process(mCollection.data());
 	}
 
-	// -------------------------------------------------------------------- Mapper 
-	AbstractMapper::AbstractMapper() {
+	// -------------------------------------------------------------------- FeatureProvider 
+	FeatureProvider::FeatureProvider(const QString & name, Extractor extractor) {
+		mName = name;
+		mExtractor = extractor;
 	}
 
-	QSharedPointer<AbstractMapper> AbstractMapper::create(const Type& type) {
+	bool FeatureProvider::isEmpty() const {
+		return !mExtractor;
+	}
 
-		switch (type) {
-		case m_reg_width:	return QSharedPointer<WidthMapper>::create();
-		case m_reg_height:	return QSharedPointer<HeightMapper>::create();
-		case m_reg_area:	return QSharedPointer<AreaMapper>::create();
-		case m_img_width:	return QSharedPointer<PageWidthMapper>::create();
-		case m_img_height:	return QSharedPointer<PageHeightMapper>::create();
-		case m_undefined:
-		case m_end: break;
-		}
+	QString FeatureProvider::name() const {
+		return mName;
+	}
 
-		if (type != m_undefined)
-			qWarning() << "[AbstractMapper] unknown type:" << type;
-		return QSharedPointer<AbstractMapper>();
+	/// <summary>
+	/// Returns the provider's values of all pages.
+	/// Models are cached by the collection, so this creates them once.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <returns>A row per feature and a column per page - empty if the model is not available.</returns>
+	cv::Mat FeatureProvider::extract(const Collection & c) const {
+
+		if (!mExtractor)
+			return cv::Mat();
+
+		return mExtractor(c);
 	}
 
-	AbstractMapper::Type AbstractMapper::type() const {
-		return mType;
+	/// <summary>
+	/// Returns true if the model is computed from other features (e.g. embeddings).
+	/// </summary>
+	bool FeatureProvider::isDerived() const {
+		return mDerived;
 	}
 
-	QString AbstractMapper::name() const {
+	void FeatureProvider::setDerived(bool derived) {
+		mDerived = derived;
+	}
+
+	/// <summary>
+	/// Returns true if the model can be computed for a collection.
+	/// </summary>
+	bool FeatureProvider::isAvailable(const Collection & c) const {
+		return !mCondition || mCondition(c);
+	}
+
+	/// <summary>
+	/// Sets a condition which the collection must fulfill
+	/// (e.g. layout features need the region positions).
+	/// </summary>
+	void FeatureProvider::setCondition(Condition condition) {
+		mCondition = condition;
+	}
+
+	// -------------------------------------------------------------------- Feature 
+	Feature::Feature() {
+	}
+
+	/// <summary>
+	/// Creates a page level feature.
+	/// </summary>
+	/// <param name="key">A unique key (e.g. "img_width").</param>
+	/// <param name="name">The display name.</param>
+	/// <param name="kernel">Computes the feature for a page.</param>
+	/// <param name="fields">The page fields which are read by the kernel.</param>
+	/// <returns>The feature.</returns>
+	Feature Feature::page(const QString & key, const QString & name, PageKernel kernel, const FieldProjection & fields) {
+
+		Feature f;
+		f.mKey = key;
+		f.mName = name;
+		f.mGroup = QObject::tr("Page");
+		f.mPageKernel = kernel;
+		f.mFields = fields;
+
+		return f;
+	}
+
+	/// <summary>
+	/// Creates a region level feature.
+	/// The kernel is evaluated for each region and
+	/// the median is assigned to the page.
+	/// </summary>
+	/// <param name="key">A unique key (e.g. "reg_width").</param>
+	/// <param name="name">The display name.</param>
+	/// <param name="kernel">Computes the feature for a region.</param>
+	/// <returns>The feature.</returns>
+	Feature Feature::region(const QString & key, const QString & name, RegionKernel kernel) {
+
+		Feature f;
+		f.mKey = key;
+		f.mName = name;
+		f.mGroup = QObject::tr("Regions");
+		f.mRegionKernel = kernel;
+		f.mFields.add(FieldProjection::f_regions);
+
+		return f;
+	}
+
+	bool Feature::isEmpty() const {
+		return !mPageKernel && !mRegionKernel;
+	}
+
+	bool Feature::isRegionFeature() const {
+		return mRegionKernel != nullptr;
+	}
+
+	int Feature::id() const {
+		return mId;
+	}
+
+	QString Feature::key() const {
+		return mKey;
+	}
+
+	QString Feature::name() const {
 		return mName;
 	}
 
-	// -------------------------------------------------------------------- RegionMapper 
-	cv::Mat RegionMapper::process(Collection * c) const {
+	QString Feature::group() const {
+		return mGroup;
+	}
 
-		if (!c) {
-			qWarning() << "cannot process empty Collection";
-			return cv::Mat();
-		}
+	void Feature::setGroup(const QString & group) {
+		mGroup = group;
+	}
 
-		std::function<double(const Region&)> fr = processor();
+	FieldProjection Feature::requiredFields() const {
+		return mFields;
+	}
 
-		// OpenGL only knows floats
-		cv::Mat dv(1, c->numPages(), CV_32FC1);
-		float* px = dv.ptr<float>();
+	Region::Property Feature::rangeHint() const {
+		return mRangeHint;
+	}
 
-		for (auto p : c->pages()) {
+	/// <summary>
+	/// If set, t_region_range transforms bound the axis by the property's
+	/// distribution of all regions in the collection (see RegionDistribution).
+	/// </summary>
+	/// <param name="p">The region property the feature is derived from.</param>
+	void Feature::setRangeHint(const Region::Property & p) {
+		mRangeHint = p;
+	}
 
-			*px = (float)p->averageRegion(fr);
-			px++;
-		}
+	int Feature::provider() const {
+		return mProvider;
+	}
 
-		cv::normalize(dv, dv, 0, 1, cv::NORM_MINMAX);
-		dv *= 2.0f;
-		dv -= 1.0f;
+	int Feature::providerRow() const {
+		return mProviderRow;
+	}
 
-		return dv;
+	/// <summary>
+	/// If set, the feature is served by a FeatureProvider
+	/// (e.g. the collection's cached RegionStatistics) instead
+	/// of running its kernel for each page.
+	/// </summary>
+	/// <param name="provider">The provider's id (see FeatureRegistry::addProvider).</param>
+	/// <param name="row">The feature's row of the provider's values.</param>
+	void Feature::setProvider(int provider, int row) {
+		mProvider = provider;
+		mProviderRow = row;
 	}
 
-	// -------------------------------------------------------------------- PageMapper 
-	cv::Mat PageMapper::process(Collection * c) const {
+	/// <summary>
+	/// Returns true if the feature is computed from other features (e.g. embeddings).
+	/// </summary>
+	bool Feature::isDerived() const {
+		return FeatureRegistry::instance().provider(mProvider).isDerived();
+	}
 
-		if (!c) {
-			qWarning() << "cannot process empty Collection";
-			return cv::Mat();
+	/// <summary>
+	/// Returns true if the feature can be computed for a collection.
+	/// The collection needs the feature's fields and its provider
+	/// might need more (e.g. layout features need the region positions).
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	bool Feature::isAvailable(const Collection & c) const {
+
+		if (!c.fields().contains(mFields))
+			return false;
+
+		return FeatureRegistry::instance().provider(mProvider).isAvailable(c);
+	}
+
+	Feature::PageKernel Feature::pageKernel() const {
+		return mPageKernel;
+	}
+
+	Feature::RegionKernel Feature::regionKernel() const {
+		return mRegionKernel;
+	}
+
+	/// <summary>
+	/// Computes the feature for a single page.
+	/// Use FeatureRegistry::compute for collections.
+	/// </summary>
+	double Feature::compute(const PageData & page) const {
+
+		if (mRegionKernel)
+			return page.averageRegion(mRegionKernel);
+		else if (mPageKernel)
+			return mPageKernel(page);
+
+		return 0.0;
+	}
+
+	// -------------------------------------------------------------------- FeatureRegistry 
+	FeatureRegistry::FeatureRegistry() {
+		registerBuiltins();
+	}
+
+	FeatureRegistry & FeatureRegistry::instance() {
+
+		static FeatureRegistry inst;
+		return inst;
+	}
+
+	/// <summary>
+	/// Registers a new feature.
+	/// </summary>
+	/// <param name="feature">The feature.</param>
+	/// <returns>The feature's id or the id of the feature which is already registered with this key.</returns>
+	int FeatureRegistry::add(const Feature & feature) {
+
+		if (feature.isEmpty()) {
+			qWarning() << "[FeatureRegistry] cannot register" << feature.key() << "it has no kernel";
+			return -1;
+		}
+
+		if (mKeys.contains(feature.key())) {
+			qWarning() << "[FeatureRegistry]" << feature.key() << "is already registered";
+			return mKeys.value(feature.key());
+		}
+
+		if (feature.provider() >= mProviders.size()) {
+			qWarning() << "[FeatureRegistry] cannot register" << feature.key() << "its provider is unknown";
+			return -1;
 		}
 
-		std::function<double(const PageData&)> pr = processor();
+		Feature f = feature;
+		f.mId = mFeatures.size();
 
-		// OpenGL only knows floats
-		cv::Mat dv(1, c->numPages(), CV_32FC1);
-		float* px = dv.ptr<float>();
+		mFeatures << f;
+		mKeys.insert(f.key(), f.id());
 
-		for (auto p : c->pages()) {
+		return f.id();
+	}
+
+	/// <summary>
+	/// Registers a provider which serves features from a model of the whole collection.
+	/// </summary>
+	/// <param name="provider">The provider.</param>
+	/// <returns>The provider's id (see Feature::setProvider) or the id of the provider which is already registered with this name.</returns>
+	int FeatureRegistry::addProvider(const FeatureProvider & provider) {
 
-			*px = (float)pr(*p);
-			px++;
+		if (provider.isEmpty()) {
+			qWarning() << "[FeatureRegistry] cannot register" << provider.name() << "it has no extractor";
+			return -1;
 		}
 
-		// map to screen
-		cv::normalize(dv, dv, 0, 1, cv::NORM_MINMAX);
-		dv *= 2.0f;
-		dv -= 1.0f;
+		int id = providerId(provider.name());
 
-		return dv;
+		if (id != -1) {
+			qWarning() << "[FeatureRegistry]" << provider.name() << "is already registered";
+			return id;
+		}
+
+		mProviders << provider;
+
+		return mProviders.size() - 1;
+	}
+
+	int FeatureRegistry::numFeatures() const {
+		return mFeatures.size();
 	}
 
+	Feature FeatureRegistry::feature(int id) const {
 
-	// -------------------------------------------------------------------- WidthMapper 
-	WidthMapper::WidthMapper() {
-		mName = QObject::tr("Region Width");
-		mType = m_reg_width;
+		if (id < 0 || id >= mFeatures.size())
+			return Feature();
+
+		return mFeatures[id];
 	}
 
-	std::function<double(const Region&)> WidthMapper::processor() const {
-		return [&](const Region& r) { return r.width(); };
+	int FeatureRegistry::id(const QString & key) const {
+		return mKeys.value(key, -1);
 	}
 
-	// -------------------------------------------------------------------- HeightMapper 
-	HeightMapper::HeightMapper() {
-		mName = QObject::tr("Region Height");
-		mType = m_reg_height;
+	QVector<Feature> FeatureRegistry::features() const {
+		return mFeatures;
 	}
-	std::function<double(const Region&)> HeightMapper::processor() const {
-		return [&](const Region& r) { return r.height(); };
+
+	FeatureProvider FeatureRegistry::provider(int id) const {
+
+		if (id < 0 || id >= mProviders.size())
+			return FeatureProvider();
+
+		return mProviders[id];
 	}
 
-	// -------------------------------------------------------------------- AreaMapper 
-	AreaMapper::AreaMapper() {
-		mName = QObject::tr("Region Area");
-		mType = m_reg_area;
+	int FeatureRegistry::providerId(const QString & name) const {
+
+		for (int idx = 0; idx < mProviders.size(); idx++) {
+			if (mProviders[idx].name() == name)
+				return idx;
+		}
+
+		return -1;
 	}
 
-	std::function<double(const Region&)> AreaMapper::processor() const {
-		return [&](const Region& r) { return r.area(); };
+	/// <summary>
+	/// Returns all features which are not derived from other features
+	/// and are available in the collection (see Feature::isAvailable).
+	/// These describe a page for embeddings, projections, etc.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <returns>The feature ids.</returns>
+	QVector<int> FeatureRegistry::baseFeatures(const Collection & c) const {
+
+		QVector<int> ids;
+
+		for (const Feature& f : mFeatures) {
+
+			if (!f.isDerived() && f.isAvailable(c))
+				ids << f.id();
+		}
+
+		return ids;
 	}
 
-	// -------------------------------------------------------------------- PageWidthMapper 
-	PageWidthMapper::PageWidthMapper() {
-		mName = QObject::tr("Image Width");
-		mType = m_img_width;
+	/// <summary>
+	/// Creates the execution plan for a set of features.
+	/// Features that read the same fields are put into one group
+	/// which is computed in a single pass over the pages.
+	/// </summary>
+	/// <param name="ids">The feature ids.</param>
+	/// <returns>Groups of indices into ids.</returns>
+	QVector<QVector<int> > FeatureRegistry::fuse(const QVector<int>& ids) const {
+
+		QVector<QVector<int> > groups;
+		QVector<FieldProjection> groupFields;
+
+		for (int idx = 0; idx < ids.size(); idx++) {
+
+			FieldProjection fp = feature(ids[idx]).requiredFields();
+			int gIdx = 0;
+
+			for (; gIdx < groupFields.size(); gIdx++) {
+				
+				if (groupFields[gIdx].contains(fp) && fp.contains(groupFields[gIdx]))
+					break;
+			}
+
+			if (gIdx == groups.size()) {
+				groups << QVector<int>();
+				groupFields << fp;
+			}
+
+			groups[gIdx] << idx;
+		}
+
+		return groups;
 	}
 
-	std::function<double(const PageData&)> PageWidthMapper::processor() const {
-		return [&](const PageData& pd) { return pd.image().width(); };
+	/// <summary>
+	/// Creates the models which serve features (e.g. the RegionStatistics).
+	/// Call this before computing chunks in parallel.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <param name="ids">The feature ids.</param>
+	void FeatureRegistry::prepare(const Collection & c, const QVector<int>& ids) const {
+
+		QVector<int> providers;
+
+		for (int id : ids) {
+
+			int pId = feature(id).provider();
+
+			if (pId >= 0 && !providers.contains(pId)) {
+				provider(pId).extract(c);
+				providers << pId;
+			}
+		}
 	}
 
-	// -------------------------------------------------------------------- PageHeightMapper 
-	PageHeightMapper::PageHeightMapper() {
-		mName = QObject::tr("Image Height");
-		mType = m_img_height;
+	/// <summary>
+	/// Computes features for all pages of a collection.
+	/// Each fused group walks the pages once and the regions
+	/// of a page are visited once for all region features.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <param name="ids">The feature ids.</param>
+	/// <returns>A CV_32FC1 matrix with a row per feature and a column per page.</returns>
+	cv::Mat FeatureRegistry::compute(const Collection & c, const QVector<int>& ids) const {
+
+		// the regions of hidden collections might be evicted
+		c.restore();
+
+		QVector<QSharedPointer<PageData> > pages = c.pages();
+		return compute(c, pages, ids, cv::Range(0, pages.size()));
 	}
 
-	std::function<double(const PageData&)> PageHeightMapper::processor() const {
-		return [&](const PageData& pd) { return pd.image().height(); };
+	/// <summary>
+	/// Computes features for a range of pages.
+	/// Use this to stream the features of large collections in chunks.
+	/// Chunks can be computed in parallel once the collection's
+	/// caches are created (see prepare()).
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <param name="pages">The collection's pages (Collection::pages()).</param>
+	/// <param name="ids">The feature ids.</param>
+	/// <param name="range">The page range.</param>
+	/// <returns>A CV_32FC1 matrix with a row per feature and a column per page in range.</returns>
+	cv::Mat FeatureRegistry::compute(const Collection & c, const QVector<QSharedPointer<PageData> >& pages, const QVector<int>& ids, const cv::Range & range) const {
+
+		cv::Mat fm(ids.size(), range.size(), CV_32FC1, cv::Scalar(0));
+
+		for (const QVector<int>& group : fuse(ids)) {
+
+			QVector<int> pageRows, regionRows;
+			QVector<Feature::PageKernel> pk;
+			QVector<Feature::RegionKernel> rk;
+
+			for (int row : group) {
+
+				Feature f = feature(ids[row]);
+
+				// models are computed for all pages at once and cached
+				if (f.provider() >= 0) {
+
+					// zero until the model is computed (e.g. the embedding)
+					cv::Mat v = provider(f.provider()).extract(c);
+					if (f.providerRow() < v.rows && v.cols == pages.size())
+						v.row(f.providerRow()).colRange(range).copyTo(fm.row(row));
+				}
+				else if (f.isRegionFeature()) {
+					regionRows << row;
+					rk << f.regionKernel();
+				}
+				else if (!f.isEmpty()) {
+					pageRows << row;
+					pk << f.pageKernel();
+				}
+			}
+
+			std::vector<std::vector<double> > values(rk.size());
+
+			for (int pIdx = range.start; pIdx < range.end; pIdx++) {
+
+				const PageData& p = *pages[pIdx];
+				const int col = pIdx - range.start;
+
+				for (int idx = 0; idx < pk.size(); idx++)
+					fm.at<float>(pageRows[idx], col) = (float)pk[idx](p);
+
+				if (rk.isEmpty())
+					continue;
+
+				for (std::vector<double>& v : values)
+					v.clear();
+
+				for (auto r : p.regions()) {
+					for (int idx = 0; idx < rk.size(); idx++)
+						values[idx].push_back(rk[idx](*r));
+				}
+
+				for (int idx = 0; idx < rk.size(); idx++)
+					fm.at<float>(regionRows[idx], col) = (float)Math::quantile(values[idx].data(), values[idx].size(), 0.5);
+			}
+		}
+
+		return fm;
 	}
-}
 
- 
\ No newline at end of file
+	void FeatureRegistry::registerBuiltins() {
+
+		FieldProjection imgFields(false);
+		imgFields.add(FieldProjection::f_image);
+
+		FieldProjection regFields(false);
+		regFields.add(FieldProjection::f_regions);
+
+		FieldProjection textFields(false);
+		textFields.add(FieldProjection::f_content);
+
+		// models which serve the features of all pages at once (the collection caches them)
+		int regionStats = addProvider(FeatureProvider("region_statistics", [](const Collection& c) { return c.regionStatistics()->data(); }));
+
+		FeatureProvider lp("layout_statistics", [](const Collection& c) { return c.layoutStatistics()->data(); });
+		lp.setCondition([](const Collection& c) { return c.hasRegionPositions(); });
+		int layoutStats = addProvider(lp);
+
+		FeatureProvider pp("principal_components", [](const Collection& c) { return c.principalComponents()->scores(); });
+		pp.setDerived(true);
+		int components = addProvider(pp);
+
+		// a row per dimension - empty until the embedding is computed (see TsneEmbedding)
+		FeatureProvider ep("embedding", [](const Collection& c) { cv::Mat e = c.embedding(); return e.empty() ? e : cv::Mat(e.t()); });
+		ep.setDerived(true);
+		int embedding = addProvider(ep);
+
+		// NOTE: the order must be the same as AbstractMapper::Type
+		Feature rw = Feature::region("reg_width", QObject::tr("Region Width"), [](const Region& r) { return r.width(); });
+		rw.setProvider(regionStats, RegionStatistics::index(RegionStatistics::s_median, Region::p_width));
+		rw.setRangeHint(Region::p_width);
+		add(rw);
+
+		Feature rh = Feature::region("reg_height", QObject::tr("Region Height"), [](const Region& r) { return r.height(); });
+		rh.setProvider(regionStats, RegionStatistics::index(RegionStatistics::s_median, Region::p_height));
+		rh.setRangeHint(Region::p_height);
+		add(rh);
+
+		Feature ra = Feature::region("reg_area", QObject::tr("Region Area"), [](const Region& r) { return r.area(); });
+		ra.setProvider(regionStats, RegionStatistics::index(RegionStatistics::s_median, Region::p_area));
+		ra.setRangeHint(Region::p_area);
+		add(ra);
+
+		add(Feature::page("img_width", QObject::tr("Image Width"), [](const PageData& p) { return p.image().width(); }, imgFields));
+		add(Feature::page("img_height", QObject::tr("Image Height"), [](const PageData& p) { return p.image().height(); }, imgFields));
+
+		Feature rc = Feature::page("reg_count", QObject::tr("Number of Regions"), [](const PageData& p) { return cmp::numRegions(&p); }, regFields);
+		rc.setProvider(regionStats, RegionStatistics::index(RegionStatistics::s_count));
+		add(rc);
+		add(Feature::page("text_length", QObject::tr("Text Length"), [](const PageData& p) { return cmp::textLength(&p); }, textFields));
+		add(Feature::page("img_aspect_ratio", QObject::tr("Image Aspect Ratio"), [](const PageData& p) { return cmp::aspectRatio(&p); }, imgFields));
+		add(Feature::region("reg_aspect_ratio", QObject::tr("Region Aspect Ratio"), [](const Region& r) { return r.height() > 0 ? r.width() / r.height() : 0.0; }));
+
+		assert(mFeatures.size() == AbstractMapper::m_end);
+
+		// number of regions per type
+		for (int t = Region::type_unknown; t < Region::type_end; t++) {
+
+			Region::Type type = (Region::Type)t;
+
+			auto count = [type](const PageData& p) {
+
+				int n = 0;
+				for (auto r : p.regions()) {
+					if (r->type() == type)
+						n++;
+				}
+				return (double)n;
+			};
+
+			Feature f = Feature::page("reg_count_" + Region::typeName(type), QObject::tr("%1 Count").arg(Region::typeName(type)), count, regFields);
+			f.setGroup(QObject::tr("Region Types"));
+			f.setProvider(regionStats, RegionStatistics::index(RegionStatistics::s_count, Region::p_width, type));
+			add(f);
+		}
+
+		// distribution of all regions - these are cheap since they share one sweep
+		for (int p = 0; p < Region::prop_end; p++) {
+
+			for (int s = RegionStatistics::s_mean; s < RegionStatistics::s_end; s++) {
+
+				if (s == RegionStatistics::s_median)
+					continue;	// registered above
+
+				int si = RegionStatistics::index((RegionStatistics::Statistic)s, (Region::Property)p);
+				QString key = "reg_stat_" + RegionStatistics::propertyName((Region::Property)p) + "_" + RegionStatistics::statisticName((RegionStatistics::Statistic)s);
+				
+				// the kernel is only used if a single page is computed
+				Region::Property prop = (Region::Property)p;
+				RegionStatistics::Statistic stat = (RegionStatistics::Statistic)s;
+				auto kernel = [prop, stat](const PageData& pd) {
+					QVector<QSharedPointer<PageData> > pages;
+					pages << QSharedPointer<PageData>::create(pd);
+					return (double)RegionStatistics::compute(pages).data().at<float>(RegionStatistics::index(stat, prop), 0);
+				};
+
+				Feature f = Feature::page(key, RegionStatistics::name(si), kernel, regFields);
+				f.setGroup(QObject::tr("Region Statistics"));
+				f.setProvider(regionStats, si);
+				add(f);
+			}
+		}
+
+		// principal components of all base features (see PrincipalComponents)
+		for (int idx = 0; idx < PrincipalComponents::num_components; idx++) {
+
+			auto kernel = [](const PageData&) { return 0.0; };	// needs all pages
+
+			Feature f = Feature::page("pca_" + QString::number(idx + 1), QObject::tr("Principal Component %1").arg(idx + 1), kernel, FieldProjection(false));
+			f.setGroup(QObject::tr("Principal Components"));
+			f.setProvider(components, idx);
+			add(f);
+		}
+
+		// the embedding is computed for the whole collection (see TsneEmbedding)
+		for (int dim = 0; dim < 2; dim++) {
+
+			auto kernel = [](const PageData&) { return 0.0; };	// pages cannot be embedded on their own
+
+			Feature f = Feature::page("tsne_" + QString::number(dim + 1), QObject::tr("t-SNE %1").arg(dim + 1), kernel, FieldProjection(false));
+			f.setGroup(QObject::tr("Embedding"));
+			f.setProvider(embedding, dim);
+			add(f);
+		}
+
+		// layout features need the region positions and the page size
+		FieldProjection layoutFields(false);
+		layoutFields.add(FieldProjection::f_regions);
+		layoutFields.add(FieldProjection::f_image);
+
+		// NOTE: the order must be the same as LayoutStatistics::Statistic
+		QVector<QPair<QString, QString> > layout;
+		layout << qMakePair(QString("layout_margin_left"), QObject::tr("Left Margin"));
+		layout << qMakePair(QString("layout_margin_right"), QObject::tr("Right Margin"));
+		layout << qMakePair(QString("layout_margin_top"), QObject::tr("Top Margin"));
+		layout << qMakePair(QString("layout_margin_bottom"), QObject::tr("Bottom Margin"));
+		layout << qMakePair(QString("layout_columns"), QObject::tr("Column Count"));
+		layout << qMakePair(QString("layout_whitespace"), QObject::tr("Whitespace Ratio"));
+		layout << qMakePair(QString("layout_reading_order"), QObject::tr("Reading Order Disorder"));
+
+		for (int idx = 0; idx < layout.size(); idx++) {
+
+			LayoutStatistics::Statistic s = (LayoutStatistics::Statistic)idx;
+			auto kernel = [s](const PageData& p) { return LayoutStatistics::value(PageLayout(p), s); };
+
+			Feature f = Feature::page(layout[idx].first, layout[idx].second, kernel, layoutFields);
+			f.setGroup(QObject::tr("Layout"));
+			f.setProvider(layoutStats, idx);
+			add(f);
+		}
+	}
+
+	// -------------------------------------------------------------------- AxisTransform 
+	AxisTransform::AxisTransform(const Mode & mode) {
+		mMode = mode;
+	}
+
+	/// <summary>
+	/// Fits the transform to data and maps it to [-1 1] (OpenGL coordinates).
+	/// Values outside the transform's range are clipped to the border.
+	/// </summary>
+	/// <param name="data">The raw values (a single CV_32F row) which are overwritten.</param>
+	/// <param name="range">The range hint of t_region_range transforms (ignored if empty).</param>
+	void AxisTransform::apply(cv::Mat & data, const cv::Vec2d & range) {
+
+		CV_Assert(data.type() == CV_32FC1 && data.rows <= 1);
+
+		cv::Vec2d mm = minMax(data);
+		mMin = mm[0];
+		mMax = mm[1];
+		mCenter = 0.0;
+		mScale = 1.0;
+		mPercentiles.clear();
+
+		if (data.empty())
+			return;
+
+		float* ptr = data.ptr<float>();
+		const int n = data.cols;
+
+		// quantiles are selected on a copy - the data keeps its order
+		std::vector<float> buffer;
+		auto qs = [&](const std::vector<double>& q) {
+
+			std::vector<double> out(q.size());
+			buffer.assign(ptr, ptr + n);
+			Math::quantiles(buffer.data(), buffer.size(), q.data(), q.size(), out.data());
+			return out;
+		};
+
+		switch (mMode) {
+		case t_linear: {
+			mLow = mMin;
+			mHigh = mMax;
+			break;
+		}
+		case t_region_range: {
+			mLow = mMin;
+			mHigh = mMax;
+
+			if (range[1] > range[0]) {
+				mLow = qMax(mLow, range[0]);
+				mHigh = qMin(mHigh, range[1]);
+			}
+			break;
+		}
+		case t_log:
+			break;
+		case t_asinh: {
+			// values around the median magnitude are mapped linearly
+			buffer.resize(n);
+			cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& r) {
+				for (int idx = r.start; idx < r.end; idx++)
+					buffer[idx] = std::abs(ptr[idx]);
+			});
+			double mag = Math::quantile(buffer.data(), buffer.size(), 0.5);
+			mScale = mag > 0.0 ? mag : 1.0;
+			break;
+		}
+		case t_rank: {
+			std::vector<double> q(101);
+			for (int idx = 0; idx < (int)q.size(); idx++)
+				q[idx] = idx / 100.0;
+			mPercentiles = qs(q);
+			break;
+		}
+		case t_robust_z: {
+			mCenter = qs({ 0.5 })[0];
+
+			// median absolute deviation
+			buffer.resize(n);
+			cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& r) {
+				for (int idx = r.start; idx < r.end; idx++)
+					buffer[idx] = std::abs(ptr[idx] - (float)mCenter);
+			});
+			double mad = Math::quantile(buffer.data(), buffer.size(), 0.5);
+
+			// 1.4826 makes the MAD consistent with the standard deviation of normal distributions
+			mScale = mad > 0.0 ? 1.4826 * mad : 1.0;
+			break;
+		}
+		case t_percentile: {
+			std::vector<double> p = qs({ 0.01, 0.99 });
+			mLow = p[0];
+			mHigh = p[1];
+			break;
+		}
+		case t_end: break;
+		}
+
+		if (mMode == t_log || mMode == t_asinh) {
+			mLow = forward(mMin);
+			mHigh = forward(mMax);
+		}
+		else if (mMode == t_robust_z) {
+			// show at most +/- 4 sigma
+			mLow = qMax(forward(mMin), -4.0);
+			mHigh = qMin(forward(mMax), 4.0);
+		}
+		else if (mMode == t_rank) {
+
+			// ranks need the sorted order - ties get their mean rank
+			std::vector<int> order(n);
+			for (int idx = 0; idx < n; idx++)
+				order[idx] = idx;
+			std::sort(order.begin(), order.end(), [ptr](int a, int b) { return ptr[a] < ptr[b]; });
+
+			std::vector<float> ranks(n);
+			for (int idx = 0; idx < n;) {
+
+				int end = idx + 1;
+				while (end < n && ptr[order[end]] == ptr[order[idx]])
+					end++;
+
+				float r = (n > 1) ? (idx + end - 1) * 0.5f / (n - 1) : 0.5f;
+				for (int rIdx = idx; rIdx < end; rIdx++)
+					ranks[order[rIdx]] = r;
+
+				idx = end;
+			}
+
+			std::copy(ranks.begin(), ranks.end(), ptr);
+			mLow = 0.0;
+			mHigh = 1.0;
+		}
+
+		if (mHigh <= mLow) {
+			data.setTo(0);
+			return;
+		}
+
+		const double s = 2.0 / (mHigh - mLow);
+		const bool isRank = mMode == t_rank;
+
+		cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& r) {
+
+			for (int idx = r.start; idx < r.end; idx++) {
+				double v = isRank ? ptr[idx] : forward(ptr[idx]);
+				ptr[idx] = (float)qBound(-1.0, (v - mLow) * s - 1.0, 1.0);
+			}
+		});
+	}
+
+	/// <summary>
+	/// Maps a screen coordinate back to real units.
+	/// </summary>
+	/// <param name="screen">A value in [-1 1].</param>
+	/// <returns>The raw feature value.</returns>
+	double AxisTransform::toValue(double screen) const {
+
+		double t = mLow + (screen + 1.0) * 0.5 * (mHigh - mLow);
+
+		if (mMode == t_rank) {
+
+			if (mPercentiles.empty())
+				return 0.0;
+
+			// interpolate between percentiles
+			double pos = qBound(0.0, t, 1.0) * (mPercentiles.size() - 1);
+			size_t idx = qMin((size_t)pos, mPercentiles.size() - 2);
+			double w = pos - idx;
+
+			return (1.0 - w) * mPercentiles[idx] + w * mPercentiles[idx + 1];
+		}
+
+		return inverse(t);
+	}
+
+	AxisTransform::Mode AxisTransform::mode() const {
+		return mMode;
+	}
+
+	void AxisTransform::setMode(const Mode & mode) {
+		mMode = mode;
+	}
+
+	/// <summary>
+	/// Returns the raw minimum of the data the transform was fitted to.
+	/// </summary>
+	double AxisTransform::minValue() const {
+		return mMin;
+	}
+
+	/// <summary>
+	/// Returns the raw maximum of the data the transform was fitted to.
+	/// </summary>
+	double AxisTransform::maxValue() const {
+		return mMax;
+	}
+
+	QString AxisTransform::name(const Mode & mode) {
+
+		switch (mode) {
+		case t_linear:		return QObject::tr("Linear");
+		case t_log:			return QObject::tr("Logarithmic");
+		case t_asinh:		return QObject::tr("Inverse Hyperbolic Sine");
+		case t_rank:		return QObject::tr("Rank (Percentile)");
+		case t_robust_z:	return QObject::tr("Robust z-Score");
+		case t_percentile:	return QObject::tr("Percentile Range (1-99 %)");
+		case t_region_range:	return QObject::tr("Region Range (1-99 %)");
+		case t_end: break;
+		}
+
+		return "";
+	}
+
+	double AxisTransform::forward(double v) const {
+
+		switch (mMode) {
+		case t_log:			return v < 0 ? -std::log1p(-v) : std::log1p(v);	// symmetric so that negative values are supported
+		case t_asinh:		return std::asinh(v / mScale);
+		case t_robust_z:	return (v - mCenter) / mScale;
+		default:			return v;
+		}
+	}
+
+	double AxisTransform::inverse(double t) const {
+
+		switch (mMode) {
+		case t_log:			return t < 0 ? -std::expm1(-t) : std::expm1(t);
+		case t_asinh:		return std::sinh(t) * mScale;
+		case t_robust_z:	return t * mScale + mCenter;
+		default:			return t;
+		}
+	}
+
+	/// <summary>
+	/// Parallel min/max reduction.
+	/// </summary>
+	cv::Vec2d AxisTransform::minMax(const cv::Mat & data) {
+
+		if (data.empty())
+			return cv::Vec2d();
+
+		const float* ptr = data.ptr<float>();
+		const int n = data.cols;
+		const int numStripes = qMax(1, qMin(cv::getNumThreads() * 4, n / 4096));
+		std::vector<cv::Vec2f> partial(numStripes, cv::Vec2f(ptr[0], ptr[0]));
+
+		cv::parallel_for_(cv::Range(0, numStripes), [&](const cv::Range& r) {
+
+			for (int sIdx = r.start; sIdx < r.end; sIdx++) {
+
+				cv::Vec2f& mm = partial[sIdx];
+				int end = (int)((int64)n * (sIdx + 1) / numStripes);
+
+				for (int idx = (int)((int64)n * sIdx / numStripes); idx < end; idx++) {
+					mm[0] = qMin(mm[0], ptr[idx]);
+					mm[1] = qMax(mm[1], ptr[idx]);
+				}
+			}
+		});
+
+		cv::Vec2d mm(ptr[0], ptr[0]);
+		for (const cv::Vec2f& p : partial) {
+			mm[0] = qMin(mm[0], (double)p[0]);
+			mm[1] = qMax(mm[1], (double)p[1]);
+		}
+
+		return mm;
+	}
+
+	// -------------------------------------------------------------------- AbstractMapper 
+	AbstractMapper::AbstractMapper() {
+	}
+
+	/// <summary>
+	/// Creates a mapper for a registered feature.
+	/// </summary>
+	/// <param name="type">The feature id (see FeatureRegistry).</param>
+	/// <returns>The mapper or NULL if the feature is not registered.</returns>
+	QSharedPointer<AbstractMapper> AbstractMapper::create(int type) {
+
+		Feature f = FeatureRegistry::instance().feature(type);
+
+		if (!f.isEmpty())
+			return QSharedPointer<FeatureMapper>::create(f);
+
+		if (type != m_undefined)
+			qWarning() << "[AbstractMapper] unknown type:" << type;
+		return QSharedPointer<AbstractMapper>();
+	}
+
+	/// <summary>
+	/// Maps several features at once.
+	/// Features which read the same data share a pass over the collection.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <param name="types">The feature ids.</param>
+	/// <param name="transforms">If set, the feature's transforms which are fitted to the data.</param>
+	/// <returns>A row in screen coordinates per feature.</returns>
+	cv::Mat AbstractMapper::processAll(const Collection * c, const QVector<int>& types, QVector<AxisTransform>* transforms) {
+
+		if (!c) {
+			qWarning() << "cannot process empty Collection";
+			return cv::Mat();
+		}
+
+		cv::Mat fm = FeatureRegistry::instance().compute(*c, types);
+
+		for (int idx = 0; idx < fm.rows; idx++) {
+
+			bool hasTransform = transforms && idx < transforms->size();
+			AxisTransform t = hasTransform ? transforms->at(idx) : AxisTransform();
+
+			cv::Mat r = fm.row(idx);
+			t.apply(r, t.mode() == AxisTransform::t_region_range ? rangeHint(*c, FeatureRegistry::instance().feature(types[idx])) : cv::Vec2d());
+
+			if (hasTransform)
+				(*transforms)[idx] = t;
+		}
+
+		return fm;
+	}
+
+	/// <summary>
+	/// Returns the fields needed to compute all mappers.
+	/// Use this to load only what the plots need.
+	/// </summary>
+	/// <param name="types">The mapper types in use.</param>
+	/// <returns>The fields that need to be loaded.</returns>
+	FieldProjection AbstractMapper::collectFields(const QVector<int>& types) {
+
+		FieldProjection fp(false);
+
+		for (int t : types) {
+
+			auto m = create(t);
+			if (m)
+				fp.add(m->requiredFields());
+		}
+
+		return fp;
+	}
+
+	/// <summary>
+	/// Returns the range of a feature which is derived from region properties.
+	/// The range covers 98 % of all regions in the collection so
+	/// that single outliers do not squash the plot (see AxisTransform::t_region_range).
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <param name="feature">The feature.</param>
+	/// <returns>[min max] or an empty range if the feature has no range hint.</returns>
+	cv::Vec2d AbstractMapper::rangeHint(const Collection & c, const Feature & feature) {
+
+		if (feature.rangeHint() == Region::prop_end)
+			return cv::Vec2d();
+
+		QuantileSketch s = c.regionDistribution()->sketch(feature.rangeHint());
+
+		return cv::Vec2d(s.quantile(0.01), s.quantile(0.99));
+	}
+
+	int AbstractMapper::type() const {
+		return mType;
+	}
+
+	QString AbstractMapper::name() const {
+		return mName;
+	}
+
+	// -------------------------------------------------------------------- FeatureMapper 
+	FeatureMapper::FeatureMapper(const Feature & feature) {
+
+		mFeature = feature;
+		mName = feature.name();
+		mType = feature.id();
+	}
+
+	cv::Mat FeatureMapper::process(Collection * c) const {
+
+		if (!c) {
+			qWarning() << "cannot process empty Collection";
+			return cv::Mat();
+		}
+
+		// OpenGL only knows floats
+		cv::Mat dv = FeatureRegistry::instance().compute(*c, QVector<int>() << mType);
+		AxisTransform t;
+		t.apply(dv);
+
+		return dv;
+	}
+
+	FieldProjection FeatureMapper::requiredFields() const {
+		return mFeature.requiredFields();
+	}
+
+	// -------------------------------------------------------------------- FeatureCache 
+	FeatureCache::FeatureCache(const Collection* collection) {
+		mCollection = collection;
+	}
+
+	/// <summary>
+	/// Returns the mapped columns of several features.
+	/// Missing columns are computed in a single pass.
+	/// </summary>
+	/// <param name="ids">The feature ids.</param>
+	/// <param name="transforms">The transform of each feature - they are fitted to the data.</param>
+	/// <returns>A column (1 x pages) per feature which must not be changed.</returns>
+	QVector<cv::Mat> FeatureCache::columns(const QVector<int>& ids, QVector<AxisTransform>& transforms) {
+
+		CV_Assert(ids.size() == transforms.size());
+
+		if (!mCollection)
+			return QVector<cv::Mat>(ids.size());
+
+		restore();
+
+		// changed pages are spliced (see Collection::replacePages())
+		if (mRaw.isEmpty())
+			mNumPages = mCollection->numPages();
+
+		QVector<QPair<int, int> > keys;
+		QVector<int> missing;
+
+		for (int idx = 0; idx < ids.size(); idx++) {
+
+			QPair<int, int> key(ids[idx], transforms[idx].mode());
+			keys << key;
+
+			if (!mColumns.contains(key) && !mRaw.contains(ids[idx]) && !missing.contains(ids[idx]))
+				missing << ids[idx];
+		}
+
+		// missing features are computed in a single pass
+		if (!missing.isEmpty()) {
+
+			cv::Mat fm = FeatureRegistry::instance().compute(*mCollection, missing);
+
+			if (fm.rows != missing.size())
+				return QVector<cv::Mat>(ids.size());
+
+			for (int idx = 0; idx < missing.size(); idx++)
+				mRaw.insert(missing[idx], fm.row(idx).clone());
+		}
+
+		// other transform modes only need to map the raw values
+		for (int idx = 0; idx < ids.size(); idx++) {
+
+			if (!mColumns.contains(keys[idx]))
+				mColumns.insert(keys[idx], fit(ids[idx], mRaw.value(ids[idx]), transforms[idx].mode()));
+		}
+
+		QVector<cv::Mat> cols;
+
+		for (int idx = 0; idx < ids.size(); idx++) {
+
+			Column c = mColumns.value(keys[idx]);
+			cols << c.data;
+			transforms[idx] = c.transform;
+		}
+
+		return cols;
+	}
+
+	/// <summary>
+	/// Returns the mapped column of a feature.
+	/// </summary>
+	cv::Mat FeatureCache::column(int id, AxisTransform & transform) {
+
+		QVector<AxisTransform> ts(1, transform);
+		cv::Mat c = columns(QVector<int>(1, id), ts)[0];
+		transform = ts[0];
+
+		return c;
+	}
+
+	/// <summary>
+	/// Returns the Pearson correlation of all feature pairs.
+	/// The sums of all pairs are accumulated in a single parallel
+	/// pass over the pages. Correlations are computed on the mapped
+	/// values - so they correspond to what the plots show.
+	/// </summary>
+	/// <param name="ids">The feature ids.</param>
+	/// <param name="transforms">The transform of each feature.</param>
+	/// <returns>The correlation matrix (features x features, CV_64F) - empty if no columns are available.</returns>
+	cv::Mat FeatureCache::correlation(const QVector<int>& ids, QVector<AxisTransform>& transforms) {
+
+		QVector<cv::Mat> cols = columns(ids, transforms);
+
+		const int d = cols.size();
+		const int n = mNumPages;
+
+		if (d == 0 || n == 0)
+			return cv::Mat();
+
+		// e.g. an empty collection or columns that could not be computed
+		for (const cv::Mat& c : cols) {
+			if (c.empty() || c.cols != n)
+				return cv::Mat();
+		}
+
+		cv::Mat sum(1, d, CV_64FC1, cv::Scalar(0));
+		cv::Mat sumSq(d, d, CV_64FC1, cv::Scalar(0));
+
+		std::vector<const float*> ptrs;
+		for (const cv::Mat& c : cols)
+			ptrs.push_back(c.ptr<float>());
+
+		QMutex mutex;
+
+		cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& r) {
+
+			cv::Mat s(1, d, CV_64FC1, cv::Scalar(0));
+			cv::Mat ss(d, d, CV_64FC1, cv::Scalar(0));
+			double* sp = s.ptr<double>();
+
+			std::vector<double> x(d);
+
+			for (int pIdx = r.start; pIdx < r.end; pIdx++) {
+
+				for (int fIdx = 0; fIdx < d; fIdx++) {
+					x[fIdx] = ptrs[fIdx][pIdx];
+					sp[fIdx] += x[fIdx];
+				}
+
+				// the upper triangle is enough
+				for (int i = 0; i < d; i++) {
+					double* ssp = ss.ptr<double>(i);
+					for (int j = i; j < d; j++)
+						ssp[j] += x[i] * x[j];
+				}
+			}
+
+			QMutexLocker lock(&mutex);
+			sum += s;
+			sumSq += ss;
+
+		}, cv::getNumThreads());
+
+		cv::Mat corr(d, d, CV_64FC1, cv::Scalar(0));
+
+		for (int i = 0; i < d; i++) {
+			for (int j = i; j < d; j++) {
+
+				double mi = sum.at<double>(i) / n;
+				double mj = sum.at<double>(j) / n;
+				double cov = sumSq.at<double>(i, j) / n - mi * mj;
+				double vi = sumSq.at<double>(i, i) / n - mi * mi;
+				double vj = sumSq.at<double>(j, j) / n - mj * mj;
+
+				// constant features do not correlate
+				double c = vi > 0 && vj > 0 ? cov / std::sqrt(vi * vj) : (i == j ? 1.0 : 0.0);
+				corr.at<double>(i, j) = corr.at<double>(j, i) = qBound(-1.0, c, 1.0);
+			}
+		}
+
+		return corr;
+	}
+
+	/// <summary>
+	/// Updates all columns after pages were replaced or appended.
+	/// Features are only computed for the new pages, the other raw values
+	/// are kept and the transforms are fitted again.
+	/// Derived features (e.g. the embedding) are removed.
+	/// NOTE: call this after the collection was changed and its region statistics were updated.
+	/// </summary>
+	/// <param name="firstPage">The index of the first page that changed.</param>
+	/// <param name="numRemoved">The number of pages that were removed at firstPage.</param>
+	/// <param name="numAdded">The number of pages that were inserted at firstPage.</param>
+	void FeatureCache::splice(int firstPage, int numRemoved, int numAdded) {
+
+		restore();
+
+		// evicted values cannot be updated
+		if (mSpill || !mCollection || mNumPages + numAdded - numRemoved != mCollection->numPages()) {
+			clear();
+			return;
+		}
+
+		// derived features depend on all pages
+		for (int id : mRaw.keys()) {
+
+			if (FeatureRegistry::instance().feature(id).isDerived())
+				invalidate(id);
+		}
+
+		QVector<int> ids = mRaw.keys().toVector();
+
+		Timer dt;
+		cv::Mat fm = FeatureRegistry::instance().compute(*mCollection, mCollection->pages(), ids, cv::Range(firstPage, firstPage + numAdded));
+
+		for (int idx = 0; idx < ids.size(); idx++)
+			mRaw[ids[idx]] = Math::spliceCols(mRaw.value(ids[idx]), firstPage, numRemoved, fm.row(idx));
+
+		for (auto it = mColumns.begin(); it != mColumns.end(); ++it)
+			it.value() = fit(it.key().first, mRaw.value(it.key().first), it.value().transform.mode());
+
+		mNumPages = mCollection->numPages();
+
+		qDebug() << "[FeatureCache]" << ids.size() << "features of" << numAdded << "pages updated in" << dt;
+	}
+
+	/// <summary>
+	/// Removes the columns of a feature.
+	/// Call this if a derived feature changed (e.g. the embedding).
+	/// </summary>
+	void FeatureCache::invalidate(int id) {
+
+		restore();
+
+		for (auto it = mColumns.begin(); it != mColumns.end();) {
+
+			if (it.key().first == id)
+				it = mColumns.erase(it);
+			else
+				++it;
+		}
+
+		mRaw.remove(id);
+	}
+
+	void FeatureCache::clear() {
+		mColumns.clear();
+		mRaw.clear();
+		mSpill.clear();
+	}
+
+	/// <summary>
+	/// Writes the raw values to a spill file and frees all columns.
+	/// Mapped columns are fitted again when they are requested.
+	/// Columns which are still referenced (e.g. by a plot) are not
+	/// freed until the last reference is released.
+	/// </summary>
+	/// <returns>The number of bytes freed.</returns>
+	qint64 FeatureCache::evict() {
+
+		qint64 freed = 0;
+
+		for (const cv::Mat& raw : mRaw)
+			freed += ownedBytes(raw);
+
+		for (const Column& c : mColumns)
+			freed += ownedBytes(c.data);
+
+		if (!mRaw.isEmpty() && !mSpill) {
+
+			QSharedPointer<QTemporaryFile> spill(new QTemporaryFile(QDir::tempPath() + "/pie-features-XXXXXX.bin"));
+
+			if (!spill->open()) {
+				qCritical() << "[FeatureCache] cannot open spill file" << spill->fileName();
+				return 0;
+			}
+
+			QDataStream ds(spill.data());
+
+			for (auto it = mRaw.constBegin(); it != mRaw.constEnd(); ++it) {
+
+				const cv::Mat& raw = it.value();
+				CV_Assert(raw.empty() || (raw.type() == CV_32FC1 && raw.isContinuous()));
+
+				ds << (qint32)it.key() << (qint32)raw.cols;
+				ds.writeRawData((const char*)raw.data, (int)(raw.total() * raw.elemSize()));
+			}
+
+			if (ds.status() != QDataStream::Ok) {
+				qCritical() << "[FeatureCache] could not write to" << spill->fileName();
+				return 0;
+			}
+
+			mSpill = spill;
+		}
+
+		mColumns.clear();
+		mRaw.clear();
+
+		return freed;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes of all raw values and columns.
+	/// </summary>
+	qint64 FeatureCache::memorySize() const {
+
+		qint64 s = 0;
+
+		for (const cv::Mat& raw : mRaw)
+			s += raw.total() * raw.elemSize();
+
+		for (const Column& c : mColumns)
+			s += c.data.total() * c.data.elemSize();
+
+		return s;
+	}
+
+	qint64 FeatureCache::diskSize() const {
+		return mSpill ? mSpill->size() : 0;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes which are freed if m is released.
+	/// </summary>
+	qint64 FeatureCache::ownedBytes(const cv::Mat & m) {
+
+		if (!m.u || m.u->refcount > 1)
+			return 0;
+
+		return m.total() * m.elemSize();
+	}
+
+	/// <summary>
+	/// Reads the evicted raw values back.
+	/// </summary>
+	void FeatureCache::restore() {
+
+		if (!mSpill)
+			return;
+
+		// the spill file is kept until all values are read
+		if (!mSpill->seek(0)) {
+			qWarning() << "[FeatureCache] cannot read" << mSpill->fileName();
+			return;
+		}
+
+		QDataStream ds(mSpill.data());
+		QMap<int, cv::Mat> raws;
+
+		while (!ds.atEnd()) {
+
+			qint32 id = 0, cols = 0;
+			ds >> id >> cols;
+
+			cv::Mat raw = cols > 0 ? cv::Mat(1, cols, CV_32FC1) : cv::Mat();
+			ds.readRawData((char*)raw.data, (int)(raw.total() * raw.elemSize()));
+
+			if (ds.status() != QDataStream::Ok) {
+				qWarning() << "[FeatureCache] cannot read" << mSpill->fileName();
+				return;
+			}
+
+			raws.insert(id, raw);
+		}
+
+		// values computed in the meantime are newer
+		for (auto it = raws.constBegin(); it != raws.constEnd(); ++it) {
+			if (!mRaw.contains(it.key()))
+				mRaw.insert(it.key(), it.value());
+		}
+
+		mSpill.clear();
+	}
+
+	int FeatureCache::numColumns() const {
+		return mColumns.size();
+	}
+
+	FeatureCache::Column FeatureCache::fit(int id, const cv::Mat & raw, const AxisTransform::Mode & mode) const {
+
+		Column c;
+		c.transform = AxisTransform(mode);
+
+		if (raw.empty())
+			return c;
+
+		c.data = raw.clone();
+		c.transform.apply(c.data, mode == AxisTransform::t_region_range ? AbstractMapper::rangeHint(*mCollection, FeatureRegistry::instance().feature(id)) : cv::Vec2d());
+
+		return c;
+	}
+
+	// -------------------------------------------------------------------- RegionStatistics 
+	RegionStatistics::RegionStatistics() {
+	}
+
+	/// <summary>
+	/// Computes all region statistics in one sweep.
+	/// Each page's regions are bucketed by type once and the
+	/// quartiles of each bucket are selected in a single call.
+	/// </summary>
+	/// <param name="pages">The pages.</param>
+	/// <returns>The statistics of all pages.</returns>
+	RegionStatistics RegionStatistics::compute(const QVector<QSharedPointer<PageData> >& pages) {
+
+		const int numGroups = Region::type_end + 1;	// all regions + one group per type
+		const int gs = groupSize();
+
+		// a row per page - so threads do not share cache lines
+		cv::Mat stats(pages.size(), numStatistics(), CV_32FC1, cv::Scalar(0));
+
+		cv::parallel_for_(cv::Range(0, pages.size()), [&](const cv::Range& range) {
+
+			// scratch buffers are reused for all pages of this range
+			std::vector<std::vector<float> > values(numGroups * Region::prop_end);
+
+			for (int pIdx = range.start; pIdx < range.end; pIdx++) {
+
+				for (std::vector<float>& v : values)
+					v.clear();
+
+				for (const QSharedPointer<Region>& r : pages[pIdx]->regions()) {
+
+					int t = r->type();
+					if (t < 0 || t >= Region::type_end)
+						t = Region::type_unknown;
+
+					const float pv[Region::prop_end] = { (float)r->width(), (float)r->height(), (float)r->area() };
+
+					for (int p = 0; p < Region::prop_end; p++) {
+						values[p].push_back(pv[p]);
+						values[(t + 1) * Region::prop_end + p].push_back(pv[p]);
+					}
+				}
+
+				float* sp = stats.ptr<float>(pIdx);
+
+				for (int g = 0; g < numGroups; g++) {
+
+					float* gp = sp + g * gs;
+					int n = (int)values[g * Region::prop_end].size();
+					gp[s_count] = (float)n;
+
+					if (n == 0)
+						continue;
+
+					for (int p = 0; p < Region::prop_end; p++) {
+
+						std::vector<float>& v = values[g * Region::prop_end + p];
+
+						double sum = 0;
+						float minV = v[0], maxV = v[0];
+
+						for (float val : v) {
+							sum += val;
+							minV = qMin(minV, val);
+							maxV = qMax(maxV, val);
+						}
+
+						const double qs[3] = { 0.5, 0.25, 0.75 };
+						double qv[3];
+						Math::quantiles(v.data(), v.size(), qs, 3, qv);
+
+						float* pp = gp + 1 + p * (s_end - 1) - 1;	// - 1 since s_count is not per property
+						pp[s_mean]		= (float)(sum / n);
+						pp[s_median]	= (float)qv[0];
+						pp[s_q25]		= (float)qv[1];
+						pp[s_q75]		= (float)qv[2];
+						pp[s_min]		= minV;
+						pp[s_max]		= maxV;
+					}
+				}
+			}
+		});
+
+		RegionStatistics rs;
+		cv::transpose(stats, rs.mData);
+
+		return rs;
+	}
+
+	/// <summary>
+	/// Returns the number of statistics per page.
+	/// </summary>
+	int RegionStatistics::numStatistics() {
+		return (Region::type_end + 1) * groupSize();
+	}
+
+	/// <summary>
+	/// Returns the row of a statistic.
+	/// </summary>
+	/// <param name="s">The statistic.</param>
+	/// <param name="p">The region property (ignored for s_count).</param>
+	/// <param name="type">The region type, type_end refers to all regions.</param>
+	/// <returns>The statistic's row in data().</returns>
+	int RegionStatistics::index(const Statistic & s, const Region::Property & p, const Region::Type & type) {
+
+		int g = (type == Region::type_end) ? 0 : type + 1;
+		int idx = g * groupSize();
+
+		if (s != s_count)
+			idx += 1 + p * (s_end - 1) + (s - 1);
+
+		return idx;
+	}
+
+	QString RegionStatistics::name(int index) {
+
+		int g = index / groupSize();
+		int r = index % groupSize();
+
+		QString gn = g == 0 ? QObject::tr("Regions") : Region::typeName((Region::Type)(g - 1));
+
+		if (r == 0)
+			return gn + " " + statisticName(s_count);
+
+		Region::Property p = (Region::Property)((r - 1) / (s_end - 1));
+		Statistic s = (Statistic)((r - 1) % (s_end - 1) + 1);
+
+		return gn + " " + propertyName(p) + " " + statisticName(s);
+	}
+
+	QString RegionStatistics::statisticName(const Statistic & s) {
+
+		switch (s) {
+		case s_count:	return "count";
+		case s_mean:	return "mean";
+		case s_median:	return "median";
+		case s_q25:		return "q25";
+		case s_q75:		return "q75";
+		case s_min:		return "min";
+		case s_max:		return "max";
+		case s_end: break;
+		}
+
+		return "";
+	}
+
+	QString RegionStatistics::propertyName(const Region::Property & p) {
+
+		switch (p) {
+		case Region::p_width:	return "width";
+		case Region::p_height:	return "height";
+		case Region::p_area:	return "area";
+		case Region::prop_end: break;
+		}
+
+		return "";
+	}
+
+	/// <summary>
+	/// Replaces the statistics of a page range.
+	/// Use this if documents were replaced or appended - only the new pages are computed.
+	/// </summary>
+	/// <param name="firstPage">The index of the first page that changed.</param>
+	/// <param name="numRemoved">The number of pages that were removed at firstPage.</param>
+	/// <param name="pages">The pages which were inserted at firstPage.</param>
+	void RegionStatistics::splice(int firstPage, int numRemoved, const QVector<QSharedPointer<PageData> >& pages) {
+		mData = Math::spliceCols(mData, firstPage, numRemoved, compute(pages).data());
+	}
+
+	int RegionStatistics::numPages() const {
+		return mData.cols;
+	}
+
+	/// <summary>
+	/// Returns the statistics with a row per statistic and a column per page.
+	/// </summary>
+	cv::Mat RegionStatistics::data() const {
+		return mData;
+	}
+
+	int RegionStatistics::groupSize() {
+		return 1 + Region::prop_end * (s_end - 1);	// count + statistics per property
+	}
+
+	// -------------------------------------------------------------------- RegionDistribution 
+	RegionDistribution::RegionDistribution() {
+	}
+
+	/// <summary>
+	/// Sketches the region sizes of all documents.
+	/// Documents are sketched in parallel and merged afterwards.
+	/// </summary>
+	/// <param name="c">The collection.</param>
+	/// <returns>The region distributions.</returns>
+	RegionDistribution RegionDistribution::compute(const Collection & c) {
+
+		QVector<QSharedPointer<Document> > docs = c.documents();
+
+		RegionDistribution rd;
+		rd.mDocuments.resize(docs.size());
+		rd.mNumPages = c.numPages();
+
+		cv::parallel_for_(cv::Range(0, docs.size()), [&](const cv::Range& range) {
+
+			for (int dIdx = range.start; dIdx < range.end; dIdx++)
+				rd.mDocuments[dIdx] = sketch(*docs[dIdx], dIdx);
+		});
+
+		rd.merge();
+
+		return rd;
+	}
+
+	/// <summary>
+	/// Replaces the sketches of documents which were replaced or appended.
+	/// Only the new documents are sketched.
+	/// </summary>
+	/// <param name="c">The collection which already contains the new documents.</param>
+	/// <param name="firstDoc">The index of the first document that changed.</param>
+	/// <param name="numRemoved">The number of documents that were removed at firstDoc.</param>
+	/// <param name="numAdded">The number of documents that were inserted at firstDoc.</param>
+	void RegionDistribution::splice(const Collection & c, int firstDoc, int numRemoved, int numAdded) {
+
+		QVector<QSharedPointer<Document> > docs = c.documents();
+
+		mDocuments.remove(firstDoc, numRemoved);
+		mDocuments.insert(firstDoc, numAdded, QVector<QuantileSketch>());
+
+		cv::parallel_for_(cv::Range(firstDoc, firstDoc + numAdded), [&](const cv::Range& range) {
+
+			for (int dIdx = range.start; dIdx < range.end; dIdx++)
+				mDocuments[dIdx] = sketch(*docs[dIdx], dIdx);
+		});
+
+		merge();
+		mNumPages = c.numPages();
+	}
+
+	/// <summary>
+	/// Returns the distribution of a region property.
+	/// </summary>
+	/// <param name="p">The region property.</param>
+	/// <param name="docIdx">The document index or -1 for the whole collection.</param>
+	/// <returns>The sketch or an empty sketch if the parameters are illegal.</returns>
+	QuantileSketch RegionDistribution::sketch(const Region::Property & p, int docIdx) const {
+
+		if (p < 0 || p >= Region::prop_end)
+			return QuantileSketch();
+
+		if (docIdx == -1)
+			return mCollection.value(p);
+
+		if (docIdx < 0 || docIdx >= mDocuments.size())
+			return QuantileSketch();
+
+		return mDocuments[docIdx].value(p);
+	}
+
+	QVector<QuantileSketch> RegionDistribution::sketch(const Document & doc, int docIdx) {
+
+		// a seed per document keeps the result deterministic
+		QVector<QuantileSketch> sketches;
+		for (int p = 0; p < Region::prop_end; p++)
+			sketches << QuantileSketch(200, docIdx + 1);
+
+		for (const QSharedPointer<PageData>& pd : doc.pages()) {
+
+			for (const QSharedPointer<Region>& r : pd->regions()) {
+				sketches[Region::p_width].add((float)r->width());
+				sketches[Region::p_height].add((float)r->height());
+				sketches[Region::p_area].add((float)r->area());
+			}
+		}
+
+		return sketches;
+	}
+
+	void RegionDistribution::merge() {
+
+		mCollection = QVector<QuantileSketch>(Region::prop_end);
+
+		for (const QVector<QuantileSketch>& ds : mDocuments) {
+			for (int p = 0; p < Region::prop_end; p++)
+				mCollection[p].merge(ds[p]);
+		}
+	}
+
+	int RegionDistribution::numDocuments() const {
+		return mDocuments.size();
+	}
+
+	int RegionDistribution::numPages() const {
+		return mNumPages;
+	}
+
+	QString RegionDistribution::toString() const {
+
+		QString msg;
+
+		for (int p = 0; p < mCollection.size(); p++) {
+			
+			if (p > 0)
+				msg += "\n";
+			msg += "region " + RegionStatistics::propertyName((Region::Property)p) + " - " + mCollection[p].toString();
+		}
+
+		return msg;
+	}
+
+	// -------------------------------------------------------------------- PageLayout 
+	PageLayout::PageLayout(const PageData & page) {
+
+		QVector<QSharedPointer<Region> > regions = page.regions();
+
+		mX0.reserve(regions.size());
+		mY0.reserve(regions.size());
+		mX1.reserve(regions.size());
+		mY1.reserve(regions.size());
+		mIsText.reserve(regions.size());
+
+		for (const QSharedPointer<Region>& r : regions) {
+
+			Region::Type t = r->type();
+
+			if (t == Region::type_text_line || t == Region::type_word || 
+				t == Region::type_table_cell || t == Region::type_root || 
+				t == Region::type_border || t == Region::type_unknown)
+				continue;
+
+			QRect rect = r->rect();
+
+			if (rect.isEmpty())
+				continue;
+
+			if (!r->hasPosition())
+				mHasPositions = false;
+
+			mX0.push_back(rect.left());
+			mY0.push_back(rect.top());
+			mX1.push_back(rect.left() + rect.width());
+			mY1.push_back(rect.top() + rect.height());
+			mIsText.push_back(t == Region::type_text_region);
+		}
+
+		const int n = numBlocks();
+
+		if (n > 0) {
+			mMinX = *std::min_element(mX0.begin(), mX0.end());
+			mMinY = *std::min_element(mY0.begin(), mY0.end());
+			mMaxX = *std::max_element(mX1.begin(), mX1.end());
+			mMaxY = *std::max_element(mY1.begin(), mY1.end());
+		}
+
+		mWidth = page.image().width();
+		mHeight = page.image().height();
+
+		// fall back to the content if the image size is unknown
+		if (mWidth <= 0 || mHeight <= 0) {
+			mWidth = mMaxX;
+			mHeight = mMaxY;
+		}
+	}
+
+	/// <summary>
+	/// Returns false if a block's position is unknown.
+	/// The layout features are meaningless then.
+	/// </summary>
+	bool PageLayout::hasPositions() const {
+		return mHasPositions;
+	}
+
+	/// <summary>
+	/// Returns the left margin relative to the page width.
+	/// </summary>
+	double PageLayout::marginLeft() const {
+
+		if (numBlocks() == 0 || mWidth <= 0)
+			return 0.0;
+
+		return qBound(0.0, (double)mMinX / mWidth, 1.0);
+	}
+
+	double PageLayout::marginRight() const {
+
+		if (numBlocks() == 0 || mWidth <= 0)
+			return 0.0;
+
+		return qBound(0.0, (double)(mWidth - mMaxX) / mWidth, 1.0);
+	}
+
+	double PageLayout::marginTop() const {
+
+		if (numBlocks() == 0 || mHeight <= 0)
+			return 0.0;
+
+		return qBound(0.0, (double)mMinY / mHeight, 1.0);
+	}
+
+	double PageLayout::marginBottom() const {
+
+		if (numBlocks() == 0 || mHeight <= 0)
+			return 0.0;
+
+		return qBound(0.0, (double)(mHeight - mMaxY) / mHeight, 1.0);
+	}
+
+	/// <summary>
+	/// Estimates the number of text columns.
+	/// The heights of text blocks are projected onto the x-axis.
+	/// Columns are runs of bins which are covered by at least 20%
+	/// of the strongest bin, so headers and footers spanning
+	/// the whole page do not merge columns.
+	/// </summary>
+	int PageLayout::columnCount() const {
+
+		const int numBins = 128;
+		const int cw = mMaxX - mMinX;
+
+		if (cw <= 0)
+			return 0;
+
+		std::vector<double> hist(numBins, 0.0);
+		const double s = (double)numBins / cw;
+
+		for (size_t idx = 0; idx < mX0.size(); idx++) {
+
+			if (!mIsText[idx])
+				continue;
+
+			int b0 = qBound(0, (int)((mX0[idx] - mMinX) * s), numBins - 1);
+			int b1 = qBound(0, (int)((mX1[idx] - mMinX) * s), numBins - 1);
+			double h = mY1[idx] - mY0[idx];
+
+			for (int b = b0; b <= b1; b++)
+				hist[b] += h;
+		}
+
+		double maxCov = *std::max_element(hist.begin(), hist.end());
+
+		if (maxCov <= 0)
+			return 0;
+
+		int nc = 0;
+		bool inColumn = false;
+
+		for (double c : hist) {
+
+			bool covered = c >= 0.2 * maxCov;
+
+			if (covered && !inColumn)
+				nc++;
+
+			inColumn = covered;
+		}
+
+		return nc;
+	}
+
+	/// <summary>
+	/// Returns the fraction of the page which is not covered by blocks.
+	/// Overlapping blocks are counted once: blocks are drawn into a
+	/// coarse occupancy grid (1/256 of the page's longer side per cell).
+	/// </summary>
+	double PageLayout::whitespaceRatio() const {
+
+		if (mWidth <= 0 || mHeight <= 0)
+			return 0.0;
+
+		if (numBlocks() == 0)
+			return 1.0;
+
+		const double s = 256.0 / qMax(mWidth, mHeight);
+		cv::Mat grid(qMax(qRound(mHeight * s), 1), qMax(qRound(mWidth * s), 1), CV_8UC1, cv::Scalar(0));
+		const cv::Rect gr(0, 0, grid.cols, grid.rows);
+
+		for (size_t idx = 0; idx < mX0.size(); idx++) {
+
+			cv::Rect r(
+				cv::Point(qRound(mX0[idx] * s), qRound(mY0[idx] * s)),
+				cv::Point(qRound(mX1[idx] * s), qRound(mY1[idx] * s)));
+			r &= gr;
+
+			if (r.area() > 0)
+				grid(r).setTo(1);
+		}
+
+		return 1.0 - (double)cv::countNonZero(grid) / grid.total();
+	}
+
+	/// <summary>
+	/// Returns the fraction of consecutive text blocks which jump back.
+	/// A jump is backwards if the next block starts above the previous
+	/// one without moving to a column on its right. Pages in
+	/// reading order have values close to 0.
+	/// </summary>
+	double PageLayout::readingOrderDisorder() const {
+
+		int numPairs = 0;
+		int numBack = 0;
+		int last = -1;
+
+		for (int idx = 0; idx < numBlocks(); idx++) {
+
+			if (!mIsText[idx])
+				continue;
+
+			if (last >= 0) {
+
+				// the center is above the previous block's top
+				bool up = mY0[idx] + mY1[idx] < 2 * mY0[last];
+				bool right = mX0[idx] >= mX1[last] - (mX1[last] - mX0[last]) / 4;
+
+				if (up && !right)
+					numBack++;
+
+				numPairs++;
+			}
+
+			last = idx;
+		}
+
+		return numPairs > 0 ? (double)numBack / numPairs : 0.0;
+	}
+
+	int PageLayout::numBlocks() const {
+		return (int)mX0.size();
+	}
+
+	// -------------------------------------------------------------------- LayoutStatistics 
+	LayoutStatistics::LayoutStatistics() {
+	}
+
+	/// <summary>
+	/// Computes the layout features of all pages.
+	/// </summary>
+	/// <param name="pages">The pages.</param>
+	/// <returns>The layout statistics.</returns>
+	LayoutStatistics LayoutStatistics::compute(const QVector<QSharedPointer<PageData> >& pages) {
+
+		// a row per page - so threads do not share cache lines
+		cv::Mat stats(pages.size(), l_end, CV_32FC1, cv::Scalar(0));
+
+		cv::parallel_for_(cv::Range(0, pages.size()), [&](const cv::Range& range) {
+
+			for (int pIdx = range.start; pIdx < range.end; pIdx++) {
+
+				PageLayout pl(*pages[pIdx]);
+				float* sp = stats.ptr<float>(pIdx);
+
+				for (int s = 0; s < l_end; s++)
+					sp[s] = (float)value(pl, (Statistic)s);
+			}
+		});
+
+		LayoutStatistics ls;
+		cv::transpose(stats, ls.mData);
+
+		return ls;
+	}
+
+	/// <summary>
+	/// Returns a layout feature of a page.
+	/// </summary>
+	/// <param name="layout">The page's layout.</param>
+	/// <param name="s">The feature.</param>
+	/// <returns>The feature's value or NaN if the block positions are unknown.</returns>
+	double LayoutStatistics::value(const PageLayout & layout, const Statistic & s) {
+
+		if (!layout.hasPositions())
+			return std::numeric_limits<double>::quiet_NaN();
+
+		switch (s) {
+		case l_margin_left:		return layout.marginLeft();
+		case l_margin_right:	return layout.marginRight();
+		case l_margin_top:		return layout.marginTop();
+		case l_margin_bottom:	return layout.marginBottom();
+		case l_columns:			return layout.columnCount();
+		case l_whitespace:		return layout.whitespaceRatio();
+		case l_reading_order:	return layout.readingOrderDisorder();
+		case l_end: break;
+		}
+
+		return 0.0;
+	}
+
+	/// <summary>
+	/// Replaces the statistics of a page range.
+	/// Use this if documents were replaced or appended - only the new pages are computed.
+	/// </summary>
+	/// <param name="firstPage">The index of the first page that changed.</param>
+	/// <param name="numRemoved">The number of pages that were removed at firstPage.</param>
+	/// <param name="pages">The pages which were inserted at firstPage.</param>
+	void LayoutStatistics::splice(int firstPage, int numRemoved, const QVector<QSharedPointer<PageData> >& pages) {
+		mData = Math::spliceCols(mData, firstPage, numRemoved, compute(pages).data());
+	}
+
+	int LayoutStatistics::numPages() const {
+		return mData.cols;
+	}
+
+	/// <summary>
+	/// Returns the statistics with a row per statistic and a column per page.
+	/// </summary>
+	cv::Mat LayoutStatistics::data() const {
+		return mData;
+	}
+}
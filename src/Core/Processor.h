@@ -33,9 +33,13 @@
 
 #include "PageData.h"
 #include "DisplayData.h"
+#include "Algorithm.h"
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QString>
+#include <QMap>
+
+#include <functional>
 #pragma warning(pop)
 
 #pragma warning (disable: 4251)	// inlined Qt functions in dll interface
@@ -49,62 +53,196 @@
 #endif
 
 // Qt defines
+class QTemporaryFile;
 
 namespace pie {
 
 // pie defines
 
-namespace math {
-
-	/// <summary>
-	/// Computes robust statistical moments (quantiles).
-	/// </summary>
-	/// <param name="valuesIn">The statistical set (samples).</param>
-	/// <param name="momentValue">The statistical moment value (0.5 = median, 0.25 and 0.75 = quartiles).</param>
-	/// <param name="interpolated">A flag if the value should be interpolated if the length of the list is even.</param>
-	/// <returns>The statistical moment.</returns>
-	template <typename numFmt>
-	static double statMoment(const QList<numFmt>& valuesIn, double momentValue, bool interpolated = true) {
-
-		// no stat moment if we have 1 value
-		if (valuesIn.size() == 1)
-			return valuesIn[0];
-
-		// return mean if we have two & interpolation is turned on
-		if (valuesIn.size() == 2 && interpolated) {
-			return (valuesIn[0] + valuesIn[1]) / 2.0;
-		}
-		else if (valuesIn.size() == 2)
-			return valuesIn[0];
-
-		QList<numFmt> values = valuesIn;
-		qSort(values);
-
-		size_t lSize = values.size();
-		double moment = -1;
-		unsigned int momIdx = cvCeil(lSize*momentValue);
-		unsigned int idx = 1;
-
-		// find the statistical moment
-		for (auto val : values) {
-
-			// skip
-			if (idx < momIdx) {
-				idx++;
-				continue;
-			}
-
-			// compute mean between this and the next element
-			if (lSize % 2 == 0 && momIdx < lSize && interpolated)
-				moment = ((double)val + values[idx + 1])*0.5;
-			else
-				moment = (double)val;
-			break;
-		}
-
-		return moment;
-	}
-}
+/// <summary>
+/// Serves features from a model of the whole collection (e.g. its
+/// RegionStatistics) instead of evaluating a kernel per page.
+/// The extractor returns the model's values with a row per
+/// feature and a column per page. Providers are registered in
+/// the FeatureRegistry and features refer to a row of their provider.
+/// </summary>
+class DllExport FeatureProvider {
+
+public:
+	typedef std::function<cv::Mat(const Collection&)> Extractor;	// CV_32FC1 - a row per feature and a column per page
+	typedef std::function<bool(const Collection&)> Condition;
+
+	FeatureProvider(const QString& name = QString(), Extractor extractor = Extractor());
+
+	bool isEmpty() const;
+	QString name() const;
+	cv::Mat extract(const Collection& c) const;
+
+	bool isDerived() const;
+	void setDerived(bool derived);
+
+	bool isAvailable(const Collection& c) const;
+	void setCondition(Condition condition);
+
+private:
+	QString mName;
+	Extractor mExtractor;
+	Condition mCondition;
+	bool mDerived = false;	// the model needs all pages (and other features)
+};
+
+/// <summary>
+/// A scalar page feature (e.g. the number of regions).
+/// Page features evaluate their kernel on the page while
+/// region features evaluate it on each region and the
+/// page's value is the median of all regions.
+/// </summary>
+class DllExport Feature {
+
+public:
+	typedef std::function<double(const PageData&)> PageKernel;
+	typedef std::function<double(const Region&)> RegionKernel;
+
+	Feature();
+
+	static Feature page(const QString& key, const QString& name, PageKernel kernel, const FieldProjection& fields);
+	static Feature region(const QString& key, const QString& name, RegionKernel kernel);
+
+	bool isEmpty() const;
+	bool isRegionFeature() const;
+
+	int id() const;
+	QString key() const;
+	QString name() const;
+	QString group() const;
+	void setGroup(const QString& group);
+	FieldProjection requiredFields() const;
+
+	Region::Property rangeHint() const;
+	void setRangeHint(const Region::Property& p);
+
+	int provider() const;
+	int providerRow() const;
+	void setProvider(int provider, int row);
+
+	bool isDerived() const;
+	bool isAvailable(const Collection& c) const;
+
+	PageKernel pageKernel() const;
+	RegionKernel regionKernel() const;
+
+	double compute(const PageData& page) const;
+
+private:
+	friend class FeatureRegistry;
+
+	int mId = -1;
+	QString mKey;
+	QString mName;
+	QString mGroup;
+	FieldProjection mFields = FieldProjection(false);
+	Region::Property mRangeHint = Region::prop_end;	// the feature is bound by this region property
+	int mProvider = -1;		// if >= 0 the feature is read from this FeatureProvider
+	int mProviderRow = -1;	// the feature's row of the provider's values
+
+	PageKernel mPageKernel;
+	RegionKernel mRegionKernel;
+};
+
+/// <summary>
+/// Holds all features which can be plotted.
+/// Features register with a unique key, the returned id is
+/// the axis index. Built-in features are registered in the
+/// order of AbstractMapper::Type so that saved axis indices stay valid.
+/// Features which read the same fields are fused into one pass.
+/// </summary>
+class DllExport FeatureRegistry {
+
+public:
+	static FeatureRegistry& instance();
+
+	int add(const Feature& feature);
+	int addProvider(const FeatureProvider& provider);
+
+	int numFeatures() const;
+	Feature feature(int id) const;
+	int id(const QString& key) const;
+	QVector<Feature> features() const;
+
+	FeatureProvider provider(int id) const;
+	int providerId(const QString& name) const;
+
+	QVector<QVector<int> > fuse(const QVector<int>& ids) const;
+	QVector<int> baseFeatures(const Collection& c) const;
+
+	void prepare(const Collection& c, const QVector<int>& ids) const;
+	cv::Mat compute(const Collection& c, const QVector<int>& ids) const;
+	cv::Mat compute(const Collection& c, const QVector<QSharedPointer<PageData> >& pages, const QVector<int>& ids, const cv::Range& range) const;
+
+private:
+	FeatureRegistry();
+	FeatureRegistry(const FeatureRegistry&);
+	
+	void registerBuiltins();
+
+	QVector<Feature> mFeatures;
+	QMap<QString, int> mKeys;
+	QVector<FeatureProvider> mProviders;
+};
+
+/// <summary>
+/// Maps raw feature values to screen coordinates [-1 1].
+/// Besides a linear mapping, robust transforms are available
+/// so that single outliers (e.g. a 20000 px scan) do not squash
+/// all other points into a corner. The raw min/max and the
+/// transform's parameters are kept so that screen coordinates
+/// can be mapped back to real units (e.g. for axis ticks).
+/// </summary>
+class DllExport AxisTransform {
+
+public:
+	enum Mode {
+		t_linear = 0,
+		t_log,
+		t_asinh,
+		t_rank,
+		t_robust_z,
+		t_percentile,
+		t_region_range,
+
+		t_end
+	};
+
+	AxisTransform(const Mode& mode = t_linear);
+
+	void apply(cv::Mat& data, const cv::Vec2d& range = cv::Vec2d());
+	double toValue(double screen) const;
+
+	Mode mode() const;
+	void setMode(const Mode& mode);
+
+	double minValue() const;
+	double maxValue() const;
+
+	static QString name(const Mode& mode);
+
+private:
+	double forward(double v) const;
+	double inverse(double t) const;
+
+	static cv::Vec2d minMax(const cv::Mat& data);
+
+	Mode mMode = t_linear;
+
+	double mMin = 0.0;		// raw min
+	double mMax = 0.0;		// raw max
+	double mCenter = 0.0;	// median for robust z
+	double mScale = 1.0;	// scale for asinh & robust z
+	double mLow = 0.0;		// transformed value at -1
+	double mHigh = 0.0;		// transformed value at 1
+
+	std::vector<double> mPercentiles;	// needed to invert ranks
+};
 
 class DllExport AbstractMapper {
 
@@ -118,88 +256,237 @@ public:
 		m_img_width,
 		m_img_height,
 
-		m_end
+		m_reg_count,
+		m_text_length,
+		m_img_aspect_ratio,
+		m_reg_aspect_ratio,
+
+		m_end	// region type counts (and user features) follow
 	};
 
 	AbstractMapper();
-	static QSharedPointer<AbstractMapper> create(const Type& type);
+	static QSharedPointer<AbstractMapper> create(int type);
 
-	Type type() const;
+	int type() const;
 	QString name() const;
 	virtual cv::Mat process(Collection* c) const = 0;
+	virtual FieldProjection requiredFields() const = 0;
+
+	static cv::Mat processAll(const Collection* c, const QVector<int>& types, QVector<AxisTransform>* transforms = 0);
+	static FieldProjection collectFields(const QVector<int>& types);
+	static cv::Vec2d rangeHint(const Collection& c, const Feature& feature);
 
 protected:
 
 	QString mName;
-	Type mType = m_undefined;
+	int mType = m_undefined;
 };
 
-
-class DllExport RegionMapper : public AbstractMapper {
+/// <summary>
+/// Maps a registered feature to screen coordinates.
+/// </summary>
+class DllExport FeatureMapper : public AbstractMapper {
 
 public:
-	cv::Mat process(Collection* c) const;
+	FeatureMapper(const Feature& feature);
 
-protected:
-	virtual std::function<double(const Region&)> processor() const = 0;
+	cv::Mat process(Collection* c) const override;
+	FieldProjection requiredFields() const override;
+
+private:
+	Feature mFeature;
 };
 
-class DllExport PageMapper : public AbstractMapper {
+/// <summary>
+/// Shares mapped feature columns between plots.
+/// A column is computed once per feature and transform mode and
+/// all plots hold the same buffer, so a scatter plot matrix of
+/// N features needs N columns and not N^2 copies.
+/// The raw feature values are kept too: other transform modes
+/// do not recompute the feature and if pages are replaced or
+/// appended (see splice()), only the new pages are computed.
+/// Other changes of the pages must clear() the cache.
+/// Raw values can be evicted to a spill file (see evict()),
+/// they are read back when columns are requested again.
+/// </summary>
+class DllExport FeatureCache {
 
 public:
-	cv::Mat process(Collection* c) const;
+	FeatureCache(const Collection* collection = 0);
 
-protected:
-	virtual std::function<double(const PageData&)> processor() const = 0;
-};
+	QVector<cv::Mat> columns(const QVector<int>& ids, QVector<AxisTransform>& transforms);
+	cv::Mat column(int id, AxisTransform& transform);
+	cv::Mat correlation(const QVector<int>& ids, QVector<AxisTransform>& transforms);
 
-class DllExport WidthMapper : public RegionMapper {
+	void splice(int firstPage, int numRemoved, int numAdded);
+	void invalidate(int id);
+	void clear();
 
-public:
-	WidthMapper();
+	qint64 evict();
+	qint64 memorySize() const;
+	qint64 diskSize() const;
+	int numColumns() const;
 
-protected:
-	virtual std::function<double(const Region&)> processor() const;
+private:
+	struct Column {
+		cv::Mat data;			// 1 x pages in screen coordinates
+		AxisTransform transform;
+	};
+
+	Column fit(int id, const cv::Mat& raw, const AxisTransform::Mode& mode) const;
+	void restore();
+	static qint64 ownedBytes(const cv::Mat& m);
 
+	const Collection* mCollection = 0;
+	QMap<QPair<int, int>, Column> mColumns;		// (feature id, transform mode)
+	QMap<int, cv::Mat> mRaw;					// feature id -> 1 x pages raw values
+	QSharedPointer<QTemporaryFile> mSpill;		// the evicted raw values
+	int mNumPages = 0;
 };
 
-class DllExport HeightMapper : public RegionMapper {
+/// <summary>
+/// Region statistics of all pages computed in a single sweep.
+/// Regions of a page are visited once and bucketed by type.
+/// For all regions and for each Region::Type, it holds the
+/// count and mean, median, quartiles, min and max of
+/// each Region::Property. Pages are processed in parallel.
+/// </summary>
+class DllExport RegionStatistics {
 
 public:
-	HeightMapper();
+	enum Statistic {
+		s_count = 0,
+		s_mean,
+		s_median,
+		s_q25,
+		s_q75,
+		s_min,
+		s_max,
+
+		s_end
+	};
 
-protected:
-	virtual std::function<double(const Region&)> processor() const;
+	RegionStatistics();
+
+	static RegionStatistics compute(const QVector<QSharedPointer<PageData> >& pages);
+	void splice(int firstPage, int numRemoved, const QVector<QSharedPointer<PageData> >& pages);
+
+	static int numStatistics();
+	static int index(const Statistic& s, const Region::Property& p = Region::p_width, const Region::Type& type = Region::type_end);
+	static QString name(int index);
+	static QString statisticName(const Statistic& s);
+	static QString propertyName(const Region::Property& p);
+
+	int numPages() const;
+	cv::Mat data() const;
+
+private:
+	static int groupSize();
 
+	cv::Mat mData;	// a row per statistic and a column per page
 };
 
-class DllExport AreaMapper : public RegionMapper {
+/// <summary>
+/// Region size distributions of a collection and its documents.
+/// Each document is summarized by QuantileSketches (built in parallel)
+/// which are merged to the collection's distribution. Hence,
+/// the memory does not depend on the number of regions.
+/// </summary>
+class DllExport RegionDistribution {
 
 public:
-	AreaMapper();
+	RegionDistribution();
 
-protected:
-	virtual std::function<double(const Region&)> processor() const;
+	static RegionDistribution compute(const Collection& c);
+	void splice(const Collection& c, int firstDoc, int numRemoved, int numAdded);
+
+	QuantileSketch sketch(const Region::Property& p, int docIdx = -1) const;
+	int numDocuments() const;
+	int numPages() const;
+
+	QString toString() const;
 
+private:
+	static QVector<QuantileSketch> sketch(const Document& doc, int docIdx);
+	void merge();
+
+	QVector<QVector<QuantileSketch> > mDocuments;	// [document][property]
+	QVector<QuantileSketch> mCollection;			// [property]
+	int mNumPages = 0;
 };
 
-class DllExport PageWidthMapper : public PageMapper {
+/// <summary>
+/// Position dependent layout features of a page.
+/// The bounding boxes of the page's block regions (text, images,
+/// tables, separators...) are copied into contiguous coordinate
+/// arrays once so that all features are tight loops over them.
+/// Lines and words are ignored since they are nested in blocks.
+/// The features are only valid if the positions of all blocks
+/// are known (see hasPositions()).
+/// </summary>
+class DllExport PageLayout {
 
 public:
-	PageWidthMapper();
+	PageLayout(const PageData& page);
 
-protected:
-	virtual std::function<double(const PageData&)> processor() const;
+	bool hasPositions() const;
+
+	double marginLeft() const;
+	double marginRight() const;
+	double marginTop() const;
+	double marginBottom() const;
+
+	int columnCount() const;
+	double whitespaceRatio() const;
+	double readingOrderDisorder() const;
+
+	int numBlocks() const;
+
+private:
+	std::vector<int> mX0, mY0, mX1, mY1;	// block bounding boxes
+	std::vector<char> mIsText;
+	int mWidth = 0;
+	int mHeight = 0;
+
+	// the content's bounding box
+	int mMinX = 0, mMinY = 0;
+	int mMaxX = 0, mMaxY = 0;
+
+	bool mHasPositions = true;
 };
 
-class DllExport PageHeightMapper : public PageMapper {
+/// <summary>
+/// Layout features of all pages (see PageLayout).
+/// The layout of a page is built once and all of its
+/// features are stored, so layout axes do not rebuild
+/// the block arrays per feature. Pages are processed in parallel.
+/// </summary>
+class DllExport LayoutStatistics {
 
 public:
-	PageHeightMapper();
+	enum Statistic {
+		l_margin_left = 0,
+		l_margin_right,
+		l_margin_top,
+		l_margin_bottom,
+		l_columns,
+		l_whitespace,
+		l_reading_order,
+
+		l_end
+	};
 
-protected:
-	virtual std::function<double(const PageData&)> processor() const;
+	LayoutStatistics();
 
+	static LayoutStatistics compute(const QVector<QSharedPointer<PageData> >& pages);
+	static double value(const PageLayout& layout, const Statistic& s);
+	void splice(int firstPage, int numRemoved, const QVector<QSharedPointer<PageData> >& pages);
+
+	int numPages() const;
+	cv::Mat data() const;
+
+private:
+	cv::Mat mData;	// a row per statistic and a column per page
 };
 
 class DllExport DisplayConverter {
@@ -219,12 +506,15 @@ private:
 namespace cmp {
 
 	DllExport double numRegions(const PageData* pd);
+	DllExport double textLength(const PageData* pd);
+	DllExport double aspectRatio(const PageData* pd);
 
 	DllExport typedef double(*Manipulator)(const PageData* pd);
 }
 
 namespace test {
 	DllExport bool Processor(const Collection& c);
+	DllExport bool Quantiles();
 }
 
 }
\ No newline at end of file
@@ -53,6 +53,11 @@ AppSettings::AppSettings() {
 void AppSettings::defaultSettings() {
 
 	recentFiles = QStringList();
+	lazyText = false;
+	loadFields = "";
+	sampleSize = 0;
+	watchFiles = false;
+	memoryBudget = 4096;
 }
 
 void AppSettings::addRecentFile(const QString& filePath) {
@@ -70,6 +75,11 @@ void AppSettings::load(QSettings& settings) {
 
 	recentFiles = settings.value("recentFiles", "").toString().split(",");
 	recentFiles.removeAll("");
+	lazyText = settings.value("lazyText", lazyText).toBool();
+	loadFields = settings.value("loadFields", loadFields).toString();	// NOTE: not saved since it can be overwritten by the command line
+	sampleSize = settings.value("sampleSize", sampleSize).toInt();
+	watchFiles = settings.value("watchFiles", watchFiles).toBool();	// NOTE: not saved since it can be overwritten by the command line
+	memoryBudget = settings.value("memoryBudget", memoryBudget).toInt();	// NOTE: not saved since it can be overwritten by the command line
 
 	settings.endGroup();
 }
@@ -79,6 +89,8 @@ void AppSettings::save(QSettings& settings) const {
 	settings.beginGroup(mName);
 
 	settings.setValue("recentFiles", recentFiles.join(","));
+	settings.setValue("lazyText", lazyText);
+	settings.setValue("sampleSize", sampleSize);
 
 	settings.endGroup();
 }
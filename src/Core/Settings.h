@@ -73,6 +73,11 @@ public:
 	AppSettings();
 
 	QStringList recentFiles;
+	bool lazyText = false;	// keep page texts on disk
+	QString loadFields;		// fields that are loaded (e.g. "image,regions") - empty loads all
+	int sampleSize = 0;		// number of pages shown first, the rest is loaded in the background (0 loads all pages at once)
+	bool watchFiles = false;	// apply changes of open databases (e.g. appended documents)
+	int memoryBudget = 4096;	// MB used by all tabs, hidden tabs are evicted if it is exceeded (0 disables eviction)
 
 	void addRecentFile(const QString& filePath);
 
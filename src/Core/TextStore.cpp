@@ -0,0 +1,182 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#include "TextStore.h"
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QDebug>
+#include <QDir>
+#include <QMutexLocker>
+#pragma warning(pop)
+
+namespace pie {
+
+	// -------------------------------------------------------------------- TextStore
+	/// <summary>
+	/// Creates an empty text store.
+	/// </summary>
+	/// <param name="cacheSize">The number of texts kept in RAM.</param>
+	TextStore::TextStore(int cacheSize) : mFile(QDir::tempPath() + "/pie-text-XXXXXX.bin") {
+		mCache.setMaxCost(cacheSize);
+	}
+
+	/// <summary>
+	/// Appends the text to the spill file.
+	/// </summary>
+	/// <param name="text">The page's transcription.</param>
+	/// <returns>The text's id which is needed to retrieve it.</returns>
+	int TextStore::add(const QString& text) {
+
+		QMutexLocker lock(&mMutex);
+
+		Entry e;
+		e.length = text.length();
+
+		// do not waste disk space for empty pages
+		if (!text.isEmpty()) {
+
+			if (!mFile.isOpen() && !mFile.open()) {
+				qCritical() << "[TextStore] cannot open spill file" << mFile.fileName();
+				return -1;
+			}
+
+			QByteArray ba = qCompress(text.toUtf8());
+
+			e.offset = mFile.size();
+			e.numBytes = ba.size();
+
+			mFile.seek(e.offset);
+			if (mFile.write(ba) != ba.size()) {
+				qCritical() << "[TextStore] could not write to" << mFile.fileName();
+				return -1;
+			}
+		}
+
+		mEntries << e;
+
+		return mEntries.size() - 1;
+	}
+
+	/// <summary>
+	/// Returns the text with the given id.
+	/// The text is loaded from disk if it is not cached.
+	/// </summary>
+	/// <param name="id">The text id returned by add().</param>
+	/// <returns>The text or an empty string if the id is illegal.</returns>
+	QString TextStore::text(int id) const {
+
+		QMutexLocker lock(&mMutex);
+
+		if (id < 0 || id >= mEntries.size())
+			return QString();
+
+		const Entry& e = mEntries[id];
+
+		if (e.numBytes == 0)
+			return QString();
+
+		QString* t = mCache.object(id);
+		if (t)
+			return *t;
+
+		QString text = QString::fromUtf8(qUncompress(read(e)));
+		mCache.insert(id, new QString(text));
+
+		return text;
+	}
+
+	/// <summary>
+	/// Returns the number of characters of a text without loading it.
+	/// </summary>
+	int TextStore::length(int id) const {
+
+		QMutexLocker lock(&mMutex);
+
+		if (id < 0 || id >= mEntries.size())
+			return 0;
+
+		return mEntries[id].length;
+	}
+
+	int TextStore::size() const {
+
+		QMutexLocker lock(&mMutex);
+		return mEntries.size();
+	}
+
+	qint64 TextStore::diskSize() const {
+
+		QMutexLocker lock(&mMutex);
+		return mFile.isOpen() ? mFile.size() : 0;
+	}
+
+	/// <summary>
+	/// Returns the number of bytes kept in RAM (offsets and cached texts).
+	/// </summary>
+	qint64 TextStore::memorySize() const {
+
+		QMutexLocker lock(&mMutex);
+
+		qint64 s = (qint64)mEntries.capacity() * sizeof(Entry);
+
+		for (int id : mCache.keys())
+			s += (qint64)mCache.object(id)->capacity() * sizeof(QChar);
+
+		return s;
+	}
+
+	void TextStore::setCacheSize(int numTexts) {
+
+		QMutexLocker lock(&mMutex);
+		mCache.setMaxCost(numTexts);
+	}
+
+	/// <summary>
+	/// Removes all cached texts - they are paged in again on demand.
+	/// </summary>
+	void TextStore::clearCache() {
+
+		QMutexLocker lock(&mMutex);
+		mCache.clear();
+	}
+
+	QByteArray TextStore::read(const Entry & e) const {
+
+		// NOTE: the mutex is locked by the caller
+		if (!mFile.seek(e.offset)) {
+			qWarning() << "[TextStore] cannot seek to" << e.offset;
+			return QByteArray();
+		}
+
+		return mFile.read(e.numBytes);
+	}
+
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************************************
+ PIE is the Page Image Explorer developed at CVL/TU Wien for the EU project READ.
+
+ Copyright (C) 2018 Markus Diem <diem@caa.tuwien.ac.at>
+ Copyright (C) 2018 Florian Kleber <kleber@caa.tuwien.ac.at>
+
+ This file is part of PIE.
+
+ ReadFramework is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ ReadFramework is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ The READ project  has  received  funding  from  the European  Union’s  Horizon  2020
+ research  and innovation programme under grant agreement No 674943
+
+ related links:
+ [1] https://cvl.tuwien.ac.at/
+ [2] https://transkribus.eu/Transkribus/
+ [3] https://github.com/TUWien/
+ [4] https://nomacs.org
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0)	// no warnings from includes
+#include <QString>
+#include <QVector>
+#include <QCache>
+#include <QMutex>
+#include <QTemporaryFile>
+#pragma warning(pop)
+
+#pragma warning (disable: 4251)	// inlined Qt functions in dll interface
+
+#ifndef DllExport
+#ifdef DLL_CORE_EXPORT
+#define DllExport Q_DECL_EXPORT
+#else
+#define DllExport Q_DECL_IMPORT
+#endif
+#endif
+
+// Qt defines
+
+namespace pie {
+
+/// <summary>
+/// Keeps page transcriptions out of core.
+/// Texts are compressed and appended to a temporary
+/// spill file. Only the byte offsets stay in RAM and
+/// texts are paged in on demand through an LRU cache.
+/// </summary>
+class DllExport TextStore {
+
+public:
+	TextStore(int cacheSize = 256);
+
+	int add(const QString& text);
+	QString text(int id) const;
+	int length(int id) const;
+
+	int size() const;
+	qint64 diskSize() const;
+	qint64 memorySize() const;
+
+	void setCacheSize(int numTexts);
+	void clearCache();
+
+private:
+	struct Entry {
+		qint64 offset = 0;
+		int numBytes = 0;
+		int length = 0;
+	};
+
+	QByteArray read(const Entry& e) const;
+
+	mutable QTemporaryFile mFile;
+	mutable QCache<int, QString> mCache;
+	mutable QMutex mMutex;
+
+	QVector<Entry> mEntries;
+};
+
+}
@@ -32,6 +32,8 @@
 
 #include "Utils.h"
 #include "Network.h"
+#include "Compression.h"
+#include "JsonStream.h"
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QApplication>
@@ -48,8 +50,12 @@
 #include <QDateTime>
 #include <QPixmap>
 #include <QPainter>
+#include <QElapsedTimer>
+#include <QAtomicInt>
 
 #include <opencv2/core.hpp>
+
+#include <climits>
 #pragma warning(pop)
 
 // needed for registering the file version
@@ -182,16 +188,15 @@ bool Utils::loadToBuffer(const QString & filePath, QByteArray & ba) {
 	
 	if (QFileInfo(filePath).exists()) {
 
-		QFile f(filePath);
+		// compressed files are decompressed on the fly
+		QSharedPointer<QIODevice> d = DecompressionDevice::openFile(filePath);
 
-		if (!f.open(QIODevice::ReadOnly)) {
-			qWarning() << "Sorry, I could not open " << filePath << " for reading...";
+		if (!d)
 			return false;
-		}
 
 		// load the element
-		ba = f.readAll();
-		f.close();
+		ba = d->readAll();
+		d->close();
 	}
 	// if there is no local resource - try downloading it
 	else if (QUrl(filePath).isValid()) {
@@ -328,6 +333,10 @@ QJsonObject Utils::readJson(const QString & filePath) {
 	return doc.object();
 }
 
+/// <summary>
+/// Writes a json object to a file.
+/// </summary>
+/// <returns>The number of bytes written or 0 on failure.</returns>
 int64 Utils::writeJson(const QString & filePath, const QJsonObject & jo) {
 
 	if (filePath.isEmpty()) {
@@ -345,15 +354,25 @@ int64 Utils::writeJson(const QString & filePath, const QJsonObject & jo) {
 		return 0;
 	}
 
-	QJsonDocument doc(jo);
-	int64 nb = file.write(doc.toJson());
+	// values are serialized one after another - use Collection::write() for databases
+	JsonStreamWriter writer(&file);
+	writer.beginObject();
+
+	for (auto it = jo.constBegin(); it != jo.constEnd(); ++it) {
+		writer.writeKey(it.key().toUtf8().constData());
+		writer.writeValue(it.value());
+	}
+
+	writer.endObject();
 
-	if (nb == -1)
+	if (!writer.flush()) {
 		qCritical() << "could not write data to" << filePath;
-	else
-		qDebug() << nb << "bytes written to" << filePath;
+		return 0;
+	}
+
+	qDebug() << writer.bytesWritten() << "bytes written to" << filePath;
 
-	return 0;
+	return writer.bytesWritten();
 }
 
 void Utils::initDefaultFramework() {
@@ -375,10 +394,14 @@ bool Utils::isValidFile(const QString & filePath) {
 	if (!fInfo.exists())
 		return false;
 
+	// folders of shards or PAGE XML files
+	if (fInfo.isDir())
+		return true;
+
 	QString fileName = fInfo.fileName();
 
 	QStringList fileFilters;
-	fileFilters << "*.json";
+	fileFilters << "*.json" << "*.json.gz" << "*.json.zst" << "*.shards";
 
 	for (const QString& f : fileFilters) {
 
@@ -422,29 +445,125 @@ cv::Rect2d Converter::qRectToCv(const QRectF & r) {
 QPolygon Converter::stringToPoly(const QString& pointList) {
 
 	// we expect point pairs like that: <Coords points="1077,482 1167,482 1167,547 1077,547"/>
-	QStringList pairs = pointList.split(" ");
 	QPolygon poly;
+	parsePoints(QStringRef(&pointList), poly);
+
+	return poly;
+}
+
+namespace {
 
-	for (const QString pair : pairs) {
+	inline ushort charCode(char c) {
+		return (uchar)c;
+	}
 
-		QStringList points = pair.split(",");
+	inline ushort charCode(QChar c) {
+		return c.unicode();
+	}
 
-		if (points.size() != 2) {
-			qWarning() << "illegal point string: " << pair;
-			continue;
+	inline QString toString(const char* begin, const char* end) {
+		return QString::fromUtf8(begin, (int)(end - begin));
+	}
+
+	inline QString toString(const QChar* begin, const QChar* end) {
+		return QString(begin, (int)(end - begin));
+	}
+
+	inline bool isSeparator(ushort c) {
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	template <typename Char>
+	inline bool parseInt(const Char*& s, const Char* end, int& val) {
+
+		bool neg = false;
+
+		if (s < end && (charCode(*s) == '-' || charCode(*s) == '+')) {
+			neg = charCode(*s) == '-';
+			s++;
 		}
 
-		bool xok = false, yok = false;
-		int x = points[0].toInt(&xok);
-		int y = points[1].toInt(&yok);
+		const Char* start = s;
+		int v = 0;
 
-		if (xok && yok)
-			poly.append(QPoint(x, y));
-		else
-			qWarning() << "illegal point string: " << pair;
+		for (; s < end; s++) {
+
+			unsigned int d = (unsigned int)charCode(*s) - '0';
+
+			if (d > 9)
+				break;
+
+			// QString::toInt rejects numbers which do not fit into an int
+			if (v > (INT_MAX - (int)d) / 10)
+				return false;
+
+			v = v * 10 + (int)d;
+		}
+
+		val = neg ? -v : v;
+
+		return s != start;
 	}
 
-	return poly;
+	/// <summary>
+	/// Parses a PAGE point list (e.g. "1077,482 1167,482") in a single pass.
+	/// Illegal pairs are skipped with a warning (like QString::toInt would).
+	/// </summary>
+	template <typename Char>
+	int parsePointSpan(const Char* s, const Char* end, QVector<QPoint>& points) {
+
+		int numPoints = 0;
+
+		while (s < end) {
+
+			while (s < end && isSeparator(charCode(*s)))
+				s++;
+
+			if (s == end)
+				break;
+
+			const Char* pair = s;
+			int x = 0, y = 0;
+
+			if (parseInt(s, end, x) && s < end && charCode(*s) == ',' &&
+				parseInt(++s, end, y) && (s == end || isSeparator(charCode(*s)))) {
+				points.append(QPoint(x, y));
+				numPoints++;
+				continue;
+			}
+
+			// skip the illegal pair
+			while (s < end && !isSeparator(charCode(*s)))
+				s++;
+
+			qWarning() << "illegal point string: " << toString(pair, s);
+		}
+
+		return numPoints;
+	}
+}
+
+/// <summary>
+/// Appends the points of a PAGE point list.
+/// The list is parsed in place so nothing but the 
+/// points vector is allocated.
+/// </summary>
+/// <param name="pointList">A point list (e.g. an attribute of a QXmlStreamReader).</param>
+/// <param name="points">The points are appended to this vector.</param>
+/// <returns>The number of points parsed.</returns>
+int Converter::parsePoints(const QStringRef & pointList, QVector<QPoint>& points) {
+	return parsePointSpan(pointList.constData(), pointList.constData() + pointList.size(), points);
+}
+
+/// <summary>
+/// Appends the points of a PAGE point list given as UTF-8 (or latin1) bytes.
+/// </summary>
+/// <param name="begin">The first byte of the point list.</param>
+/// <param name="end">The end of the point list.</param>
+/// <param name="points">The points are appended to this vector.</param>
+/// <returns>The number of points parsed.</returns>
+int Converter::parsePoints(const char * begin, const char * end, QVector<QPoint>& points) {
+	return parsePointSpan(begin, end, points);
 }
 
 /// <summary>
@@ -476,6 +595,114 @@ cv::Point2d Converter::qPointToCv(const QPointF & pt) {
 	return cv::Point2d(pt.x(), pt.y());
 }
 
+// PolygonBuffer --------------------------------------------------------------------
+PolygonBuffer::PolygonBuffer() {
+	mOffsets << 0;
+}
+
+void PolygonBuffer::reserve(int numPolygons, int numPoints) {
+	mOffsets.reserve(numPolygons + 1);
+	mPoints.reserve(numPoints);
+}
+
+/// <summary>
+/// Removes all polygons but keeps the memory.
+/// </summary>
+void PolygonBuffer::clear() {
+	mPoints.resize(0);
+	mOffsets.resize(1);
+}
+
+/// <summary>
+/// Parses a point list and appends its polygon.
+/// </summary>
+/// <param name="pointList">A PAGE point list.</param>
+/// <returns>The polygon's index.</returns>
+int PolygonBuffer::add(const QStringRef & pointList) {
+
+	Converter::parsePoints(pointList, mPoints);
+	mOffsets << mPoints.size();
+
+	return size() - 1;
+}
+
+/// <summary>
+/// Parses a point list given as bytes and appends its polygon.
+/// </summary>
+/// <returns>The polygon's index.</returns>
+int PolygonBuffer::add(const char * begin, const char * end) {
+
+	Converter::parsePoints(begin, end, mPoints);
+	mOffsets << mPoints.size();
+
+	return size() - 1;
+}
+
+/// <summary>
+/// Appends a polygon which is already parsed.
+/// </summary>
+/// <returns>The polygon's index.</returns>
+int PolygonBuffer::add(const QPolygon & poly) {
+
+	mPoints << poly;
+	mOffsets << mPoints.size();
+
+	return size() - 1;
+}
+
+int PolygonBuffer::size() const {
+	return mOffsets.size() - 1;
+}
+
+int PolygonBuffer::numPoints() const {
+	return mPoints.size();
+}
+
+int PolygonBuffer::numPoints(int idx) const {
+	return mOffsets[idx + 1] - mOffsets[idx];
+}
+
+/// <summary>
+/// Returns the first point of a polygon.
+/// The pointer is valid until the next polygon is added.
+/// </summary>
+const QPoint * PolygonBuffer::points(int idx) const {
+	return mPoints.constData() + mOffsets[idx];
+}
+
+QPolygon PolygonBuffer::polygon(int idx) const {
+
+	QPolygon poly(numPoints(idx));
+	std::copy(points(idx), points(idx) + numPoints(idx), poly.begin());
+
+	return poly;
+}
+
+/// <summary>
+/// Returns the bounding box of a polygon (without copying it).
+/// </summary>
+QRect PolygonBuffer::boundingRect(int idx) const {
+
+	int n = numPoints(idx);
+
+	if (n == 0)
+		return QRect();
+
+	const QPoint* p = points(idx);
+	int minX = p[0].x(), maxX = p[0].x();
+	int minY = p[0].y(), maxY = p[0].y();
+
+	for (int pIdx = 1; pIdx < n; pIdx++) {
+		minX = qMin(minX, p[pIdx].x());
+		maxX = qMax(maxX, p[pIdx].x());
+		minY = qMin(minY, p[pIdx].y());
+		maxY = qMax(maxY, p[pIdx].y());
+	}
+
+	// same as QPolygon::boundingRect
+	return QRect(QPoint(minX, minY), QPoint(maxX, maxY));
+}
+
 // Timer --------------------------------------------------------------------
 /**
 * Initializes the class and stops the clock.
@@ -728,6 +955,73 @@ QPixmap ColorManager::colorizePixmap(const QPixmap& pm, const QColor& col, doubl
 
 	return pmc;
 }
+
+/// <summary>
+/// Returns the display name of a colormap.
+/// </summary>
+/// <param name="cm">The ColorMap.</param>
+QString ColorManager::colorMapName(int cm) {
+
+	switch (cm) {
+	case cm_viridis:	return QObject::tr("Viridis");
+	case cm_magma:		return QObject::tr("Magma");
+	case cm_coolwarm:	return QObject::tr("Cool Warm");
+	case cm_gray:		return QObject::tr("Gray");
+	}
+
+	return QObject::tr("Unknown");
+}
+
+/// <summary>
+/// Samples a colormap.
+/// The colormaps are linearly interpolated between a few stops.
+/// </summary>
+/// <param name="cm">The ColorMap.</param>
+/// <param name="size">The number of colors.</param>
+/// <returns>size colors from low to high values.</returns>
+QVector<QColor> ColorManager::colorMap(int cm, int size) {
+
+	QVector<QColor> stops;
+
+	switch (cm) {
+	case cm_magma:
+		stops << QColor(0, 0, 4) << QColor(24, 15, 61) << QColor(68, 15, 118) << QColor(114, 31, 129) << QColor(158, 47, 127)
+			<< QColor(205, 64, 113) << QColor(241, 96, 93) << QColor(253, 150, 104) << QColor(254, 202, 141) << QColor(252, 253, 191);
+		break;
+	case cm_coolwarm:
+		stops << QColor(59, 76, 192) << QColor(98, 130, 234) << QColor(141, 176, 254) << QColor(184, 208, 249) << QColor(221, 221, 221)
+			<< QColor(245, 196, 173) << QColor(244, 154, 123) << QColor(222, 96, 77) << QColor(180, 4, 38);
+		break;
+	case cm_gray:
+		// dark values are more visible on our (white) background
+		stops << QColor(220, 220, 220) << QColor(30, 30, 30);
+		break;
+	default:
+		stops << QColor(68, 1, 84) << QColor(72, 40, 120) << QColor(62, 73, 137) << QColor(49, 104, 142) << QColor(38, 130, 142)
+			<< QColor(31, 158, 137) << QColor(53, 183, 121) << QColor(110, 206, 88) << QColor(181, 222, 43) << QColor(253, 231, 37);
+		break;
+	}
+
+	QVector<QColor> cols;
+
+	for (int idx = 0; idx < size; idx++) {
+
+		double s = size > 1 ? (double)idx / (size - 1) * (stops.size() - 1) : 0.0;
+		int sIdx = qMin((int)s, stops.size() - 2);
+		double w = s - sIdx;
+
+		const QColor& c0 = stops[sIdx];
+		const QColor& c1 = stops[sIdx + 1];
+
+		cols << QColor(
+			qRound(c0.red() * (1.0 - w) + c1.red() * w),
+			qRound(c0.green() * (1.0 - w) + c1.green() * w),
+			qRound(c0.blue() * (1.0 - w) + c1.blue() * w));
+	}
+
+	return cols;
+}
+
 // -------------------------------------------------------------------- ThemeManager 
 ThemeManager & ThemeManager::instance() {
 	
@@ -746,4 +1040,146 @@ QColor ThemeManager::foreground() const {
 ThemeManager::ThemeManager() {
 }
 
+// -------------------------------------------------------------------- test 
+namespace test {
+
+	namespace {
+
+		/// <summary>
+		/// The stringToPoly implementation we had before Converter::parsePoints.
+		/// It is only kept as a reference for the benchmark.
+		/// </summary>
+		QPolygon legacyStringToPoly(const QString& pointList) {
+
+			QStringList pairs = pointList.split(" ");
+			QPolygon poly;
+
+			for (const QString pair : pairs) {
+
+				QStringList points = pair.split(",");
+
+				if (points.size() != 2)
+					continue;
+
+				bool xok = false, yok = false;
+				int x = points[0].toInt(&xok);
+				int y = points[1].toInt(&yok);
+
+				if (xok && yok)
+					poly.append(QPoint(x, y));
+			}
+
+			return poly;
+		}
+	}
+
+	/// <summary>
+	/// Compares the legacy point list parser with Converter::parsePoints.
+	/// Random PAGE point lists (4-64 points) are parsed by
+	/// the legacy parser, by PolygonBuffer from QStrings and raw bytes
+	/// and by one PolygonBuffer per thread from raw bytes.
+	/// </summary>
+	/// <returns>true if all parsers return the same points.</returns>
+	bool PolygonParsing() {
+
+		cv::RNG rng(42);
+		const int numPolygons = 100000;
+
+		QByteArray data;
+		QVector<int> offsets;
+		offsets << 0;
+
+		for (int pIdx = 0; pIdx < numPolygons; pIdx++) {
+
+			int n = rng.uniform(4, 65);
+
+			for (int idx = 0; idx < n; idx++) {
+
+				if (idx > 0)
+					data += ' ';
+
+				data += QByteArray::number(rng.uniform(0, 10000));
+				data += ',';
+				data += QByteArray::number(rng.uniform(0, 10000));
+			}
+
+			offsets << data.size();
+		}
+
+		QVector<QString> strings;
+		strings.reserve(numPolygons);
+		for (int pIdx = 0; pIdx < numPolygons; pIdx++)
+			strings << QString::fromLatin1(data.constData() + offsets[pIdx], offsets[pIdx + 1] - offsets[pIdx]);
+
+		const double mb = data.size() / (1024.0 * 1024.0);
+		QElapsedTimer t;
+
+		// legacy
+		t.start();
+		QVector<QPolygon> legacy;
+		legacy.reserve(numPolygons);
+		for (const QString& s : strings)
+			legacy << legacyStringToPoly(s);
+		qint64 tl = t.nsecsElapsed();
+
+		// QString spans
+		t.restart();
+		PolygonBuffer sb;
+		for (const QString& s : strings)
+			sb.add(QStringRef(&s));
+		qint64 ts = t.nsecsElapsed();
+
+		// raw bytes
+		t.restart();
+		PolygonBuffer bb;
+		bb.reserve(numPolygons, sb.numPoints());
+		for (int pIdx = 0; pIdx < numPolygons; pIdx++)
+			bb.add(data.constData() + offsets[pIdx], data.constData() + offsets[pIdx + 1]);
+		qint64 tb = t.nsecsElapsed();
+
+		// raw bytes - one buffer per thread
+		QAtomicInt numPoints;
+		t.restart();
+		cv::parallel_for_(cv::Range(0, numPolygons), [&](const cv::Range& r) {
+
+			PolygonBuffer pb;
+			for (int pIdx = r.start; pIdx < r.end; pIdx++)
+				pb.add(data.constData() + offsets[pIdx], data.constData() + offsets[pIdx + 1]);
+
+			numPoints.fetchAndAddRelaxed(pb.numPoints());
+		});
+		qint64 tp = t.nsecsElapsed();
+
+		bool success = sb.size() == numPolygons && bb.size() == numPolygons && numPoints.load() == bb.numPoints();
+
+		// numbers which overflow an int are illegal
+		QByteArray overflow = "1,2 2147483648,5 3,4 99999999999,1 2147483647,-2147483647";
+		QVector<QPoint> op;
+		Converter::parsePoints(overflow.constData(), overflow.constData() + overflow.size(), op);
+
+		if (op != QVector<QPoint>({ QPoint(1, 2), QPoint(3, 4), QPoint(INT_MAX, -INT_MAX) })) {
+			qWarning() << "[PolygonParsing] overflowing coordinates are not rejected:" << op;
+			success = false;
+		}
+
+		for (int pIdx = 0; pIdx < numPolygons && success; pIdx++) {
+
+			if (legacy[pIdx] != sb.polygon(pIdx) || legacy[pIdx] != bb.polygon(pIdx)) {
+				qWarning() << "[PolygonParsing] polygon" << pIdx << "differs:" << legacy[pIdx] << "vs" << sb.polygon(pIdx);
+				success = false;
+			}
+		}
+
+		auto gbs = [&](qint64 ns) { return data.size() / (double)qMax(ns, (qint64)1); };
+
+		qInfo().nospace() << "[PolygonParsing] " << numPolygons << " polygons, " << bb.numPoints() << " points, " << mb << " MB";
+		qInfo().nospace() << "[PolygonParsing] legacy: " << gbs(tl) << " GB/s";
+		qInfo().nospace() << "[PolygonParsing] QString spans: " << gbs(ts) << " GB/s" << " speed-up: " << (double)tl / qMax(ts, (qint64)1) << "x";
+		qInfo().nospace() << "[PolygonParsing] bytes: " << gbs(tb) << " GB/s" << " speed-up: " << (double)tl / qMax(tb, (qint64)1) << "x";
+		qInfo().nospace() << "[PolygonParsing] bytes (parallel): " << gbs(tp) << " GB/s" << " speed-up: " << (double)tl / qMax(tp, (qint64)1) << "x";
+
+		return success;
+	}
+}
+
 }
\ No newline at end of file
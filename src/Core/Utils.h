@@ -35,6 +35,7 @@
 #include <QSharedPointer>
 #include <QSettings>
 #include <QTime>
+#include <QPolygon>
 
 #include <opencv2/core.hpp>
 #pragma warning(pop)
@@ -122,6 +123,9 @@ public:
 	static QPolygon stringToPoly(const QString& pointList);
 	static QString polyToString(const QPolygon& poly);
 
+	static int parsePoints(const QStringRef& pointList, QVector<QPoint>& points);
+	static int parsePoints(const char* begin, const char* end, QVector<QPoint>& points);
+
 	static QPointF cvPointToQt(const cv::Point& pt);
 	static cv::Point2d qPointToCv(const QPointF& pt);
 
@@ -135,6 +139,40 @@ public:
 * This class is designed to measure the time of a method, especially
 * intervals and the total time can be measured.
 **/
+/// <summary>
+/// Parses many PAGE point lists into one contiguous buffer.
+/// In contrast to Converter::stringToPoly, no memory
+/// is allocated per point or polygon.
+/// Useage:
+///		PolygonBuffer pb;
+///		int idx = pb.add(attributes.value("points"));
+///		QRect r = pb.boundingRect(idx);
+/// </summary>
+class DllExport PolygonBuffer {
+
+public:
+	PolygonBuffer();
+
+	void reserve(int numPolygons, int numPoints);
+	void clear();
+
+	int add(const QStringRef& pointList);
+	int add(const char* begin, const char* end);
+	int add(const QPolygon& poly);
+
+	int size() const;
+	int numPoints() const;
+	int numPoints(int idx) const;
+	const QPoint* points(int idx) const;
+
+	QPolygon polygon(int idx) const;
+	QRect boundingRect(int idx) const;
+
+private:
+	QVector<QPoint> mPoints;
+	QVector<int> mOffsets;	// the first point of each polygon (and the end)
+};
+
 class DllExport Timer {
 
 public:
@@ -176,6 +214,19 @@ namespace ColorManager {
 
 	DllExport QPixmap colorizePixmap(const QPixmap& pm, const QColor& col, double opacity = 1.0);
 
+	// colormaps for continuous values
+	enum ColorMap {
+		cm_viridis,
+		cm_magma,
+		cm_coolwarm,
+		cm_gray,
+
+		cm_end
+	};
+
+	DllExport QString colorMapName(int cm);
+	DllExport QVector<QColor> colorMap(int cm, int size = 256);
+
 	// add your favorite colors here
 }
 
@@ -259,4 +310,8 @@ protected:
     Underlying mFlags;
 };
 
+namespace test {
+	DllExport bool PolygonParsing();
+}
+
 }
@@ -35,10 +35,23 @@
 #include "ActionManager.h"
 #include "Utils.h"
 #include "Processor.h"
+#include "Neighbors.h"
+#include "Clustering.h"
+#include "Algorithm.h"
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QDebug>
 #include <QMouseEvent>
+#include <QContextMenuEvent>
+#include <QMenu>
+#include <QToolTip>
+#include <QApplication>
+#include <QTimer>
+#include <QActionGroup>
+#include <QOpenGLTexture>
+
+#include <algorithm>
+#include <cmath>
 #include <QPainter>
 #include <QStyleOption>
 #pragma warning(pop)
@@ -61,6 +74,11 @@ namespace pie {
 		connect(mP, SIGNAL(pointAlphaChanged()), this, SLOT(update()));
 		connect(mP, SIGNAL(displayPercentChanged()), this, SLOT(update()));
 		connect(mP, SIGNAL(axisIndexChanged()), this, SLOT(update()));
+		connect(mP, SIGNAL(colorMapChanged(int)), this, SLOT(update()));
+		connect(mP, SIGNAL(colorRangeChanged(const QPointF&)), this, SLOT(update()));
+
+		mXTransform.setMode((AxisTransform::Mode)mP->axisTransform().x());
+		mYTransform.setMode((AxisTransform::Mode)mP->axisTransform().y());
 
 		ActionManager& m = ActionManager::instance();
 		connect(m.action(ActionManager::view_zoom_in), SIGNAL(triggered()), this, SLOT(zoomIn()));
@@ -69,6 +87,16 @@ namespace pie {
 		//connect(m.action(ActionManager::view_update), SIGNAL(triggered()), this, SLOT(update()));
 	}
 
+	DotViewPort::~DotViewPort() {
+
+		// GL resources must be released in our context
+		makeCurrent();
+		qDeleteAll(mColorMaps);
+		mVertexBuffer.destroy();
+		mColorBuffer.destroy();
+		doneCurrent();
+	}
+
 	void DotViewPort::initializeGL() {
 
 		// member init
@@ -180,6 +208,9 @@ namespace pie {
 		//	displayText = tr("Ich sehe gerade\nes ist ein bisschen\nwas durcheinander gekommen...");
 
 		drawDimArrows(p);
+		drawTicks(p);
+		drawPicked(p);
+		drawColorBar(p);
 
 		// currently vertical labels are always centered sorry for ignoring the style here...
 		QPen pen;
@@ -187,6 +218,8 @@ namespace pie {
 		p.setPen(pen);
 		p.drawText(rect(), Qt::AlignHCenter | Qt::AlignVCenter | Qt::TextWordWrap, displayText);
 
+		if (!std::isnan(mCorrelation))
+			p.drawText(rect().adjusted(4, 4, -4, -4), Qt::AlignRight | Qt::AlignTop, QString("r = %1").arg(mCorrelation, 0, 'f', 2));
 	}
 
 	void DotViewPort::drawArrow(QPainter& p, const QPoint & start, const QPoint & end, double angle) const {
@@ -251,6 +284,96 @@ namespace pie {
 		p.setPen(oldPen);
 	}
 
+	/// <summary>
+	/// Draws tick labels in real units (not screen coordinates).
+	/// </summary>
+	void DotViewPort::drawTicks(QPainter & p) const {
+
+		if (!mXMapper || !mYMapper)
+			return;
+
+		QPen oldPen = p.pen();
+		p.setPen(ColorManager::darkGray());
+
+		const QTransform& t = mP->worldMatrix();
+		const int numTicks = 5;
+		const int ts = 4;	// tick size
+
+		for (int idx = 0; idx < numTicks; idx++) {
+
+			double s = -1.0 + 2.0 * idx / (numTicks - 1);
+
+			// GL coordinates to widget coordinates
+			double x = width() / 2.0 + t.m11() * s * width() / 2.0 + t.dx();
+			double y = height() / 2.0 - t.m22() * s * height() / 2.0 - t.dy();
+
+			if (x >= 0 && x <= width()) {
+				p.drawLine(QPointF(x, height()), QPointF(x, height() - ts));
+				p.drawText(QPointF(x + 2, height() - ts - 2), QString::number(mXTransform.toValue(s), 'g', 4));
+			}
+
+			if (y >= 0 && y <= height()) {
+				p.drawLine(QPointF(0, y), QPointF(ts, y));
+				p.drawText(QPointF(ts + 2, y - 2), QString::number(mYTransform.toValue(s), 'g', 4));
+			}
+		}
+
+		p.setPen(oldPen);
+	}
+
+	/// <summary>
+	/// Marks the picked page and its most similar pages.
+	/// </summary>
+	void DotViewPort::drawPicked(QPainter & p) const {
+
+		if (mPickedPage < 0 || mPickedPage >= mXData.cols)
+			return;
+
+		QPen oldPen = p.pen();
+		QBrush oldBrush = p.brush();
+		p.setBrush(Qt::NoBrush);
+
+		const double r = 5.0;
+
+		p.setPen(ColorManager::blue());
+		for (int pIdx : mSimilarPages)
+			p.drawEllipse(toWidgetCoords(pIdx), r, r);
+
+		p.setPen(QPen(ColorManager::red(), 2));
+		p.drawEllipse(toWidgetCoords(mPickedPage), r + 1, r + 1);
+
+		p.setPen(oldPen);
+		p.setBrush(oldBrush);
+	}
+
+	/// <summary>
+	/// Draws the colormap's legend if points are colored by a feature.
+	/// </summary>
+	void DotViewPort::drawColorBar(QPainter & p) const {
+
+		if (!mCMapper || mCData.empty())
+			return;
+
+		QVector<QColor> cols = ColorManager::colorMap(mP->colorMap(), 16);
+		QRect r(10, 20, 100, 8);
+
+		QLinearGradient g(r.topLeft(), r.topRight());
+		for (int idx = 0; idx < cols.size(); idx++)
+			g.setColorAt((double)idx / (cols.size() - 1), cols[idx]);
+
+		QPen oldPen = p.pen();
+		p.fillRect(r, g);
+
+		// the colormap's range in feature units
+		QPointF cr = mP->colorRange();
+		p.setPen(ColorManager::darkGray());
+		p.drawText(QRect(r.left(), 2, 200, r.top() - 4), Qt::AlignLeft | Qt::AlignBottom, mCMapper->name());
+		p.drawText(QRect(r.left(), r.bottom() + 2, r.width(), 14), Qt::AlignLeft | Qt::AlignTop, QString::number(mCTransform.toValue(cr.x() * 2.0 - 1.0), 'g', 3));
+		p.drawText(QRect(r.left(), r.bottom() + 2, r.width(), 14), Qt::AlignRight | Qt::AlignTop, QString::number(mCTransform.toValue(cr.y() * 2.0 - 1.0), 'g', 3));
+
+		p.setPen(oldPen);
+	}
+
 	bool DotViewPort::drawPoints() {
 
 		if (!mCollection || !mXMapper || !mYMapper)
@@ -258,6 +381,9 @@ namespace pie {
 		
 		qDebug() << "drawing...";
 
+		if (mCMapper)
+			return drawPointsColored();
+
 		//glPointSize((GLfloat)mP->pointSize());
 		glPointSize(5);
 		glBegin(GL_POINTS);
@@ -278,11 +404,17 @@ namespace pie {
 		if (!mXMapper || !mYMapper)
 			return false; // illegal axis
 
-		if (mXData.cols != mYData.cols)
+		if (mXData.cols != mYData.cols || mXData.cols != mCollection->numPages())
 			return false;	// illegal data - out of sync?
 
-		// TODO: add colors here
-		
+		// pages are colored by their cluster (if clustered)
+		QSharedPointer<KMeans> km = mCollection->clustering();
+		const int* labels = km ? km->labels().ptr<int>() : 0;
+
+		QVector<QColor> clusterColors;
+		for (int idx = 0; km && idx < km->numClusters(); idx++)
+			clusterColors << ColorManager::color(idx, mP->alpha() / 255.0);
+
 		int start = 0;
 		for (auto doc : mCollection->documents()) {
 
@@ -300,6 +432,7 @@ namespace pie {
 
 			const float* x = mXData.ptr<float>()+start;
 			const float* y = mYData.ptr<float>()+start;
+			const int* l = labels && !doc->selected() ? labels + start : 0;
 
 			// draw the points
 			double skip = 0.0;
@@ -314,6 +447,11 @@ namespace pie {
 				//int dataIdx = labels.empty() || !syncedData || (int)label[rIdx] >= events.rows ? rIdx : label[rIdx];
 				//const float* sample = events.ptr<float>(dataIdx);
 
+				if (l) {
+					const QColor& cc = clusterColors[l[idx]];
+					glColor4f((GLfloat)cc.redF(), (GLfloat)cc.greenF(), (GLfloat)cc.blueF(), (GLfloat)cc.alphaF());
+				}
+
 				glVertex3f(x[idx], y[idx], zIndex);
 			}
 			start += doc->numPages();
@@ -322,6 +460,276 @@ namespace pie {
 		return true;
 	}
 
+	/// <summary>
+	/// Draws the points colored by the color feature.
+	/// Vertices and colormap coordinates live in buffers which are only
+	/// uploaded if their columns change. The colormap is a 1D lookup
+	/// texture and its range is applied by the texture matrix,
+	/// hence changing either of them does not touch the vertices.
+	/// </summary>
+	bool DotViewPort::drawPointsColored() {
+
+		const int n = mCollection->numPages();
+
+		if (mXData.cols != n || mYData.cols != n || mCData.cols != n)
+			return false;	// illegal data - out of sync?
+
+		uploadBuffers();
+
+		QOpenGLTexture* cm = colorMapTexture(mP->colorMap());
+
+		if (!cm)
+			return false;
+
+		// map the color range to [0 1]
+		QPointF cr = mP->colorRange();
+		double cw = qMax(cr.y() - cr.x(), 1e-6);
+
+		glMatrixMode(GL_TEXTURE);
+		glLoadIdentity();
+		glScaled(1.0 / cw, 1.0, 1.0);
+		glTranslated(-cr.x(), 0.0, 0.0);
+		glMatrixMode(GL_MODELVIEW);
+
+		// layers are defined by the drawing order
+		glDisable(GL_DEPTH_TEST);
+
+		glEnable(GL_TEXTURE_1D);
+		cm->bind();
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+		glColor4f(1.0f, 1.0f, 1.0f, (GLfloat)(mP->alpha() / 255.0f));
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+		// the pointers refer to the buffer which is bound when they are set
+		mVertexBuffer.bind();
+		glVertexPointer(2, GL_FLOAT, 0, 0);
+		mVertexBuffer.release();
+		mColorBuffer.bind();
+		glTexCoordPointer(1, GL_FLOAT, 0, 0);
+		mColorBuffer.release();
+
+		// display percent is applied by an index list
+		if (mP->displayPercent() < 100) {
+			const QVector<GLuint>& indices = drawIndices();
+			glDrawElements(GL_POINTS, indices.size(), GL_UNSIGNED_INT, indices.constData());
+		}
+		else
+			glDrawArrays(GL_POINTS, 0, n);
+
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		cm->release();
+		glDisable(GL_TEXTURE_1D);
+
+		glMatrixMode(GL_TEXTURE);
+		glLoadIdentity();
+		glMatrixMode(GL_MODELVIEW);
+
+		// selected documents are drawn on top
+		QColor sc = ColorManager::red();
+		glColor4f((GLfloat)sc.redF(), (GLfloat)sc.greenF(), (GLfloat)sc.blueF(), (GLfloat)sc.alphaF());
+
+		int start = 0;
+		for (auto doc : mCollection->documents()) {
+
+			if (doc->selected())
+				glDrawArrays(GL_POINTS, start, doc->numPages());
+
+			start += doc->numPages();
+		}
+
+		glDisableClientState(GL_VERTEX_ARRAY);
+
+		return true;
+	}
+
+	/// <summary>
+	/// Returns the indices of the pages which are drawn if only
+	/// a percentage of the points is displayed. Pages are skipped
+	/// per document with the same fractional skip as drawPointsLabels,
+	/// so both modes show the same points. The list is cached until
+	/// the display percent or the data changes.
+	/// </summary>
+	const QVector<GLuint>& DotViewPort::drawIndices() {
+
+		if (mDrawPercent == mP->displayPercent() && !mDrawIndices.isEmpty())
+			return mDrawIndices;
+
+		mDrawPercent = mP->displayPercent();
+		mDrawIndices.clear();
+
+		float skipFactor = (mDrawPercent == 100) ? 0.f : 1.f - mDrawPercent / 100.f;
+
+		GLuint start = 0;
+		for (auto doc : mCollection->documents()) {
+
+			int count = doc->numPages();
+
+			double skip = 0.0;
+			for (int idx = 0; idx < count; ++idx, skip += skipFactor) {
+
+				if (skip >= 1.0) {
+					skip -= 1.0;
+					continue;
+				}
+
+				mDrawIndices << start + idx;
+			}
+			start += count;
+		}
+
+		return mDrawIndices;
+	}
+
+	/// <summary>
+	/// Uploads the vertices and colormap coordinates.
+	/// Columns are shared by the FeatureCache, so a buffer is
+	/// only uploaded if its columns were replaced. If pages were
+	/// appended (e.g. a watched database grew) and the transforms
+	/// did not change, only the values after the first change are
+	/// written. Buffers are allocated with some headroom for that.
+	/// NOTE: the GL context must be current.
+	/// </summary>
+	void DotViewPort::uploadBuffers() {
+
+		const int n = mXData.cols;
+
+		if (mBufferX.data != mXData.data || mBufferY.data != mYData.data || !mVertexBuffer.isCreated()) {
+
+			if (!mVertexBuffer.isCreated()) {
+				mVertexBuffer.create();
+				mVertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+			}
+
+			mVertexBuffer.bind();
+
+			const bool fits = mVertexBuffer.size() >= (int)(n * 2 * sizeof(float));
+			const int first = fits ? qMin(firstChange(mBufferX, mXData), firstChange(mBufferY, mYData)) : 0;
+
+			cv::Mat v(1, (n - first) * 2, CV_32F);
+
+			const float* x = mXData.ptr<float>();
+			const float* y = mYData.ptr<float>();
+			float* vp = v.ptr<float>();
+
+			// interleave x y
+			cv::parallel_for_(cv::Range(first, n), [&](const cv::Range& r) {
+
+				for (int idx = r.start; idx < r.end; idx++) {
+					vp[2 * (idx - first)] = x[idx];
+					vp[2 * (idx - first) + 1] = y[idx];
+				}
+			});
+
+			if (!fits)
+				mVertexBuffer.allocate(capacity(n) * 2 * (int)sizeof(float));
+
+			if (!v.empty())
+				mVertexBuffer.write(first * 2 * (int)sizeof(float), vp, (int)(v.total() * sizeof(float)));
+
+			mVertexBuffer.release();
+
+			mBufferX = mXData;
+			mBufferY = mYData;
+		}
+
+		if (mBufferC.data != mCData.data || !mColorBuffer.isCreated()) {
+
+			if (!mColorBuffer.isCreated()) {
+				mColorBuffer.create();
+				mColorBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+			}
+
+			mColorBuffer.bind();
+
+			const bool fits = mColorBuffer.size() >= (int)(n * sizeof(float));
+			const int first = fits ? firstChange(mBufferC, mCData) : 0;
+
+			cv::Mat t(1, n - first, CV_32F);
+
+			const float* c = mCData.ptr<float>();
+			float* tp = t.ptr<float>();
+
+			// screen coordinates [-1 1] to colormap coordinates [0 1]
+			cv::parallel_for_(cv::Range(first, n), [&](const cv::Range& r) {
+
+				for (int idx = r.start; idx < r.end; idx++)
+					tp[idx - first] = std::isfinite(c[idx]) ? (c[idx] + 1.0f) * 0.5f : 0.0f;
+			});
+
+			if (!fits)
+				mColorBuffer.allocate(capacity(n) * (int)sizeof(float));
+
+			if (!t.empty())
+				mColorBuffer.write(first * (int)sizeof(float), tp, (int)(t.total() * sizeof(float)));
+
+			mColorBuffer.release();
+
+			mBufferC = mCData;
+		}
+	}
+
+	/// <summary>
+	/// Returns the index of the first value that differs.
+	/// </summary>
+	/// <param name="uploaded">The values which are uploaded.</param>
+	/// <param name="data">The new values.</param>
+	/// <returns>The index of the first value that needs to be uploaded.</returns>
+	int DotViewPort::firstChange(const cv::Mat & uploaded, const cv::Mat & data) {
+
+		const int n = qMin(uploaded.cols, data.cols);
+
+		if (n == 0 || uploaded.type() != data.type())
+			return 0;
+
+		const float* u = uploaded.ptr<float>();
+		const float* d = data.ptr<float>();
+
+		return (int)(std::mismatch(u, u + n, d).first - u);
+	}
+
+	/// <summary>
+	/// Returns the buffer size for n pages.
+	/// A quarter is reserved for pages that are appended later.
+	/// </summary>
+	int DotViewPort::capacity(int n) {
+		return n + n / 4;
+	}
+
+	/// <summary>
+	/// Returns the lookup texture of a colormap.
+	/// Textures are created once per colormap and view port.
+	/// NOTE: the GL context must be current.
+	/// </summary>
+	/// <param name="cm">The ColorManager::ColorMap.</param>
+	QOpenGLTexture* DotViewPort::colorMapTexture(int cm) {
+
+		QOpenGLTexture* t = mColorMaps.value(cm);
+
+		if (t)
+			return t;
+
+		QVector<QColor> cols = ColorManager::colorMap(cm);
+		QVector<uchar> lut;
+
+		for (const QColor& c : cols)
+			lut << (uchar)c.red() << (uchar)c.green() << (uchar)c.blue() << (uchar)255;
+
+		t = new QOpenGLTexture(QOpenGLTexture::Target1D);
+		t->setSize(cols.size());
+		t->setFormat(QOpenGLTexture::RGBA8_UNorm);
+		t->allocateStorage();
+		t->setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, lut.constData());
+		t->setMinificationFilter(QOpenGLTexture::Linear);
+		t->setMagnificationFilter(QOpenGLTexture::Linear);
+		t->setWrapMode(QOpenGLTexture::ClampToEdge);
+
+		mColorMaps.insert(cm, t);
+
+		return t;
+	}
+
 	//bool DotViewPort::drawPointsSelection(const cv::Mat & events, const DkSelectionModel & model) const {
 
 	//	if (model.selections().empty())
@@ -417,6 +825,13 @@ namespace pie {
 		//	mActiveSelection.clear();
 		//}
 
+		// a click (no drag) picks the page below the cursor
+		if (ev->button() == Qt::LeftButton && dist.length() < 3) {
+			mPickedPage = pickPage(ev->pos());
+			mSimilarPages.clear();
+			update();
+		}
+
 		// clean up
 		mLastMousePos = QPoint();
 		QOpenGLWidget::mouseReleaseEvent(ev);
@@ -473,6 +888,189 @@ namespace pie {
 			QOpenGLWidget::wheelEvent(ev);
 	}
 
+	void DotViewPort::contextMenuEvent(QContextMenuEvent * ev) {
+
+		int pIdx = pickPage(ev->pos());
+
+		if (pIdx >= 0 && pIdx != mPickedPage) {
+			mPickedPage = pIdx;
+			mSimilarPages.clear();
+			update();
+		}
+
+		QMenu menu(this);
+
+		if (pIdx >= 0) {
+			menu.addAction(tr("Show 20 Most Similar Pages"), this, SLOT(showSimilarPages()));
+			menu.addSeparator();
+		}
+
+		// color channel
+		QMenu* fm = menu.addMenu(tr("Color By"));
+		QActionGroup* fg = new QActionGroup(fm);
+		QMap<QString, QMenu*> groups;
+
+		QAction* da = new QAction(tr("Documents"), fg);
+		da->setData(-1);
+		da->setCheckable(true);
+		da->setChecked(!mCMapper);
+		fm->addAction(da);
+		fm->addSeparator();
+
+		for (const Feature& f : FeatureRegistry::instance().features()) {
+
+			QMenu* gm = groups.value(f.group());
+
+			if (!gm) {
+				gm = fm->addMenu(f.group());
+				groups.insert(f.group(), gm);
+			}
+
+			QAction* a = new QAction(f.name(), fg);
+			a->setData(f.id());
+			a->setCheckable(true);
+			a->setChecked(mCMapper && mCMapper->type() == f.id());
+			a->setEnabled(f.isAvailable(*mCollection));
+			gm->addAction(a);
+		}
+
+		QMenu* cm = menu.addMenu(tr("Colormap"));
+		QActionGroup* cg = new QActionGroup(cm);
+		cm->setEnabled(!mCMapper.isNull());
+
+		for (int idx = 0; idx < ColorManager::cm_end; idx++) {
+
+			QAction* a = new QAction(ColorManager::colorMapName(idx), cg);
+			a->setData(idx);
+			a->setCheckable(true);
+			a->setChecked(mP->colorMap() == idx);
+			cm->addAction(a);
+		}
+
+		// the range clips outliers
+		QMenu* rm = menu.addMenu(tr("Color Range"));
+		QActionGroup* rg = new QActionGroup(rm);
+		rm->setEnabled(!mCMapper.isNull());
+
+		QVector<double> clips;
+		clips << 0.0 << 0.01 << 0.05;
+
+		for (double c : clips) {
+			QAction* a = new QAction(c == 0.0 ? tr("Full Range") : tr("Clip %1%").arg(qRound(c * 100)), rg);
+			a->setData(c);
+			rm->addAction(a);
+		}
+
+		QAction* a = menu.exec(ev->globalPos());
+
+		if (!a)
+			return;
+		else if (a->actionGroup() == fg)
+			setColorIndex(a->data().toInt());
+		else if (a->actionGroup() == cg)
+			mP->setColorMap(a->data().toInt());
+		else if (a->actionGroup() == rg)
+			mP->setColorRange(colorPercentiles(a->data().toDouble()));
+	}
+
+	/// <summary>
+	/// Returns the colormap range which clips outliers of the color feature.
+	/// </summary>
+	/// <param name="clip">The fraction of pages clipped at either end (e.g. 0.01).</param>
+	/// <returns>The range in normalized feature values [0 1].</returns>
+	QPointF DotViewPort::colorPercentiles(double clip) const {
+
+		if (clip <= 0.0 || mCData.empty())
+			return QPointF(0, 1);
+
+		std::vector<float> v(mCData.ptr<float>(), mCData.ptr<float>() + mCData.cols);
+
+		int lIdx = qBound(0, qRound(clip * (v.size() - 1)), (int)v.size() - 1);
+		int uIdx = qBound(0, qRound((1.0 - clip) * (v.size() - 1)), (int)v.size() - 1);
+
+		std::nth_element(v.begin(), v.begin() + lIdx, v.end());
+		float lo = v[lIdx];
+		std::nth_element(v.begin(), v.begin() + uIdx, v.end());
+		float hi = v[uIdx];
+
+		// screen coordinates to [0 1]
+		return QPointF((lo + 1.0) * 0.5, (hi + 1.0) * 0.5);
+	}
+
+	/// <summary>
+	/// Highlights the pages which are most similar to the picked page.
+	/// Similar pages are the nearest neighbors in the (full) feature space
+	/// and not necessarily close to each other in the current plot.
+	/// </summary>
+	void DotViewPort::showSimilarPages() {
+
+		if (!mCollection || mPickedPage < 0)
+			return;
+
+		Timer dt;
+		QApplication::setOverrideCursor(Qt::WaitCursor);
+
+		// the index is built (or loaded) once per collection
+		QSharedPointer<NeighborIndex> ni = mCollection->neighborIndex();
+		QVector<NeighborIndex::Neighbor> nbs = ni->neighbors(mPickedPage, 20);
+
+		QApplication::restoreOverrideCursor();
+
+		QVector<QSharedPointer<PageData> > pages = mCollection->pages();
+		QString msg = tr("Pages similar to %1:").arg(pages[mPickedPage]->name());
+
+		mSimilarPages.clear();
+		for (const NeighborIndex::Neighbor& nb : nbs) {
+			mSimilarPages << nb.page;
+			msg += "\n" + pages[nb.page]->name() + " (" + QString::number(nb.distance, 'f', 2) + ")";
+		}
+
+		qInfo().noquote() << msg;
+		qDebug() << "similar pages found in" << dt;
+
+		QToolTip::showText(mapToGlobal(toWidgetCoords(mPickedPage).toPoint()), msg, this);
+		update();
+	}
+
+	/// <summary>
+	/// Returns the page which is closest to pos.
+	/// </summary>
+	/// <param name="pos">The position in widget coordinates.</param>
+	/// <param name="radius">The maximal distance in pixels.</param>
+	/// <returns>The page's index or -1 if no page is within the radius.</returns>
+	int DotViewPort::pickPage(const QPoint & pos, int radius) const {
+
+		if (!mCollection || mXData.cols != mYData.cols || mXData.cols != mCollection->numPages())
+			return -1;
+
+		const QTransform& t = mP->worldMatrix();
+		const float* x = mXData.ptr<float>();
+		const float* y = mYData.ptr<float>();
+
+		// the inverse of toWidgetCoords - so that pages are not mapped one by one
+		double gx = (pos.x() - width() / 2.0 - t.dx()) / (t.m11() * width() / 2.0);
+		double gy = -(pos.y() - height() / 2.0 + t.dy()) / (t.m22() * height() / 2.0);
+		double sx = t.m11() * width() / 2.0;
+		double sy = t.m22() * height() / 2.0;
+
+		int best = -1;
+		double bestDist = (double)radius * radius;
+
+		for (int idx = 0; idx < mXData.cols; idx++) {
+
+			double dx = (x[idx] - gx) * sx;
+			double dy = (y[idx] - gy) * sy;
+			double d = dx * dx + dy * dy;
+
+			if (d < bestDist) {
+				bestDist = d;
+				best = idx;
+			}
+		}
+
+		return best;
+	}
+
 	void DotViewPort::zoomIn() {
 
 		if (parentHasFocus())
@@ -507,6 +1105,33 @@ namespace pie {
 		mIsSelected = selected;
 	}
 
+	/// <summary>
+	/// Sets the correlation coefficient of the displayed axes.
+	/// It is reset whenever an axis or its transform changes.
+	/// </summary>
+	/// <param name="r">Pearson's r or NaN to hide it.</param>
+	void DotViewPort::setCorrelation(double r) {
+		mCorrelation = r;
+		update();
+	}
+
+	/// <summary>
+	/// Returns the picked page and the pages similar to it (sorted).
+	/// </summary>
+	QVector<int> DotViewPort::pickedPages() const {
+
+		if (mPickedPage < 0)
+			return QVector<int>();
+
+		QVector<int> pageIdx = mSimilarPages;
+		pageIdx << mPickedPage;
+
+		std::sort(pageIdx.begin(), pageIdx.end());
+		pageIdx.erase(std::unique(pageIdx.begin(), pageIdx.end()), pageIdx.end());
+
+		return pageIdx;
+	}
+
 	void DotViewPort::moveView(const QPointF& dxy) {
 
 		//qDebug() << "translating by: " << dxy;
@@ -556,6 +1181,15 @@ namespace pie {
 		return glp;
 	}
 
+	QPointF DotViewPort::toWidgetCoords(int pageIdx) const {
+
+		const QTransform& t = mP->worldMatrix();
+		double x = width() / 2.0 + t.m11() * mXData.at<float>(pageIdx) * width() / 2.0 + t.dx();
+		double y = height() / 2.0 - t.m22() * mYData.at<float>(pageIdx) * height() / 2.0 - t.dy();
+
+		return QPointF(x, y);
+	}
+
 	void DotViewPort::map(QPainter & painter) const {
 
 		// map to view
@@ -579,18 +1213,140 @@ namespace pie {
 		return hasFocus() || (p && p->hasFocus()) || mIsSelected;
 	}
 
+	/// <summary>
+	/// Recomputes the point buffers.
+	/// Call this if pages were added to the collection.
+	/// </summary>
+	void DotViewPort::updateData() {
+
+		// page indices are not valid anymore if pages were added
+		if (mCollection && mNumPages != mCollection->numPages()) {
+			mPickedPage = -1;
+			mSimilarPages.clear();
+		}
+
+		if (mCollection)
+			mNumPages = mCollection->numPages();
+
+		// documents might have changed
+		mDrawIndices.clear();
+
+		if (mXMapper && mYMapper) {
+
+			// both axes are computed in one pass (if not cached)
+			QVector<AxisTransform> ts;
+			ts << mXTransform << mYTransform;
+
+			QVector<cv::Mat> cols = mCollection->featureCache()->columns(QVector<int>() << mXMapper->type() << mYMapper->type(), ts);
+			mXData = cols[0];
+			mYData = cols[1];
+			mXTransform = ts[0];
+			mYTransform = ts[1];
+		}
+		else if (mXMapper)
+			mXData = process(mXMapper, mXTransform);
+		else if (mYMapper)
+			mYData = process(mYMapper, mYTransform);
+
+		if (mCMapper)
+			mCData = process(mCMapper, mCTransform);
+
+		update();
+	}
+
+	/// <summary>
+	/// Releases the columns (and the uploaded copies) of the plot.
+	/// Call this if the plot is hidden - the collection's columns
+	/// can only be evicted if no plot references them (see MemoryBudget).
+	/// updateData() fetches the columns again.
+	/// </summary>
+	void DotViewPort::releaseData() {
+
+		mXData.release();
+		mYData.release();
+		mCData.release();
+		mBufferX.release();
+		mBufferY.release();
+		mBufferC.release();
+		mDrawIndices.clear();
+	}
+
+	/// <summary>
+	/// Colors the points by a feature.
+	/// </summary>
+	/// <param name="id">The feature id or -1 to color points by their document.</param>
+	void DotViewPort::setColorIndex(int id) {
+
+		mP->setColorIndex(id);
+
+		if (id < 0) {
+			mCMapper.clear();
+			mCData = cv::Mat();
+		}
+		else if (!mCMapper || mCMapper->type() != id) {
+			mCMapper = AbstractMapper::create(id);
+
+			if (mCMapper)
+				mCData = process(mCMapper, mCTransform);
+
+			// a new feature starts with the full range
+			mP->setColorRange(QPointF(0, 1));
+		}
+
+		update();
+	}
+
+	cv::Mat DotViewPort::process(QSharedPointer<AbstractMapper> mapper, AxisTransform & transform) const {
+
+		// columns are shared with other plots
+		return mCollection->featureCache()->column(mapper->type(), transform);
+	}
+
+	/// <summary>
+	/// Changes the transforms (AxisTransform::Mode) of the axes.
+	/// </summary>
+	/// <param name="modes">The x and y modes (-1 keeps the current mode).</param>
+	void DotViewPort::setAxisTransform(const QPoint & modes) {
+
+		mP->setAxisTransform(modes);
+
+		QPoint m = mP->axisTransform();
+
+		// the correlation was computed on the old transform
+		if (m.x() != mXTransform.mode() || m.y() != mYTransform.mode())
+			mCorrelation = std::numeric_limits<double>::quiet_NaN();
+
+		if (m.x() != mXTransform.mode() && mXMapper) {
+			mXTransform.setMode((AxisTransform::Mode)m.x());
+			mXData = process(mXMapper, mXTransform);
+		}
+
+		if (m.y() != mYTransform.mode() && mYMapper) {
+			mYTransform.setMode((AxisTransform::Mode)m.y());
+			mYData = process(mYMapper, mYTransform);
+		}
+
+		// keep the mode for mappers selected later on
+		mXTransform.setMode((AxisTransform::Mode)m.x());
+		mYTransform.setMode((AxisTransform::Mode)m.y());
+
+		update();
+	}
+
 	void DotViewPort::setAxisIndex(const QPoint& dims) {
 
 		mP->setAxisIndex(dims);
 
 		if (dims.x() != AbstractMapper::m_undefined && (!mXMapper || mXMapper->type() != dims.x())) {
-			mXMapper = AbstractMapper::create((AbstractMapper::Type)dims.x());
-			mXData = mXMapper->process(mCollection.data());
+			mXMapper = AbstractMapper::create(dims.x());
+			mXData = process(mXMapper, mXTransform);
+			mCorrelation = std::numeric_limits<double>::quiet_NaN();
 		}
 
 		if (dims.y() != AbstractMapper::m_undefined && (!mYMapper || mYMapper->type() != dims.y())) {
-			mYMapper = AbstractMapper::create((AbstractMapper::Type)dims.y());
-			mYData = mYMapper->process(mCollection.data());
+			mCorrelation = std::numeric_limits<double>::quiet_NaN();
+			mYMapper = AbstractMapper::create(dims.y());
+			mYData = process(mYMapper, mYTransform);
 		}
 
 		if (mXMapper)
@@ -601,4 +1357,416 @@ namespace pie {
 		update();
 	}
 
+	// -------------------------------------------------------------------- HistViewPort 
+	HistViewPort::HistViewPort(QSharedPointer<Collection> collection, HistPlotParams* params, QWidget* parent) : QWidget(parent) {
+
+		mCollection = collection;
+		mP = params;
+		setObjectName("HistViewPort");
+
+		mTransform.setMode((AxisTransform::Mode)mP->axisTransform().x());
+
+		// wheel events come in bursts - re-bin once they are done
+		mRebinTimer = new QTimer(this);
+		mRebinTimer->setSingleShot(true);
+		mRebinTimer->setInterval(100);
+		connect(mRebinTimer, SIGNAL(timeout()), this, SLOT(rebin()));
+
+		connect(mP, SIGNAL(numBinsChanged(int)), this, SLOT(rebin()));
+		connect(mP, SIGNAL(stackedChanged(bool)), this, SLOT(update()));
+
+		ActionManager& m = ActionManager::instance();
+		connect(m.action(ActionManager::view_zoom_in), SIGNAL(triggered()), this, SLOT(zoomIn()));
+		connect(m.action(ActionManager::view_zoom_out), SIGNAL(triggered()), this, SLOT(zoomOut()));
+		connect(m.action(ActionManager::view_reset), SIGNAL(triggered()), this, SLOT(resetView()));
+	}
+
+	void HistViewPort::paintEvent(QPaintEvent* ev) {
+
+		QPainter p(this);
+
+		QStyleOption opt;
+		opt.init(this);
+
+		style()->drawPrimitive(QStyle::PE_Widget, &opt, &p, this);
+		p.setRenderHints(QPainter::Antialiasing);
+
+		// the pages were clustered (or the clusters were removed)
+		if (mCollection->clustering() != mClustering) {
+			updateSeries();
+			computeBins();
+		}
+
+		drawBins(p);
+		drawTicks(p);
+		drawEmpty(p);
+
+		QWidget::paintEvent(ev);
+	}
+
+	void HistViewPort::drawBins(QPainter & p) const {
+
+		if (mCounts.empty() || mCounts.rows != mNumSeries)
+			return;
+
+		const bool stacked = mP->stacked();
+		const int nb = mCounts.cols;
+		QVector<QColor> cols = seriesColors();
+
+		// scale the highest bar to the widget's height
+		int maxCount = 1;
+		for (int bIdx = 0; bIdx < nb; bIdx++) {
+
+			int c = 0;
+			for (int sIdx = 0; sIdx < mCounts.rows; sIdx++)
+				c = stacked ? c + mCounts.at<int>(sIdx, bIdx) : qMax(c, mCounts.at<int>(sIdx, bIdx));
+
+			maxCount = qMax(maxCount, c);
+		}
+
+		const double sy = (height() - 14.0) / maxCount;
+		const double bw = (mBinRange[1] - mBinRange[0]) / nb;
+
+		for (int bIdx = 0; bIdx < nb; bIdx++) {
+
+			double x0 = toWidgetX(mBinRange[0] + bIdx * bw);
+			double x1 = toWidgetX(mBinRange[0] + (bIdx + 1) * bw);
+			double y = height();
+
+			for (int sIdx = 0; sIdx < mCounts.rows; sIdx++) {
+
+				int c = mCounts.at<int>(sIdx, bIdx);
+
+				if (c == 0)
+					continue;
+
+				QColor col = cols[sIdx];
+				if (!stacked)
+					col.setAlphaF(0.5);
+
+				double h = c * sy;
+				p.fillRect(QRectF(x0, (stacked ? y : height()) - h, qMax(x1 - x0 - 1.0, 1.0), h), col);
+
+				if (stacked)
+					y -= h;
+			}
+		}
+
+		p.setPen(ColorManager::darkGray());
+		p.drawText(QPointF(4, 12), QString::number(maxCount));
+	}
+
+	void HistViewPort::drawTicks(QPainter & p) const {
+
+		if (!mMapper)
+			return;
+
+		QPen oldPen = p.pen();
+		p.setPen(ColorManager::darkGray());
+
+		const int numTicks = 5;
+		const int ts = 4;	// tick size
+
+		for (int idx = 0; idx < numTicks; idx++) {
+
+			// ticks are equally spaced on the screen
+			double x = width() * (idx + 0.5) / numTicks;
+			double s = (x - width() / 2.0 - mP->worldMatrix().dx()) / (mP->worldMatrix().m11() * width() / 2.0);
+
+			p.drawLine(QPointF(x, height()), QPointF(x, height() - ts));
+			p.drawText(QPointF(x + 2, height() - ts - 2), QString::number(mTransform.toValue(s), 'g', 4));
+		}
+
+		p.setPen(oldPen);
+	}
+
+	void HistViewPort::drawEmpty(QPainter & p) const {
+
+		if (mMapper)
+			return;
+
+		QPen pen;
+		pen.setColor(ColorManager::blue());
+		p.setPen(pen);
+		p.drawText(rect(), Qt::AlignHCenter | Qt::AlignVCenter | Qt::TextWordWrap, tr("Please select a feature."));
+	}
+
+	/// <summary>
+	/// Assigns pages to series.
+	/// Series are clusters if the pages are clustered and documents otherwise.
+	/// </summary>
+	void HistViewPort::updateSeries() {
+
+		mClustering = mCollection->clustering();
+
+		if (mClustering) {
+			mSeries = mClustering->labels();
+			mNumSeries = mClustering->numClusters();
+			return;
+		}
+
+		// documents hold consecutive pages
+		mSeries = cv::Mat(1, mCollection->numPages(), CV_32SC1, cv::Scalar(-1));
+		mNumSeries = 0;
+
+		int* s = mSeries.ptr<int>();
+		int start = 0;
+
+		for (auto doc : mCollection->documents()) {
+
+			int end = qMin(start + doc->numPages(), mSeries.cols);
+			std::fill(s + start, s + end, mNumSeries);
+
+			start = end;
+			mNumSeries++;
+		}
+	}
+
+	QVector<QColor> HistViewPort::seriesColors() const {
+
+		QVector<QColor> cols;
+
+		if (mClustering) {
+			for (int idx = 0; idx < mNumSeries; idx++)
+				cols << ColorManager::color(idx);
+		}
+		else {
+			for (auto doc : mCollection->documents())
+				cols << (doc->selected() ? ColorManager::red() : doc->color());
+		}
+
+		// the collection might have changed since the series were assigned
+		cols.resize(mNumSeries);
+
+		return cols;
+	}
+
+	/// <summary>
+	/// Counts the pages in bins which cover the visible range.
+	/// </summary>
+	void HistViewPort::computeBins() {
+
+		if (mData.empty() || mData.cols != mSeries.cols) {
+			mCounts.release();
+			return;
+		}
+
+		Timer dt;
+		cv::Vec2d r = visibleRange();
+		mCounts = Math::histogram(mData, r[0], r[1], mP->numBins(), mSeries, mNumSeries);
+		mBinRange = r;
+
+		qDebug() << mData.cols << "pages binned in" << dt;
+	}
+
+	void HistViewPort::rebin() {
+
+		computeBins();
+		update();
+	}
+
+	/// <summary>
+	/// Returns the visible part of the data range [-1 1].
+	/// </summary>
+	cv::Vec2d HistViewPort::visibleRange() const {
+
+		const QTransform& t = mP->worldMatrix();
+		double sx = t.m11() * width() / 2.0;
+
+		// not shown yet
+		if (sx <= 0.0)
+			return cv::Vec2d(-1.0, 1.0);
+
+		double lo = (-width() / 2.0 - t.dx()) / sx;
+		double hi = (width() / 2.0 - t.dx()) / sx;
+
+		return cv::Vec2d(qMax(lo, -1.0), qMin(hi, 1.0));
+	}
+
+	double HistViewPort::toWidgetX(double s) const {
+
+		const QTransform& t = mP->worldMatrix();
+		return width() / 2.0 + t.m11() * s * width() / 2.0 + t.dx();
+	}
+
+	void HistViewPort::updateData() {
+
+		if (mMapper) {
+			mData = mCollection->featureCache()->column(mMapper->type(), mTransform);
+		}
+
+		updateSeries();
+		rebin();
+	}
+
+	/// <summary>
+	/// Releases the column and the bins (see DotViewPort::releaseData).
+	/// </summary>
+	void HistViewPort::releaseData() {
+
+		mData.release();
+		mSeries.release();
+		mCounts.release();
+	}
+
+	void HistViewPort::setAxisIndex(const QPoint & dims) {
+
+		mP->setAxisIndex(dims);
+
+		if (dims.x() != AbstractMapper::m_undefined && (!mMapper || mMapper->type() != dims.x())) {
+			mMapper = AbstractMapper::create(dims.x());
+			updateData();
+		}
+
+		if (mMapper)
+			mP->setXAxisName(mMapper->name());
+
+		update();
+	}
+
+	void HistViewPort::setAxisTransform(const QPoint & modes) {
+
+		mP->setAxisTransform(modes);
+
+		int m = mP->axisTransform().x();
+
+		if (m != mTransform.mode()) {
+			mTransform.setMode((AxisTransform::Mode)m);
+
+			if (mMapper)
+				updateData();
+		}
+	}
+
+	/// <summary>
+	/// Moves the view horizontally.
+	/// </summary>
+	/// <param name="dx">The offset in pixels.</param>
+	void HistViewPort::moveView(double dx) {
+
+		QTransform t = mP->worldMatrix();
+		mP->setWorldMatrix(QTransform(t.m11(), 0.0, 0.0, 1.0, t.dx() - dx, 0.0));
+
+		// bins are stretched until the data is re-binned
+		update();
+		mRebinTimer->start();
+	}
+
+	/// <summary>
+	/// Zooms horizontally.
+	/// </summary>
+	/// <param name="factor">The relative zoom (> 0 zooms in).</param>
+	/// <param name="center">The x coordinate which is kept (-1 for the widget's center).</param>
+	void HistViewPort::zoom(float factor, double center) {
+
+		const QTransform& t = mP->worldMatrix();
+		double c = center < 0 ? width() / 2.0 : center;
+
+		// the data coordinate below c stays in place
+		double s = (c - width() / 2.0 - t.dx()) / (t.m11() * width() / 2.0);
+		double m11 = qMax(t.m11() * (factor + 1.0), 0.5);
+		double dx = c - width() / 2.0 - m11 * s * width() / 2.0;
+
+		mP->setWorldMatrix(QTransform(m11, 0.0, 0.0, 1.0, dx, 0.0));
+
+		update();
+		mRebinTimer->start();
+	}
+
+	void HistViewPort::resetView() {
+
+		if (parentHasFocus()) {
+			mP->setWorldMatrix(QTransform());
+			rebin();
+		}
+	}
+
+	void HistViewPort::zoomIn() {
+
+		if (parentHasFocus())
+			zoom(.1f);
+	}
+
+	void HistViewPort::zoomOut() {
+
+		if (parentHasFocus())
+			zoom(-.1f);
+	}
+
+	void HistViewPort::setSelected(bool selected) {
+		mIsSelected = selected;
+	}
+
+	bool HistViewPort::parentHasFocus() const {
+
+		auto p = dynamic_cast<QWidget*>(parent());
+		return hasFocus() || (p && p->hasFocus()) || mIsSelected;
+	}
+
+	void HistViewPort::mousePressEvent(QMouseEvent * ev) {
+
+		if (ev->buttons() & Qt::LeftButton)
+			mLastMousePos = ev->pos();
+
+		QWidget::mousePressEvent(ev);
+	}
+
+	void HistViewPort::mouseMoveEvent(QMouseEvent * ev) {
+
+		if (!mLastMousePos.isNull() &&
+			(ev->buttons() & Qt::LeftButton) &&
+			ev->modifiers() == Qt::NoModifier) {
+
+			moveView(mLastMousePos.x() - ev->pos().x());
+			mLastMousePos = ev->pos();
+			return; // do not propagate
+		}
+
+		QWidget::mouseMoveEvent(ev);
+	}
+
+	void HistViewPort::mouseReleaseEvent(QMouseEvent * ev) {
+
+		mLastMousePos = QPoint();
+		QWidget::mouseReleaseEvent(ev);
+	}
+
+	void HistViewPort::wheelEvent(QWheelEvent * ev) {
+
+		if (hasFocus() || parentHasFocus()) {
+			zoom((float)ev->delta() / 1200.0f, ev->pos().x());
+			ev->accept();
+		}
+		else
+			QWidget::wheelEvent(ev);
+	}
+
+	void HistViewPort::contextMenuEvent(QContextMenuEvent * ev) {
+
+		QMenu menu(this);
+
+		QAction* stackedAction = menu.addAction(tr("Stacked"));
+		stackedAction->setCheckable(true);
+		stackedAction->setChecked(mP->stacked());
+
+		QMenu* bm = menu.addMenu(tr("Bins"));
+		QActionGroup* bg = new QActionGroup(bm);
+
+		for (int nb : {16, 32, 64, 128, 256}) {
+
+			QAction* a = new QAction(QString::number(nb), bg);
+			a->setData(nb);
+			a->setCheckable(true);
+			a->setChecked(nb == mP->numBins());
+			bm->addAction(a);
+		}
+
+		QAction* a = menu.exec(ev->globalPos());
+
+		if (a == stackedAction)
+			mP->setStacked(a->isChecked());
+		else if (a && a->data().isValid())
+			mP->setNumBins(a->data().toInt());
+	}
+
 }
\ No newline at end of file
@@ -34,13 +34,18 @@
 #include "PageData.h"
 #include "BasePlot.h"
 #include "Plot.h"
+#include "Processor.h"
 
 #pragma warning(push, 0)	// no warnings from includes
 #include <QWidget>
 #include <QOpenGLWidget>
+#include <QOpenGLBuffer>
 #include <QAction>
+#include <QHash>
 
 #include <opencv2/core.hpp>
+
+#include <limits>
 #pragma warning(pop)
 
 #pragma warning (disable: 4251)	// inlined Qt functions in dll interface
@@ -54,28 +59,39 @@
 #endif
 
 // Qt defines
+class QTimer;
+class QOpenGLTexture;
 
 namespace pie {
 
 	class AbstractMapper;
 	class DotPlot;
+	class HistPlotParams;
+	class KMeans;
 
 	class DllExport DotViewPort : public QOpenGLWidget {
 		Q_OBJECT
 
 	public:
 		DotViewPort(QSharedPointer<Collection> collection, DotPlotParams* params, DotPlot* parent = 0);
-	virtual ~DotViewPort() {}
+		virtual ~DotViewPort();
 
 		void moveView(const QPointF& dxy);
 		void zoom(float factor, const QPointF& center = QPointF());
 
 		void setSelected(bool selected);
+		void setCorrelation(double r);
+		QVector<int> pickedPages() const;
 
 	signals:
 
 	public slots:
 		virtual void setAxisIndex(const QPoint& dims);
+		void setAxisTransform(const QPoint& modes);
+		void setColorIndex(int id);
+		void updateData();
+		void releaseData();
+		void showSimilarPages();
 		void resetView();
 		void zoomIn();
 		void zoomOut();
@@ -90,6 +106,12 @@ namespace pie {
 		virtual bool drawGL();
 		virtual bool drawPoints();
 		bool drawPointsLabels() const;
+		bool drawPointsColored();
+		const QVector<GLuint>& drawIndices();
+		void uploadBuffers();
+		static int firstChange(const cv::Mat& uploaded, const cv::Mat& data);
+		static int capacity(int n);
+		QOpenGLTexture* colorMapTexture(int cm);
 		//bool drawPointsSelection(const cv::Mat& data, const DkSelectionModel& model) const;
 
 		// annotations
@@ -98,6 +120,9 @@ namespace pie {
 		//void drawSunSystem(QPainter& p, DkSolarSystem* system) const;
 		//void drawSolarSystemGL(DkSolarSystem* system) const;
 		void drawDimArrows(QPainter& p) const;
+		void drawTicks(QPainter& p) const;
+		void drawPicked(QPainter& p) const;
+		void drawColorBar(QPainter& p) const;
 		void drawArrow(QPainter& p, const QPoint& start, const QPoint& end, double angle) const;
 		//QString mapMouseCoords(const QPoint& coords) const;
 
@@ -105,11 +130,16 @@ namespace pie {
 		void mousePressEvent(QMouseEvent *ev);
 		void mouseReleaseEvent(QMouseEvent *ev);
 		void wheelEvent(QWheelEvent *ev);
+		void contextMenuEvent(QContextMenuEvent *ev);
 		QPointF toGLCoords(const QPoint& p) const;
+		QPointF toWidgetCoords(int pageIdx) const;
+		int pickPage(const QPoint& pos, int radius = 8) const;
+		QPointF colorPercentiles(double clip) const;
 
 		bool parentHasFocus() const;
 		
 		void map(QPainter& painter) const;
+		cv::Mat process(QSharedPointer<AbstractMapper> mapper, AxisTransform& transform) const;
 
 		QPoint mFirstMousePos;
 		QPoint mLastMousePos;
@@ -127,7 +157,96 @@ namespace pie {
 		cv::Mat mXData;
 		cv::Mat mYData;
 
+		AxisTransform mXTransform;
+		AxisTransform mYTransform;
+
+		// color channel
+		QSharedPointer<AbstractMapper> mCMapper;
+		AxisTransform mCTransform;
+		cv::Mat mCData;
+
+		QOpenGLBuffer mVertexBuffer;	// x y per page
+		QOpenGLBuffer mColorBuffer;		// a colormap coordinate [0 1] per page
+		cv::Mat mBufferX;				// the columns which are currently uploaded
+		cv::Mat mBufferY;
+		cv::Mat mBufferC;
+		QHash<int, QOpenGLTexture*> mColorMaps;	// 1D lookup textures per ColorManager::ColorMap
+		QVector<GLuint> mDrawIndices;	// the pages which are drawn for mDrawPercent
+		int mDrawPercent = -1;
+
+		int mPickedPage = -1;
+		QVector<int> mSimilarPages;		// neighbors of the picked page
+		int mNumPages = 0;				// the number of pages when the data was updated
+
+		double mCorrelation = std::numeric_limits<double>::quiet_NaN();	// of the displayed axes (NaN if unknown)
+
 		//QSharedPointer<DkSelection> mActiveSelection;
 	};
 
+	/// <summary>
+	/// Shows the distribution of a feature.
+	/// Pages are binned by a parallel kernel and shown as series
+	/// (per document or per cluster) which are stacked or overlaid.
+	/// Zooming re-bins the visible range so that bins keep their width.
+	/// </summary>
+	class DllExport HistViewPort : public QWidget {
+		Q_OBJECT
+
+	public:
+		HistViewPort(QSharedPointer<Collection> collection, HistPlotParams* params, QWidget* parent = 0);
+		virtual ~HistViewPort() {}
+
+		void moveView(double dx);
+		void zoom(float factor, double center = -1.0);
+
+		void setSelected(bool selected);
+
+	public slots:
+		void setAxisIndex(const QPoint& dims);
+		void setAxisTransform(const QPoint& modes);
+		void updateData();
+		void releaseData();
+		void rebin();
+		void resetView();
+		void zoomIn();
+		void zoomOut();
+
+	protected:
+		void paintEvent(QPaintEvent* ev) override;
+		void mousePressEvent(QMouseEvent* ev) override;
+		void mouseMoveEvent(QMouseEvent* ev) override;
+		void mouseReleaseEvent(QMouseEvent* ev) override;
+		void wheelEvent(QWheelEvent* ev) override;
+		void contextMenuEvent(QContextMenuEvent* ev) override;
+
+		void drawBins(QPainter& p) const;
+		void drawTicks(QPainter& p) const;
+		void drawEmpty(QPainter& p) const;
+
+		void updateSeries();
+		void computeBins();
+		QVector<QColor> seriesColors() const;
+		cv::Vec2d visibleRange() const;
+		double toWidgetX(double s) const;
+		bool parentHasFocus() const;
+
+		QSharedPointer<Collection> mCollection;
+		HistPlotParams* mP;
+
+		QSharedPointer<AbstractMapper> mMapper;
+		AxisTransform mTransform;
+		cv::Mat mData;			// 1 x pages in screen coordinates [-1 1]
+
+		cv::Mat mSeries;		// the series of each page (1 x pages, CV_32S)
+		int mNumSeries = 0;
+		QSharedPointer<KMeans> mClustering;	// series are clusters if set
+
+		cv::Mat mCounts;		// series x bins
+		cv::Vec2d mBinRange;	// the range of mCounts in screen coordinates
+		QTimer* mRebinTimer = 0;
+
+		QPoint mLastMousePos;
+		bool mIsSelected = false;
+	};
+
 }
\ No newline at end of file
@@ -47,6 +47,7 @@ namespace pie {
 
 		const ActionManager& am = ActionManager::instance();
 		connect(am.action(ActionManager::file_open_database), SIGNAL(triggered()), this, SLOT(openDialog()));
+		connect(am.action(ActionManager::file_import_page_xml), SIGNAL(triggered()), this, SLOT(importDialog()));
 	}
 
 	DialogManager& DialogManager::instance() {
@@ -60,7 +61,7 @@ namespace pie {
 	void DialogManager::openDialog() {
 
 		QStringList openFilters;
-		openFilters << tr("Collection (*.json)");
+		openFilters << tr("Collection (*.json *.json.gz *.json.zst *.shards)");
 
 		const auto& s = Settings::instance().app();
 		QString ldir = !s.recentFiles.isEmpty() ? s.recentFiles[0] : "";
@@ -78,6 +79,26 @@ namespace pie {
 		emit loadFileSignal(filePath);
 	}
 
+	/// <summary>
+	/// Opens a folder of PAGE XML files.
+	/// The DatabaseLoader ingests folders directly.
+	/// </summary>
+	void DialogManager::importDialog() {
+
+		const auto& s = Settings::instance().app();
+		QString ldir = !s.recentFiles.isEmpty() ? s.recentFiles[0] : "";
+
+		QString dirPath = QFileDialog::getExistingDirectory(
+			wm::dialogParent(),
+			tr("Import PAGE XML"),
+			ldir);
+
+		if (dirPath.isEmpty())
+			return;
+
+		emit loadFileSignal(dirPath);
+	}
+
 	// -------------------------------------------------------------------- general functions 
 	QWidget * wm::dialogParent() {
 
@@ -69,6 +69,7 @@ namespace pie {
 
 	public slots:
 		void openDialog();
+		void importDialog();
 
 	private:
 		DialogManager();
@@ -35,6 +35,7 @@
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QDebug>
+#include <QDir>
 
 #include <opencv2/core.hpp>
 #pragma warning(pop)
@@ -43,6 +44,10 @@
 #include "PageData.h"
 #include "Utils.h"
 #include "DatabaseLoader.h"
+#include "Network.h"
+#include "PageXml.h"
+#include "TextStore.h"
+#include "PolygonStore.h"
 #include "PieUi.h"
 #include "Settings.h"
 
@@ -83,6 +88,35 @@ int main(int argc, char** argv) {
 	QCommandLineOption testOpt(QStringList() << "test", QObject::tr("If set, Unit Tests are performed"));
 	parser.addOption(testOpt);
 
+	QCommandLineOption benchmarkOpt(QStringList() << "benchmark", QObject::tr("If set, micro benchmarks are performed"));
+	parser.addOption(benchmarkOpt);
+
+	// field projection
+	QCommandLineOption fieldsOpt(QStringList() << "fields", 
+		QObject::tr("Comma separated list of page fields that are loaded (xml, text, collection, document, image, regions)."), 
+		"list");
+	parser.addOption(fieldsOpt);
+
+	QCommandLineOption watchOpt(QStringList() << "watch", 
+		QObject::tr("If set, changes of open databases (e.g. appended documents) are applied to the plots."));
+	parser.addOption(watchOpt);
+
+	QCommandLineOption budgetOpt(QStringList() << "memory-budget", 
+		QObject::tr("The RAM in MB used by all tabs, hidden tabs are moved to disk if it is exceeded (0 keeps all tabs in RAM)."), 
+		"MB");
+	parser.addOption(budgetOpt);
+
+	// PAGE XML ingest
+	QCommandLineOption ingestOpt(QStringList() << "ingest", 
+		QObject::tr("Creates a PIE database from a folder of PAGE XML files."), 
+		"folder");
+	parser.addOption(ingestOpt);
+
+	QCommandLineOption outputOpt(QStringList() << "o" << "output", 
+		QObject::tr("The database which is written by --ingest (default: <folder>.json)."), 
+		"path");
+	parser.addOption(outputOpt);
+
 	parser.process(*QCoreApplication::instance());
 	// CMD parser --------------------------------------------------------------------
 
@@ -95,15 +129,70 @@ int main(int argc, char** argv) {
 
 	pie::DefaultSettings ds;
 	pie::Settings::instance().app().load(ds);
+
+	if (parser.isSet(fieldsOpt))
+		pie::Settings::instance().app().loadFields = parser.value(fieldsOpt);
+
+	if (parser.isSet(watchOpt))
+		pie::Settings::instance().app().watchFiles = true;
+
+	if (parser.isSet(budgetOpt))
+		pie::Settings::instance().app().memoryBudget = parser.value(budgetOpt).toInt();
 	
 	qDebug() << "lol <-- help me, I am drowning";
 
-	// for now
-	if (parser.isSet(testOpt)) {
-		pie::DatabaseLoader db("C:/temp/db.json");
-		db.parse();
+	if (parser.isSet(benchmarkOpt)) {
+		bool success = pie::test::Quantiles();
+		success = pie::test::PolygonParsing() && success;
+
+		if (!success)
+			return 1;
+	}
+	else if (parser.isSet(ingestOpt)) {
+
+		QString dirPath = QDir::cleanPath(parser.value(ingestOpt));
+		QString dbPath = parser.isSet(outputOpt) ? parser.value(outputOpt) : dirPath + ".json";
+
+		pie::LoadOptions options;
+		options.fields = pie::FieldProjection::fromString(parser.value(fieldsOpt));
+
+		// keep texts on disk - they are only needed for writing
+		options.textStore = QSharedPointer<pie::TextStore>::create();
+		options.polygons = QSharedPointer<pie::PolygonStore>::create();
+
+		pie::PageXmlIngester pi(dirPath);
+		pi.setOptions(options);
+
+		if (!pi.ingest() || !pie::PageXmlIngester::write(*pi.collection(), dbPath))
+			return 1;
+	}
+	else if (parser.isSet(testOpt)) {
+
+		// all tests run - a single failure fails the run
+		bool success = pie::test::Quantiles();
+		success = pie::test::PolygonParsing() && success;
+		success = pie::test::Downloads() && success;
+		success = pie::test::RemoteDatabase() && success;
+
+		// the processor is tested on a database (if given)
+		if (!parser.positionalArguments().isEmpty()) {
+
+			pie::DatabaseLoader db(parser.positionalArguments().first());
+
+			// only load what the processor needs
+			if (parser.isSet(fieldsOpt))
+				db.setFields(pie::FieldProjection::fromString(parser.value(fieldsOpt)));
+			else
+				db.setFields(pie::AbstractMapper::collectFields(
+					{ pie::AbstractMapper::m_reg_width, pie::AbstractMapper::m_reg_height, pie::AbstractMapper::m_reg_area }));
+
+			success = db.parse() && pie::test::Processor(*db.collection()) && success;
+		}
+
+		qInfo() << (success ? "all tests passed" : "tests FAILED");
 
-		pie::test::Processor(*db.collection());
+		if (!success)
+			return 1;
 	}
 	// show them what we've got
 	else {